@@ -0,0 +1,312 @@
+//*****************************************************************************
+//
+// bulk_dma.c - Tests the uDMA transfer mode of the bulk device class against
+//              the software model of the uDMA controller and endpoint FIFOs.
+//
+// A bulk device with four endpoint pairs is enumerated with
+// USBD_BULK_FLAG_DMA set on every pair.  Endpoints 1 to 3 have uDMA channels
+// so their packets must only reach the FIFO or the client's buffer once the
+// uDMA transfer completes, while endpoint 4 has none and must fall back to
+// CPU copies.  Packets are passed in both directions on every pair and the
+// data and the callbacks reporting it are checked.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The number of endpoint pairs offered by the device and the number of them
+// which have uDMA channels.
+//
+//*****************************************************************************
+#define NUM_PIPES               4
+#define NUM_DMA_PIPES           3
+
+//*****************************************************************************
+//
+// The number of packets passed in each direction on each pair.
+//
+//*****************************************************************************
+#define NUM_PACKETS             8
+
+//*****************************************************************************
+//
+// The state recorded by the callbacks of one endpoint pair.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char pucRx[64];
+    unsigned long ulRxRequests;
+    unsigned long ulRxAvailable;
+    unsigned long ulRxSize;
+    unsigned long ulTxComplete;
+    unsigned long ulTxBytes;
+}
+tPipeState;
+
+static tPipeState g_psPipeState[NUM_PIPES];
+
+//*****************************************************************************
+//
+// The receive callback.  Every packet is read into the pair's buffer.
+//
+//*****************************************************************************
+static unsigned long
+RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    tPipeState *psState = pvCBData;
+
+    switch(ulEvent)
+    {
+        case USB_EVENT_REQUEST_BUFFER:
+        {
+            psState->ulRxRequests++;
+            *(unsigned char **)pvMsgData = psState->pucRx;
+            return(sizeof(psState->pucRx));
+        }
+
+        case USB_EVENT_RX_AVAILABLE:
+        {
+            CHECK(pvMsgData == psState->pucRx);
+            psState->ulRxAvailable++;
+            psState->ulRxSize = ulMsgValue;
+            return(ulMsgValue);
+        }
+
+        default:
+        {
+            return(0);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// The transmit callback.
+//
+//*****************************************************************************
+static unsigned long
+TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    tPipeState *psState = pvCBData;
+
+    if(ulEvent == USB_EVENT_TX_COMPLETE)
+    {
+        psState->ulTxComplete++;
+        psState->ulTxBytes += ulMsgValue;
+    }
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The bulk device and its additional endpoint pairs.
+//
+//*****************************************************************************
+static tBulkInstance g_psBulkInst[NUM_PIPES];
+
+#define PIPE(n)                                                               \
+    {                                                                         \
+        0, 0, 0, 0,                                                           \
+        RxHandler, &g_psPipeState[n],                                         \
+        TxHandler, &g_psPipeState[n],                                         \
+        0, 0,                                                                 \
+        &g_psBulkInst[n],                                                     \
+        USBD_BULK_FLAG_DMA,                                                   \
+        0, 0                                                                  \
+    }
+
+static const tUSBDBulkDevice g_psPipes[NUM_PIPES - 1] =
+{
+    PIPE(1), PIPE(2), PIPE(3)
+};
+
+static const tUSBDBulkDevice * const g_ppsPipes[NUM_PIPES - 1] =
+{
+    &g_psPipes[0], &g_psPipes[1], &g_psPipes[2]
+};
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    RxHandler,
+    &g_psPipeState[0],
+    TxHandler,
+    &g_psPipeState[0],
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_psBulkInst[0],
+    USBD_BULK_FLAG_DMA,
+    g_ppsPipes,
+    NUM_PIPES - 1
+};
+
+//*****************************************************************************
+//
+// Returns the device structure of endpoint pair ulPipe.
+//
+//*****************************************************************************
+static void *
+Pipe(unsigned long ulPipe)
+{
+    return(ulPipe ? (void *)&g_psPipes[ulPipe - 1] : (void *)&g_sBulkDevice);
+}
+
+//*****************************************************************************
+//
+// Sends a packet from the device to the host on endpoint pair ulPipe.
+//
+//*****************************************************************************
+static void
+CheckIN(unsigned long ulPipe, unsigned long ulSize, unsigned char ucSeed)
+{
+    unsigned char pucData[64], pucHost[64];
+    unsigned long ulEndpoint, ulLoop, ulTransfers, ulComplete;
+    tBoolean bDMA;
+
+    ulEndpoint = ulPipe + 1;
+    bDMA = (ulPipe < NUM_DMA_PIPES) ? true : false;
+    for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+    {
+        pucData[ulLoop] = (unsigned char)(ucSeed + (ulLoop * 3));
+    }
+
+    ulTransfers = SimDMATransfers();
+    ulComplete = g_psPipeState[ulPipe].ulTxComplete;
+    CHECK(USBDBulkPacketWrite(Pipe(ulPipe), pucData, ulSize, true) ==
+          ulSize);
+
+    if(bDMA)
+    {
+        //
+        // The packet must not be sent until the uDMA controller has loaded
+        // it and no further packet may be accepted in the meantime.
+        //
+        CHECK(SimPacketsQueued(0, ulEndpoint, true) == 0);
+        CHECK(USBDBulkPacketWrite(Pipe(ulPipe), pucData, ulSize, true) == 0);
+        CHECK(SimDMARun() == 1);
+        CHECK(SimDMATransfers() == (ulTransfers + 1));
+    }
+    else
+    {
+        CHECK(SimDMATransfers() == ulTransfers);
+    }
+
+    CHECK(SimPacketsQueued(0, ulEndpoint, true) == 1);
+    CHECK(SimHostIn(0, ulEndpoint, pucHost) == (long)ulSize);
+    CHECK(memcmp(pucData, pucHost, ulSize) == 0);
+    CHECK(g_psPipeState[ulPipe].ulTxComplete == (ulComplete + 1));
+    CHECK(USBDBulkTxPacketAvailable(Pipe(ulPipe)) != 0);
+}
+
+//*****************************************************************************
+//
+// Sends a packet from the host to the device on endpoint pair ulPipe.
+//
+//*****************************************************************************
+static void
+CheckOUT(unsigned long ulPipe, unsigned long ulSize, unsigned char ucSeed)
+{
+    unsigned char pucData[64];
+    unsigned long ulEndpoint, ulLoop, ulTransfers, ulAvailable;
+    tPipeState *psState;
+    tBoolean bDMA;
+
+    ulEndpoint = ulPipe + 1;
+    bDMA = (ulPipe < NUM_DMA_PIPES) ? true : false;
+    psState = &g_psPipeState[ulPipe];
+    for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+    {
+        pucData[ulLoop] = (unsigned char)(ucSeed ^ (ulLoop * 5));
+    }
+    memset(psState->pucRx, 0, sizeof(psState->pucRx));
+
+    ulTransfers = SimDMATransfers();
+    ulAvailable = psState->ulRxAvailable;
+    CHECK(SimHostOut(0, ulEndpoint, pucData, ulSize));
+
+    if(bDMA)
+    {
+        //
+        // The client must not be told of the packet until the uDMA
+        // controller has read it and the packet must stay in the FIFO until
+        // then.
+        //
+        CHECK(psState->ulRxAvailable == ulAvailable);
+        CHECK(SimPacketsQueued(0, ulEndpoint, false) == 1);
+        CHECK(SimDMARun() == 1);
+        CHECK(SimDMATransfers() == (ulTransfers + 1));
+    }
+    else
+    {
+        CHECK(SimDMATransfers() == ulTransfers);
+    }
+
+    CHECK(psState->ulRxAvailable == (ulAvailable + 1));
+    CHECK(psState->ulRxSize == ulSize);
+    CHECK(memcmp(pucData, psState->pucRx, ulSize) == 0);
+    CHECK(SimPacketsQueued(0, ulEndpoint, false) == 0);
+}
+
+//*****************************************************************************
+//
+// Enumerates the device then passes packets in both directions on each
+// endpoint pair.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulPipe, ulPacket, ulBytes;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+
+    CHECK(USBDBulkInit(0, (tUSBDBulkDevice *)&g_sBulkDevice) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+
+    ulBytes = 0;
+    for(ulPacket = 0; ulPacket < NUM_PACKETS; ulPacket++)
+    {
+        for(ulPipe = 0; ulPipe < NUM_PIPES; ulPipe++)
+        {
+            CheckIN(ulPipe, 64 - (ulPacket * 7), ulPacket + ulPipe);
+            CheckOUT(ulPipe, 64 - (ulPacket * 5), ulPacket * ulPipe);
+            if(ulPipe < NUM_DMA_PIPES)
+            {
+                ulBytes += (64 - (ulPacket * 7)) + (64 - (ulPacket * 5));
+            }
+        }
+    }
+
+    //
+    // Every packet on the pairs with channels went through the uDMA
+    // controller and no other packet did.
+    //
+    CHECK(SimDMATransfers() == (NUM_PACKETS * NUM_DMA_PIPES * 2));
+    CHECK(SimDMABytes() == ulBytes);
+    for(ulPipe = 0; ulPipe < NUM_PIPES; ulPipe++)
+    {
+        CHECK(g_psPipeState[ulPipe].ulRxRequests == NUM_PACKETS);
+    }
+
+    printf("%lu uDMA transfers, %lu bytes\n", SimDMATransfers(),
+           SimDMABytes());
+
+    return(SimResult("bulk_dma"));
+}
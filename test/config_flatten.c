@@ -0,0 +1,356 @@
+//*****************************************************************************
+//
+// config_flatten.c - Checks that configuration descriptors served from the
+//                    buffer filled by USBDCDConfigDescFlatten() match those
+//                    built section by section.
+//
+// Each device's configuration descriptors are read with a range of wLength
+// values, including lengths either side of each packet boundary and of the
+// descriptor's own length, while they are built from their sections.  The
+// descriptors are then flattened and read again with the same lengths, and
+// every reply must be identical.  The devices are a bulk device with four
+// endpoint pairs, whose descriptor spans two packets, and a made-up device
+// with two configurations whose sections include an empty one and one which
+// crosses a packet boundary.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The largest descriptor read and the number of guard bytes placed after the
+// flattened descriptors.
+//
+//*****************************************************************************
+#define MAX_DESC                512
+#define GUARD                   16
+
+//*****************************************************************************
+//
+// The wLength values used to read each descriptor.  Those which depend on the
+// descriptor's length are given as offsets from it.
+//
+//*****************************************************************************
+static const unsigned short g_pusLengths[] =
+{
+    1, 9, 18, 63, 64, 65, 127, 128, 129, MAX_DESC
+};
+
+#define NUM_LENGTHS             (sizeof(g_pusLengths) /                       \
+                                 sizeof(g_pusLengths[0]))
+
+static const long g_plOffsets[] = { -1, 0, 1 };
+
+#define NUM_OFFSETS             (sizeof(g_plOffsets) / sizeof(g_plOffsets[0]))
+
+//*****************************************************************************
+//
+// The replies read while the descriptors are built from their sections.
+//
+//*****************************************************************************
+typedef struct
+{
+    long lSize;
+    unsigned char pucData[MAX_DESC];
+}
+tReply;
+
+static tReply g_psReplies[2][NUM_LENGTHS + NUM_OFFSETS];
+
+//*****************************************************************************
+//
+// The bulk device.
+//
+//*****************************************************************************
+#define NUM_PIPES               4
+
+static tBulkInstance g_psBulkInst[NUM_PIPES];
+
+static unsigned long
+Handler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+        void *pvMsgData)
+{
+    return(0);
+}
+
+#define PIPE(n)                                                               \
+    {                                                                         \
+        0, 0, 0, 0,                                                           \
+        Handler, 0,                                                           \
+        Handler, 0,                                                           \
+        0, 0,                                                                 \
+        &g_psBulkInst[n],                                                     \
+        0,                                                                    \
+        0, 0                                                                  \
+    }
+
+static const tUSBDBulkDevice g_psPipes[NUM_PIPES - 1] =
+{
+    PIPE(1), PIPE(2), PIPE(3)
+};
+
+static const tUSBDBulkDevice * const g_ppsPipes[NUM_PIPES - 1] =
+{
+    &g_psPipes[0], &g_psPipes[1], &g_psPipes[2]
+};
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    Handler,
+    0,
+    Handler,
+    0,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_psBulkInst[0],
+    0,
+    g_ppsPipes,
+    NUM_PIPES - 1
+};
+
+//*****************************************************************************
+//
+// The made-up device with two configurations.  Each begins with a
+// configuration descriptor whose wTotalLength is left for the library to
+// fill in.  The second configuration carries a vendor-specific descriptor
+// long enough to cross a packet boundary.
+//
+//*****************************************************************************
+static const unsigned char g_pucTwoDeviceDesc[18] =
+{
+    18, USB_DTYPE_DEVICE, 0x00, 0x02, USB_CLASS_VEND_SPECIFIC, 0, 0, 64,
+    0xbe, 0x1c, 0x04, 0x00, 0x00, 0x01, 1, 2, 3, 2
+};
+
+static const unsigned char g_pucTwoConfig1[9] =
+{
+    9, USB_DTYPE_CONFIGURATION, 0, 0, 1, 1, 0, USB_CONF_ATTR_SELF_PWR, 0
+};
+
+static const unsigned char g_pucTwoConfig2[9] =
+{
+    9, USB_DTYPE_CONFIGURATION, 0, 0, 1, 2, 0, USB_CONF_ATTR_SELF_PWR, 0
+};
+
+static const unsigned char g_pucTwoInterface[9 + 7 + 7] =
+{
+    9, USB_DTYPE_INTERFACE, 0, 0, 2, USB_CLASS_VEND_SPECIFIC, 0, 0, 0,
+    7, USB_DTYPE_ENDPOINT, USB_EP_DESC_IN | 1, USB_EP_ATTR_BULK, 64, 0, 0,
+    7, USB_DTYPE_ENDPOINT, USB_EP_DESC_OUT | 1, USB_EP_ATTR_BULK, 64, 0, 0
+};
+
+static unsigned char g_pucTwoVendor[100];
+
+static const tConfigSection g_sTwoConfig1 = { 9, g_pucTwoConfig1 };
+static const tConfigSection g_sTwoConfig2 = { 9, g_pucTwoConfig2 };
+static const tConfigSection g_sTwoEmpty = { 0, g_pucTwoInterface };
+static const tConfigSection g_sTwoInterface =
+{
+    sizeof(g_pucTwoInterface), g_pucTwoInterface
+};
+static const tConfigSection g_sTwoVendor =
+{
+    sizeof(g_pucTwoVendor), g_pucTwoVendor
+};
+
+static const tConfigSection * const g_psTwoSections1[] =
+{
+    &g_sTwoConfig1, &g_sTwoEmpty, &g_sTwoInterface
+};
+
+static const tConfigSection * const g_psTwoSections2[] =
+{
+    &g_sTwoConfig2, &g_sTwoInterface, &g_sTwoVendor, &g_sTwoEmpty,
+    &g_sTwoInterface
+};
+
+static const tConfigHeader g_sTwoHeader1 = { 3, g_psTwoSections1 };
+static const tConfigHeader g_sTwoHeader2 = { 5, g_psTwoSections2 };
+
+static const tConfigHeader * const g_ppsTwoConfigs[] =
+{
+    &g_sTwoHeader1, &g_sTwoHeader2
+};
+
+static tDeviceInfo g_sTwoDeviceInfo =
+{
+    { 0 },
+    g_pucTwoDeviceDesc,
+    g_ppsTwoConfigs,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_sUSBDefaultFIFOConfig,
+    0
+};
+
+//*****************************************************************************
+//
+// Reads configuration descriptor ulConfig with each wLength in turn.  If
+// bRecord is true, the replies are recorded, otherwise they are checked
+// against those recorded.  Returns the descriptor's wTotalLength.
+//
+//*****************************************************************************
+static unsigned long
+ReadConfig(unsigned long ulConfig, tBoolean bRecord)
+{
+    unsigned char pucHeader[9];
+    unsigned long ulTotal, ulLoop;
+    unsigned short usLength;
+    tReply sReply, *psReply;
+
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         (USB_DTYPE_CONFIGURATION << 8) | ulConfig, 0, 9,
+                         pucHeader) == 9);
+    ulTotal = pucHeader[2] | (pucHeader[3] << 8);
+    CHECK((ulTotal >= 9) && ((ulTotal + 1) <= MAX_DESC));
+
+    for(ulLoop = 0; ulLoop < (NUM_LENGTHS + NUM_OFFSETS); ulLoop++)
+    {
+        usLength = (ulLoop < NUM_LENGTHS) ? g_pusLengths[ulLoop] :
+                   ulTotal + g_plOffsets[ulLoop - NUM_LENGTHS];
+        psReply = &g_psReplies[ulConfig][ulLoop];
+
+        memset(&sReply, 0, sizeof(sReply));
+        sReply.lSize = SimHostControl(0, USB_RTYPE_DIR_IN |
+                                      USB_RTYPE_STANDARD | USB_RTYPE_DEVICE,
+                                      USBREQ_GET_DESCRIPTOR,
+                                      (USB_DTYPE_CONFIGURATION << 8) |
+                                      ulConfig, 0, usLength,
+                                      sReply.pucData);
+        CHECK(sReply.lSize == (long)((usLength < ulTotal) ? usLength :
+                                     ulTotal));
+
+        if(bRecord)
+        {
+            *psReply = sReply;
+        }
+        else
+        {
+            CHECK(sReply.lSize == psReply->lSize);
+            CHECK(memcmp(sReply.pucData, psReply->pucData,
+                         sizeof(sReply.pucData)) == 0);
+        }
+    }
+
+    return(ulTotal);
+}
+
+//*****************************************************************************
+//
+// Reads each of the device's configuration descriptors before and after
+// flattening them and checks that nothing changes.
+//
+//*****************************************************************************
+static void
+CheckFlatten(const char *pcName, unsigned long ulNumConfigs)
+{
+    static unsigned char pucFlat[(2 * MAX_DESC) + GUARD];
+    unsigned long ulConfig, ulTotal, ulSize, ulPos, ulLoop;
+
+    ulTotal = 0;
+    for(ulConfig = 0; ulConfig < ulNumConfigs; ulConfig++)
+    {
+        ulTotal += ReadConfig(ulConfig, true);
+    }
+
+    //
+    // Asking for the size must report all of the configurations, and a
+    // buffer one byte short must be refused and leave the descriptors
+    // served as before.
+    //
+    ulSize = USBDCDConfigDescFlatten(0, 0, 0);
+    CHECK(ulSize == ulTotal);
+    memset(pucFlat, 0xa5, sizeof(pucFlat));
+    CHECK(USBDCDConfigDescFlatten(0, pucFlat, ulSize - 1) == 0);
+    CHECK(pucFlat[0] == 0xa5);
+    for(ulConfig = 0; ulConfig < ulNumConfigs; ulConfig++)
+    {
+        ReadConfig(ulConfig, false);
+    }
+
+    //
+    // Flatten the descriptors.  Nothing may be written beyond them and each
+    // configuration must follow the last with its length filled in.
+    //
+    CHECK(USBDCDConfigDescFlatten(0, pucFlat, sizeof(pucFlat) - GUARD) ==
+          ulSize);
+    for(ulLoop = ulSize; ulLoop < sizeof(pucFlat); ulLoop++)
+    {
+        CHECK(pucFlat[ulLoop] == 0xa5);
+    }
+    ulPos = 0;
+    for(ulConfig = 0; ulConfig < ulNumConfigs; ulConfig++)
+    {
+        CHECK(pucFlat[ulPos + 1] == USB_DTYPE_CONFIGURATION);
+        CHECK(memcmp(pucFlat + ulPos, g_psReplies[ulConfig][NUM_LENGTHS +
+                                                            1].pucData,
+                     pucFlat[ulPos + 2] | (pucFlat[ulPos + 3] << 8)) == 0);
+        ulPos += pucFlat[ulPos + 2] | (pucFlat[ulPos + 3] << 8);
+    }
+    CHECK(ulPos == ulSize);
+
+    //
+    // Every read must give the same reply as before.
+    //
+    for(ulConfig = 0; ulConfig < ulNumConfigs; ulConfig++)
+    {
+        ReadConfig(ulConfig, false);
+    }
+
+    //
+    // There is no configuration beyond the last.
+    //
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         (USB_DTYPE_CONFIGURATION << 8) | ulNumConfigs, 0,
+                         9, pucFlat) < 0);
+
+    printf("%-5s %lu configuration%s, %lu bytes\n", pcName, ulNumConfigs,
+           (ulNumConfigs == 1) ? "" : "s", ulSize);
+}
+
+//*****************************************************************************
+//
+// Checks both devices.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulLoop;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    CHECK(USBDBulkInit(0, (tUSBDBulkDevice *)&g_sBulkDevice) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+    CheckFlatten("bulk", 1);
+
+    g_pucTwoVendor[0] = sizeof(g_pucTwoVendor);
+    g_pucTwoVendor[1] = 0xff;
+    for(ulLoop = 2; ulLoop < sizeof(g_pucTwoVendor); ulLoop++)
+    {
+        g_pucTwoVendor[ulLoop] = (unsigned char)ulLoop;
+    }
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    USBDCDInit(0, &g_sTwoDeviceInfo);
+    SimHostReset(0);
+    CheckFlatten("two", 2);
+
+    return(SimResult("config_flatten"));
+}
@@ -0,0 +1,367 @@
+//*****************************************************************************
+//
+// fifo_map.c - Checks the endpoint FIFO map planned by USBDeviceConfig() for
+//              the default configuration of each device class.
+//
+// Each class's configuration descriptor is passed to USBDeviceConfig() and
+// the FIFOs it sets up in the simulated controller are checked against the
+// endpoints the descriptor declares.  Every endpoint must have a FIFO large
+// enough for its largest packet in any alternate setting, the FIFOs must not
+// overlap each other or endpoint zero and must fit in the FIFO RAM, and
+// bulk and isochronous endpoints must be double-buffered, unless the class
+// opts out, exactly as USBDCDEndpointDoubleBuffered() reports.  The FIFO use
+// reported by USBDCDFIFOUsageGet() must match the map.  Two made-up
+// configurations then check that double-buffering stops when the FIFO RAM is
+// exhausted and that a configuration which does not fit is refused with its
+// FIFO use reported.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The device information of each class tested.
+//
+//*****************************************************************************
+extern tDeviceInfo g_sBulkDeviceInfo;
+extern tDeviceInfo g_sCDCSerDeviceInfo;
+extern tDeviceInfo g_sHIDDeviceInfo;
+extern tDeviceInfo g_sMSCDeviceInfo;
+extern tDeviceInfo g_sAudioDeviceInfo;
+extern tDeviceInfo g_sDFUDeviceInfo;
+
+static const struct
+{
+    const char *pcName;
+    tDeviceInfo *psInfo;
+}
+g_psClasses[] =
+{
+    { "bulk", &g_sBulkDeviceInfo },
+    { "cdc", &g_sCDCSerDeviceInfo },
+    { "hid", &g_sHIDDeviceInfo },
+    { "msc", &g_sMSCDeviceInfo },
+    { "audio", &g_sAudioDeviceInfo },
+    { "dfu", &g_sDFUDeviceInfo }
+};
+
+#define NUM_CLASSES             (sizeof(g_psClasses) / sizeof(g_psClasses[0]))
+
+//*****************************************************************************
+//
+// The endpoints declared by a configuration descriptor, indexed by direction
+// (0 for IN, 1 for OUT) and endpoint number.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulMaxPacket;
+    unsigned char ucType;
+}
+tEndpointUse;
+
+//*****************************************************************************
+//
+// Records the largest packet size and the transfer type of each endpoint in
+// every section of a configuration descriptor.
+//
+//*****************************************************************************
+static void
+EndpointsFind(const tConfigHeader *psConfig, tEndpointUse psUse[2][8])
+{
+    const unsigned char *pucDesc, *pucEnd;
+    unsigned long ulSection, ulEP, ulDir, ulSize;
+
+    memset(psUse, 0, sizeof(tEndpointUse) * 16);
+
+    for(ulSection = 0; ulSection < psConfig->ucNumSections; ulSection++)
+    {
+        pucDesc = psConfig->psSections[ulSection]->pucData;
+        pucEnd = pucDesc + psConfig->psSections[ulSection]->usSize;
+        while((pucDesc < pucEnd) && pucDesc[0])
+        {
+            if(pucDesc[1] == USB_DTYPE_ENDPOINT)
+            {
+                ulEP = pucDesc[2] & USB_EP_DESC_NUM_M;
+                ulDir = (pucDesc[2] & USB_EP_DESC_IN) ? 0 : 1;
+                ulSize = pucDesc[4] | (pucDesc[5] << 8);
+                if(ulSize > psUse[ulDir][ulEP].ulMaxPacket)
+                {
+                    psUse[ulDir][ulEP].ulMaxPacket = ulSize;
+                }
+                if((pucDesc[3] & USB_EP_ATTR_TYPE_M) != USB_EP_ATTR_INT)
+                {
+                    psUse[ulDir][ulEP].ucType =
+                        pucDesc[3] & USB_EP_ATTR_TYPE_M;
+                }
+            }
+            pucDesc += pucDesc[0];
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Configures the simulated controller for a device and checks the FIFO map.
+// If bRoomy is true, the configuration is one which leaves room to
+// double-buffer every bulk and isochronous endpoint.
+//
+// \return Returns the number of FIFO RAM bytes the FIFOs occupy.
+//
+//*****************************************************************************
+static unsigned long
+CheckFIFOMap(const char *pcName, tDeviceInfo *psInfo, tBoolean bRoomy)
+{
+    tEndpointUse psUse[2][8];
+    const tSimFIFO *psFIFO, *psOther;
+    const tFIFOEntry *psEntry;
+    unsigned long ulEP, ulDir, ulOEP, ulODir, ulBuffer, ulUsed, ulAvailable;
+    unsigned long ulEnd, ulFIFOs, ulDB;
+    tBoolean bDB, bAuto;
+
+    SimReset();
+    g_psUSBDevice[0].ulIndex = 0;
+    g_psUSBDevice[0].psInfo = psInfo;
+
+    EndpointsFind(psInfo->ppConfigDescriptors[0], psUse);
+
+    if(!CHECK(USBDeviceConfig(&g_psUSBDevice[0],
+                              psInfo->ppConfigDescriptors[0])))
+    {
+        printf("%s: USBDeviceConfig() failed\n", pcName);
+        return(0);
+    }
+
+    ulUsed = USBDCDFIFOUsageGet(0, &ulAvailable);
+    CHECK(ulAvailable == SIM_FIFO_RAM_SIZE);
+    CHECK(ulUsed <= ulAvailable);
+
+    printf("%-6s", pcName);
+    ulEnd = MAX_PACKET_SIZE_EP0;
+    ulFIFOs = 0;
+    ulDB = 0;
+    for(ulEP = 1; ulEP < 8; ulEP++)
+    {
+        for(ulDir = 0; ulDir < 2; ulDir++)
+        {
+            psFIFO = SimFIFOGet(0, ulEP, ulDir == 0);
+
+            //
+            // Only the endpoints in the descriptor may have FIFOs.
+            //
+            if(!psUse[ulDir][ulEP].ulMaxPacket)
+            {
+                CHECK(!psFIFO->bConfigured);
+                continue;
+            }
+            if(!CHECK(psFIFO->bConfigured))
+            {
+                continue;
+            }
+            ulFIFOs++;
+
+            printf(" %s%lu@%lu+%lu%s", ulDir ? "OUT" : "IN", ulEP,
+                   psFIFO->ulAddress, psFIFO->ulSize,
+                   psFIFO->bDoubleBuffered ? "(DB)" : "");
+
+            //
+            // Each buffer must hold the largest packet of any alternate
+            // setting as well as the packet size of the default setting.
+            //
+            ulBuffer = psFIFO->ulSize / (psFIFO->bDoubleBuffered ? 2 : 1);
+            CHECK(ulBuffer >= psUse[ulDir][ulEP].ulMaxPacket);
+            CHECK(ulBuffer >= psFIFO->ulMaxPacket);
+
+            //
+            // The FIFO must lie after endpoint zero's, within the FIFO RAM
+            // and apart from every other FIFO.
+            //
+            CHECK(psFIFO->ulAddress >= MAX_PACKET_SIZE_EP0);
+            CHECK((psFIFO->ulAddress + psFIFO->ulSize) <= SIM_FIFO_RAM_SIZE);
+            CHECK((psFIFO->ulAddress & 7) == 0);
+            for(ulOEP = 1; ulOEP < 8; ulOEP++)
+            {
+                for(ulODir = 0; ulODir < 2; ulODir++)
+                {
+                    psOther = SimFIFOGet(0, ulOEP, ulODir == 0);
+                    if((psOther == psFIFO) || !psOther->bConfigured)
+                    {
+                        continue;
+                    }
+                    CHECK(((psFIFO->ulAddress + psFIFO->ulSize) <=
+                           psOther->ulAddress) ||
+                          ((psOther->ulAddress + psOther->ulSize) <=
+                           psFIFO->ulAddress));
+                }
+            }
+            if((psFIFO->ulAddress + psFIFO->ulSize) > ulEnd)
+            {
+                ulEnd = psFIFO->ulAddress + psFIFO->ulSize;
+            }
+
+            //
+            // The device core must report the buffering it set up.
+            //
+            bDB = USBDCDEndpointDoubleBuffered(0, INDEX_TO_USB_EP(ulEP),
+                                               ulDir ? USB_EP_DEV_OUT :
+                                               USB_EP_DEV_IN);
+            CHECK(bDB == psFIFO->bDoubleBuffered);
+            ulDB += bDB ? 1 : 0;
+
+            //
+            // If there is room, bulk and isochronous endpoints are
+            // double-buffered unless the class asks otherwise.  Interrupt
+            // endpoints are double-buffered only if the class asks for it.
+            //
+            psEntry = ulDir ? &psInfo->psFIFOConfig->sOut[ulEP - 1] :
+                              &psInfo->psFIFOConfig->sIn[ulEP - 1];
+            bAuto = (((psUse[ulDir][ulEP].ucType == USB_EP_ATTR_BULK) ||
+                      (psUse[ulDir][ulEP].ucType == USB_EP_ATTR_ISOC)) &&
+                     !psEntry->bSingleBuffer) ? true : false;
+            if(bRoomy)
+            {
+                CHECK(bDB == (psEntry->bDoubleBuffer || bAuto));
+            }
+            else if(psEntry->bDoubleBuffer)
+            {
+                CHECK(bDB);
+            }
+            else if(!bAuto)
+            {
+                CHECK(!bDB);
+            }
+        }
+    }
+    printf(" (%lu FIFOs, %lu double-buffered, %lu of %lu bytes)\n", ulFIFOs,
+           ulDB, ulUsed, ulAvailable);
+
+    //
+    // The FIFO use reported must match the map.
+    //
+    CHECK(ulEnd == ulUsed);
+
+    return(ulEnd);
+}
+
+//*****************************************************************************
+//
+// A made-up configuration with isochronous IN endpoints 1 to ulCount, each
+// with a 1023 byte packet, used to fill the FIFO RAM.
+//
+//*****************************************************************************
+static unsigned char g_pucIsocDesc[9 + 9 + (7 * 7)];
+static tConfigSection g_sIsocSection;
+static const tConfigSection *g_psIsocSections[] = { &g_sIsocSection };
+static tConfigHeader g_sIsocHeader = { 1, g_psIsocSections };
+static const tConfigHeader *g_ppsIsocConfig[] = { &g_sIsocHeader };
+static tFIFOConfig g_sIsocFIFOConfig;
+static tDeviceInfo g_sIsocDeviceInfo;
+
+static void
+IsocConfigBuild(unsigned long ulCount)
+{
+    unsigned char *pucDesc;
+    unsigned long ulEP;
+
+    pucDesc = g_pucIsocDesc;
+    *pucDesc++ = 9;
+    *pucDesc++ = USB_DTYPE_CONFIGURATION;
+    *pucDesc++ = (18 + (7 * ulCount)) & 0xFF;
+    *pucDesc++ = (18 + (7 * ulCount)) >> 8;
+    *pucDesc++ = 1;
+    *pucDesc++ = 1;
+    *pucDesc++ = 0;
+    *pucDesc++ = USB_CONF_ATTR_SELF_PWR;
+    *pucDesc++ = 0;
+
+    *pucDesc++ = 9;
+    *pucDesc++ = USB_DTYPE_INTERFACE;
+    *pucDesc++ = 0;
+    *pucDesc++ = 0;
+    *pucDesc++ = ulCount;
+    *pucDesc++ = USB_CLASS_VEND_SPECIFIC;
+    *pucDesc++ = 0;
+    *pucDesc++ = 0;
+    *pucDesc++ = 0;
+
+    for(ulEP = 1; ulEP <= ulCount; ulEP++)
+    {
+        *pucDesc++ = 7;
+        *pucDesc++ = USB_DTYPE_ENDPOINT;
+        *pucDesc++ = USB_EP_DESC_IN | ulEP;
+        *pucDesc++ = USB_EP_ATTR_ISOC;
+        *pucDesc++ = 1023 & 0xFF;
+        *pucDesc++ = 1023 >> 8;
+        *pucDesc++ = 1;
+    }
+
+    g_sIsocSection.usSize = pucDesc - g_pucIsocDesc;
+    g_sIsocSection.pucData = g_pucIsocDesc;
+    g_sIsocDeviceInfo.ppConfigDescriptors = g_ppsIsocConfig;
+    g_sIsocDeviceInfo.psFIFOConfig = &g_sIsocFIFOConfig;
+}
+
+//*****************************************************************************
+//
+// Checks the FIFO map of each class then the planner's behavior when the
+// FIFO RAM runs out.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulClass, ulAvailable;
+
+    for(ulClass = 0; ulClass < NUM_CLASSES; ulClass++)
+    {
+        CheckFIFOMap(g_psClasses[ulClass].pcName,
+                     g_psClasses[ulClass].psInfo, true);
+    }
+
+    //
+    // Two 1023 byte isochronous endpoints need 1024 bytes each.  Only the
+    // first can be double-buffered in the remaining space.
+    //
+    IsocConfigBuild(2);
+    CHECK(CheckFIFOMap("isoc2", &g_sIsocDeviceInfo, false) ==
+          (MAX_PACKET_SIZE_EP0 + (3 * 1024)));
+    CHECK(SimFIFOGet(0, 1, true)->bDoubleBuffered);
+    CHECK(!SimFIFOGet(0, 2, true)->bDoubleBuffered);
+
+    //
+    // Marking the first endpoint single-buffered lets the second have the
+    // space instead.
+    //
+    g_sIsocFIFOConfig.sIn[0].bSingleBuffer = true;
+    CHECK(CheckFIFOMap("isoc2s", &g_sIsocDeviceInfo, false) ==
+          (MAX_PACKET_SIZE_EP0 + (3 * 1024)));
+    CHECK(!SimFIFOGet(0, 1, true)->bDoubleBuffered);
+    CHECK(SimFIFOGet(0, 2, true)->bDoubleBuffered);
+    g_sIsocFIFOConfig.sIn[0].bSingleBuffer = false;
+
+    //
+    // Four such endpoints do not fit alongside endpoint zero.  The
+    // configuration must be refused without configuring any endpoint and
+    // the space it needed reported.
+    //
+    IsocConfigBuild(4);
+    SimReset();
+    g_psUSBDevice[0].psInfo = &g_sIsocDeviceInfo;
+    CHECK(!USBDeviceConfig(&g_psUSBDevice[0], g_ppsIsocConfig[0]));
+    CHECK(USBDCDFIFOUsageGet(0, &ulAvailable) ==
+          (MAX_PACKET_SIZE_EP0 + (4 * 1024)));
+    CHECK(ulAvailable == SIM_FIFO_RAM_SIZE);
+    CHECK(!SimFIFOGet(0, 1, true)->bConfigured);
+    CHECK(SimFIFOGet(0, 1, true)->ulMaxPacket == 0);
+    printf("isoc4: refused, needs %lu of %lu bytes\n",
+           USBDCDFIFOUsageGet(0, 0), ulAvailable);
+
+    return(SimResult("fifo_map"));
+}
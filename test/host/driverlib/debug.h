@@ -0,0 +1,37 @@
+//*****************************************************************************
+//
+// debug.h - Assertion macro for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __DEBUG_H__
+#define __DEBUG_H__
+
+//*****************************************************************************
+//
+// Prototype for the function called when an assertion fails.  The simulator
+// reports the failure and aborts the test, so the compiler is told that it
+// does not return and does not follow the code after a failed assertion.
+//
+//*****************************************************************************
+extern void __error__(char *pcFilename, unsigned long ulLine)
+    __attribute__((noreturn));
+
+//*****************************************************************************
+//
+// The ASSERT macro, which does the actual assertion checking.  Typically,
+// this will be for procedure arguments.
+//
+//*****************************************************************************
+#ifdef DEBUG
+#define ASSERT(expr) {                                      \
+                         if(!(expr))                        \
+                         {                                  \
+                             __error__(__FILE__, __LINE__); \
+                         }                                  \
+                     }
+#else
+#define ASSERT(expr)
+#endif
+
+#endif // __DEBUG_H__
@@ -0,0 +1,12 @@
+//*****************************************************************************
+//
+// fpu.h - Prototypes for the floating point unit driver.
+//
+//*****************************************************************************
+
+#ifndef __FPU_H__
+#define __FPU_H__
+
+extern void FPULazyStackingEnable(void);
+
+#endif // __FPU_H__
@@ -0,0 +1,24 @@
+//*****************************************************************************
+//
+// interrupt.h - Prototypes for the NVIC interrupt controller driver.
+//
+//*****************************************************************************
+
+#ifndef __INTERRUPT_H__
+#define __INTERRUPT_H__
+
+//*****************************************************************************
+//
+// Prototypes for the interrupt functions.  The simulator keeps a single
+// processor-wide interrupt mask and delivers pending USB controller
+// interrupts whenever it is cleared.
+//
+//*****************************************************************************
+extern tBoolean IntMasterEnable(void);
+extern tBoolean IntMasterDisable(void);
+extern void IntEnable(unsigned long ulInterrupt);
+extern void IntDisable(unsigned long ulInterrupt);
+extern void IntPendSet(unsigned long ulInterrupt);
+extern void IntPendClear(unsigned long ulInterrupt);
+
+#endif // __INTERRUPT_H__
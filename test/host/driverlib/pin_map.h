@@ -0,0 +1,13 @@
+//*****************************************************************************
+//
+// pin_map.h - Pin mapping for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __PIN_MAP_H__
+#define __PIN_MAP_H__
+
+#define GPIO_PA0_U0RX           0x00000001
+#define GPIO_PA1_U0TX           0x00000401
+
+#endif // __PIN_MAP_H__
@@ -0,0 +1,28 @@
+//*****************************************************************************
+//
+// rom.h - ROM function table for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __ROM_H__
+#define __ROM_H__
+
+//*****************************************************************************
+//
+// The simulated part has no ROM so each ROM_ function is the library
+// function of the same name.
+//
+//*****************************************************************************
+#define ROM_FPULazyStackingEnable       FPULazyStackingEnable
+#define ROM_GPIOPinTypeGPIOOutput       GPIOPinTypeGPIOOutput
+#define ROM_GPIOPinTypeUART             GPIOPinTypeUART
+#define ROM_GPIOPinTypeUSBAnalog        GPIOPinTypeUSBAnalog
+#define ROM_SysCtlClockGet              SysCtlClockGet
+#define ROM_SysCtlClockSet              SysCtlClockSet
+#define ROM_SysCtlPeripheralEnable      SysCtlPeripheralEnable
+#define ROM_SysTickEnable               SysTickEnable
+#define ROM_SysTickIntEnable            SysTickIntEnable
+#define ROM_SysTickPeriodSet            SysTickPeriodSet
+#define ROM_SysTickValueGet             SysTickValueGet
+
+#endif // __ROM_H__
@@ -0,0 +1,66 @@
+//*****************************************************************************
+//
+// rom_map.h - Macros to use the ROM or library version of a function.
+//
+//*****************************************************************************
+
+#ifndef __ROM_MAP_H__
+#define __ROM_MAP_H__
+
+//*****************************************************************************
+//
+// The simulated part has no ROM so each MAP_ function is the library
+// function of the same name.
+//
+//*****************************************************************************
+#define MAP_IntDisable                  IntDisable
+#define MAP_IntEnable                   IntEnable
+#define MAP_IntMasterDisable            IntMasterDisable
+#define MAP_IntMasterEnable             IntMasterEnable
+#define MAP_IntPendSet                  IntPendSet
+#define MAP_SysCtlClockGet              SysCtlClockGet
+#define MAP_SysCtlDelay                 SysCtlDelay
+#define MAP_SysCtlPeripheralDisable     SysCtlPeripheralDisable
+#define MAP_SysCtlPeripheralEnable      SysCtlPeripheralEnable
+#define MAP_SysCtlPeripheralReset       SysCtlPeripheralReset
+#define MAP_SysCtlUSBPLLDisable         SysCtlUSBPLLDisable
+#define MAP_SysCtlUSBPLLEnable          SysCtlUSBPLLEnable
+#define MAP_SysTickDisable              SysTickDisable
+#define MAP_SysTickIntDisable           SysTickIntDisable
+#define MAP_USBDevAddrSet               USBDevAddrSet
+#define MAP_USBDevConnect               USBDevConnect
+#define MAP_USBDevDisconnect            USBDevDisconnect
+#define MAP_USBDevEndpointConfigSet     USBDevEndpointConfigSet
+#define MAP_USBDevEndpointDataAck       USBDevEndpointDataAck
+#define MAP_USBDevEndpointStall         USBDevEndpointStall
+#define MAP_USBDevEndpointStallClear    USBDevEndpointStallClear
+#define MAP_USBDevEndpointStatusClear   USBDevEndpointStatusClear
+#define MAP_USBDevMode                  USBDevMode
+#define MAP_USBEndpointDMAChannel       USBEndpointDMAChannel
+#define MAP_USBEndpointDMADisable       USBEndpointDMADisable
+#define MAP_USBEndpointDMAEnable        USBEndpointDMAEnable
+#define MAP_USBEndpointDataAvail        USBEndpointDataAvail
+#define MAP_USBEndpointDataGet          USBEndpointDataGet
+#define MAP_USBEndpointDataPut          USBEndpointDataPut
+#define MAP_USBEndpointDataSend         USBEndpointDataSend
+#define MAP_USBEndpointDataToggleClear  USBEndpointDataToggleClear
+#define MAP_USBEndpointStatus           USBEndpointStatus
+#define MAP_USBFIFOConfigSet            USBFIFOConfigSet
+#define MAP_USBFIFOFlush                USBFIFOFlush
+#define MAP_USBFrameNumberGet           USBFrameNumberGet
+#define MAP_USBHostResume               USBHostResume
+#define MAP_USBIntDisableControl        USBIntDisableControl
+#define MAP_USBIntDisableEndpoint       USBIntDisableEndpoint
+#define MAP_USBIntEnableControl         USBIntEnableControl
+#define MAP_USBIntEnableEndpoint        USBIntEnableEndpoint
+#define MAP_USBIntStatusControl         USBIntStatusControl
+#define MAP_USBIntStatusEndpoint        USBIntStatusEndpoint
+#define MAP_USBOTGMode                  USBOTGMode
+#define MAP_uDMAChannelAttributeDisable uDMAChannelAttributeDisable
+#define MAP_uDMAChannelControlSet       uDMAChannelControlSet
+#define MAP_uDMAChannelDisable          uDMAChannelDisable
+#define MAP_uDMAChannelEnable           uDMAChannelEnable
+#define MAP_uDMAChannelModeGet          uDMAChannelModeGet
+#define MAP_uDMAChannelTransferSet      uDMAChannelTransferSet
+
+#endif // __ROM_MAP_H__
@@ -0,0 +1,19 @@
+//*****************************************************************************
+//
+// rtos_bindings.h - Operating system bindings for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __RTOS_BINDINGS_H__
+#define __RTOS_BINDINGS_H__
+
+//*****************************************************************************
+//
+// No RTOS is used so the bindings map directly onto the driver library.
+//
+//*****************************************************************************
+#define OS_INT_ENABLE(ulInt)    MAP_IntEnable(ulInt)
+#define OS_INT_DISABLE(ulInt)   MAP_IntDisable(ulInt)
+#define OS_DELAY(ul1mS)         MAP_SysCtlDelay(ul1mS)
+
+#endif // __RTOS_BINDINGS_H__
@@ -0,0 +1,44 @@
+//*****************************************************************************
+//
+// sysctl.h - Prototypes for the system control driver.
+//
+//*****************************************************************************
+
+#ifndef __SYSCTL_H__
+#define __SYSCTL_H__
+
+//*****************************************************************************
+//
+// The peripherals and clock settings used by the USB library and example.
+//
+//*****************************************************************************
+#define SYSCTL_PERIPH_UDMA      0x00002000
+#define SYSCTL_PERIPH_USB0      0x10010000
+#ifdef SIM_TWO_CONTROLLERS
+#define SYSCTL_PERIPH_USB1      0x10010001
+#endif
+#define SYSCTL_PERIPH_GPIOA     0x20000001
+#define SYSCTL_PERIPH_GPIOD     0x20000008
+#define SYSCTL_PERIPH_GPIOF     0x20000020
+#define SYSCTL_PERIPH_UART0     0x10000001
+
+#define SYSCTL_SYSDIV_4         0x01C00000
+#define SYSCTL_USE_PLL          0x00000000
+#define SYSCTL_OSC_MAIN         0x00000000
+#define SYSCTL_XTAL_16MHZ       0x00000540
+
+//*****************************************************************************
+//
+// Prototypes for the system control functions.
+//
+//*****************************************************************************
+extern unsigned long SysCtlClockGet(void);
+extern void SysCtlClockSet(unsigned long ulConfig);
+extern void SysCtlDelay(unsigned long ulCount);
+extern void SysCtlPeripheralDisable(unsigned long ulPeripheral);
+extern void SysCtlPeripheralEnable(unsigned long ulPeripheral);
+extern void SysCtlPeripheralReset(unsigned long ulPeripheral);
+extern void SysCtlUSBPLLDisable(void);
+extern void SysCtlUSBPLLEnable(void);
+
+#endif // __SYSCTL_H__
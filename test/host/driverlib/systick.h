@@ -0,0 +1,17 @@
+//*****************************************************************************
+//
+// systick.h - Prototypes for the SysTick driver.
+//
+//*****************************************************************************
+
+#ifndef __SYSTICK_H__
+#define __SYSTICK_H__
+
+extern void SysTickDisable(void);
+extern void SysTickEnable(void);
+extern void SysTickIntDisable(void);
+extern void SysTickIntEnable(void);
+extern void SysTickPeriodSet(unsigned long ulPeriod);
+extern unsigned long SysTickValueGet(void);
+
+#endif // __SYSTICK_H__
@@ -0,0 +1,10 @@
+//*****************************************************************************
+//
+// timer.h - Prototypes for the timer driver.
+//
+//*****************************************************************************
+
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#endif // __TIMER_H__
@@ -0,0 +1,10 @@
+//*****************************************************************************
+//
+// uart.h - Prototypes for the UART driver.
+//
+//*****************************************************************************
+
+#ifndef __UART_H__
+#define __UART_H__
+
+#endif // __UART_H__
@@ -0,0 +1,79 @@
+//*****************************************************************************
+//
+// udma.h - Prototypes for the uDMA controller driver.
+//
+//*****************************************************************************
+
+#ifndef __UDMA_H__
+#define __UDMA_H__
+
+//*****************************************************************************
+//
+// Values that can be passed to uDMAChannelControlSet().
+//
+//*****************************************************************************
+#define UDMA_DST_INC_8          0x00000000
+#define UDMA_DST_INC_16         0x40000000
+#define UDMA_DST_INC_32         0x80000000
+#define UDMA_DST_INC_NONE       0xc0000000
+#define UDMA_SRC_INC_8          0x00000000
+#define UDMA_SRC_INC_16         0x04000000
+#define UDMA_SRC_INC_32         0x08000000
+#define UDMA_SRC_INC_NONE       0x0c000000
+#define UDMA_SIZE_8             0x00000000
+#define UDMA_SIZE_16            0x11000000
+#define UDMA_SIZE_32            0x22000000
+#define UDMA_ARB_1              0x00000000
+#define UDMA_ARB_16             0x00010000
+#define UDMA_ARB_64             0x00018000
+
+//*****************************************************************************
+//
+// Channel attributes and transfer modes.
+//
+//*****************************************************************************
+#define UDMA_ATTR_USEBURST      0x00000001
+#define UDMA_ATTR_ALTSELECT     0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK       0x00000008
+#define UDMA_ATTR_ALL           0x0000000F
+
+#define UDMA_MODE_STOP          0x00000000
+#define UDMA_MODE_BASIC         0x00000001
+#define UDMA_MODE_AUTO          0x00000002
+
+#define UDMA_PRI_SELECT         0x00000000
+#define UDMA_ALT_SELECT         0x00000020
+
+//*****************************************************************************
+//
+// The channels dedicated to the USB endpoints.
+//
+//*****************************************************************************
+#define UDMA_CHANNEL_USBEP1RX   0
+#define UDMA_CHANNEL_USBEP1TX   1
+#define UDMA_CHANNEL_USBEP2RX   2
+#define UDMA_CHANNEL_USBEP2TX   3
+#define UDMA_CHANNEL_USBEP3RX   4
+#define UDMA_CHANNEL_USBEP3TX   5
+
+//*****************************************************************************
+//
+// Prototypes for the uDMA functions.
+//
+//*****************************************************************************
+extern void uDMAChannelAttributeDisable(unsigned long ulChannelNum,
+                                        unsigned long ulAttr);
+extern void uDMAChannelControlSet(unsigned long ulChannelStructIndex,
+                                  unsigned long ulControl);
+extern void uDMAChannelDisable(unsigned long ulChannelNum);
+extern void uDMAChannelEnable(unsigned long ulChannelNum);
+extern tBoolean uDMAChannelIsEnabled(unsigned long ulChannelNum);
+extern unsigned long uDMAChannelModeGet(unsigned long ulChannelStructIndex);
+extern unsigned long uDMAChannelSizeGet(unsigned long ulChannelStructIndex);
+extern void uDMAChannelTransferSet(unsigned long ulChannelStructIndex,
+                                   unsigned long ulMode, void *pvSrcAddr,
+                                   void *pvDstAddr,
+                                   unsigned long ulTransferSize);
+
+#endif // __UDMA_H__
@@ -0,0 +1,240 @@
+//*****************************************************************************
+//
+// usb.h - Prototypes for the USB controller driver in the host test build.
+//
+// The values and prototypes match those of the StellarisWare driver library.
+// The functions are implemented by the USB controller model in
+// host/usbsim.c.
+//
+//*****************************************************************************
+
+#ifndef __USB_H__
+#define __USB_H__
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBIntEnableControl() and
+// USBIntDisableControl() and are returned by USBIntStatusControl().
+//
+//*****************************************************************************
+#define USB_INTCTRL_ALL         0x000003FF
+#define USB_INTCTRL_STATUS      0x000000FF
+#define USB_INTCTRL_VBUS_ERR    0x00000080
+#define USB_INTCTRL_SESSION     0x00000040
+#define USB_INTCTRL_SESSION_END 0x00000040
+#define USB_INTCTRL_DISCONNECT  0x00000020
+#define USB_INTCTRL_CONNECT     0x00000010
+#define USB_INTCTRL_SOF         0x00000008
+#define USB_INTCTRL_BABBLE      0x00000004
+#define USB_INTCTRL_RESET       0x00000004
+#define USB_INTCTRL_RESUME      0x00000002
+#define USB_INTCTRL_SUSPEND     0x00000001
+#define USB_INTCTRL_MODE_DETECT 0x00000200
+#define USB_INTCTRL_POWER_FAULT 0x00000100
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBIntEnableEndpoint() and
+// USBIntDisableEndpoint() and are returned by USBIntStatusEndpoint().  IN
+// endpoint n is reported in bit n and OUT endpoint n in bit n + 16.
+//
+//*****************************************************************************
+#define USB_INTEP_ALL           0xFFFFFFFF
+#define USB_INTEP_HOST_IN       0xFFFE0000
+#define USB_INTEP_DEV_OUT       0xFFFE0000
+#define USB_INTEP_HOST_OUT      0x0000FFFE
+#define USB_INTEP_DEV_IN        0x0000FFFE
+#define USB_INTEP_0             0x00000001
+
+//*****************************************************************************
+//
+// The following are values that are returned from USBEndpointStatus().
+//
+//*****************************************************************************
+#define USB_DEV_RX_SENT_STALL   0x00400000
+#define USB_DEV_RX_DATA_ERROR   0x00080000
+#define USB_DEV_RX_OVERRUN      0x00040000
+#define USB_DEV_RX_FIFO_FULL    0x00020000
+#define USB_DEV_RX_PKT_RDY      0x00010000
+#define USB_DEV_TX_NOT_COMP     0x00000080
+#define USB_DEV_TX_SENT_STALL   0x00000020
+#define USB_DEV_TX_UNDERRUN     0x00000004
+#define USB_DEV_TX_FIFO_NE      0x00000002
+#define USB_DEV_TX_TXPKTRDY     0x00000001
+#define USB_DEV_EP0_SETUP_END   0x00000010
+#define USB_DEV_EP0_SENT_STALL  0x00000004
+#define USB_DEV_EP0_IN_PKTPEND  0x00000002
+#define USB_DEV_EP0_OUT_PKTRDY  0x00000001
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBDevEndpointConfigSet(),
+// USBFIFOConfigSet() and the uDMA functions as the ulFlags parameter.
+//
+//*****************************************************************************
+#define USB_EP_AUTO_SET         0x00000001
+#define USB_EP_AUTO_REQUEST     0x00000002
+#define USB_EP_AUTO_CLEAR       0x00000004
+#define USB_EP_DMA_MODE_0       0x00000008
+#define USB_EP_DMA_MODE_1       0x00000010
+#define USB_EP_MODE_ISOC        0x00000000
+#define USB_EP_MODE_BULK        0x00000100
+#define USB_EP_MODE_INT         0x00000200
+#define USB_EP_MODE_CTRL        0x00000300
+#define USB_EP_MODE_MASK        0x00000300
+#define USB_EP_SPEED_LOW        0x00000000
+#define USB_EP_SPEED_FULL       0x00001000
+#define USB_EP_HOST_IN          0x00000000
+#define USB_EP_HOST_OUT         0x00002000
+#define USB_EP_DEV_IN           0x00002000
+#define USB_EP_DEV_OUT          0x00000000
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBEndpointDataSend().
+//
+//*****************************************************************************
+#define USB_TRANS_OUT           0x00000102
+#define USB_TRANS_IN            0x00000102
+#define USB_TRANS_IN_LAST       0x0000010a
+#define USB_TRANS_SETUP         0x0000110a
+#define USB_TRANS_STATUS        0x00000142
+
+//*****************************************************************************
+//
+// The endpoint numbers and the macros converting them to and from indices.
+//
+//*****************************************************************************
+#define USB_EP_0                0x00000000
+#define USB_EP_1                0x00000010
+#define USB_EP_2                0x00000020
+#define USB_EP_3                0x00000030
+#define USB_EP_4                0x00000040
+#define USB_EP_5                0x00000050
+#define USB_EP_6                0x00000060
+#define USB_EP_7                0x00000070
+#define NUM_USB_EP              8
+
+#define INDEX_TO_USB_EP(x)      ((x) << 4)
+#define USB_EP_TO_INDEX(x)      ((x) >> 4)
+
+//*****************************************************************************
+//
+// The maximum packet size of endpoint zero.
+//
+//*****************************************************************************
+#define MAX_PACKET_SIZE_EP0     64
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBFIFOConfigSet() as the
+// ulFIFOSize parameter.
+//
+//*****************************************************************************
+#define USB_FIFO_SZ_8           0x00000000
+#define USB_FIFO_SZ_16          0x00000001
+#define USB_FIFO_SZ_32          0x00000002
+#define USB_FIFO_SZ_64          0x00000003
+#define USB_FIFO_SZ_128         0x00000004
+#define USB_FIFO_SZ_256         0x00000005
+#define USB_FIFO_SZ_512         0x00000006
+#define USB_FIFO_SZ_1024        0x00000007
+#define USB_FIFO_SZ_2048        0x00000008
+#define USB_FIFO_SZ_4096        0x00000009
+#define USB_FIFO_SZ_8_DB        0x00000010
+#define USB_FIFO_SZ_16_DB       0x00000011
+#define USB_FIFO_SZ_32_DB       0x00000012
+#define USB_FIFO_SZ_64_DB       0x00000013
+#define USB_FIFO_SZ_128_DB      0x00000014
+#define USB_FIFO_SZ_256_DB      0x00000015
+#define USB_FIFO_SZ_512_DB      0x00000016
+#define USB_FIFO_SZ_1024_DB     0x00000017
+#define USB_FIFO_SZ_2048_DB     0x00000018
+#define USB_FIFO_SIZE_DB_FLAG   0x00000010
+
+#define USB_FIFO_SZ_TO_BYTES(x) ((8 << ((x) & 0xF)) *                         \
+                                 ((((x) & USB_FIFO_SIZE_DB_FLAG) >> 4) + 1))
+
+//*****************************************************************************
+//
+// The following are values that can be passed to USBOTGMode() and are
+// returned by USBModeGet().
+//
+//*****************************************************************************
+#define USB_OTG_MODE_ASIDE_HOST 0x0000001D
+#define USB_OTG_MODE_ASIDE_NPWR 0x00000001
+#define USB_OTG_MODE_ASIDE_SESS 0x00000009
+#define USB_OTG_MODE_ASIDE_AVAL 0x00000011
+#define USB_OTG_MODE_ASIDE_DEV  0x00000019
+#define USB_OTG_MODE_BSIDE_HOST 0x0000009D
+#define USB_OTG_MODE_BSIDE_DEV  0x00000099
+#define USB_OTG_MODE_BSIDE_NPWR 0x00000081
+#define USB_OTG_MODE_NONE       0x00000080
+
+//*****************************************************************************
+//
+// Prototypes for the USB controller functions used by the USB library.
+//
+//*****************************************************************************
+extern void USBDevAddrSet(unsigned long ulBase, unsigned long ulAddress);
+extern void USBDevConnect(unsigned long ulBase);
+extern void USBDevDisconnect(unsigned long ulBase);
+extern void USBDevEndpointConfigSet(unsigned long ulBase,
+                                    unsigned long ulEndpoint,
+                                    unsigned long ulMaxPacketSize,
+                                    unsigned long ulFlags);
+extern void USBDevEndpointDataAck(unsigned long ulBase,
+                                  unsigned long ulEndpoint,
+                                  tBoolean bIsLastPacket);
+extern void USBDevEndpointStall(unsigned long ulBase, unsigned long ulEndpoint,
+                                unsigned long ulFlags);
+extern void USBDevEndpointStallClear(unsigned long ulBase,
+                                     unsigned long ulEndpoint,
+                                     unsigned long ulFlags);
+extern void USBDevEndpointStatusClear(unsigned long ulBase,
+                                      unsigned long ulEndpoint,
+                                      unsigned long ulFlags);
+extern void USBDevMode(unsigned long ulBase);
+extern void USBEndpointDMAChannel(unsigned long ulBase,
+                                  unsigned long ulEndpoint,
+                                  unsigned long ulChannel);
+extern void USBEndpointDMADisable(unsigned long ulBase,
+                                  unsigned long ulEndpoint,
+                                  unsigned long ulFlags);
+extern void USBEndpointDMAEnable(unsigned long ulBase, unsigned long ulEndpoint,
+                                 unsigned long ulFlags);
+extern unsigned long USBEndpointDataAvail(unsigned long ulBase,
+                                          unsigned long ulEndpoint);
+extern long USBEndpointDataGet(unsigned long ulBase, unsigned long ulEndpoint,
+                               unsigned char *pucData, unsigned long *pulSize);
+extern long USBEndpointDataPut(unsigned long ulBase, unsigned long ulEndpoint,
+                               unsigned char *pucData, unsigned long ulSize);
+extern long USBEndpointDataSend(unsigned long ulBase, unsigned long ulEndpoint,
+                                unsigned long ulTransType);
+extern void USBEndpointDataToggleClear(unsigned long ulBase,
+                                       unsigned long ulEndpoint,
+                                       unsigned long ulFlags);
+extern unsigned long USBEndpointStatus(unsigned long ulBase,
+                                       unsigned long ulEndpoint);
+extern unsigned long USBFIFOAddrGet(unsigned long ulBase,
+                                    unsigned long ulEndpoint);
+extern void USBFIFOConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                             unsigned long ulFIFOAddress,
+                             unsigned long ulFIFOSize, unsigned long ulFlags);
+extern void USBFIFOFlush(unsigned long ulBase, unsigned long ulEndpoint,
+                         unsigned long ulFlags);
+extern unsigned long USBFrameNumberGet(unsigned long ulBase);
+extern void USBHostResume(unsigned long ulBase, tBoolean bStart);
+extern void USBIntDisableControl(unsigned long ulBase,
+                                 unsigned long ulIntFlags);
+extern void USBIntDisableEndpoint(unsigned long ulBase,
+                                  unsigned long ulIntFlags);
+extern void USBIntEnableControl(unsigned long ulBase,
+                                unsigned long ulIntFlags);
+extern void USBIntEnableEndpoint(unsigned long ulBase,
+                                 unsigned long ulIntFlags);
+extern unsigned long USBIntStatusControl(unsigned long ulBase);
+extern unsigned long USBIntStatusEndpoint(unsigned long ulBase);
+extern void USBOTGMode(unsigned long ulBase);
+
+#endif // __USB_H__
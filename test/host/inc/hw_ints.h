@@ -0,0 +1,18 @@
+//*****************************************************************************
+//
+// hw_ints.h - Interrupt assignments for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __HW_INTS_H__
+#define __HW_INTS_H__
+
+#define FAULT_SYSTICK           15
+#define INT_UART0               21
+#define INT_USB0                60
+#ifdef SIM_TWO_CONTROLLERS
+#define INT_USB1                61
+#endif
+#define NUM_INTERRUPTS          64
+
+#endif // __HW_INTS_H__
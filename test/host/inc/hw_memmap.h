@@ -0,0 +1,24 @@
+//*****************************************************************************
+//
+// hw_memmap.h - Peripheral base addresses for the host test build.
+//
+// No Stellaris part has a second USB controller.  Defining
+// SIM_TWO_CONTROLLERS gives the simulated part one so that the USB library's
+// multiple controller support can be tested.
+//
+//*****************************************************************************
+
+#ifndef __HW_MEMMAP_H__
+#define __HW_MEMMAP_H__
+
+#define GPIO_PORTA_BASE         0x40004000
+#define GPIO_PORTD_BASE         0x40007000
+#define GPIO_PORTF_BASE         0x40025000
+#define UART0_BASE              0x4000C000
+#define USB0_BASE               0x40050000
+#ifdef SIM_TWO_CONTROLLERS
+#define USB1_BASE               0x40051000
+#endif
+#define UDMA_BASE               0x400FF000
+
+#endif // __HW_MEMMAP_H__
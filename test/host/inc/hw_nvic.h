@@ -0,0 +1,17 @@
+//*****************************************************************************
+//
+// hw_nvic.h - NVIC register definitions for the host test build.
+//
+//*****************************************************************************
+
+#ifndef __HW_NVIC_H__
+#define __HW_NVIC_H__
+
+#define NVIC_INT_CTRL           0xE000ED04
+#define NVIC_DIS0               0xE000E180
+#define NVIC_DIS1               0xE000E184
+#define NVIC_ST_CURRENT         0xE000E018
+
+#define NVIC_INT_CTRL_PEND_SYST 0x04000000
+
+#endif // __HW_NVIC_H__
@@ -0,0 +1,66 @@
+//*****************************************************************************
+//
+// hw_types.h - Common types and macros for the host test build.
+//
+// This replaces the StellarisWare header of the same name when the USB
+// library is built on a host for testing.  Register accesses are redirected
+// to the register file kept by the simulator in host/usbsim.c.
+//
+//*****************************************************************************
+
+#ifndef __HW_TYPES_H__
+#define __HW_TYPES_H__
+
+//*****************************************************************************
+//
+// Define a boolean type, and values for true and false.
+//
+//*****************************************************************************
+typedef unsigned char tBoolean;
+
+#ifndef true
+#define true 1
+#endif
+
+#ifndef false
+#define false 0
+#endif
+
+//*****************************************************************************
+//
+// The simulated register file.  Each address used with HWREG() is given its
+// own 32-bit cell.
+//
+//*****************************************************************************
+extern volatile unsigned long *SimRegister(unsigned long ulAddress);
+
+#define HWREG(x)                                                              \
+        (*SimRegister((unsigned long)(x)))
+
+//*****************************************************************************
+//
+// The host has no bit-band alias region.  A bit-band store such as
+//
+//     HWREGBITH(pusFlags, usBit) = bSet;
+//
+// is turned into a single pass loop whose body captures the value being
+// stored and whose increment expression writes it into the addressed bit.
+// This only supports stores, which is the only way the USB library uses
+// these macros.
+//
+//*****************************************************************************
+extern volatile void *g_pvSimBitAddr;
+extern unsigned long g_ulSimBitNum;
+extern unsigned long g_ulSimBitValue;
+extern void SimBitBandStore(unsigned long ulSize);
+
+#define SIM_BITBAND_STORE(x, b, s)                                            \
+        for(g_pvSimBitAddr = (volatile void *)(x), g_ulSimBitNum = (b);       \
+            g_pvSimBitAddr; SimBitBandStore(s))                                \
+            g_ulSimBitValue
+
+#define HWREGBITW(x, b)         SIM_BITBAND_STORE(x, b, 4)
+#define HWREGBITH(x, b)         SIM_BITBAND_STORE(x, b, 2)
+#define HWREGBITB(x, b)         SIM_BITBAND_STORE(x, b, 1)
+
+#endif // __HW_TYPES_H__
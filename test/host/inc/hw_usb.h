@@ -0,0 +1,13 @@
+//*****************************************************************************
+//
+// hw_usb.h - USB controller register definitions for the host test build.
+//
+// The simulated USB controller is only accessed through the driverlib
+// functions in host/usbsim.c so no registers are defined here.
+//
+//*****************************************************************************
+
+#ifndef __HW_USB_H__
+#define __HW_USB_H__
+
+#endif // __HW_USB_H__
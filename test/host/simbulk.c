@@ -0,0 +1,68 @@
+//*****************************************************************************
+//
+// simbulk.c - String descriptors shared by the tests which run a bulk device
+//             on the simulated part.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "usblib/usblib.h"
+#include "simbulk.h"
+
+//*****************************************************************************
+//
+// The language descriptor and one short string for each of the strings a
+// bulk device needs.
+//
+//*****************************************************************************
+static const unsigned char g_pucSimLang[] =
+{
+    4,
+    USB_DTYPE_STRING,
+    USBShort(USB_LANG_EN_US)
+};
+
+static const unsigned char g_pucSimManufacturer[] =
+{
+    (3 + 1) * 2,
+    USB_DTYPE_STRING,
+    'S', 0, 'i', 0, 'm', 0
+};
+
+static const unsigned char g_pucSimProduct[] =
+{
+    (4 + 1) * 2,
+    USB_DTYPE_STRING,
+    'B', 0, 'u', 0, 'l', 0, 'k', 0
+};
+
+static const unsigned char g_pucSimSerial[] =
+{
+    (4 + 1) * 2,
+    USB_DTYPE_STRING,
+    '0', 0, '0', 0, '0', 0, '1', 0
+};
+
+static const unsigned char g_pucSimInterface[] =
+{
+    (4 + 1) * 2,
+    USB_DTYPE_STRING,
+    'D', 0, 'a', 0, 't', 0, 'a', 0
+};
+
+static const unsigned char g_pucSimConfig[] =
+{
+    (6 + 1) * 2,
+    USB_DTYPE_STRING,
+    'C', 0, 'o', 0, 'n', 0, 'f', 0, 'i', 0, 'g', 0
+};
+
+const unsigned char * const g_ppucSimBulkStrings[SIM_BULK_NUM_STRINGS] =
+{
+    g_pucSimLang,
+    g_pucSimManufacturer,
+    g_pucSimProduct,
+    g_pucSimSerial,
+    g_pucSimInterface,
+    g_pucSimConfig
+};
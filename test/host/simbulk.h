@@ -0,0 +1,21 @@
+//*****************************************************************************
+//
+// simbulk.h - String descriptors shared by the tests which run a bulk device
+//             on the simulated part.
+//
+//*****************************************************************************
+
+#ifndef __SIMBULK_H__
+#define __SIMBULK_H__
+
+//*****************************************************************************
+//
+// A string descriptor table for a bulk device in a single language, English
+// (US).
+//
+//*****************************************************************************
+#define SIM_BULK_NUM_STRINGS    6
+
+extern const unsigned char * const g_ppucSimBulkStrings[SIM_BULK_NUM_STRINGS];
+
+#endif // __SIMBULK_H__
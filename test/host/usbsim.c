@@ -0,0 +1,1637 @@
+//*****************************************************************************
+//
+// usbsim.c - Host simulation of a Stellaris part used to run the USB library
+//            in the tests.
+//
+//*****************************************************************************
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "driverlib/fpu.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/systick.h"
+#include "driverlib/udma.h"
+#include "driverlib/usb.h"
+#include "utils/uartstdio.h"
+#include "utils/ustdlib.h"
+#include "usblib/usblib.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The packets held by one direction of an endpoint.  An endpoint whose FIFO
+// is double-buffered holds two packets, any other endpoint one.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ppucData[2][SIM_MAX_PACKET];
+    unsigned long pulSize[2];
+    unsigned long ulCount;
+
+    //
+    // The number of bytes of the oldest packet that have been read from the
+    // FIFO by USBEndpointDataGet() or the uDMA controller.
+    //
+    unsigned long ulRead;
+}
+tSimQueue;
+
+//*****************************************************************************
+//
+// The state of one endpoint.  For endpoint zero, sIn holds the packet being
+// sent to the host and sOut the setup or data packet received from it.
+//
+//*****************************************************************************
+typedef struct
+{
+    tSimQueue sIn;
+    tSimQueue sOut;
+
+    //
+    // The packet being loaded into the IN FIFO by USBEndpointDataPut() or the
+    // uDMA controller before USBEndpointDataSend() is called.
+    //
+    unsigned char pucLoad[SIM_MAX_PACKET];
+    unsigned long ulLoad;
+
+    //
+    // The FIFO and packet settings for each direction.
+    //
+    tSimFIFO sINFIFO;
+    tSimFIFO sOUTFIFO;
+
+    //
+    // Stall and uDMA state for each direction.
+    //
+    tBoolean bINStall;
+    tBoolean bOUTStall;
+    tBoolean bINDMA;
+    tBoolean bOUTDMA;
+}
+tSimEndpoint;
+
+//*****************************************************************************
+//
+// The state of one USB controller.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulBase;
+    unsigned long ulInterrupt;
+    tSimEndpoint psEP[SIM_NUM_ENDPOINTS];
+
+    //
+    // Sticky endpoint zero status bits and the transaction type of the last
+    // packet sent on endpoint zero.
+    //
+    unsigned long ulEP0Status;
+    unsigned long ulEP0Trans;
+
+    //
+    // Interrupt status waiting to be read by the interrupt handler.
+    //
+    unsigned long ulIntControl;
+    unsigned long ulIntEndpoint;
+
+    //
+    // The interrupt handler, whether the interrupt is enabled in the NVIC and
+    // whether it is pending.
+    //
+    void (*pfnHandler)(void);
+    tBoolean bEnabled;
+    tBoolean bPending;
+    unsigned long ulIntCount;
+
+    unsigned long ulAddress;
+    tBoolean bConnected;
+}
+tSimController;
+
+//*****************************************************************************
+//
+// The state of one uDMA channel.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulControl;
+    unsigned long ulMode;
+    void *pvSrc;
+    void *pvDst;
+    unsigned long ulSize;
+    tBoolean bEnabled;
+
+    //
+    // The controller and endpoint to which the channel has been assigned by
+    // USBEndpointDMAChannel().
+    //
+    tSimController *psController;
+    unsigned long ulEndpoint;
+}
+tSimDMAChannel;
+
+#define SIM_NUM_DMA_CHANNELS    32
+
+//*****************************************************************************
+//
+// The register file used by HWREG().
+//
+//*****************************************************************************
+#define SIM_NUM_REGISTERS       32
+
+typedef struct
+{
+    unsigned long ulAddress;
+    volatile unsigned long ulValue;
+}
+tSimRegister;
+
+//*****************************************************************************
+//
+// The complete simulation state.
+//
+//*****************************************************************************
+static tSimController g_psSimUSB[SIM_NUM_CONTROLLERS];
+static tSimDMAChannel g_psSimDMA[SIM_NUM_DMA_CHANNELS];
+static tSimRegister g_psSimRegs[SIM_NUM_REGISTERS];
+static unsigned long g_pulSimPendCount[NUM_INTERRUPTS];
+static unsigned long g_ulSimDMATransfers;
+static unsigned long g_ulSimDMABytes;
+static tBoolean g_bSimIntsOff;
+static unsigned long g_ulSimIntMaskCount;
+static tBoolean g_bSimInISR;
+static tBoolean g_bSimVerbose;
+static void (*g_pfnSimIdle)(void);
+static unsigned long g_ulSimChecks;
+static unsigned long g_ulSimFailures;
+
+//*****************************************************************************
+//
+// The USB library mode.  This normally belongs to usbmode.c, which holds the
+// OTG and host mode code and is not built into the tests.
+//
+//*****************************************************************************
+tUSBMode g_eUSBMode = USB_MODE_NONE;
+
+//*****************************************************************************
+//
+// The state used by the bit-band store macros in inc/hw_types.h.
+//
+//*****************************************************************************
+volatile void *g_pvSimBitAddr;
+unsigned long g_ulSimBitNum;
+unsigned long g_ulSimBitValue;
+
+//*****************************************************************************
+//
+// The number of times SimHostControl() calls the idle hook while waiting for
+// the device before giving up.
+//
+//*****************************************************************************
+#define SIM_IDLE_RETRIES        16
+
+//*****************************************************************************
+//
+// Test result checking.
+//
+//*****************************************************************************
+tBoolean
+SimCheck(tBoolean bPassed, const char *pcExpr, const char *pcFile, int iLine)
+{
+    g_ulSimChecks++;
+    if(!bPassed)
+    {
+        g_ulSimFailures++;
+        printf("%s:%d: check failed: %s\n", pcFile, iLine, pcExpr);
+    }
+    return(bPassed);
+}
+
+int
+SimResult(const char *pcTest)
+{
+    printf("%s: %s (%lu checks, %lu failed)\n", pcTest,
+           g_ulSimFailures ? "FAIL" : "PASS", g_ulSimChecks,
+           g_ulSimFailures);
+    return(g_ulSimFailures ? 1 : 0);
+}
+
+void
+__error__(char *pcFilename, unsigned long ulLine)
+{
+    printf("%s:%lu: assertion failed\n", pcFilename, ulLine);
+    abort();
+}
+
+//*****************************************************************************
+//
+// General simulation control.
+//
+//*****************************************************************************
+void
+SimReset(void)
+{
+    unsigned long ulIndex;
+    void (*pfnHandler)(void);
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        pfnHandler = g_psSimUSB[ulIndex].pfnHandler;
+        memset(&g_psSimUSB[ulIndex], 0, sizeof(tSimController));
+        g_psSimUSB[ulIndex].pfnHandler = pfnHandler;
+        g_psSimUSB[ulIndex].ulBase = USB0_BASE + (ulIndex * 0x1000);
+        g_psSimUSB[ulIndex].ulInterrupt = INT_USB0 + ulIndex;
+    }
+    memset(g_psSimDMA, 0, sizeof(g_psSimDMA));
+    memset(g_psSimRegs, 0, sizeof(g_psSimRegs));
+    memset(g_pulSimPendCount, 0, sizeof(g_pulSimPendCount));
+    g_ulSimDMATransfers = 0;
+    g_ulSimDMABytes = 0;
+    g_bSimIntsOff = false;
+    g_bSimInISR = false;
+    g_ulSimIntMaskCount = 0;
+}
+
+void
+SimVerbose(tBoolean bVerbose)
+{
+    g_bSimVerbose = bVerbose;
+}
+
+double
+SimTimeNow(void)
+{
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return((double)sNow.tv_sec + ((double)sNow.tv_nsec / 1e9));
+}
+
+//*****************************************************************************
+//
+// Finds the controller with a given base address.
+//
+//*****************************************************************************
+static tSimController *
+SimController(unsigned long ulBase)
+{
+    unsigned long ulIndex;
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(g_psSimUSB[ulIndex].ulBase == ulBase)
+        {
+            return(&g_psSimUSB[ulIndex]);
+        }
+    }
+
+    printf("usbsim: no USB controller at 0x%08lx\n", ulBase);
+    abort();
+}
+
+//*****************************************************************************
+//
+// Finds an endpoint from the endpoint value (USB_EP_n) passed to a driver
+// library function.
+//
+//*****************************************************************************
+static tSimEndpoint *
+SimEndpoint(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    return(&SimController(ulBase)->psEP[USB_EP_TO_INDEX(ulEndpoint)]);
+}
+
+//*****************************************************************************
+//
+// Returns the number of packets that one direction of an endpoint can hold.
+//
+//*****************************************************************************
+static unsigned long
+SimDepth(const tSimFIFO *psFIFO)
+{
+    return((psFIFO->bConfigured && psFIFO->bDoubleBuffered) ? 2 : 1);
+}
+
+//*****************************************************************************
+//
+// Adds a packet to the newest end of an endpoint queue.
+//
+//*****************************************************************************
+static void
+SimQueuePush(tSimQueue *psQueue, const unsigned char *pucData,
+             unsigned long ulSize)
+{
+    memcpy(psQueue->ppucData[psQueue->ulCount], pucData, ulSize);
+    psQueue->pulSize[psQueue->ulCount] = ulSize;
+    psQueue->ulCount++;
+}
+
+//*****************************************************************************
+//
+// Removes the oldest packet from an endpoint queue.
+//
+//*****************************************************************************
+static void
+SimQueuePop(tSimQueue *psQueue)
+{
+    if(psQueue->ulCount)
+    {
+        memcpy(psQueue->ppucData[0], psQueue->ppucData[1], SIM_MAX_PACKET);
+        psQueue->pulSize[0] = psQueue->pulSize[1];
+        psQueue->ulCount--;
+        psQueue->ulRead = 0;
+    }
+}
+
+//*****************************************************************************
+//
+// Interrupt delivery.  A pending USB interrupt is handled as soon as the
+// processor interrupt mask is clear and no interrupt handler is running.
+// Interrupt handlers do not nest.
+//
+//*****************************************************************************
+static void
+SimIntDeliver(void)
+{
+    unsigned long ulIndex;
+    tBoolean bRan;
+
+    if(g_bSimIntsOff || g_bSimInISR)
+    {
+        return;
+    }
+
+    do
+    {
+        bRan = false;
+        for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+        {
+            tSimController *psUSB = &g_psSimUSB[ulIndex];
+
+            if(psUSB->bPending && psUSB->bEnabled && psUSB->pfnHandler &&
+               !g_bSimIntsOff)
+            {
+                psUSB->bPending = false;
+                psUSB->ulIntCount++;
+                g_bSimInISR = true;
+                psUSB->pfnHandler();
+                g_bSimInISR = false;
+                bRan = true;
+            }
+        }
+    }
+    while(bRan);
+}
+
+static void
+SimIntRaise(tSimController *psUSB)
+{
+    psUSB->bPending = true;
+    SimIntDeliver();
+}
+
+void
+SimIntHandlerSet(unsigned long ulIndex, void (*pfnHandler)(void))
+{
+    g_psSimUSB[ulIndex].pfnHandler = pfnHandler;
+}
+
+void
+SimIdleHookSet(void (*pfnIdle)(void))
+{
+    g_pfnSimIdle = pfnIdle;
+}
+
+tBoolean
+SimIntMasked(void)
+{
+    return(g_bSimIntsOff);
+}
+
+unsigned long
+SimIntMaskCount(void)
+{
+    return(g_ulSimIntMaskCount);
+}
+
+unsigned long
+SimIntPendCount(unsigned long ulInterrupt)
+{
+    return(g_pulSimPendCount[ulInterrupt]);
+}
+
+unsigned long
+SimUSBIntCount(unsigned long ulIndex)
+{
+    return(g_psSimUSB[ulIndex].ulIntCount);
+}
+
+//*****************************************************************************
+//
+// The NVIC and processor interrupt mask.
+//
+//*****************************************************************************
+tBoolean
+IntMasterDisable(void)
+{
+    tBoolean bWasOff;
+
+    g_ulSimIntMaskCount++;
+    bWasOff = g_bSimIntsOff;
+    g_bSimIntsOff = true;
+    return(bWasOff);
+}
+
+tBoolean
+IntMasterEnable(void)
+{
+    tBoolean bWasOff;
+
+    bWasOff = g_bSimIntsOff;
+    g_bSimIntsOff = false;
+    SimIntDeliver();
+    return(bWasOff);
+}
+
+void
+IntEnable(unsigned long ulInterrupt)
+{
+    unsigned long ulIndex;
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(g_psSimUSB[ulIndex].ulInterrupt == ulInterrupt)
+        {
+            g_psSimUSB[ulIndex].bEnabled = true;
+        }
+    }
+    SimIntDeliver();
+}
+
+void
+IntDisable(unsigned long ulInterrupt)
+{
+    unsigned long ulIndex;
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(g_psSimUSB[ulIndex].ulInterrupt == ulInterrupt)
+        {
+            g_psSimUSB[ulIndex].bEnabled = false;
+        }
+    }
+}
+
+void
+IntPendSet(unsigned long ulInterrupt)
+{
+    unsigned long ulIndex;
+
+    if(ulInterrupt < NUM_INTERRUPTS)
+    {
+        g_pulSimPendCount[ulInterrupt]++;
+    }
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(g_psSimUSB[ulIndex].ulInterrupt == ulInterrupt)
+        {
+            SimIntRaise(&g_psSimUSB[ulIndex]);
+        }
+    }
+}
+
+void
+IntPendClear(unsigned long ulInterrupt)
+{
+    unsigned long ulIndex;
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(g_psSimUSB[ulIndex].ulInterrupt == ulInterrupt)
+        {
+            g_psSimUSB[ulIndex].bPending = false;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// The register file and bit-band stores.
+//
+//*****************************************************************************
+volatile unsigned long *
+SimRegister(unsigned long ulAddress)
+{
+    unsigned long ulLoop;
+
+    for(ulLoop = 0; ulLoop < SIM_NUM_REGISTERS; ulLoop++)
+    {
+        if(g_psSimRegs[ulLoop].ulAddress == ulAddress)
+        {
+            return(&g_psSimRegs[ulLoop].ulValue);
+        }
+        if(g_psSimRegs[ulLoop].ulAddress == 0)
+        {
+            g_psSimRegs[ulLoop].ulAddress = ulAddress;
+            g_psSimRegs[ulLoop].ulValue = 0;
+            return(&g_psSimRegs[ulLoop].ulValue);
+        }
+    }
+
+    printf("usbsim: register file full\n");
+    abort();
+}
+
+void
+SimBitBandStore(unsigned long ulSize)
+{
+    unsigned long ulMask;
+
+    ulMask = 1UL << g_ulSimBitNum;
+    switch(ulSize)
+    {
+        case 1:
+        {
+            volatile unsigned char *pucVal = g_pvSimBitAddr;
+            *pucVal = g_ulSimBitValue ? (*pucVal | ulMask) :
+                      (*pucVal & ~ulMask);
+            break;
+        }
+        case 2:
+        {
+            volatile unsigned short *pusVal = g_pvSimBitAddr;
+            *pusVal = g_ulSimBitValue ? (*pusVal | ulMask) :
+                      (*pusVal & ~ulMask);
+            break;
+        }
+        default:
+        {
+            volatile unsigned long *pulVal = g_pvSimBitAddr;
+            *pulVal = g_ulSimBitValue ? (*pulVal | ulMask) :
+                      (*pulVal & ~ulMask);
+            break;
+        }
+    }
+    g_pvSimBitAddr = 0;
+}
+
+//*****************************************************************************
+//
+// System control, SysTick, GPIO and FPU.  These have no effect.
+//
+//*****************************************************************************
+unsigned long
+SysCtlClockGet(void)
+{
+    return(50000000);
+}
+
+void SysCtlClockSet(unsigned long ulConfig) {}
+void SysCtlDelay(unsigned long ulCount) {}
+void SysCtlPeripheralDisable(unsigned long ulPeripheral) {}
+void SysCtlPeripheralEnable(unsigned long ulPeripheral) {}
+void SysCtlPeripheralReset(unsigned long ulPeripheral) {}
+void SysCtlUSBPLLDisable(void) {}
+void SysCtlUSBPLLEnable(void) {}
+void SysTickDisable(void) {}
+void SysTickEnable(void) {}
+void SysTickIntDisable(void) {}
+void SysTickIntEnable(void) {}
+void SysTickPeriodSet(unsigned long ulPeriod) {}
+void GPIOPinConfigure(unsigned long ulPinConfig) {}
+void GPIOPinTypeGPIOOutput(unsigned long ulPort, unsigned char ucPins) {}
+void GPIOPinTypeUART(unsigned long ulPort, unsigned char ucPins) {}
+void GPIOPinTypeUSBAnalog(unsigned long ulPort, unsigned char ucPins) {}
+void GPIOPinWrite(unsigned long ulPort, unsigned char ucPins,
+                  unsigned char ucVal) {}
+void FPULazyStackingEnable(void) {}
+
+unsigned long
+SysTickValueGet(void)
+{
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The UART console and string formatting.
+//
+//*****************************************************************************
+void UARTStdioInit(unsigned long ulPortNum) {}
+
+void
+UARTprintf(const char *pcString, ...)
+{
+    va_list vaArgP;
+
+    if(g_bSimVerbose)
+    {
+        va_start(vaArgP, pcString);
+        vprintf(pcString, vaArgP);
+        va_end(vaArgP);
+    }
+}
+
+int
+usnprintf(char *pcBuf, unsigned long ulSize, const char *pcString, ...)
+{
+    va_list vaArgP;
+    int iRet;
+
+    va_start(vaArgP, pcString);
+    iRet = vsnprintf(pcBuf, ulSize, pcString, vaArgP);
+    va_end(vaArgP);
+    return(iRet);
+}
+
+int
+usprintf(char *pcBuf, const char *pcString, ...)
+{
+    va_list vaArgP;
+    int iRet;
+
+    va_start(vaArgP, pcString);
+    iRet = vsprintf(pcBuf, pcString, vaArgP);
+    va_end(vaArgP);
+    return(iRet);
+}
+
+//*****************************************************************************
+//
+// The USB controller: device mode, addressing and interrupts.
+//
+//*****************************************************************************
+void
+USBDevMode(unsigned long ulBase)
+{
+}
+
+void
+USBOTGMode(unsigned long ulBase)
+{
+}
+
+void
+USBDevConnect(unsigned long ulBase)
+{
+    SimController(ulBase)->bConnected = true;
+}
+
+void
+USBDevDisconnect(unsigned long ulBase)
+{
+    SimController(ulBase)->bConnected = false;
+}
+
+void
+USBDevAddrSet(unsigned long ulBase, unsigned long ulAddress)
+{
+    SimController(ulBase)->ulAddress = ulAddress;
+}
+
+void
+USBHostResume(unsigned long ulBase, tBoolean bStart)
+{
+}
+
+unsigned long
+USBFrameNumberGet(unsigned long ulBase)
+{
+    return(0);
+}
+
+void
+USBIntDisableControl(unsigned long ulBase, unsigned long ulIntFlags)
+{
+}
+
+void
+USBIntDisableEndpoint(unsigned long ulBase, unsigned long ulIntFlags)
+{
+}
+
+void
+USBIntEnableControl(unsigned long ulBase, unsigned long ulIntFlags)
+{
+}
+
+void
+USBIntEnableEndpoint(unsigned long ulBase, unsigned long ulIntFlags)
+{
+}
+
+unsigned long
+USBIntStatusControl(unsigned long ulBase)
+{
+    tSimController *psUSB = SimController(ulBase);
+    unsigned long ulStatus;
+
+    ulStatus = psUSB->ulIntControl;
+    psUSB->ulIntControl = 0;
+    return(ulStatus);
+}
+
+unsigned long
+USBIntStatusEndpoint(unsigned long ulBase)
+{
+    tSimController *psUSB = SimController(ulBase);
+    unsigned long ulStatus;
+
+    ulStatus = psUSB->ulIntEndpoint;
+    psUSB->ulIntEndpoint = 0;
+    return(ulStatus);
+}
+
+//*****************************************************************************
+//
+// The USB controller: endpoint and FIFO configuration.
+//
+//*****************************************************************************
+void
+USBFIFOConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                 unsigned long ulFIFOAddress, unsigned long ulFIFOSize,
+                 unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+    tSimFIFO *psFIFO;
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &psEP->sINFIFO : &psEP->sOUTFIFO;
+    psFIFO->bConfigured = true;
+    psFIFO->ulAddress = ulFIFOAddress;
+    psFIFO->ulSize = USB_FIFO_SZ_TO_BYTES(ulFIFOSize);
+    psFIFO->bDoubleBuffered = (ulFIFOSize & USB_FIFO_SIZE_DB_FLAG) ? true :
+                              false;
+}
+
+void
+USBDevEndpointConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                        unsigned long ulMaxPacketSize, unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+    tSimFIFO *psFIFO;
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &psEP->sINFIFO : &psEP->sOUTFIFO;
+    psFIFO->ulMaxPacket = ulMaxPacketSize;
+    psFIFO->ulFlags = ulFlags;
+}
+
+unsigned long
+USBFIFOAddrGet(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    return(ulBase + 0x20 + (ulEndpoint >> 2));
+}
+
+void
+USBFIFOFlush(unsigned long ulBase, unsigned long ulEndpoint,
+             unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        psEP->sIn.ulCount = 0;
+        psEP->ulLoad = 0;
+    }
+    else
+    {
+        psEP->sOut.ulCount = 0;
+        psEP->sOut.ulRead = 0;
+    }
+}
+
+void
+USBEndpointDataToggleClear(unsigned long ulBase, unsigned long ulEndpoint,
+                           unsigned long ulFlags)
+{
+}
+
+//*****************************************************************************
+//
+// The USB controller: endpoint status and stalls.
+//
+//*****************************************************************************
+unsigned long
+USBEndpointStatus(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    tSimController *psUSB = SimController(ulBase);
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+    unsigned long ulStatus;
+
+    if(ulEndpoint == USB_EP_0)
+    {
+        ulStatus = psUSB->ulEP0Status;
+        if(psEP->sOut.ulCount)
+        {
+            ulStatus |= USB_DEV_EP0_OUT_PKTRDY;
+        }
+        if(psEP->sIn.ulCount)
+        {
+            ulStatus |= USB_DEV_EP0_IN_PKTPEND;
+        }
+        return(ulStatus);
+    }
+
+    ulStatus = 0;
+    if(psEP->sIn.ulCount)
+    {
+        ulStatus |= USB_DEV_TX_FIFO_NE;
+    }
+    if(psEP->sIn.ulCount >= SimDepth(&psEP->sINFIFO))
+    {
+        ulStatus |= USB_DEV_TX_TXPKTRDY;
+    }
+    if(psEP->sOut.ulCount)
+    {
+        ulStatus |= USB_DEV_RX_PKT_RDY;
+    }
+    if(psEP->sOut.ulCount >= SimDepth(&psEP->sOUTFIFO))
+    {
+        ulStatus |= USB_DEV_RX_FIFO_FULL;
+    }
+    return(ulStatus);
+}
+
+void
+USBDevEndpointStatusClear(unsigned long ulBase, unsigned long ulEndpoint,
+                          unsigned long ulFlags)
+{
+    if(ulEndpoint == USB_EP_0)
+    {
+        SimController(ulBase)->ulEP0Status &=
+            ~(ulFlags & (USB_DEV_EP0_SENT_STALL | USB_DEV_EP0_SETUP_END));
+    }
+}
+
+void
+USBDevEndpointStall(unsigned long ulBase, unsigned long ulEndpoint,
+                    unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(ulEndpoint == USB_EP_0)
+    {
+        //
+        // Stalling endpoint zero also services the setup packet.
+        //
+        SimQueuePop(&psEP->sOut);
+        psEP->bOUTStall = true;
+    }
+    else if(ulFlags & USB_EP_DEV_IN)
+    {
+        psEP->bINStall = true;
+    }
+    else
+    {
+        psEP->bOUTStall = true;
+    }
+}
+
+void
+USBDevEndpointStallClear(unsigned long ulBase, unsigned long ulEndpoint,
+                         unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        psEP->bINStall = false;
+    }
+    else
+    {
+        psEP->bOUTStall = false;
+    }
+}
+
+//*****************************************************************************
+//
+// The USB controller: moving data through the endpoint FIFOs.
+//
+//*****************************************************************************
+unsigned long
+USBEndpointDataAvail(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(!psEP->sOut.ulCount)
+    {
+        return(0);
+    }
+    return(psEP->sOut.pulSize[0] - psEP->sOut.ulRead);
+}
+
+long
+USBEndpointDataGet(unsigned long ulBase, unsigned long ulEndpoint,
+                   unsigned char *pucData, unsigned long *pulSize)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+    unsigned long ulAvail;
+
+    if(!psEP->sOut.ulCount)
+    {
+        *pulSize = 0;
+        return(-1);
+    }
+
+    ulAvail = psEP->sOut.pulSize[0] - psEP->sOut.ulRead;
+    if(*pulSize > ulAvail)
+    {
+        *pulSize = ulAvail;
+    }
+    memcpy(pucData, psEP->sOut.ppucData[0] + psEP->sOut.ulRead, *pulSize);
+    psEP->sOut.ulRead += *pulSize;
+    return(0);
+}
+
+void
+USBDevEndpointDataAck(unsigned long ulBase, unsigned long ulEndpoint,
+                      tBoolean bIsLastPacket)
+{
+    tSimController *psUSB = SimController(ulBase);
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    //
+    // If the other half of a double-buffered FIFO holds a packet, it is now
+    // the one presented to the processor so it raises its own interrupt.
+    //
+    SimQueuePop(&psEP->sOut);
+    if(psEP->sOut.ulCount)
+    {
+        psUSB->ulIntEndpoint |= 0x10000 << USB_EP_TO_INDEX(ulEndpoint);
+        SimIntRaise(psUSB);
+    }
+}
+
+long
+USBEndpointDataPut(unsigned long ulBase, unsigned long ulEndpoint,
+                   unsigned char *pucData, unsigned long ulSize)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if((psEP->sIn.ulCount >= SimDepth(&psEP->sINFIFO)) ||
+       ((psEP->ulLoad + ulSize) > SIM_MAX_PACKET))
+    {
+        return(-1);
+    }
+
+    memcpy(psEP->pucLoad + psEP->ulLoad, pucData, ulSize);
+    psEP->ulLoad += ulSize;
+    return(0);
+}
+
+long
+USBEndpointDataSend(unsigned long ulBase, unsigned long ulEndpoint,
+                    unsigned long ulTransType)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(psEP->sIn.ulCount >= SimDepth(&psEP->sINFIFO))
+    {
+        return(-1);
+    }
+
+    SimQueuePush(&psEP->sIn, psEP->pucLoad, psEP->ulLoad);
+    psEP->ulLoad = 0;
+    if(ulEndpoint == USB_EP_0)
+    {
+        SimController(ulBase)->ulEP0Trans = ulTransType;
+    }
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The USB controller: uDMA requests.
+//
+//*****************************************************************************
+void
+USBEndpointDMAChannel(unsigned long ulBase, unsigned long ulEndpoint,
+                      unsigned long ulChannel)
+{
+    g_psSimDMA[ulChannel].psController = SimController(ulBase);
+    g_psSimDMA[ulChannel].ulEndpoint = USB_EP_TO_INDEX(ulEndpoint);
+}
+
+void
+USBEndpointDMAEnable(unsigned long ulBase, unsigned long ulEndpoint,
+                     unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        psEP->bINDMA = true;
+    }
+    else
+    {
+        psEP->bOUTDMA = true;
+    }
+}
+
+void
+USBEndpointDMADisable(unsigned long ulBase, unsigned long ulEndpoint,
+                      unsigned long ulFlags)
+{
+    tSimEndpoint *psEP = SimEndpoint(ulBase, ulEndpoint);
+
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        psEP->bINDMA = false;
+    }
+    else
+    {
+        psEP->bOUTDMA = false;
+    }
+}
+
+//*****************************************************************************
+//
+// The uDMA controller.
+//
+//*****************************************************************************
+void
+uDMAChannelAttributeDisable(unsigned long ulChannelNum, unsigned long ulAttr)
+{
+}
+
+void
+uDMAChannelControlSet(unsigned long ulChannelStructIndex,
+                      unsigned long ulControl)
+{
+    g_psSimDMA[ulChannelStructIndex & 0x1F].ulControl = ulControl;
+}
+
+void
+uDMAChannelTransferSet(unsigned long ulChannelStructIndex,
+                       unsigned long ulMode, void *pvSrcAddr, void *pvDstAddr,
+                       unsigned long ulTransferSize)
+{
+    tSimDMAChannel *psChannel = &g_psSimDMA[ulChannelStructIndex & 0x1F];
+
+    psChannel->ulMode = ulMode;
+    psChannel->pvSrc = pvSrcAddr;
+    psChannel->pvDst = pvDstAddr;
+    psChannel->ulSize = ulTransferSize;
+}
+
+void
+uDMAChannelEnable(unsigned long ulChannelNum)
+{
+    g_psSimDMA[ulChannelNum].bEnabled = true;
+}
+
+void
+uDMAChannelDisable(unsigned long ulChannelNum)
+{
+    g_psSimDMA[ulChannelNum].bEnabled = false;
+}
+
+tBoolean
+uDMAChannelIsEnabled(unsigned long ulChannelNum)
+{
+    return(g_psSimDMA[ulChannelNum].bEnabled);
+}
+
+unsigned long
+uDMAChannelModeGet(unsigned long ulChannelStructIndex)
+{
+    return(g_psSimDMA[ulChannelStructIndex & 0x1F].ulMode);
+}
+
+unsigned long
+uDMAChannelSizeGet(unsigned long ulChannelStructIndex)
+{
+    tSimDMAChannel *psChannel = &g_psSimDMA[ulChannelStructIndex & 0x1F];
+
+    return((psChannel->ulMode == UDMA_MODE_STOP) ? 0 : psChannel->ulSize);
+}
+
+//*****************************************************************************
+//
+// Completes every enabled uDMA transfer, moving the data between memory and
+// the endpoint FIFO that the channel serves, then raises the interrupt of
+// each USB controller whose channels completed a transfer.
+//
+// Returns the number of transfers completed.
+//
+//*****************************************************************************
+unsigned long
+SimDMARun(void)
+{
+    tSimDMAChannel *psChannel;
+    tSimController *psUSB;
+    tSimEndpoint *psEP;
+    unsigned long ulChannel, ulIndex, ulCount, ulFIFO;
+    tBoolean pbRaise[SIM_NUM_CONTROLLERS];
+
+    memset(pbRaise, 0, sizeof(pbRaise));
+    ulCount = 0;
+
+    for(ulChannel = 0; ulChannel < SIM_NUM_DMA_CHANNELS; ulChannel++)
+    {
+        psChannel = &g_psSimDMA[ulChannel];
+        if(!psChannel->bEnabled || (psChannel->ulMode == UDMA_MODE_STOP) ||
+           !psChannel->psController)
+        {
+            continue;
+        }
+
+        psUSB = psChannel->psController;
+        psEP = &psUSB->psEP[psChannel->ulEndpoint];
+        ulFIFO = USBFIFOAddrGet(psUSB->ulBase,
+                                INDEX_TO_USB_EP(psChannel->ulEndpoint));
+
+        if((unsigned long)psChannel->pvDst == ulFIFO)
+        {
+            //
+            // A transfer into the IN FIFO.  The endpoint's uDMA request must
+            // have been enabled.
+            //
+            if(!psEP->bINDMA ||
+               ((psEP->ulLoad + psChannel->ulSize) > SIM_MAX_PACKET))
+            {
+                continue;
+            }
+            memcpy(psEP->pucLoad + psEP->ulLoad, psChannel->pvSrc,
+                   psChannel->ulSize);
+            psEP->ulLoad += psChannel->ulSize;
+        }
+        else if((unsigned long)psChannel->pvSrc == ulFIFO)
+        {
+            //
+            // A transfer out of the OUT FIFO.
+            //
+            if(!psEP->bOUTDMA || !psEP->sOut.ulCount ||
+               ((psEP->sOut.ulRead + psChannel->ulSize) >
+                psEP->sOut.pulSize[0]))
+            {
+                continue;
+            }
+            memcpy(psChannel->pvDst,
+                   psEP->sOut.ppucData[0] + psEP->sOut.ulRead,
+                   psChannel->ulSize);
+            psEP->sOut.ulRead += psChannel->ulSize;
+        }
+        else
+        {
+            continue;
+        }
+
+        g_ulSimDMABytes += psChannel->ulSize;
+        g_ulSimDMATransfers++;
+        psChannel->ulMode = UDMA_MODE_STOP;
+        psChannel->bEnabled = false;
+        pbRaise[psUSB - g_psSimUSB] = true;
+        ulCount++;
+    }
+
+    for(ulIndex = 0; ulIndex < SIM_NUM_CONTROLLERS; ulIndex++)
+    {
+        if(pbRaise[ulIndex])
+        {
+            SimIntRaise(&g_psSimUSB[ulIndex]);
+        }
+    }
+
+    return(ulCount);
+}
+
+unsigned long
+SimDMATransfers(void)
+{
+    return(g_ulSimDMATransfers);
+}
+
+unsigned long
+SimDMABytes(void)
+{
+    return(g_ulSimDMABytes);
+}
+
+//*****************************************************************************
+//
+// The actions of the USB host on the bus.
+//
+//*****************************************************************************
+void
+SimHostReset(unsigned long ulIndex)
+{
+    tSimController *psUSB = &g_psSimUSB[ulIndex];
+    unsigned long ulEP;
+
+    psUSB->ulAddress = 0;
+    psUSB->ulEP0Status = 0;
+    for(ulEP = 0; ulEP < SIM_NUM_ENDPOINTS; ulEP++)
+    {
+        psUSB->psEP[ulEP].sIn.ulCount = 0;
+        psUSB->psEP[ulEP].sOut.ulCount = 0;
+        psUSB->psEP[ulEP].sOut.ulRead = 0;
+        psUSB->psEP[ulEP].ulLoad = 0;
+        psUSB->psEP[ulEP].bINStall = false;
+        psUSB->psEP[ulEP].bOUTStall = false;
+    }
+    psUSB->ulIntControl |= USB_INTCTRL_RESET;
+    SimIntRaise(psUSB);
+}
+
+void
+SimHostSuspend(unsigned long ulIndex)
+{
+    g_psSimUSB[ulIndex].ulIntControl |= USB_INTCTRL_SUSPEND;
+    SimIntRaise(&g_psSimUSB[ulIndex]);
+}
+
+void
+SimHostResume(unsigned long ulIndex)
+{
+    g_psSimUSB[ulIndex].ulIntControl |= USB_INTCTRL_RESUME;
+    SimIntRaise(&g_psSimUSB[ulIndex]);
+}
+
+void
+SimHostDisconnect(unsigned long ulIndex)
+{
+    g_psSimUSB[ulIndex].ulIntControl |= USB_INTCTRL_DISCONNECT;
+    SimIntRaise(&g_psSimUSB[ulIndex]);
+}
+
+void
+SimHostSOF(unsigned long ulIndex)
+{
+    g_psSimUSB[ulIndex].ulIntControl |= USB_INTCTRL_SOF;
+    SimIntRaise(&g_psSimUSB[ulIndex]);
+}
+
+//*****************************************************************************
+//
+// Raises an endpoint zero interrupt and checks whether the device responded
+// to it by stalling.  If it did, the stall is sent to the host and the
+// resulting interrupt handled.
+//
+//*****************************************************************************
+static void
+SimEP0Raise(tSimController *psUSB)
+{
+    psUSB->ulIntEndpoint |= USB_INTEP_0;
+    SimIntRaise(psUSB);
+}
+
+static tBoolean
+SimEP0Stalled(tSimController *psUSB)
+{
+    if(!psUSB->psEP[0].bOUTStall)
+    {
+        return(false);
+    }
+
+    psUSB->psEP[0].bOUTStall = false;
+    psUSB->psEP[0].sIn.ulCount = 0;
+    psUSB->psEP[0].ulLoad = 0;
+    psUSB->ulEP0Status |= USB_DEV_EP0_SENT_STALL;
+    SimEP0Raise(psUSB);
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Waits for the device to make endpoint zero ready for the next stage of a
+// control transfer.  If it is not ready, the idle hook is called to let the
+// device do work deferred to its main loop.
+//
+// \param psUSB is the controller.
+// \param bIn is true to wait for an IN packet or false to wait for the last
+// OUT packet to be acknowledged.
+//
+// \return Returns 0 when the controller is ready, SIM_CONTROL_STALL if the
+// device stalled or SIM_CONTROL_TIMEOUT if it did not respond.
+//
+//*****************************************************************************
+static long
+SimEP0Wait(tSimController *psUSB, tBoolean bIn)
+{
+    unsigned long ulRetry;
+
+    for(ulRetry = 0; ulRetry <= SIM_IDLE_RETRIES; ulRetry++)
+    {
+        if(SimEP0Stalled(psUSB))
+        {
+            return(SIM_CONTROL_STALL);
+        }
+        if(bIn ? (psUSB->psEP[0].sIn.ulCount != 0) :
+           (psUSB->psEP[0].sOut.ulCount == 0))
+        {
+            return(0);
+        }
+        if(g_pfnSimIdle)
+        {
+            g_pfnSimIdle();
+        }
+    }
+    return(SIM_CONTROL_TIMEOUT);
+}
+
+//*****************************************************************************
+//
+// Performs a control transfer on endpoint zero.
+//
+// \param ulIndex is the index of the USB controller.
+// \param ucRequestType, ucRequest, usValue, usIndex and usLength are the
+// fields of the setup packet.
+// \param pucData points to the data to send to the device or to the buffer
+// for data read from it.  The direction is given by bit 7 of ucRequestType.
+//
+// \return Returns the number of bytes transferred in the data stage or
+// SIM_CONTROL_STALL or SIM_CONTROL_TIMEOUT.
+//
+//*****************************************************************************
+long
+SimHostControl(unsigned long ulIndex, unsigned char ucRequestType,
+               unsigned char ucRequest, unsigned short usValue,
+               unsigned short usIndex, unsigned short usLength,
+               unsigned char *pucData)
+{
+    tSimController *psUSB = &g_psSimUSB[ulIndex];
+    tSimEndpoint *psEP0 = &psUSB->psEP[0];
+    unsigned char pucSetup[8];
+    unsigned long ulDone, ulSize, ulTrans;
+    long lStatus;
+
+    //
+    // The setup stage.
+    //
+    pucSetup[0] = ucRequestType;
+    pucSetup[1] = ucRequest;
+    pucSetup[2] = usValue & 0xFF;
+    pucSetup[3] = usValue >> 8;
+    pucSetup[4] = usIndex & 0xFF;
+    pucSetup[5] = usIndex >> 8;
+    pucSetup[6] = usLength & 0xFF;
+    pucSetup[7] = usLength >> 8;
+
+    //
+    // A setup packet ends any data stage which the host did not finish, such
+    // as the zero-length packet a device sends after a multiple of the
+    // packet size when the host has already had the wLength it asked for.
+    // The controller discards the packet and flags the early end.
+    //
+    if(psEP0->sIn.ulCount || psEP0->ulLoad)
+    {
+        psEP0->sIn.ulCount = 0;
+        psEP0->ulLoad = 0;
+        psUSB->ulEP0Status |= USB_DEV_EP0_SETUP_END;
+    }
+    psEP0->sOut.ulCount = 0;
+    psEP0->sOut.ulRead = 0;
+    SimQueuePush(&psEP0->sOut, pucSetup, 8);
+    SimEP0Raise(psUSB);
+
+    ulDone = 0;
+    if((ucRequestType & 0x80) && usLength)
+    {
+        //
+        // An IN data stage.  Each packet read raises an interrupt, the last
+        // of which also completes the status stage.
+        //
+        while(1)
+        {
+            lStatus = SimEP0Wait(psUSB, true);
+            if(lStatus)
+            {
+                return(lStatus);
+            }
+
+            //
+            // Note the transaction type of this packet before the interrupt
+            // lets the device load the next one.
+            //
+            ulTrans = psUSB->ulEP0Trans;
+            ulSize = psEP0->sIn.pulSize[0];
+            if((ulDone + ulSize) > usLength)
+            {
+                ulSize = usLength - ulDone;
+            }
+            memcpy(pucData + ulDone, psEP0->sIn.ppucData[0], ulSize);
+            ulDone += ulSize;
+            SimQueuePop(&psEP0->sIn);
+            SimEP0Raise(psUSB);
+
+            if((ulTrans == USB_TRANS_IN_LAST) ||
+               (ulSize < MAX_PACKET_SIZE_EP0) || (ulDone >= usLength))
+            {
+                break;
+            }
+        }
+        return(ulDone);
+    }
+
+    //
+    // An OUT data stage, if there is one.
+    //
+    while(ulDone < usLength)
+    {
+        lStatus = SimEP0Wait(psUSB, false);
+        if(lStatus)
+        {
+            return(lStatus);
+        }
+
+        ulSize = usLength - ulDone;
+        if(ulSize > MAX_PACKET_SIZE_EP0)
+        {
+            ulSize = MAX_PACKET_SIZE_EP0;
+        }
+        SimQueuePush(&psEP0->sOut, pucData + ulDone, ulSize);
+        ulDone += ulSize;
+        SimEP0Raise(psUSB);
+    }
+
+    //
+    // The status stage, once the device has acknowledged the last packet.
+    //
+    lStatus = SimEP0Wait(psUSB, false);
+    if(lStatus)
+    {
+        return(lStatus);
+    }
+    SimEP0Raise(psUSB);
+    if(SimEP0Stalled(psUSB))
+    {
+        return(SIM_CONTROL_STALL);
+    }
+
+    return(ulDone);
+}
+
+//*****************************************************************************
+//
+// Reads a packet from an IN endpoint.
+//
+// \param ulIndex is the index of the USB controller.
+// \param ulEndpoint is the endpoint number, from 1 to 7.
+// \param pucData points to the buffer for the packet.
+//
+// \return Returns the size of the packet or -1 if the endpoint had no packet
+// ready and so would have NAKed the IN token.
+//
+//*****************************************************************************
+long
+SimHostIn(unsigned long ulIndex, unsigned long ulEndpoint,
+          unsigned char *pucData)
+{
+    tSimController *psUSB = &g_psSimUSB[ulIndex];
+    tSimEndpoint *psEP = &psUSB->psEP[ulEndpoint];
+    unsigned long ulSize;
+
+    if(!psEP->sIn.ulCount || psEP->bINStall)
+    {
+        return(-1);
+    }
+
+    ulSize = psEP->sIn.pulSize[0];
+    memcpy(pucData, psEP->sIn.ppucData[0], ulSize);
+    SimQueuePop(&psEP->sIn);
+    psUSB->ulIntEndpoint |= 1 << ulEndpoint;
+    SimIntRaise(psUSB);
+    return(ulSize);
+}
+
+//*****************************************************************************
+//
+// Writes a packet to an OUT endpoint.
+//
+// \param ulIndex is the index of the USB controller.
+// \param ulEndpoint is the endpoint number, from 1 to 7.
+// \param pucData points to the packet.
+// \param ulSize is the size of the packet.
+//
+// \return Returns true if the packet was accepted or false if the endpoint's
+// FIFO was full and so the OUT token would have been NAKed.
+//
+//*****************************************************************************
+tBoolean
+SimHostOut(unsigned long ulIndex, unsigned long ulEndpoint,
+           const unsigned char *pucData, unsigned long ulSize)
+{
+    tSimController *psUSB = &g_psSimUSB[ulIndex];
+    tSimEndpoint *psEP = &psUSB->psEP[ulEndpoint];
+
+    if((psEP->sOut.ulCount >= SimDepth(&psEP->sOUTFIFO)) || psEP->bOUTStall)
+    {
+        return(false);
+    }
+
+    //
+    // A packet arriving behind one that the processor has not yet read does
+    // not interrupt until that one has been acknowledged.
+    //
+    SimQueuePush(&psEP->sOut, pucData, ulSize);
+    if(psEP->sOut.ulCount == 1)
+    {
+        psUSB->ulIntEndpoint |= 0x10000 << ulEndpoint;
+        SimIntRaise(psUSB);
+    }
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Enumerates the device as a host would, resetting the bus, assigning an
+// address, reading the device descriptor and selecting a configuration.
+//
+// \param ulIndex is the index of the USB controller.
+// \param ulAddress is the address to assign to the device.
+// \param ulConfig is the configuration value to select.
+//
+// \return Returns true if the device accepted every request or false
+// otherwise.
+//
+//*****************************************************************************
+tBoolean
+SimHostEnumerate(unsigned long ulIndex, unsigned long ulAddress,
+                 unsigned long ulConfig)
+{
+    unsigned char pucDesc[18];
+
+    SimHostReset(ulIndex);
+
+    if(SimHostControl(ulIndex, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                      USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                      USB_DTYPE_DEVICE << 8, 0, 8, pucDesc) != 8)
+    {
+        return(false);
+    }
+
+    SimHostReset(ulIndex);
+
+    if((SimHostControl(ulIndex, USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD |
+                       USB_RTYPE_DEVICE, USBREQ_SET_ADDRESS, ulAddress, 0, 0,
+                       0) != 0) ||
+       (g_psSimUSB[ulIndex].ulAddress != ulAddress))
+    {
+        return(false);
+    }
+
+    if(SimHostControl(ulIndex, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                      USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                      USB_DTYPE_DEVICE << 8, 0, 18, pucDesc) != 18)
+    {
+        return(false);
+    }
+
+    return(SimHostControl(ulIndex, USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD |
+                          USB_RTYPE_DEVICE, USBREQ_SET_CONFIG, ulConfig, 0, 0,
+                          0) == 0);
+}
+
+//*****************************************************************************
+//
+// Inspection of the controller state.
+//
+//*****************************************************************************
+unsigned long
+SimDeviceAddress(unsigned long ulIndex)
+{
+    return(g_psSimUSB[ulIndex].ulAddress);
+}
+
+tBoolean
+SimDeviceConnected(unsigned long ulIndex)
+{
+    return(g_psSimUSB[ulIndex].bConnected);
+}
+
+const tSimFIFO *
+SimFIFOGet(unsigned long ulIndex, unsigned long ulEndpoint, tBoolean bIn)
+{
+    tSimEndpoint *psEP = &g_psSimUSB[ulIndex].psEP[ulEndpoint];
+
+    return(bIn ? &psEP->sINFIFO : &psEP->sOUTFIFO);
+}
+
+unsigned long
+SimPacketsQueued(unsigned long ulIndex, unsigned long ulEndpoint, tBoolean bIn)
+{
+    tSimEndpoint *psEP = &g_psSimUSB[ulIndex].psEP[ulEndpoint];
+
+    return(bIn ? psEP->sIn.ulCount : psEP->sOut.ulCount);
+}
+
+tBoolean
+SimEndpointStalled(unsigned long ulIndex, unsigned long ulEndpoint,
+                   tBoolean bIn)
+{
+    tSimEndpoint *psEP = &g_psSimUSB[ulIndex].psEP[ulEndpoint];
+
+    return(bIn ? psEP->bINStall : psEP->bOUTStall);
+}
@@ -0,0 +1,166 @@
+//*****************************************************************************
+//
+// usbsim.h - Interface to the host simulation of a Stellaris part used to
+//            run the USB library in the tests.
+//
+// The simulation provides the driver library functions used by the USB
+// library along with a model of the processor interrupt mask, the USB
+// controller, its endpoint FIFOs and the uDMA controller.  Tests drive the
+// model from the USB host's side using the SimHostxxx() functions, each of
+// which raises the USB interrupt and runs the registered interrupt handler
+// just as the hardware would.
+//
+//*****************************************************************************
+
+#ifndef __USBSIM_H__
+#define __USBSIM_H__
+
+//*****************************************************************************
+//
+// The number of USB controllers and endpoints modeled and the largest packet
+// that any endpoint may hold.
+//
+//*****************************************************************************
+#define SIM_NUM_CONTROLLERS     2
+#define SIM_NUM_ENDPOINTS       8
+#define SIM_MAX_PACKET          1024
+
+//*****************************************************************************
+//
+// The size of the endpoint FIFO RAM in the USB controller.
+//
+//*****************************************************************************
+#define SIM_FIFO_RAM_SIZE       4096
+
+//*****************************************************************************
+//
+// The value returned by SimHostControl() when the device stalls a request and
+// when it fails to respond to one.
+//
+//*****************************************************************************
+#define SIM_CONTROL_STALL       (-1)
+#define SIM_CONTROL_TIMEOUT     (-2)
+
+//*****************************************************************************
+//
+// The FIFO assigned to one direction of an endpoint by USBFIFOConfigSet() and
+// the settings passed to USBDevEndpointConfigSet().
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // True if USBFIFOConfigSet() has been called for the endpoint.
+    //
+    tBoolean bConfigured;
+
+    //
+    // The start address of the FIFO in the FIFO RAM and its total size in
+    // bytes, including the second buffer if it is double-buffered.
+    //
+    unsigned long ulAddress;
+    unsigned long ulSize;
+
+    //
+    // True if the FIFO is double-buffered.
+    //
+    tBoolean bDoubleBuffered;
+
+    //
+    // The maximum packet size and flags passed to USBDevEndpointConfigSet()
+    // or 0 if it has not been called for the endpoint.
+    //
+    unsigned long ulMaxPacket;
+    unsigned long ulFlags;
+}
+tSimFIFO;
+
+//*****************************************************************************
+//
+// Test result checking.  CHECK() records a failure, with its location, if the
+// expression is false and the test carries on.  SimResult() prints the
+// outcome of a test and returns the value to be returned from main().
+//
+//*****************************************************************************
+#define CHECK(expr)             SimCheck((expr) != 0, #expr, __FILE__,        \
+                                         __LINE__)
+
+extern tBoolean SimCheck(tBoolean bPassed, const char *pcExpr,
+                         const char *pcFile, int iLine);
+extern int SimResult(const char *pcTest);
+
+//*****************************************************************************
+//
+// General simulation control.
+//
+//*****************************************************************************
+extern void SimReset(void);
+extern void SimVerbose(tBoolean bVerbose);
+extern double SimTimeNow(void);
+
+//*****************************************************************************
+//
+// Interrupt control.  The handler for each USB controller's interrupt must be
+// registered before the USB library is initialized.  The idle hook is called
+// by SimHostControl() while it waits for the device to respond to a request
+// so that work deferred to the main loop can be done.  SimIntMaskCount()
+// returns the number of times IntMasterDisable() has been called.
+//
+//*****************************************************************************
+extern void SimIntHandlerSet(unsigned long ulIndex, void (*pfnHandler)(void));
+extern void SimIdleHookSet(void (*pfnIdle)(void));
+extern tBoolean SimIntMasked(void);
+extern unsigned long SimIntMaskCount(void);
+extern unsigned long SimIntPendCount(unsigned long ulInterrupt);
+extern unsigned long SimUSBIntCount(unsigned long ulIndex);
+
+//*****************************************************************************
+//
+// The actions of the USB host.
+//
+//*****************************************************************************
+extern void SimHostReset(unsigned long ulIndex);
+extern void SimHostSuspend(unsigned long ulIndex);
+extern void SimHostResume(unsigned long ulIndex);
+extern void SimHostDisconnect(unsigned long ulIndex);
+extern void SimHostSOF(unsigned long ulIndex);
+extern long SimHostControl(unsigned long ulIndex,
+                           unsigned char ucRequestType,
+                           unsigned char ucRequest, unsigned short usValue,
+                           unsigned short usIndex, unsigned short usLength,
+                           unsigned char *pucData);
+extern long SimHostIn(unsigned long ulIndex, unsigned long ulEndpoint,
+                      unsigned char *pucData);
+extern tBoolean SimHostOut(unsigned long ulIndex, unsigned long ulEndpoint,
+                           const unsigned char *pucData,
+                           unsigned long ulSize);
+extern tBoolean SimHostEnumerate(unsigned long ulIndex,
+                                 unsigned long ulAddress,
+                                 unsigned long ulConfig);
+
+//*****************************************************************************
+//
+// Inspection of the controller state.
+//
+//*****************************************************************************
+extern unsigned long SimDeviceAddress(unsigned long ulIndex);
+extern tBoolean SimDeviceConnected(unsigned long ulIndex);
+extern const tSimFIFO *SimFIFOGet(unsigned long ulIndex,
+                                  unsigned long ulEndpoint, tBoolean bIn);
+extern unsigned long SimPacketsQueued(unsigned long ulIndex,
+                                      unsigned long ulEndpoint, tBoolean bIn);
+extern tBoolean SimEndpointStalled(unsigned long ulIndex,
+                                   unsigned long ulEndpoint, tBoolean bIn);
+
+//*****************************************************************************
+//
+// uDMA control.  Transfers started by the USB library complete when
+// SimDMARun() is called, which then raises the interrupt of the USB
+// controller owning the channel.
+//
+//*****************************************************************************
+extern unsigned long SimDMARun(void);
+extern unsigned long SimDMATransfers(void);
+extern unsigned long SimDMABytes(void);
+
+#endif // __USBSIM_H__
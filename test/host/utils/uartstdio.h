@@ -0,0 +1,19 @@
+//*****************************************************************************
+//
+// uartstdio.h - Prototypes for the UART console functions.
+//
+//*****************************************************************************
+
+#ifndef __UARTSTDIO_H__
+#define __UARTSTDIO_H__
+
+//*****************************************************************************
+//
+// The simulator writes console output to stdout when SimVerbose() has been
+// called and discards it otherwise.
+//
+//*****************************************************************************
+extern void UARTStdioInit(unsigned long ulPortNum);
+extern void UARTprintf(const char *pcString, ...);
+
+#endif // __UARTSTDIO_H__
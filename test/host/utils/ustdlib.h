@@ -0,0 +1,14 @@
+//*****************************************************************************
+//
+// ustdlib.h - Prototypes for the simple standard library functions.
+//
+//*****************************************************************************
+
+#ifndef __USTDLIB_H__
+#define __USTDLIB_H__
+
+extern int usnprintf(char *pcBuf, unsigned long ulSize, const char *pcString,
+                     ...);
+extern int usprintf(char *pcBuf, const char *pcString, ...);
+
+#endif // __USTDLIB_H__
@@ -0,0 +1,448 @@
+//*****************************************************************************
+//
+// msos20_bos.c - Checks the BOS descriptor and Microsoft OS 2.0 descriptor
+//                set generated by USBDCDMSOS20Set().
+//
+// A bulk device is enumerated and given several Microsoft OS 2.0
+// configurations.  For each, the host reads the BOS descriptor as Windows
+// does, first its header then the whole descriptor, and then reads the
+// descriptor set with the vendor request named in the platform capability.
+// Both blobs are parsed and every length, offset and field checked against
+// the configuration.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The descriptor types within the BOS descriptor and the descriptor set.
+//
+//*****************************************************************************
+#define CAP_USB20_EXT           2
+#define CAP_PLATFORM            5
+#define MSOS20_SET_HEADER       0
+#define MSOS20_SUBSET_CONFIG    1
+#define MSOS20_SUBSET_FUNCTION  2
+#define MSOS20_COMPATIBLE_ID    3
+#define MSOS20_REG_PROPERTY     4
+
+//*****************************************************************************
+//
+// The Windows version, 8.1, given in the platform capability and set header.
+//
+//*****************************************************************************
+#define WINDOWS_VERSION         0x06030000
+
+//*****************************************************************************
+//
+// The bmRequestType of the vendor request which reads the descriptor set.
+//
+//*****************************************************************************
+#define MSOS20_REQUEST_TYPE     (USB_RTYPE_DIR_IN | USB_RTYPE_VENDOR |        \
+                                 USB_RTYPE_DEVICE)
+
+//*****************************************************************************
+//
+// The UUID of the Microsoft OS 2.0 platform capability in the order sent on
+// the bus.
+//
+//*****************************************************************************
+static const unsigned char g_pucPlatformUUID[16] =
+{
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,
+    0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F
+};
+
+//*****************************************************************************
+//
+// The configurations checked.
+//
+//*****************************************************************************
+#define GUID                    "{6E45736A-2B1B-4078-B772-B3AF2B6FDE1C}"
+
+static const tUSBMSOS20Config g_psConfigs[] =
+{
+    { 0x20, USB_MSOS20_DEVICE, "WINUSB", GUID },
+    { 0x21, USB_MSOS20_DEVICE, "WINUSB", 0 },
+    { 0x22, 0, "WINUSB", GUID },
+    { 0xC3, 1, "ABCDEFGH", 0 }
+};
+
+#define NUM_CONFIGS             (sizeof(g_psConfigs) / sizeof(g_psConfigs[0]))
+
+//*****************************************************************************
+//
+// The bulk device.
+//
+//*****************************************************************************
+static tBulkInstance g_sBulkInst;
+
+static unsigned long
+Handler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+        void *pvMsgData)
+{
+    return(0);
+}
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    Handler,
+    0,
+    Handler,
+    0,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_sBulkInst,
+    0,
+    0,
+    0
+};
+
+//*****************************************************************************
+//
+// Reads little-endian values from a descriptor.
+//
+//*****************************************************************************
+static unsigned long
+Short(const unsigned char *pucData)
+{
+    return(pucData[0] | (pucData[1] << 8));
+}
+
+static unsigned long
+Long(const unsigned char *pucData)
+{
+    return(Short(pucData) | (Short(pucData + 2) << 16));
+}
+
+//*****************************************************************************
+//
+// Returns true if ulSize bytes of UTF-16LE text match the ASCII string
+// pcString followed by its terminating NULL.
+//
+//*****************************************************************************
+static tBoolean
+UnicodeMatch(const unsigned char *pucData, unsigned long ulSize,
+             const char *pcString)
+{
+    unsigned long ulLoop;
+
+    if(ulSize != ((strlen(pcString) + 1) * 2))
+    {
+        return(false);
+    }
+    for(ulLoop = 0; ulLoop < ulSize / 2; ulLoop++)
+    {
+        if(Short(pucData + (ulLoop * 2)) != (unsigned char)pcString[ulLoop])
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Reads the BOS descriptor as Windows does and checks it.  Returns the length
+// of the descriptor set and its vendor code through the pointers.
+//
+//*****************************************************************************
+static void
+CheckBOS(const tUSBMSOS20Config *psConfig, unsigned long *pulSetSize,
+         unsigned char *pucVendorCode)
+{
+    unsigned char pucBOS[256], *pucCap;
+    unsigned long ulTotal, ulCaps, ulPos;
+    tBoolean bUSB20Ext, bPlatform;
+
+    *pulSetSize = 0;
+    *pucVendorCode = 0;
+
+    //
+    // Read the header alone to learn the total length.
+    //
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_BOS << 8, 0, 5, pucBOS) == 5);
+    CHECK(pucBOS[0] == 5);
+    CHECK(pucBOS[1] == USB_DTYPE_BOS);
+    ulTotal = Short(pucBOS + 2);
+    ulCaps = pucBOS[4];
+    CHECK((ulTotal > 5) && (ulTotal <= sizeof(pucBOS)));
+    if((ulTotal <= 5) || (ulTotal > sizeof(pucBOS)))
+    {
+        return;
+    }
+
+    //
+    // Read the whole descriptor and walk its capabilities.  They must
+    // exactly fill it.
+    //
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_BOS << 8, 0, sizeof(pucBOS), pucBOS) ==
+          (long)ulTotal);
+    CHECK(Short(pucBOS + 2) == ulTotal);
+
+    bUSB20Ext = false;
+    bPlatform = false;
+    for(ulPos = 5; ulPos < ulTotal; ulPos += pucCap[0])
+    {
+        pucCap = pucBOS + ulPos;
+        CHECK(pucCap[0] >= 3);
+        CHECK(pucCap[1] == USB_DTYPE_DEVICE_CAP);
+        if((pucCap[0] < 3) || ((ulPos + pucCap[0]) > ulTotal))
+        {
+            CHECK(false);
+            return;
+        }
+        CHECK(ulCaps != 0);
+        ulCaps--;
+
+        if(pucCap[2] == CAP_USB20_EXT)
+        {
+            //
+            // No link power management is offered.
+            //
+            CHECK(pucCap[0] == 7);
+            CHECK(Long(pucCap + 3) == 0);
+            bUSB20Ext = true;
+        }
+        else if(pucCap[2] == CAP_PLATFORM)
+        {
+            CHECK(pucCap[0] == 28);
+            CHECK(pucCap[3] == 0);
+            CHECK(memcmp(pucCap + 4, g_pucPlatformUUID, 16) == 0);
+            CHECK(Long(pucCap + 20) == WINDOWS_VERSION);
+            CHECK(pucCap[26] == psConfig->ucVendorCode);
+            CHECK(pucCap[27] == 0);
+            *pulSetSize = Short(pucCap + 24);
+            *pucVendorCode = pucCap[26];
+            bPlatform = true;
+        }
+    }
+    CHECK(ulPos == ulTotal);
+    CHECK(ulCaps == 0);
+    CHECK(bUSB20Ext);
+    CHECK(bPlatform);
+}
+
+//*****************************************************************************
+//
+// Reads the descriptor set named by the BOS descriptor and checks it against
+// the configuration.
+//
+//*****************************************************************************
+static void
+CheckSet(const tUSBMSOS20Config *psConfig, unsigned long ulSetSize,
+         unsigned char ucVendorCode)
+{
+    unsigned char pucSet[512], pucPart[512], *pucDesc;
+    unsigned long ulPos, ulLength, ulType, ulExpected, ulNameSize;
+    unsigned long ulDataSize;
+    tBoolean bCompatID, bRegProperty, bFunction;
+    char pcCompatID[9];
+
+    CHECK((ulSetSize >= 10) && (ulSetSize <= sizeof(pucSet)));
+    if((ulSetSize < 10) || (ulSetSize > sizeof(pucSet)))
+    {
+        return;
+    }
+
+    //
+    // Work out the size the set should be.
+    //
+    ulExpected = 10 + 20;
+    if(psConfig->ucFirstInterface != USB_MSOS20_DEVICE)
+    {
+        ulExpected += 16;
+    }
+    if(psConfig->pcInterfaceGUID)
+    {
+        ulExpected += 10 + ((strlen("DeviceInterfaceGUIDs") + 1) * 2) +
+                      ((strlen(psConfig->pcInterfaceGUID) + 2) * 2);
+    }
+    CHECK(ulSetSize == ulExpected);
+
+    //
+    // Read the set as the host would, then read less of it and check that
+    // the same bytes arrive.
+    //
+    CHECK(SimHostControl(0, MSOS20_REQUEST_TYPE, ucVendorCode, 0,
+                         USB_MSOS20_DESCRIPTOR_INDEX, ulSetSize, pucSet) ==
+          (long)ulSetSize);
+    CHECK(SimHostControl(0, MSOS20_REQUEST_TYPE, ucVendorCode, 0,
+                         USB_MSOS20_DESCRIPTOR_INDEX, ulSetSize - 3,
+                         pucPart) == (long)(ulSetSize - 3));
+    CHECK(memcmp(pucSet, pucPart, ulSetSize - 3) == 0);
+
+    //
+    // The set header.
+    //
+    CHECK(Short(pucSet) == 10);
+    CHECK(Short(pucSet + 2) == MSOS20_SET_HEADER);
+    CHECK(Long(pucSet + 4) == WINDOWS_VERSION);
+    CHECK(Short(pucSet + 8) == ulSetSize);
+
+    //
+    // Walk the descriptors following the header.  They must exactly fill the
+    // set and any subset must run to its end.
+    //
+    bCompatID = false;
+    bRegProperty = false;
+    bFunction = false;
+    for(ulPos = 10; ulPos < ulSetSize; ulPos += ulLength)
+    {
+        pucDesc = pucSet + ulPos;
+        ulLength = Short(pucDesc);
+        ulType = Short(pucDesc + 2);
+        if((ulLength < 4) || ((ulPos + ulLength) > ulSetSize))
+        {
+            CHECK(false);
+            return;
+        }
+
+        switch(ulType)
+        {
+            case MSOS20_SUBSET_CONFIG:
+            {
+                CHECK(psConfig->ucFirstInterface != USB_MSOS20_DEVICE);
+                CHECK(ulLength == 8);
+                CHECK(ulPos == 10);
+                CHECK(pucDesc[4] == 0);
+                CHECK(Short(pucDesc + 6) == (ulSetSize - ulPos));
+                break;
+            }
+
+            case MSOS20_SUBSET_FUNCTION:
+            {
+                CHECK(ulLength == 8);
+                CHECK(ulPos == 18);
+                CHECK(pucDesc[4] == psConfig->ucFirstInterface);
+                CHECK(Short(pucDesc + 6) == (ulSetSize - ulPos));
+                bFunction = true;
+                break;
+            }
+
+            case MSOS20_COMPATIBLE_ID:
+            {
+                CHECK(ulLength == 20);
+                memcpy(pcCompatID, pucDesc + 4, 8);
+                pcCompatID[8] = 0;
+                CHECK(strcmp(pcCompatID, psConfig->pcCompatibleID) == 0);
+                CHECK(memcmp(pucDesc + 4 + strlen(pcCompatID),
+                             "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
+                             16 - strlen(pcCompatID)) == 0);
+                bCompatID = true;
+                break;
+            }
+
+            case MSOS20_REG_PROPERTY:
+            {
+                //
+                // A REG_MULTI_SZ holding the GUID with a second NULL to end
+                // the list.
+                //
+                CHECK(psConfig->pcInterfaceGUID != 0);
+                CHECK(Short(pucDesc + 4) == 7);
+                ulNameSize = Short(pucDesc + 6);
+                CHECK(UnicodeMatch(pucDesc + 8, ulNameSize,
+                                   "DeviceInterfaceGUIDs"));
+                ulDataSize = Short(pucDesc + 8 + ulNameSize);
+                CHECK(ulLength == (10 + ulNameSize + ulDataSize));
+                if(psConfig->pcInterfaceGUID &&
+                   (ulLength == (10 + ulNameSize + ulDataSize)))
+                {
+                    CHECK(UnicodeMatch(pucDesc + 10 + ulNameSize,
+                                       ulDataSize - 2,
+                                       psConfig->pcInterfaceGUID));
+                    CHECK(Short(pucDesc + ulLength - 2) == 0);
+                }
+                bRegProperty = true;
+                break;
+            }
+
+            default:
+            {
+                CHECK(false);
+                break;
+            }
+        }
+    }
+    CHECK(ulPos == ulSetSize);
+    CHECK(bCompatID);
+    CHECK(bRegProperty == (psConfig->pcInterfaceGUID ? true : false));
+    CHECK(bFunction ==
+          ((psConfig->ucFirstInterface != USB_MSOS20_DEVICE) ? true : false));
+}
+
+//*****************************************************************************
+//
+// Checks the blobs generated for each configuration, then checks that
+// configurations which cannot be represented are refused and that no BOS
+// descriptor is served once the descriptors are removed.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    static const tUSBMSOS20Config sLongID =
+    {
+        0x20, USB_MSOS20_DEVICE, "ABCDEFGHI", 0
+    };
+    static const tUSBMSOS20Config sLongGUID =
+    {
+        0x20, USB_MSOS20_DEVICE, "WINUSB", GUID "X"
+    };
+    unsigned char pucData[64], ucVendorCode;
+    unsigned long ulConfig, ulSetSize;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+
+    CHECK(USBDBulkInit(0, (tUSBDBulkDevice *)&g_sBulkDevice) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+
+    for(ulConfig = 0; ulConfig < NUM_CONFIGS; ulConfig++)
+    {
+        CHECK(USBDCDMSOS20Set(0, &g_psConfigs[ulConfig]));
+        CheckBOS(&g_psConfigs[ulConfig], &ulSetSize, &ucVendorCode);
+        CheckSet(&g_psConfigs[ulConfig], ulSetSize, ucVendorCode);
+        printf("vendor code 0x%02x interface 0x%02x %-8s %s: set %lu bytes\n",
+               g_psConfigs[ulConfig].ucVendorCode,
+               g_psConfigs[ulConfig].ucFirstInterface,
+               g_psConfigs[ulConfig].pcCompatibleID,
+               g_psConfigs[ulConfig].pcInterfaceGUID ? "GUID" : "    ",
+               ulSetSize);
+    }
+
+    //
+    // A configuration which does not fit is refused and leaves no BOS
+    // descriptor behind, as does removing the descriptors.
+    //
+    CHECK(!USBDCDMSOS20Set(0, &sLongID));
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_BOS << 8, 0, 5, pucData) < 0);
+    CHECK(!USBDCDMSOS20Set(0, &sLongGUID));
+    CHECK(USBDCDMSOS20Set(0, &g_psConfigs[0]));
+    CHECK(USBDCDMSOS20Set(0, 0));
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_BOS << 8, 0, 5, pucData) < 0);
+
+    return(SimResult("msos20_bos"));
+}
@@ -0,0 +1,220 @@
+//*****************************************************************************
+//
+// ringbuf_bench.c - Checks and times the block copy paths of the USB library
+//                   ring buffer.
+//
+// USBRingBufRead() and USBRingBufWrite() copy data in at most two contiguous
+// segments and update the buffer index once per call.  This test checks that
+// the data survives every combination of transfer size and wrap position in
+// each ring buffer mode, that each call masks interrupts at most once, and
+// then compares the throughput of the block copies against the previous
+// implementation, which moved each byte with USBRingBufReadOne() and
+// USBRingBufWriteOne().
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "usblib/usblib.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The size of the ring buffer used by the tests.  This is a power of two so
+// that the same buffer can be used in every mode.
+//
+//*****************************************************************************
+#define RING_SIZE               8192
+
+//*****************************************************************************
+//
+// The number of bytes moved through the ring buffer for each timed transfer
+// size.
+//
+//*****************************************************************************
+#define BENCH_BYTES             (32 * 1024 * 1024)
+
+//*****************************************************************************
+//
+// The ring buffer modes tested.
+//
+//*****************************************************************************
+static const struct
+{
+    const char *pcName;
+    unsigned long ulFlags;
+}
+g_psModes[] =
+{
+    { "atomic", 0 },
+    { "spsc", USB_RING_FLAG_SPSC },
+    { "pow2", USB_RING_FLAG_POW2 },
+    { "spsc+pow2", USB_RING_FLAG_SPSC | USB_RING_FLAG_POW2 }
+};
+
+#define NUM_MODES               (sizeof(g_psModes) / sizeof(g_psModes[0]))
+
+//*****************************************************************************
+//
+// The transfer sizes timed.
+//
+//*****************************************************************************
+static const unsigned long g_pulSizes[] = { 1, 64, 512, 4096 };
+
+#define NUM_SIZES               (sizeof(g_pulSizes) / sizeof(g_pulSizes[0]))
+
+static unsigned char g_pucRing[RING_SIZE];
+static unsigned char g_pucSrc[RING_SIZE];
+static unsigned char g_pucDst[RING_SIZE];
+
+//*****************************************************************************
+//
+// Reads a free-running cycle counter where the host has one, otherwise the
+// time in nanoseconds.
+//
+//*****************************************************************************
+static unsigned long long
+CyclesNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return(__builtin_ia32_rdtsc());
+#else
+    return((unsigned long long)(SimTimeNow() * 1e9));
+#endif
+}
+
+//*****************************************************************************
+//
+// Checks that data written to and read from the ring buffer in blocks of
+// ulBlock bytes comes out unchanged with the buffer wrap at every position,
+// and that each block copy masks interrupts no more than once.
+//
+//*****************************************************************************
+static void
+CheckBlocks(unsigned long ulFlags, unsigned long ulBlock)
+{
+    tUSBRingBufObject sRing;
+    unsigned long ulStart, ulLoop, ulMasks;
+
+    for(ulLoop = 0; ulLoop < RING_SIZE; ulLoop++)
+    {
+        g_pucSrc[ulLoop] = (unsigned char)((ulLoop * 7) + ulBlock);
+    }
+
+    for(ulStart = 0; ulStart < 512; ulStart += 61)
+    {
+        USBRingBufInitEx(&sRing, g_pucRing, RING_SIZE, ulFlags);
+
+        //
+        // Move the indices so that the block straddles the wrap point.
+        //
+        sRing.ulReadIndex = sRing.ulWriteIndex =
+            RING_SIZE - ulStart - (ulBlock / 2) - 1;
+
+        memset(g_pucDst, 0, ulBlock);
+        ulMasks = SimIntMaskCount();
+        USBRingBufWrite(&sRing, g_pucSrc, ulBlock);
+        CHECK((SimIntMaskCount() - ulMasks) <= 1);
+        CHECK(USBRingBufUsed(&sRing) == ulBlock);
+
+        ulMasks = SimIntMaskCount();
+        USBRingBufRead(&sRing, g_pucDst, ulBlock);
+        CHECK((SimIntMaskCount() - ulMasks) <= 1);
+        CHECK(USBRingBufEmpty(&sRing));
+        CHECK(memcmp(g_pucSrc, g_pucDst, ulBlock) == 0);
+
+        //
+        // The single-producer/single-consumer mode never masks interrupts.
+        //
+        if(ulFlags & USB_RING_FLAG_SPSC)
+        {
+            CHECK(SimIntMaskCount() == ulMasks);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Moves BENCH_BYTES through the ring buffer in transfers of ulBlock bytes,
+// either with the block copy functions or a byte at a time, and returns the
+// number of bytes moved per cycle.
+//
+//*****************************************************************************
+static double
+TimeBlocks(unsigned long ulFlags, unsigned long ulBlock, tBoolean bPerByte)
+{
+    tUSBRingBufObject sRing;
+    unsigned long long ullStart, ullCycles;
+    unsigned long ulDone, ulLoop;
+
+    USBRingBufInitEx(&sRing, g_pucRing, RING_SIZE, ulFlags);
+
+    ullStart = CyclesNow();
+    for(ulDone = 0; ulDone < BENCH_BYTES; ulDone += ulBlock)
+    {
+        if(bPerByte)
+        {
+            for(ulLoop = 0; ulLoop < ulBlock; ulLoop++)
+            {
+                USBRingBufWriteOne(&sRing, g_pucSrc[ulLoop]);
+            }
+            for(ulLoop = 0; ulLoop < ulBlock; ulLoop++)
+            {
+                g_pucDst[ulLoop] = USBRingBufReadOne(&sRing);
+            }
+        }
+        else
+        {
+            USBRingBufWrite(&sRing, g_pucSrc, ulBlock);
+            USBRingBufRead(&sRing, g_pucDst, ulBlock);
+        }
+    }
+    ullCycles = CyclesNow() - ullStart;
+
+    return((2.0 * BENCH_BYTES) / (double)(ullCycles ? ullCycles : 1));
+}
+
+//*****************************************************************************
+//
+// Runs the checks then prints the benchmark table.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulMode, ulSize;
+    double dPerByte, dBlock;
+
+    SimReset();
+
+    for(ulMode = 0; ulMode < NUM_MODES; ulMode++)
+    {
+        for(ulSize = 1; ulSize <= 4096; ulSize = (ulSize * 3) + 1)
+        {
+            CheckBlocks(g_psModes[ulMode].ulFlags, ulSize);
+        }
+        for(ulSize = 0; ulSize < NUM_SIZES; ulSize++)
+        {
+            CheckBlocks(g_psModes[ulMode].ulFlags, g_pulSizes[ulSize]);
+        }
+    }
+
+    printf("%-10s %6s %14s %14s %8s\n", "mode", "block", "per-byte B/c",
+           "block B/c", "speedup");
+    for(ulMode = 0; ulMode < NUM_MODES; ulMode++)
+    {
+        for(ulSize = 0; ulSize < NUM_SIZES; ulSize++)
+        {
+            dPerByte = TimeBlocks(g_psModes[ulMode].ulFlags,
+                                  g_pulSizes[ulSize], true);
+            dBlock = TimeBlocks(g_psModes[ulMode].ulFlags,
+                                g_pulSizes[ulSize], false);
+            printf("%-10s %6lu %14.4f %14.4f %7.1fx\n",
+                   g_psModes[ulMode].pcName, g_pulSizes[ulSize], dPerByte,
+                   dBlock, dBlock / dPerByte);
+        }
+    }
+
+    return(SimResult("ringbuf_bench"));
+}
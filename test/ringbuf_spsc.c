@@ -0,0 +1,266 @@
+//*****************************************************************************
+//
+// ringbuf_spsc.c - Stress test of the single-producer/single-consumer mode of
+//                  the USB library ring buffer.
+//
+// A producer thread and a consumer thread pass a numbered byte stream through
+// a ring buffer initialized with USB_RING_FLAG_SPSC, using every read and
+// write function the mode allows and random transfer sizes so that the
+// transfers straddle the buffer wrap at varying positions.  The consumer
+// checks each byte against the sequence.  The two threads run on separate
+// cores where the host has them so that the ordering of the index updates is
+// exercised for real.  Each thread yields while the buffer is full or empty
+// so that the test also completes on a single core.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "usblib/usblib.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The number of bytes passed through the ring buffer in each mode.
+//
+//*****************************************************************************
+#define STRESS_BYTES            (16 * 1024 * 1024)
+
+//*****************************************************************************
+//
+// The largest transfer made by either thread.
+//
+//*****************************************************************************
+#define MAX_BLOCK               300
+
+//*****************************************************************************
+//
+// The ring buffer under test and the results of the consumer.
+//
+//*****************************************************************************
+static tUSBRingBufObject g_sRing;
+static unsigned char g_pucRing[1024];
+static unsigned long g_ulErrors;
+static unsigned long g_ulFirstError;
+
+//*****************************************************************************
+//
+// The value of byte ulPos of the stream.
+//
+//*****************************************************************************
+#define STREAM_BYTE(ulPos)      ((unsigned char)((ulPos) ^ ((ulPos) >> 8)))
+
+//*****************************************************************************
+//
+// A small pseudo-random number generator, one per thread.
+//
+//*****************************************************************************
+static unsigned long
+Random(unsigned long *pulSeed)
+{
+    *pulSeed = (*pulSeed * 1103515245) + 12345;
+    return((*pulSeed >> 16) & 0x7FFF);
+}
+
+//*****************************************************************************
+//
+// The producer.  It writes the stream in blocks of random size, choosing
+// between USBRingBufWrite(), USBRingBufWriteOne() and writing directly to the
+// buffer followed by USBRingBufAdvanceWrite().
+//
+//*****************************************************************************
+static void *
+Producer(void *pvArg)
+{
+    unsigned char pucBlock[MAX_BLOCK];
+    unsigned long ulPos, ulSeed, ulSize, ulFree, ulLoop, ulMethod;
+
+    ulSeed = 1;
+    ulPos = 0;
+    while(ulPos < STRESS_BYTES)
+    {
+        ulSize = (Random(&ulSeed) % MAX_BLOCK) + 1;
+        if(ulSize > (STRESS_BYTES - ulPos))
+        {
+            ulSize = STRESS_BYTES - ulPos;
+        }
+        ulMethod = Random(&ulSeed) % 3;
+
+        //
+        // Wait for some space and write as much of the block as fits.
+        //
+        while((ulFree = USBRingBufFree(&g_sRing)) == 0)
+        {
+            sched_yield();
+        }
+        ulSize = (ulSize < ulFree) ? ulSize : ulFree;
+
+        if(ulMethod == 0)
+        {
+            for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+            {
+                pucBlock[ulLoop] = STREAM_BYTE(ulPos + ulLoop);
+            }
+            USBRingBufWrite(&g_sRing, pucBlock, ulSize);
+        }
+        else if(ulMethod == 1)
+        {
+            for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+            {
+                USBRingBufWriteOne(&g_sRing, STREAM_BYTE(ulPos + ulLoop));
+            }
+        }
+        else
+        {
+            //
+            // Fill only the contiguous space at the write pointer.
+            //
+            ulFree = USBRingBufContigFree(&g_sRing);
+            ulSize = (ulSize < ulFree) ? ulSize : ulFree;
+            if(ulSize == 0)
+            {
+                continue;
+            }
+            for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+            {
+                USBRingBufWritePtr(&g_sRing)[ulLoop] =
+                    STREAM_BYTE(ulPos + ulLoop);
+            }
+            USBRingBufAdvanceWrite(&g_sRing, ulSize);
+        }
+        ulPos += ulSize;
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The consumer.  It reads the stream in blocks of random size, choosing
+// between USBRingBufRead(), USBRingBufReadOne() and reading directly from the
+// buffer followed by USBRingBufAdvanceRead(), and checks every byte.
+//
+//*****************************************************************************
+static void *
+Consumer(void *pvArg)
+{
+    unsigned char pucBlock[MAX_BLOCK];
+    unsigned long ulPos, ulSeed, ulSize, ulUsed, ulLoop, ulMethod;
+
+    ulSeed = 2;
+    ulPos = 0;
+    while(ulPos < STRESS_BYTES)
+    {
+        ulSize = (Random(&ulSeed) % MAX_BLOCK) + 1;
+        if(ulSize > (STRESS_BYTES - ulPos))
+        {
+            ulSize = STRESS_BYTES - ulPos;
+        }
+        ulMethod = Random(&ulSeed) % 3;
+
+        //
+        // Wait for some data and read as much of the block as is there.
+        //
+        while((ulUsed = USBRingBufUsed(&g_sRing)) == 0)
+        {
+            sched_yield();
+        }
+        ulSize = (ulSize < ulUsed) ? ulSize : ulUsed;
+
+        if(ulMethod == 0)
+        {
+            USBRingBufRead(&g_sRing, pucBlock, ulSize);
+        }
+        else if(ulMethod == 1)
+        {
+            for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+            {
+                pucBlock[ulLoop] = USBRingBufReadOne(&g_sRing);
+            }
+        }
+        else
+        {
+            ulUsed = USBRingBufContigUsed(&g_sRing);
+            ulSize = (ulSize < ulUsed) ? ulSize : ulUsed;
+            if(ulSize == 0)
+            {
+                continue;
+            }
+            memcpy(pucBlock, USBRingBufReadPtr(&g_sRing), ulSize);
+            USBRingBufAdvanceRead(&g_sRing, ulSize);
+        }
+
+        for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+        {
+            if(pucBlock[ulLoop] != STREAM_BYTE(ulPos + ulLoop))
+            {
+                if(!g_ulErrors)
+                {
+                    g_ulFirstError = ulPos + ulLoop;
+                }
+                g_ulErrors++;
+            }
+        }
+        ulPos += ulSize;
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Runs the producer and consumer on a ring buffer of ulSize bytes in the
+// given mode.
+//
+//*****************************************************************************
+static void
+Stress(unsigned long ulSize, unsigned long ulFlags)
+{
+    pthread_t sProducer, sConsumer;
+    double dStart;
+
+    USBRingBufInitEx(&g_sRing, g_pucRing, ulSize, ulFlags);
+    g_ulErrors = 0;
+
+    dStart = SimTimeNow();
+    CHECK(pthread_create(&sConsumer, 0, Consumer, 0) == 0);
+    CHECK(pthread_create(&sProducer, 0, Producer, 0) == 0);
+    pthread_join(sProducer, 0);
+    pthread_join(sConsumer, 0);
+
+    printf("size %4lu flags 0x%lx: %lu MB in %.2fs, %lu errors",
+           ulSize, ulFlags, (unsigned long)(STRESS_BYTES >> 20),
+           SimTimeNow() - dStart, g_ulErrors);
+    if(g_ulErrors)
+    {
+        printf(" (first at byte %lu)", g_ulFirstError);
+    }
+    printf("\n");
+
+    CHECK(g_ulErrors == 0);
+    CHECK(USBRingBufEmpty(&g_sRing));
+}
+
+//*****************************************************************************
+//
+// Runs the stress test with a buffer that is a power of two in size and with
+// one that is not, neither of which ever masks interrupts.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    SimReset();
+
+    Stress(1024, USB_RING_FLAG_SPSC | USB_RING_FLAG_POW2);
+    Stress(1000, USB_RING_FLAG_SPSC);
+    Stress(512, USB_RING_FLAG_SPSC | USB_RING_FLAG_POW2);
+    Stress(301, USB_RING_FLAG_SPSC);
+
+    CHECK(SimIntMaskCount() == 0);
+
+    return(SimResult("ringbuf_spsc"));
+}
@@ -0,0 +1,384 @@
+//*****************************************************************************
+//
+// rx_resume.c - Simulates the delay between a receive buffer client freeing
+//               space and the bulk device taking a waiting packet from the
+//               host.
+//
+// A bulk device passes a numbered byte stream from the host into a small USB
+// receive buffer which is drained by a slow consumer at random intervals, so
+// the buffer is often too full for the next packet and the packet is left in
+// the endpoint FIFO.  Virtual time advances in fixed steps with a start of
+// frame every millisecond.  Each time the buffer has room for a full packet
+// while one is still waiting, the time until the packet is taken is recorded.
+//
+// The run is made twice.  Without a pfnResume function the packet is only
+// taken when the bulk device retries it from its tick handler, which is the
+// safety net that remains of the previous polling scheme.  With
+// USBDBulkRxResume() as pfnResume, the packet must be taken as soon as the
+// consumer frees the space.  The distribution of the delays is printed for
+// both runs.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/usblibpriv.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The length of each run and the size of each step of virtual time, in
+// microseconds.
+//
+//*****************************************************************************
+#define RUN_US                  2000000UL
+#define STEP_US                 50
+#define SOF_US                  1000
+
+//*****************************************************************************
+//
+// The size of the receive buffer and of the packets sent by the host.
+//
+//*****************************************************************************
+#define RX_BUFFER_SIZE          256
+#define PACKET_SIZE             64
+
+//*****************************************************************************
+//
+// The longest delay allowed when the packet is only retried from the tick
+// handler.  The bulk device retries a waiting packet after 10ms and its tick
+// handler runs every USB_SOF_TICK_DIVIDE frames.
+//
+//*****************************************************************************
+#define MAX_TICK_DELAY_US       ((10 + USB_SOF_TICK_DIVIDE) * 1000)
+
+//*****************************************************************************
+//
+// The upper bounds, in microseconds, of the buckets of the delay histogram.
+// The last bucket holds every longer delay.
+//
+//*****************************************************************************
+static const unsigned long g_pulBuckets[] =
+{
+    1, 250, 1000, 2000, 5000, 10000, 0xFFFFFFFF
+};
+
+#define NUM_BUCKETS             (sizeof(g_pulBuckets) /                       \
+                                 sizeof(g_pulBuckets[0]))
+
+//*****************************************************************************
+//
+// The value of byte ulPos of the stream.
+//
+//*****************************************************************************
+#define STREAM_BYTE(ulPos)      ((unsigned char)((ulPos) ^ ((ulPos) >> 8)))
+
+//*****************************************************************************
+//
+// The delays recorded during one run.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long pulCount[NUM_BUCKETS];
+    unsigned long ulSamples;
+    unsigned long ulMax;
+    unsigned long long ullTotal;
+}
+tDelays;
+
+//*****************************************************************************
+//
+// The bulk device and its receive buffer.  The workspace is larger than
+// USB_BUFFER_WORKSPACE_SIZE since pointers are wider on the host.
+//
+//*****************************************************************************
+static tBulkInstance g_sBulkInst;
+static unsigned char g_pucRxBuffer[RX_BUFFER_SIZE];
+static unsigned char g_pucRxWorkspace[256];
+static tUSBBuffer g_sRxBuffer;
+
+//*****************************************************************************
+//
+// The receive buffer callback.  The data is left in the buffer for the
+// consumer to read in its own time.
+//
+//*****************************************************************************
+static unsigned long
+RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The transmit callback.  Nothing is sent to the host.
+//
+//*****************************************************************************
+static unsigned long
+TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    return(0);
+}
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    USBBufferEventCallback,
+    &g_sRxBuffer,
+    TxHandler,
+    0,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_sBulkInst,
+    0,
+    0,
+    0
+};
+
+//*****************************************************************************
+//
+// A small pseudo-random number generator.
+//
+//*****************************************************************************
+static unsigned long g_ulSeed;
+
+static unsigned long
+Random(void)
+{
+    g_ulSeed = (g_ulSeed * 1103515245) + 12345;
+    return((g_ulSeed >> 16) & 0x7FFF);
+}
+
+//*****************************************************************************
+//
+// Adds a delay to the histogram.
+//
+//*****************************************************************************
+static void
+DelayAdd(tDelays *psDelays, unsigned long ulDelay)
+{
+    unsigned long ulBucket;
+
+    for(ulBucket = 0; ulDelay >= g_pulBuckets[ulBucket]; ulBucket++)
+    {
+    }
+    psDelays->pulCount[ulBucket]++;
+    psDelays->ulSamples++;
+    psDelays->ullTotal += ulDelay;
+    if(ulDelay > psDelays->ulMax)
+    {
+        psDelays->ulMax = ulDelay;
+    }
+}
+
+//*****************************************************************************
+//
+// Prints the histogram.
+//
+//*****************************************************************************
+static void
+DelayPrint(const char *pcName, const tDelays *psDelays)
+{
+    unsigned long ulBucket;
+
+    printf("%-7s %6lu samples, mean %7.1fus, max %6luus:", pcName,
+           psDelays->ulSamples,
+           psDelays->ulSamples ?
+           (double)psDelays->ullTotal / psDelays->ulSamples : 0.0,
+           psDelays->ulMax);
+    for(ulBucket = 0; ulBucket < NUM_BUCKETS; ulBucket++)
+    {
+        printf(" %lu", psDelays->pulCount[ulBucket]);
+    }
+    printf("\n");
+}
+
+//*****************************************************************************
+//
+// Runs the stream through the device for RUN_US microseconds of virtual time
+// with the given pfnResume function and records the delays.  Returns the
+// number of bytes read by the consumer.
+//
+//*****************************************************************************
+static unsigned long
+Run(tUSBPacketResume pfnResume, tDelays *psDelays)
+{
+    unsigned char pucPacket[PACKET_SIZE], pucData[RX_BUFFER_SIZE];
+    unsigned long ulNow, ulNextRead, ulNextSOF, ulWaitStart, ulHostPos;
+    unsigned long ulReadPos, ulQueued, ulRead, ulLoop, ulErrors;
+    tBoolean bWaiting, bBlocked;
+
+    memset(psDelays, 0, sizeof(*psDelays));
+    g_ulSeed = 1;
+
+    //
+    // Set up the receive buffer, then the device, then enumerate it.
+    //
+    g_sRxBuffer.bTransmitBuffer = false;
+    g_sRxBuffer.pfnCallback = RxHandler;
+    g_sRxBuffer.pvCBData = 0;
+    g_sRxBuffer.pfnTransfer = USBDBulkPacketRead;
+    g_sRxBuffer.pfnAvailable = USBDBulkRxPacketAvailable;
+    g_sRxBuffer.pvHandle = (void *)&g_sBulkDevice;
+    g_sRxBuffer.pcBuffer = g_pucRxBuffer;
+    g_sRxBuffer.ulBufferSize = RX_BUFFER_SIZE;
+    g_sRxBuffer.pvWorkspace = g_pucRxWorkspace;
+    g_sRxBuffer.ulRingFlags = USB_RING_FLAG_SPSC | USB_RING_FLAG_POW2;
+    g_sRxBuffer.ulSlackSize = 0;
+    g_sRxBuffer.ulRxThreshold = 0;
+    g_sRxBuffer.ulRxTimeoutmS = 0;
+    g_sRxBuffer.pfnResume = pfnResume;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    USBBufferInit(&g_sRxBuffer);
+    CHECK(USBDBulkInit(0, (tUSBDBulkDevice *)&g_sBulkDevice) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+
+    ulHostPos = 0;
+    ulReadPos = 0;
+    ulErrors = 0;
+    ulNextRead = 0;
+    ulNextSOF = SOF_US;
+    ulWaitStart = 0;
+    bWaiting = false;
+    for(ulNow = 0; ulNow < RUN_US; ulNow += STEP_US)
+    {
+        if(ulNow >= ulNextSOF)
+        {
+            SimHostSOF(0);
+            ulNextSOF += SOF_US;
+        }
+
+        //
+        // The host sends the next packet of the stream whenever the device
+        // will take it.
+        //
+        for(ulLoop = 0; ulLoop < PACKET_SIZE; ulLoop++)
+        {
+            pucPacket[ulLoop] = STREAM_BYTE(ulHostPos + ulLoop);
+        }
+        if(SimHostOut(0, 1, pucPacket, PACKET_SIZE))
+        {
+            ulHostPos += PACKET_SIZE;
+        }
+
+        //
+        // The consumer reads a random amount at random intervals and checks
+        // it.  If a packet was held back for want of space and the read
+        // caused it to be taken at once, record a delay of zero.
+        //
+        if(ulNow >= ulNextRead)
+        {
+            ulQueued = SimPacketsQueued(0, 1, false);
+            bBlocked = (ulQueued &&
+                        (USBBufferSpaceAvailable(&g_sRxBuffer) <
+                         PACKET_SIZE)) ? true : false;
+
+            ulRead = USBBufferRead(&g_sRxBuffer, pucData,
+                                   (Random() % RX_BUFFER_SIZE) + 1);
+            for(ulLoop = 0; ulLoop < ulRead; ulLoop++)
+            {
+                if(pucData[ulLoop] != STREAM_BYTE(ulReadPos + ulLoop))
+                {
+                    ulErrors++;
+                }
+            }
+            ulReadPos += ulRead;
+
+            if(bBlocked && !bWaiting &&
+               (SimPacketsQueued(0, 1, false) < ulQueued))
+            {
+                DelayAdd(psDelays, 0);
+            }
+
+            ulNextRead = ulNow + ((Random() % 40) * STEP_US);
+        }
+
+        //
+        // Time any packet that is still waiting although there is now room
+        // for it.
+        //
+        if(SimPacketsQueued(0, 1, false) &&
+           (USBBufferSpaceAvailable(&g_sRxBuffer) >= PACKET_SIZE))
+        {
+            if(!bWaiting)
+            {
+                bWaiting = true;
+                ulWaitStart = ulNow;
+            }
+        }
+        else if(bWaiting)
+        {
+            bWaiting = false;
+            DelayAdd(psDelays, ulNow - ulWaitStart);
+        }
+    }
+
+    //
+    // Every byte which reached the consumer must be in sequence.
+    //
+    CHECK(ulErrors == 0);
+    CHECK(ulReadPos <= ulHostPos);
+
+    return(ulReadPos);
+}
+
+//*****************************************************************************
+//
+// Runs the stream with the tick handler retry alone and then with the resume
+// notification, and compares the delays.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    tDelays sTick, sResume;
+    unsigned long ulBucket, ulTickBytes, ulResumeBytes;
+
+    printf("delay buckets (us):");
+    for(ulBucket = 0; ulBucket < NUM_BUCKETS - 1; ulBucket++)
+    {
+        printf(" <%lu", g_pulBuckets[ulBucket]);
+    }
+    printf(" more\n");
+
+    //
+    // With only the tick handler to retry the packet, every delay must be
+    // bounded by the retry interval and no interrupt is pended.
+    //
+    ulTickBytes = Run(0, &sTick);
+    DelayPrint("tick", &sTick);
+    CHECK(sTick.ulSamples != 0);
+    CHECK(sTick.ulMax <= MAX_TICK_DELAY_US);
+    CHECK(SimIntPendCount(INT_USB0) == 0);
+
+    //
+    // With the resume notification, the packet must be taken in the same
+    // step as the space is freed so the consumer sees more of the stream.
+    //
+    ulResumeBytes = Run(USBDBulkRxResume, &sResume);
+    DelayPrint("resume", &sResume);
+    CHECK(sResume.ulSamples != 0);
+    CHECK(sResume.ulMax == 0);
+    CHECK(SimIntPendCount(INT_USB0) != 0);
+    CHECK(ulResumeBytes > ulTickBytes);
+
+    printf("bytes read in %lums: tick %lu, resume %lu\n", RUN_US / 1000,
+           ulTickBytes, ulResumeBytes);
+
+    return(SimResult("rx_resume"));
+}
@@ -0,0 +1,310 @@
+//*****************************************************************************
+//
+// string_table.c - Checks the string descriptor lookup table built by
+//                  USBDCDInit().
+//
+// A made-up device is initialized with a series of string descriptor tables
+// and the host asks for every string in every language of each.  Valid
+// tables must serve the right descriptor for each language ID and index,
+// including languages whose IDs differ only in their sublanguage bits,
+// languages listed twice and tables with more languages than the hash table
+// holds.  Invalid tables must be reported by USBDCDStringTableValid() and
+// serve only the language descriptor.  Requests which the table cannot answer
+// must reach the pfnGetStringDescriptor callback.
+//
+// This test is built without DEBUG so that the invalid tables are rejected
+// as they are in a release build rather than failing an assertion.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The largest string table built.
+//
+//*****************************************************************************
+#define MAX_LANGS               12
+#define MAX_STRINGS             (1 + (MAX_LANGS * 4) + 1)
+
+//*****************************************************************************
+//
+// The string descriptor table under test.  Each string holds two characters
+// naming its group and its index within the group.
+//
+//*****************************************************************************
+static unsigned char g_pucLangDesc[2 + (2 * MAX_LANGS)];
+static unsigned char g_ppucStrings[MAX_STRINGS][6];
+static const unsigned char *g_ppucTable[MAX_STRINGS];
+
+//*****************************************************************************
+//
+// The requests passed to the pfnGetStringDescriptor callback.
+//
+//*****************************************************************************
+static unsigned long g_ulCallbacks;
+static unsigned short g_usCallbackLang;
+static unsigned short g_usCallbackValue;
+
+static void
+GetStringDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
+{
+    g_ulCallbacks++;
+    g_usCallbackLang = pUSBRequest->wIndex;
+    g_usCallbackValue = pUSBRequest->wValue;
+    USBDCDStallEP0(0);
+}
+
+//*****************************************************************************
+//
+// The made-up device.
+//
+//*****************************************************************************
+static const unsigned char g_pucDeviceDesc[18] =
+{
+    18, USB_DTYPE_DEVICE, 0x00, 0x02, USB_CLASS_VEND_SPECIFIC, 0, 0, 64,
+    0xbe, 0x1c, 0x05, 0x00, 0x00, 0x01, 1, 2, 3, 1
+};
+
+static const unsigned char g_pucConfigDesc[9 + 9] =
+{
+    9, USB_DTYPE_CONFIGURATION, 18, 0, 1, 1, 0, USB_CONF_ATTR_SELF_PWR, 0,
+    9, USB_DTYPE_INTERFACE, 0, 0, 0, USB_CLASS_VEND_SPECIFIC, 0, 0, 0
+};
+
+static const tConfigSection g_sConfigSection =
+{
+    sizeof(g_pucConfigDesc), g_pucConfigDesc
+};
+
+static const tConfigSection * const g_psConfigSections[] =
+{
+    &g_sConfigSection
+};
+
+static const tConfigHeader g_sConfigHeader = { 1, g_psConfigSections };
+
+static const tConfigHeader * const g_ppsConfigs[] = { &g_sConfigHeader };
+
+static tDeviceInfo g_sDeviceInfo =
+{
+    { 0 },
+    g_pucDeviceDesc,
+    g_ppsConfigs,
+    0,
+    0,
+    &g_sUSBDefaultFIFOConfig,
+    0
+};
+
+//*****************************************************************************
+//
+// Builds a table of ulNumLangs languages from pusLangs, each with ulPerLang
+// strings, followed by ulExtra strings which belong to no language.  The
+// language descriptor lists ulListed languages.  The device is then
+// initialized with the table.
+//
+//*****************************************************************************
+static void
+TableInit(const unsigned short *pusLangs, unsigned long ulNumLangs,
+          unsigned long ulListed, unsigned long ulPerLang,
+          unsigned long ulExtra)
+{
+    unsigned long ulLoop, ulCount;
+
+    g_pucLangDesc[0] = 2 + (2 * ulListed);
+    g_pucLangDesc[1] = USB_DTYPE_STRING;
+    for(ulLoop = 0; ulLoop < ulListed; ulLoop++)
+    {
+        g_pucLangDesc[2 + (2 * ulLoop)] = pusLangs[ulLoop] & 0xFF;
+        g_pucLangDesc[3 + (2 * ulLoop)] = pusLangs[ulLoop] >> 8;
+    }
+    g_ppucTable[0] = g_pucLangDesc;
+
+    ulCount = (ulNumLangs * ulPerLang) + ulExtra;
+    for(ulLoop = 0; ulLoop < ulCount; ulLoop++)
+    {
+        g_ppucStrings[ulLoop][0] = 6;
+        g_ppucStrings[ulLoop][1] = USB_DTYPE_STRING;
+        g_ppucStrings[ulLoop][2] = 'A' + (ulLoop / (ulPerLang ? ulPerLang :
+                                                    1));
+        g_ppucStrings[ulLoop][3] = 0;
+        g_ppucStrings[ulLoop][4] = '1' + (ulLoop % (ulPerLang ? ulPerLang :
+                                                    1));
+        g_ppucStrings[ulLoop][5] = 0;
+        g_ppucTable[ulLoop + 1] = g_ppucStrings[ulLoop];
+    }
+
+    g_sDeviceInfo.ppStringDescriptors = g_ppucTable;
+    g_sDeviceInfo.ulNumStringDescriptors = ulCount + 1;
+    g_sDeviceInfo.sCallbacks.pfnGetStringDescriptor = GetStringDescriptor;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    USBDCDInit(0, &g_sDeviceInfo);
+    SimHostReset(0);
+    g_ulCallbacks = 0;
+}
+
+//*****************************************************************************
+//
+// Asks for string ucIndex in language usLang and checks that the reply is
+// table entry lEntry or, if lEntry is -1, that the request was passed to the
+// callback.
+//
+//*****************************************************************************
+static void
+CheckString(unsigned short usLang, unsigned char ucIndex, long lEntry)
+{
+    unsigned char pucData[64];
+    unsigned long ulCallbacks;
+    long lSize;
+
+    ulCallbacks = g_ulCallbacks;
+    lSize = SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                           USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                           (USB_DTYPE_STRING << 8) | ucIndex, usLang,
+                           sizeof(pucData), pucData);
+    if(lEntry < 0)
+    {
+        CHECK(lSize < 0);
+        CHECK(g_ulCallbacks == (ulCallbacks + 1));
+        CHECK(g_usCallbackLang == usLang);
+        CHECK(g_usCallbackValue == ((USB_DTYPE_STRING << 8) | ucIndex));
+    }
+    else
+    {
+        CHECK(lSize == g_ppucTable[lEntry][0]);
+        CHECK((lSize > 0) &&
+              (memcmp(pucData, g_ppucTable[lEntry], lSize) == 0));
+        CHECK(g_ulCallbacks == ulCallbacks);
+    }
+}
+
+//*****************************************************************************
+//
+// Checks every string of a valid table of ulNumLangs languages, each with
+// ulPerLang strings, then checks requests which the table cannot answer.
+//
+//*****************************************************************************
+static void
+CheckTable(const char *pcName, const unsigned short *pusLangs,
+           unsigned long ulNumLangs, unsigned long ulPerLang)
+{
+    unsigned long ulLang, ulString, ulGroup;
+
+    CHECK(USBDCDStringTableValid(0));
+
+    for(ulLang = 0; ulLang < ulNumLangs; ulLang++)
+    {
+        //
+        // A language listed more than once uses its first group.
+        //
+        for(ulGroup = 0; pusLangs[ulGroup] != pusLangs[ulLang]; ulGroup++)
+        {
+        }
+
+        CheckString(pusLangs[ulLang], 0, 0);
+        for(ulString = 1; ulString <= ulPerLang; ulString++)
+        {
+            CheckString(pusLangs[ulLang], ulString,
+                        (ulGroup * ulPerLang) + ulString);
+        }
+        CheckString(pusLangs[ulLang], ulPerLang + 1, -1);
+        CheckString(pusLangs[ulLang], 0xEE, -1);
+    }
+
+    //
+    // A language which is not listed.
+    //
+    CheckString(0x0422, 1, -1);
+    CheckString(0x0422, 0, 0);
+
+    printf("%-9s %2lu languages x %lu strings: valid\n", pcName, ulNumLangs,
+           ulPerLang);
+}
+
+//*****************************************************************************
+//
+// Checks that a table has been rejected.  Only the language descriptor is
+// served and every other request goes to the callback.
+//
+//*****************************************************************************
+static void
+CheckInvalid(const char *pcName, unsigned short usLang)
+{
+    CHECK(!USBDCDStringTableValid(0));
+    CheckString(usLang, 0, 0);
+    CheckString(usLang, 1, -1);
+    CheckString(usLang, 2, -1);
+
+    printf("%-9s rejected\n", pcName);
+}
+
+//*****************************************************************************
+//
+// Checks each of the tables.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    static const unsigned short pusThree[] = { 0x0409, 0x0407, 0x0411 };
+    static const unsigned short pusRegional[] =
+    {
+        0x0409, 0x0809, 0x0c09, 0x1009, 0x1409, 0x1809, 0x1c09, 0x2009
+    };
+    static const unsigned short pusTwice[] = { 0x0409, 0x0407, 0x0409 };
+    static const unsigned short pusMany[MAX_LANGS] =
+    {
+        0x0409, 0x0407, 0x0411, 0x040c, 0x0410, 0x0c0a,
+        0x0416, 0x0419, 0x0804, 0x0412, 0x041d, 0x0413
+    };
+
+    //
+    // Valid tables, including the most languages the hash table holds, all
+    // of them regional variants of one language, a language listed twice
+    // and more languages than the hash table holds.
+    //
+    TableInit(pusThree, 3, 3, 4, 0);
+    CheckTable("three", pusThree, 3, 4);
+    TableInit(pusRegional, 8, 8, 2, 0);
+    CheckTable("regional", pusRegional, 8, 2);
+    TableInit(pusTwice, 3, 3, 2, 0);
+    CheckTable("twice", pusTwice, 3, 2);
+    TableInit(pusMany + 2, 10, 10, 3, 0);
+    CheckTable("ten", pusMany + 2, 10, 3);
+    TableInit(pusMany, MAX_LANGS, MAX_LANGS, 1, 0);
+    CheckTable("twelve", pusMany, MAX_LANGS, 1);
+
+    //
+    // A table whose strings do not divide equally between its languages and
+    // one whose language descriptor lists no languages.
+    //
+    TableInit(pusThree, 2, 2, 2, 1);
+    CheckInvalid("uneven", 0x0409);
+    TableInit(pusThree, 1, 0, 2, 0);
+    CheckInvalid("no langs", 0x0409);
+
+    //
+    // A device with no strings at all is valid but has nothing to serve.
+    //
+    TableInit(pusThree, 0, 0, 0, 0);
+    g_sDeviceInfo.ppStringDescriptors = 0;
+    g_sDeviceInfo.ulNumStringDescriptors = 0;
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    USBDCDInit(0, &g_sDeviceInfo);
+    SimHostReset(0);
+    CHECK(USBDCDStringTableValid(0));
+    CheckString(0x0409, 0, -1);
+    CheckString(0x0409, 1, -1);
+
+    return(SimResult("string_table"));
+}
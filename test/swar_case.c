@@ -0,0 +1,264 @@
+//*****************************************************************************
+//
+// swar_case.c - Checks and times the word-at-a-time case conversion of the
+//               bulk device example.
+//
+// The example is built into this test with its main() renamed so that its
+// static SWAP_CASE_WORD() and SwapCaseSpan() can be called directly.  Both are
+// checked against the previous implementation, which converted one byte at a
+// time, over every byte value in every lane of the word and every alignment
+// of the source and destination.  The bytes either side of each destination
+// span are checked to make sure that no word store strays outside it.  The
+// throughput of the two implementations is then compared.
+//
+//*****************************************************************************
+
+#define main BulkMain
+#define __error__ BulkError
+#include "usb_dev_bulk.c"
+#undef main
+#undef __error__
+
+#include <stdio.h>
+#include <string.h>
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The longest span checked and the number of guard bytes either side of the
+// destination.
+//
+//*****************************************************************************
+#define MAX_SPAN                300
+#define GUARD                   8
+
+//*****************************************************************************
+//
+// The number of bytes converted for each timed span length.
+//
+//*****************************************************************************
+#define BENCH_BYTES             (16 * 1024 * 1024)
+
+//*****************************************************************************
+//
+// The span lengths timed.
+//
+//*****************************************************************************
+static const unsigned long g_pulSizes[] = { 16, 64, 512, 4096 };
+
+#define NUM_SIZES               (sizeof(g_pulSizes) / sizeof(g_pulSizes[0]))
+
+static unsigned char g_pucSrc[4096 + 8];
+static unsigned char g_pucDst[4096 + 8 + (2 * GUARD)];
+static unsigned char g_pucRef[4096 + 8 + (2 * GUARD)];
+
+//*****************************************************************************
+//
+// The example's main() uses the USB mode selection of the full library, which
+// is not part of the simulated part.  It is never called.
+//
+//*****************************************************************************
+void
+USBStackModeSet(unsigned long ulIndex, tUSBMode eUSBMode,
+                tUSBModeCallback pfnCallback)
+{
+}
+
+//*****************************************************************************
+//
+// The previous implementation of SwapCaseSpan(), against which the new one is
+// checked.
+//
+//*****************************************************************************
+static void
+RefSwapCaseSpan(unsigned char *pucDst, const unsigned char *pucSrc,
+                unsigned long ulCount)
+{
+    unsigned char ucChar;
+
+    while(ulCount--)
+    {
+        ucChar = *pucSrc++;
+        if((ucChar >= 'a') && (ucChar <= 'z'))
+        {
+            ucChar = (ucChar - 'a') + 'A';
+        }
+        else if((ucChar >= 'A') && (ucChar <= 'Z'))
+        {
+            ucChar = (ucChar - 'Z') + 'z';
+        }
+        *pucDst++ = ucChar;
+    }
+}
+
+//*****************************************************************************
+//
+// Reads a free-running cycle counter where the host has one, otherwise the
+// time in nanoseconds.
+//
+//*****************************************************************************
+static unsigned long long
+CyclesNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return(__builtin_ia32_rdtsc());
+#else
+    return((unsigned long long)(SimTimeNow() * 1e9));
+#endif
+}
+
+//*****************************************************************************
+//
+// Checks SWAP_CASE_WORD() against the per-byte conversion for every pair of
+// values in every pair of adjacent lanes of the word.  Any carry between
+// lanes can only reach the next lane up so this covers every interaction.
+//
+//*****************************************************************************
+static void
+CheckWords(void)
+{
+    unsigned char pucIn[4], pucOut[4];
+    unsigned long ulLane, ulLow, ulHigh, ulErrors;
+    CASE_WORD ulWord, ulSwapped;
+
+    ulErrors = 0;
+    for(ulLane = 0; ulLane < 3; ulLane++)
+    {
+        for(ulLow = 0; ulLow < 256; ulLow++)
+        {
+            for(ulHigh = 0; ulHigh < 256; ulHigh++)
+            {
+                //
+                // Fill the other lanes with values which change with the
+                // lanes under test.
+                //
+                pucIn[0] = (unsigned char)(ulLow + ulHigh);
+                pucIn[1] = (unsigned char)(ulLow ^ 0x40);
+                pucIn[2] = (unsigned char)(ulHigh ^ 0x60);
+                pucIn[3] = (unsigned char)(ulLow - ulHigh);
+                pucIn[ulLane] = (unsigned char)ulLow;
+                pucIn[ulLane + 1] = (unsigned char)ulHigh;
+
+                ulWord = ((CASE_WORD)pucIn[0] | ((CASE_WORD)pucIn[1] << 8) |
+                          ((CASE_WORD)pucIn[2] << 16) |
+                          ((CASE_WORD)pucIn[3] << 24));
+                ulSwapped = SWAP_CASE_WORD(ulWord);
+
+                RefSwapCaseSpan(pucOut, pucIn, 4);
+                if((ulSwapped & 0xff) != pucOut[0] ||
+                   ((ulSwapped >> 8) & 0xff) != pucOut[1] ||
+                   ((ulSwapped >> 16) & 0xff) != pucOut[2] ||
+                   ((ulSwapped >> 24) & 0xff) != pucOut[3])
+                {
+                    ulErrors++;
+                }
+            }
+        }
+    }
+
+    CHECK(ulErrors == 0);
+}
+
+//*****************************************************************************
+//
+// Checks SwapCaseSpan() against the per-byte conversion for every span length
+// up to MAX_SPAN at every alignment of the source and destination.  The
+// source holds every byte value.
+//
+//*****************************************************************************
+static void
+CheckSpans(void)
+{
+    unsigned long ulSrcAlign, ulDstAlign, ulCount, ulLoop, ulErrors;
+
+    for(ulLoop = 0; ulLoop < sizeof(g_pucSrc); ulLoop++)
+    {
+        g_pucSrc[ulLoop] = (unsigned char)((ulLoop * 97) + (ulLoop >> 8));
+    }
+
+    ulErrors = 0;
+    for(ulSrcAlign = 0; ulSrcAlign < 8; ulSrcAlign++)
+    {
+        for(ulDstAlign = 0; ulDstAlign < 8; ulDstAlign++)
+        {
+            for(ulCount = 0; ulCount <= MAX_SPAN; ulCount++)
+            {
+                memset(g_pucDst, 0xa5, ulCount + ulDstAlign + (2 * GUARD));
+                memset(g_pucRef, 0xa5, ulCount + ulDstAlign + (2 * GUARD));
+
+                SwapCaseSpan(g_pucDst + GUARD + ulDstAlign,
+                             g_pucSrc + ulSrcAlign, ulCount);
+                RefSwapCaseSpan(g_pucRef + GUARD + ulDstAlign,
+                                g_pucSrc + ulSrcAlign, ulCount);
+
+                if(memcmp(g_pucDst, g_pucRef,
+                          ulCount + ulDstAlign + (2 * GUARD)))
+                {
+                    ulErrors++;
+                }
+            }
+        }
+    }
+
+    CHECK(ulErrors == 0);
+}
+
+//*****************************************************************************
+//
+// Converts BENCH_BYTES in spans of ulCount bytes with the given function and
+// returns the number of bytes converted per cycle.
+//
+//*****************************************************************************
+static double
+TimeSpans(void (*pfnSpan)(unsigned char *pucDst, const unsigned char *pucSrc,
+                          unsigned long ulCount),
+          unsigned long ulCount, unsigned long ulSrcAlign)
+{
+    unsigned long long ullStart, ullCycles;
+    unsigned long ulDone;
+
+    ullStart = CyclesNow();
+    for(ulDone = 0; ulDone < BENCH_BYTES; ulDone += ulCount)
+    {
+        pfnSpan(g_pucDst, g_pucSrc + ulSrcAlign, ulCount);
+        __asm__ __volatile__("" : : "r"(g_pucDst) : "memory");
+    }
+    ullCycles = CyclesNow() - ullStart;
+
+    return((double)BENCH_BYTES / (double)(ullCycles ? ullCycles : 1));
+}
+
+//*****************************************************************************
+//
+// Runs the checks then prints the benchmark table.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulSize, ulSrcAlign;
+    double dPerByte, dWord;
+
+    SimReset();
+
+    CHECK(sizeof(CASE_WORD) == 4);
+    CheckWords();
+    CheckSpans();
+
+    printf("%6s %6s %14s %14s %8s\n", "span", "align", "per-byte B/c",
+           "word B/c", "speedup");
+    for(ulSize = 0; ulSize < NUM_SIZES; ulSize++)
+    {
+        for(ulSrcAlign = 0; ulSrcAlign < 2; ulSrcAlign++)
+        {
+            dPerByte = TimeSpans(RefSwapCaseSpan, g_pulSizes[ulSize],
+                                 ulSrcAlign);
+            dWord = TimeSpans(SwapCaseSpan, g_pulSizes[ulSize], ulSrcAlign);
+            printf("%6lu %6s %14.4f %14.4f %7.1fx\n", g_pulSizes[ulSize],
+                   ulSrcAlign ? "src+1" : "both", dPerByte, dWord,
+                   dWord / dPerByte);
+        }
+    }
+
+    return(SimResult("swar_case"));
+}
@@ -0,0 +1,559 @@
+//*****************************************************************************
+//
+// trace_dump.c - Records the enumeration of a bulk device with the device
+//                core's tracer and dumps the timeline to a file.
+//
+// The tracer is enabled before the bulk device is initialized so that the
+// first bus reset is recorded.  The host then enumerates the device in the
+// order Windows does, reads the string descriptors, asks for a device
+// qualifier (which a full speed device stalls), selects the configuration,
+// reads the bulk statistics with a vendor request and suspends, resumes and
+// disconnects the device.  The events read back with USBDCDTraceRead() must
+// match this sequence, with every request complete and only the device
+// qualifier stalled.  A small ring is then checked to keep only the newest
+// events.
+//
+// The events are time stamped in nanoseconds of host time, so the durations
+// show the time spent in the device core for each request.  The timeline is
+// written to build/trace_dump.txt, or to the file named on the command line,
+// and the time spent in each kind of request is printed.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The number of events held by the trace ring, and by the small ring used to
+// check that the oldest events are replaced.
+//
+//*****************************************************************************
+#define NUM_EVENTS              32
+#define NUM_SMALL_EVENTS        4
+
+//*****************************************************************************
+//
+// The file to which the timeline is written if none is named.
+//
+//*****************************************************************************
+#define DUMP_FILE               "build/trace_dump.txt"
+
+//*****************************************************************************
+//
+// The address given to the device.
+//
+//*****************************************************************************
+#define DEVICE_ADDRESS          7
+
+//*****************************************************************************
+//
+// The trace ring and the buffer into which it is read.
+//
+//*****************************************************************************
+static tUSBDTraceEvent g_psTrace[NUM_EVENTS];
+static tUSBDTraceEvent g_psEvents[NUM_EVENTS];
+
+//*****************************************************************************
+//
+// An event expected in the trace.  For a request, usValue is the wValue of
+// the setup packet.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ucEvent;
+    unsigned char ucRequest;
+    unsigned short usValue;
+    unsigned char ucFlags;
+}
+tExpected;
+
+#define EXPECT_REQ(ucRequest, usValue)                                        \
+    { USBD_TRACE_REQUEST, (ucRequest), (usValue), USBD_TRACE_FLAG_DONE }
+
+#define EXPECT_STALL(ucRequest, usValue)                                      \
+    {                                                                         \
+        USBD_TRACE_REQUEST, (ucRequest), (usValue),                           \
+        USBD_TRACE_FLAG_DONE | USBD_TRACE_FLAG_STALLED                        \
+    }
+
+#define EXPECT_EVENT(ucEvent)   { (ucEvent), 0, 0, 0 }
+
+static const tExpected g_psExpected[] =
+{
+    EXPECT_EVENT(USBD_TRACE_RESET),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, USB_DTYPE_DEVICE << 8),
+    EXPECT_EVENT(USBD_TRACE_RESET),
+    EXPECT_REQ(USBREQ_SET_ADDRESS, DEVICE_ADDRESS),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, USB_DTYPE_DEVICE << 8),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, USB_DTYPE_CONFIGURATION << 8),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, USB_DTYPE_CONFIGURATION << 8),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, USB_DTYPE_STRING << 8),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, (USB_DTYPE_STRING << 8) | 2),
+    EXPECT_REQ(USBREQ_GET_DESCRIPTOR, (USB_DTYPE_STRING << 8) | 3),
+    EXPECT_STALL(USBREQ_GET_DESCRIPTOR, USB_DTYPE_DEVICE_QUAL << 8),
+    EXPECT_REQ(USBREQ_SET_CONFIG, 1),
+    EXPECT_REQ(USBD_BULK_REQ_STATS_GET, 0),
+    EXPECT_EVENT(USBD_TRACE_SUSPEND),
+    EXPECT_EVENT(USBD_TRACE_RESUME),
+    EXPECT_EVENT(USBD_TRACE_DISCONNECT)
+};
+
+#define NUM_EXPECTED            (sizeof(g_psExpected) /                       \
+                                 sizeof(g_psExpected[0]))
+
+//*****************************************************************************
+//
+// The names of the trace events and of the standard requests and descriptor
+// types seen during enumeration.
+//
+//*****************************************************************************
+static const char * const g_ppcEvents[] =
+{
+    "reset", "request", "suspend", "resume", "disconnect"
+};
+
+static const char * const g_ppcRequests[] =
+{
+    "GET_STATUS", "CLEAR_FEATURE", "request 2", "SET_FEATURE", "request 4",
+    "SET_ADDRESS", "GET_DESCRIPTOR", "SET_DESCRIPTOR", "GET_CONFIG",
+    "SET_CONFIG", "GET_INTERFACE", "SET_INTERFACE", "SYNC_FRAME"
+};
+
+static const char * const g_ppcDescriptors[] =
+{
+    "type 0", "device", "config", "string", "interface", "endpoint",
+    "qualifier"
+};
+
+//*****************************************************************************
+//
+// The kinds of request for which the total time is printed.
+//
+//*****************************************************************************
+#define KIND_DESCRIPTOR         0
+#define NUM_DESC_KINDS          7
+#define KIND_OTHER_DESC         (KIND_DESCRIPTOR + NUM_DESC_KINDS)
+#define KIND_SET_ADDRESS        (KIND_OTHER_DESC + 1)
+#define KIND_SET_CONFIG         (KIND_SET_ADDRESS + 1)
+#define KIND_VENDOR             (KIND_SET_CONFIG + 1)
+#define KIND_OTHER              (KIND_VENDOR + 1)
+#define NUM_KINDS               (KIND_OTHER + 1)
+
+//*****************************************************************************
+//
+// The bulk device.  Nothing is passed on the data endpoints.
+//
+//*****************************************************************************
+static tBulkInstance g_sBulkInst;
+
+static unsigned long
+Handler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+        void *pvMsgData)
+{
+    return(0);
+}
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    Handler,
+    0,
+    Handler,
+    0,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_sBulkInst,
+    0,
+    0,
+    0
+};
+
+//*****************************************************************************
+//
+// The trace counter, which counts nanoseconds of host time from the start of
+// the test.
+//
+//*****************************************************************************
+static double g_dStart;
+
+static unsigned long
+Counter(void)
+{
+    return((unsigned long)((SimTimeNow() - g_dStart) * 1e9));
+}
+
+//*****************************************************************************
+//
+// Sends a request from the host with a data stage of up to usLength bytes
+// and returns the number of bytes transferred, or -1 on a stall.
+//
+//*****************************************************************************
+static long
+Request(unsigned char ucType, unsigned char ucRequest, unsigned short usValue,
+        unsigned short usIndex, unsigned short usLength)
+{
+    unsigned char pucData[256];
+
+    return(SimHostControl(0, ucType, ucRequest, usValue, usIndex, usLength,
+                          pucData));
+}
+
+//*****************************************************************************
+//
+// Asks for descriptor ucType, ucIndex with the given wLength.
+//
+//*****************************************************************************
+static long
+Descriptor(unsigned char ucType, unsigned char ucIndex, unsigned short usLang,
+           unsigned short usLength)
+{
+    return(Request(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD | USB_RTYPE_DEVICE,
+                   USBREQ_GET_DESCRIPTOR, (ucType << 8) | ucIndex, usLang,
+                   usLength));
+}
+
+//*****************************************************************************
+//
+// Returns the kind of a traced request.
+//
+//*****************************************************************************
+static unsigned long
+RequestKind(const tUSBRequest *psRequest)
+{
+    unsigned long ulType;
+
+    if((psRequest->bmRequestType & USB_RTYPE_TYPE_M) == USB_RTYPE_VENDOR)
+    {
+        return(KIND_VENDOR);
+    }
+
+    switch(psRequest->bRequest)
+    {
+        case USBREQ_GET_DESCRIPTOR:
+        {
+            ulType = psRequest->wValue >> 8;
+            return((ulType < NUM_DESC_KINDS) ? (KIND_DESCRIPTOR + ulType) :
+                   KIND_OTHER_DESC);
+        }
+
+        case USBREQ_SET_ADDRESS:
+        {
+            return(KIND_SET_ADDRESS);
+        }
+
+        case USBREQ_SET_CONFIG:
+        {
+            return(KIND_SET_CONFIG);
+        }
+
+        default:
+        {
+            return(KIND_OTHER);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the name of a kind of request.
+//
+//*****************************************************************************
+static const char *
+KindName(unsigned long ulKind)
+{
+    static char pcName[32];
+
+    if(ulKind < KIND_OTHER_DESC)
+    {
+        snprintf(pcName, sizeof(pcName), "GET_DESCRIPTOR %s",
+                 g_ppcDescriptors[ulKind - KIND_DESCRIPTOR]);
+        return(pcName);
+    }
+
+    switch(ulKind)
+    {
+        case KIND_OTHER_DESC:
+        {
+            return("GET_DESCRIPTOR other");
+        }
+
+        case KIND_SET_ADDRESS:
+        {
+            return("SET_ADDRESS");
+        }
+
+        case KIND_SET_CONFIG:
+        {
+            return("SET_CONFIG");
+        }
+
+        case KIND_VENDOR:
+        {
+            return("vendor");
+        }
+
+        default:
+        {
+            return("other");
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Writes one event of the timeline, with its time relative to the first
+// event.
+//
+//*****************************************************************************
+static void
+EventWrite(FILE *psFile, const tUSBDTraceEvent *psEvent,
+           unsigned long ulStart)
+{
+    const tUSBRequest *psRequest;
+    unsigned long ulType;
+
+    fprintf(psFile, "%10.3f  ", (psEvent->ulTime - ulStart) / 1e3);
+
+    if(psEvent->ucEvent != USBD_TRACE_REQUEST)
+    {
+        fprintf(psFile, "%s\n",
+                (psEvent->ucEvent <= USBD_TRACE_DISCONNECT) ?
+                g_ppcEvents[psEvent->ucEvent] : "unknown");
+        return;
+    }
+
+    psRequest = &psEvent->sRequest;
+    fprintf(psFile, "%-10s %02x %02x %04x %04x %4u  ", "request",
+            psRequest->bmRequestType, psRequest->bRequest, psRequest->wValue,
+            psRequest->wIndex, psRequest->wLength);
+
+    if(((psRequest->bmRequestType & USB_RTYPE_TYPE_M) ==
+        USB_RTYPE_STANDARD) &&
+       (psRequest->bRequest <= USBREQ_SYNC_FRAME))
+    {
+        fprintf(psFile, "%-14s", g_ppcRequests[psRequest->bRequest]);
+    }
+    else
+    {
+        fprintf(psFile, "%-14s", "vendor");
+    }
+
+    if(psRequest->bRequest == USBREQ_GET_DESCRIPTOR)
+    {
+        ulType = psRequest->wValue >> 8;
+        fprintf(psFile, " %-9s %3u",
+                (ulType < NUM_DESC_KINDS) ? g_ppcDescriptors[ulType] :
+                "other", psRequest->wValue & 0xFF);
+    }
+    else
+    {
+        fprintf(psFile, " %13s", "");
+    }
+
+    if(psEvent->ucFlags & USBD_TRACE_FLAG_DONE)
+    {
+        fprintf(psFile, "  %9.3f", psEvent->ulDuration / 1e3);
+    }
+    else
+    {
+        fprintf(psFile, "  %9s", "open");
+    }
+    fprintf(psFile, "%s%s\n",
+            (psEvent->ucFlags & USBD_TRACE_FLAG_STALLED) ? " stalled" : "",
+            (psEvent->ucFlags & USBD_TRACE_FLAG_DEFERRED) ? " deferred" : "");
+}
+
+//*****************************************************************************
+//
+// Writes the timeline to the named file and prints the time spent in each
+// kind of request.
+//
+//*****************************************************************************
+static void
+TimelineDump(const char *pcFile, const tUSBDTraceEvent *psEvents,
+             unsigned long ulCount)
+{
+    unsigned long pulTotal[NUM_KINDS], pulCount[NUM_KINDS];
+    unsigned long ulLoop, ulKind, ulAll;
+    FILE *psFile;
+
+    psFile = fopen(pcFile, "w");
+    CHECK(psFile != 0);
+    if(!psFile)
+    {
+        return;
+    }
+
+    fprintf(psFile, "%10s  %-10s %2s %2s %4s %4s %4s  %-14s %-9s %3s  %9s\n",
+            "time (us)", "event", "rt", "rq", "wVal", "wIdx", "wLen",
+            "request", "desc", "idx", "took (us)");
+    memset(pulTotal, 0, sizeof(pulTotal));
+    memset(pulCount, 0, sizeof(pulCount));
+    ulAll = 0;
+    for(ulLoop = 0; ulLoop < ulCount; ulLoop++)
+    {
+        EventWrite(psFile, &psEvents[ulLoop], psEvents[0].ulTime);
+
+        if((psEvents[ulLoop].ucEvent == USBD_TRACE_REQUEST) &&
+           (psEvents[ulLoop].ucFlags & USBD_TRACE_FLAG_DONE))
+        {
+            ulKind = RequestKind(&psEvents[ulLoop].sRequest);
+            pulTotal[ulKind] += psEvents[ulLoop].ulDuration;
+            pulCount[ulKind]++;
+            ulAll += psEvents[ulLoop].ulDuration;
+        }
+    }
+    fclose(psFile);
+
+    printf("%-24s %5s %10s %6s\n", "request", "count", "total (us)", "share");
+    for(ulKind = 0; ulKind < NUM_KINDS; ulKind++)
+    {
+        if(pulCount[ulKind])
+        {
+            printf("%-24s %5lu %10.3f %5.1f%%\n", KindName(ulKind),
+                   pulCount[ulKind], pulTotal[ulKind] / 1e3,
+                   ulAll ? (100.0 * pulTotal[ulKind]) / ulAll : 0.0);
+        }
+    }
+    printf("timeline of %lu events written to %s\n", ulCount, pcFile);
+}
+
+//*****************************************************************************
+//
+// Checks the events read back against the expected sequence.
+//
+//*****************************************************************************
+static void
+CheckEvents(const tUSBDTraceEvent *psEvents, unsigned long ulCount)
+{
+    unsigned long ulLoop, ulEnd;
+
+    CHECK(ulCount == NUM_EXPECTED);
+    if(ulCount != NUM_EXPECTED)
+    {
+        return;
+    }
+
+    for(ulLoop = 0; ulLoop < ulCount; ulLoop++)
+    {
+        CHECK(psEvents[ulLoop].ucEvent == g_psExpected[ulLoop].ucEvent);
+        CHECK(psEvents[ulLoop].ucFlags == g_psExpected[ulLoop].ucFlags);
+        if(g_psExpected[ulLoop].ucEvent == USBD_TRACE_REQUEST)
+        {
+            CHECK(psEvents[ulLoop].sRequest.bRequest ==
+                  g_psExpected[ulLoop].ucRequest);
+            CHECK(psEvents[ulLoop].sRequest.wValue ==
+                  g_psExpected[ulLoop].usValue);
+        }
+        else
+        {
+            CHECK(psEvents[ulLoop].ulDuration == 0);
+        }
+
+        //
+        // Each event must follow the previous one, and each request must
+        // complete before the next event.
+        //
+        if(ulLoop)
+        {
+            CHECK(psEvents[ulLoop].ulTime >= psEvents[ulLoop - 1].ulTime);
+            ulEnd = psEvents[ulLoop - 1].ulTime +
+                    psEvents[ulLoop - 1].ulDuration;
+            CHECK(ulEnd <= psEvents[ulLoop].ulTime);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Traces the enumeration, checks and dumps the timeline, then checks that a
+// full ring keeps the newest events.
+//
+//*****************************************************************************
+int
+main(int argc, char *argv[])
+{
+    tUSBDTraceEvent psSmall[NUM_SMALL_EVENTS];
+    unsigned long ulCount;
+
+    g_dStart = SimTimeNow();
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+
+    //
+    // Start tracing before the device is initialized so that the first bus
+    // reset is recorded.
+    //
+    USBDCDTraceSet(0, g_psTrace, NUM_EVENTS, Counter);
+    CHECK(USBDBulkInit(0, &g_sBulkDevice) != 0);
+
+    //
+    // Enumerate the device as Windows does, asking for 64 bytes of the
+    // device descriptor before the address is set.
+    //
+    SimHostReset(0);
+    CHECK(Descriptor(USB_DTYPE_DEVICE, 0, 0, 64) == 18);
+    SimHostReset(0);
+    CHECK(Request(USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD | USB_RTYPE_DEVICE,
+                  USBREQ_SET_ADDRESS, DEVICE_ADDRESS, 0, 0) == 0);
+    CHECK(SimDeviceAddress(0) == DEVICE_ADDRESS);
+    CHECK(Descriptor(USB_DTYPE_DEVICE, 0, 0, 18) == 18);
+    CHECK(Descriptor(USB_DTYPE_CONFIGURATION, 0, 0, 9) == 9);
+    CHECK(Descriptor(USB_DTYPE_CONFIGURATION, 0, 0, 255) > 9);
+    CHECK(Descriptor(USB_DTYPE_STRING, 0, 0, 255) > 2);
+    CHECK(Descriptor(USB_DTYPE_STRING, 2, 0x0409, 255) > 2);
+    CHECK(Descriptor(USB_DTYPE_STRING, 3, 0x0409, 255) > 2);
+    CHECK(Descriptor(USB_DTYPE_DEVICE_QUAL, 0, 0, 10) < 0);
+    CHECK(Request(USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD | USB_RTYPE_DEVICE,
+                  USBREQ_SET_CONFIG, 1, 0, 0) == 0);
+    CHECK(Request(USB_RTYPE_DIR_IN | USB_RTYPE_VENDOR | USB_RTYPE_INTERFACE,
+                  USBD_BULK_REQ_STATS_GET, 0, 0, sizeof(tUSBDBulkStats)) ==
+          sizeof(tUSBDBulkStats));
+    SimHostSuspend(0);
+    SimHostResume(0);
+    SimHostDisconnect(0);
+
+    //
+    // Read the trace back, check it and write it out.
+    //
+    ulCount = USBDCDTraceRead(0, g_psEvents, NUM_EVENTS);
+    CheckEvents(g_psEvents, ulCount);
+    TimelineDump((argc > 1) ? argv[1] : DUMP_FILE, g_psEvents, ulCount);
+
+    //
+    // Reading the trace must leave it unchanged, and a short buffer must
+    // receive the newest events.
+    //
+    CHECK(USBDCDTraceRead(0, g_psEvents, NUM_EVENTS) == ulCount);
+    CHECK(USBDCDTraceRead(0, psSmall, NUM_SMALL_EVENTS) == NUM_SMALL_EVENTS);
+    CHECK(memcmp(psSmall, &g_psEvents[ulCount - NUM_SMALL_EVENTS],
+                 sizeof(psSmall)) == 0);
+
+    //
+    // A ring too small for a whole enumeration keeps its newest events,
+    // oldest first, ending with SET_CONFIGURATION.
+    //
+    USBDCDTraceSet(0, g_psTrace, NUM_SMALL_EVENTS, Counter);
+    CHECK(USBDCDTraceRead(0, g_psEvents, NUM_EVENTS) == 0);
+    CHECK(SimHostEnumerate(0, DEVICE_ADDRESS, 1));
+    CHECK(USBDCDTraceRead(0, g_psEvents, NUM_EVENTS) == NUM_SMALL_EVENTS);
+    CHECK(g_psEvents[0].ucEvent == USBD_TRACE_RESET);
+    CHECK(g_psEvents[1].sRequest.bRequest == USBREQ_SET_ADDRESS);
+    CHECK(g_psEvents[2].sRequest.bRequest == USBREQ_GET_DESCRIPTOR);
+    CHECK(g_psEvents[3].sRequest.bRequest == USBREQ_SET_CONFIG);
+    CHECK(g_psEvents[3].ucFlags == USBD_TRACE_FLAG_DONE);
+
+    return(SimResult("trace_dump"));
+}
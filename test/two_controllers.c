@@ -0,0 +1,475 @@
+//*****************************************************************************
+//
+// two_controllers.c - Runs two bulk devices at once on the two USB
+//                     controllers of the simulated part.
+//
+// A bulk device with its own product ID, callbacks and instance data is
+// initialized on each controller and each is enumerated by its own host at
+// its own address.  Packets are then passed in both directions on both
+// devices, interleaved, and each device's callbacks must see only its own
+// data.  The devices also differ in their power settings and in the number
+// of endpoint pairs they offer and each controller must report its own
+// configuration descriptor.  Control requests which stall on one controller,
+// a bus reset of one controller and a RX resume from one device must leave
+// the other device and its interrupt untouched.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The number of controllers used and the number of packets passed in each
+// direction on each of them.
+//
+//*****************************************************************************
+#define NUM_DEVICES             2
+#define NUM_PACKETS             16
+
+//*****************************************************************************
+//
+// The number of endpoint pairs offered by the device on controller 1 in
+// addition to the first.  The device on controller 0 offers only one pair.
+//
+//*****************************************************************************
+#define NUM_EXTRA_PIPES         2
+
+//*****************************************************************************
+//
+// The state recorded by the callbacks of one device.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char pucRx[64];
+    unsigned long ulRxAvailable;
+    unsigned long ulRxSize;
+    unsigned long ulTxComplete;
+    unsigned long ulConnected;
+    unsigned long ulDisconnected;
+    tBoolean bRxHold;
+}
+tDeviceState;
+
+static tDeviceState g_psState[NUM_DEVICES];
+
+static const tUSBDBulkDevice g_psBulkDevice[NUM_DEVICES];
+
+//*****************************************************************************
+//
+// The receive callback.  Every packet is read into the device's buffer
+// unless the device has been told to hold received packets, in which case
+// they are left in the endpoint until USBDBulkRxResume() is called.
+//
+//*****************************************************************************
+static unsigned long
+RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    tDeviceState *psState = pvCBData;
+
+    switch(ulEvent)
+    {
+        case USB_EVENT_CONNECTED:
+        {
+            psState->ulConnected++;
+            return(0);
+        }
+
+        case USB_EVENT_DISCONNECTED:
+        {
+            psState->ulDisconnected++;
+            return(0);
+        }
+
+        case USB_EVENT_REQUEST_BUFFER:
+        {
+            if(psState->bRxHold)
+            {
+                return(0);
+            }
+            *(unsigned char **)pvMsgData = psState->pucRx;
+            return(sizeof(psState->pucRx));
+        }
+
+        case USB_EVENT_RX_AVAILABLE:
+        {
+            if(psState->bRxHold)
+            {
+                return(0);
+            }
+            if(!pvMsgData)
+            {
+                ulMsgValue = USBDBulkPacketRead(
+                    (void *)&g_psBulkDevice[psState - g_psState],
+                    psState->pucRx, sizeof(psState->pucRx), true);
+            }
+            else
+            {
+                CHECK(pvMsgData == psState->pucRx);
+            }
+            psState->ulRxAvailable++;
+            psState->ulRxSize = ulMsgValue;
+            return(ulMsgValue);
+        }
+
+        default:
+        {
+            return(0);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// The transmit callback.
+//
+//*****************************************************************************
+static unsigned long
+TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    tDeviceState *psState = pvCBData;
+
+    if(ulEvent == USB_EVENT_TX_COMPLETE)
+    {
+        psState->ulTxComplete++;
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The additional endpoint pairs of the device on controller 1.  These are
+// not used to pass data so their callbacks do nothing.
+//
+//*****************************************************************************
+static tBulkInstance g_psPipeInst[NUM_EXTRA_PIPES];
+
+static unsigned long
+PipeHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+            void *pvMsgData)
+{
+    return(0);
+}
+
+#define PIPE(n)                                                               \
+    {                                                                         \
+        0, 0, 0, 0,                                                           \
+        PipeHandler, 0,                                                       \
+        PipeHandler, 0,                                                       \
+        0, 0,                                                                 \
+        &g_psPipeInst[n],                                                     \
+        0,                                                                    \
+        0, 0                                                                  \
+    }
+
+static const tUSBDBulkDevice g_psPipes[NUM_EXTRA_PIPES] =
+{
+    PIPE(0), PIPE(1)
+};
+
+static const tUSBDBulkDevice * const g_ppsPipes[NUM_EXTRA_PIPES] =
+{
+    &g_psPipes[0], &g_psPipes[1]
+};
+
+//*****************************************************************************
+//
+// The two bulk devices, which differ in their product ID, their power
+// settings, the number of endpoint pairs they offer and the state their
+// callbacks are given.
+//
+//*****************************************************************************
+static tBulkInstance g_psBulkInst[NUM_DEVICES];
+
+#define DEVICE(n, mA, attr, pipes, num)                                       \
+    {                                                                         \
+        0x1cbe,                                                               \
+        0x0003 + (n),                                                         \
+        (mA),                                                                 \
+        (attr),                                                               \
+        RxHandler,                                                            \
+        &g_psState[n],                                                        \
+        TxHandler,                                                            \
+        &g_psState[n],                                                        \
+        g_ppucSimBulkStrings,                                                 \
+        SIM_BULK_NUM_STRINGS,                                                 \
+        &g_psBulkInst[n],                                                     \
+        0,                                                                    \
+        (pipes),                                                              \
+        (num)                                                                 \
+    }
+
+static const tUSBDBulkDevice g_psBulkDevice[NUM_DEVICES] =
+{
+    DEVICE(0, 100, USB_CONF_ATTR_SELF_PWR, 0, 0),
+    DEVICE(1, 300, USB_CONF_ATTR_BUS_PWR | USB_CONF_ATTR_RWAKE, g_ppsPipes,
+           NUM_EXTRA_PIPES)
+};
+
+//*****************************************************************************
+//
+// Returns the configuration selected on controller ulIndex, or -1 if the
+// request fails.
+//
+//*****************************************************************************
+static long
+ConfigGet(unsigned long ulIndex)
+{
+    unsigned char ucConfig;
+
+    if(SimHostControl(ulIndex, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                      USB_RTYPE_DEVICE, USBREQ_GET_CONFIG, 0, 0, 1,
+                      &ucConfig) != 1)
+    {
+        return(-1);
+    }
+
+    return(ucConfig);
+}
+
+//*****************************************************************************
+//
+// Checks that controller ulIndex reports the product ID of its own device.
+//
+//*****************************************************************************
+static void
+CheckDescriptor(unsigned long ulIndex)
+{
+    unsigned char pucDesc[18];
+
+    CHECK(SimHostControl(ulIndex, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_DEVICE << 8, 0, sizeof(pucDesc),
+                         pucDesc) == sizeof(pucDesc));
+    CHECK((pucDesc[10] | (pucDesc[11] << 8)) ==
+          g_psBulkDevice[ulIndex].usPID);
+}
+
+//*****************************************************************************
+//
+// Checks that controller ulIndex reports a configuration descriptor built
+// from its own device's power settings and endpoint pairs.
+//
+//*****************************************************************************
+static void
+CheckConfigDescriptor(unsigned long ulIndex)
+{
+    const tUSBDBulkDevice *psDevice;
+    unsigned char pucDesc[80], *pucEndpoint;
+    unsigned long ulSize, ulPipe;
+
+    psDevice = &g_psBulkDevice[ulIndex];
+    ulSize = COMPOSITE_DBULK_SIZE + 9 +
+             (psDevice->ulNumPipes * COMPOSITE_DBULK_PIPE_SIZE);
+
+    CHECK(SimHostControl(ulIndex, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                         USB_DTYPE_CONFIGURATION << 8, 0, sizeof(pucDesc),
+                         pucDesc) == (long)ulSize);
+    CHECK((pucDesc[2] | (pucDesc[3] << 8)) == ulSize);
+    CHECK(pucDesc[7] == psDevice->ucPwrAttributes);
+    CHECK(pucDesc[8] == (psDevice->usMaxPowermA / 2));
+    CHECK(pucDesc[9 + 4] == ((psDevice->ulNumPipes + 1) * 2));
+
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        pucEndpoint = pucDesc + 18 + (ulPipe * COMPOSITE_DBULK_PIPE_SIZE);
+        CHECK(pucEndpoint[1] == USB_DTYPE_ENDPOINT);
+        CHECK(pucEndpoint[2] == (USB_EP_DESC_IN | (ulPipe + 1)));
+        CHECK(pucEndpoint[7 + 1] == USB_DTYPE_ENDPOINT);
+        CHECK(pucEndpoint[7 + 2] == (USB_EP_DESC_OUT | (ulPipe + 1)));
+    }
+}
+
+//*****************************************************************************
+//
+// Sends a packet from the host of controller ulIndex and checks that only
+// that controller's device receives it.
+//
+//*****************************************************************************
+static void
+CheckOUT(unsigned long ulIndex, unsigned long ulSize, unsigned char ucSeed)
+{
+    unsigned char pucData[64];
+    unsigned long ulLoop, ulOther, pulAvailable[NUM_DEVICES];
+
+    ulOther = ulIndex ^ 1;
+    for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+    {
+        pucData[ulLoop] = (unsigned char)(ucSeed ^ (ulLoop * 5));
+    }
+    for(ulLoop = 0; ulLoop < NUM_DEVICES; ulLoop++)
+    {
+        pulAvailable[ulLoop] = g_psState[ulLoop].ulRxAvailable;
+    }
+    memset(g_psState[ulIndex].pucRx, 0, sizeof(g_psState[ulIndex].pucRx));
+
+    CHECK(SimHostOut(ulIndex, 1, pucData, ulSize));
+
+    CHECK(g_psState[ulIndex].ulRxAvailable == (pulAvailable[ulIndex] + 1));
+    CHECK(g_psState[ulIndex].ulRxSize == ulSize);
+    CHECK(memcmp(pucData, g_psState[ulIndex].pucRx, ulSize) == 0);
+    CHECK(g_psState[ulOther].ulRxAvailable == pulAvailable[ulOther]);
+    CHECK(SimPacketsQueued(ulIndex, 1, false) == 0);
+    CHECK(SimPacketsQueued(ulOther, 1, false) == 0);
+}
+
+//*****************************************************************************
+//
+// Writes a packet from the device on controller ulIndex and checks that it
+// reaches only that controller's host.
+//
+//*****************************************************************************
+static void
+CheckIN(unsigned long ulIndex, unsigned long ulSize, unsigned char ucSeed)
+{
+    unsigned char pucData[64], pucHost[64];
+    unsigned long ulLoop, ulOther, pulComplete[NUM_DEVICES];
+
+    ulOther = ulIndex ^ 1;
+    for(ulLoop = 0; ulLoop < ulSize; ulLoop++)
+    {
+        pucData[ulLoop] = (unsigned char)(ucSeed + (ulLoop * 3));
+    }
+    for(ulLoop = 0; ulLoop < NUM_DEVICES; ulLoop++)
+    {
+        pulComplete[ulLoop] = g_psState[ulLoop].ulTxComplete;
+    }
+
+    CHECK(USBDBulkPacketWrite((void *)&g_psBulkDevice[ulIndex], pucData,
+                              ulSize, true) == ulSize);
+    CHECK(SimPacketsQueued(ulIndex, 1, true) == 1);
+    CHECK(SimPacketsQueued(ulOther, 1, true) == 0);
+
+    CHECK(SimHostIn(ulIndex, 1, pucHost) == (long)ulSize);
+    CHECK(memcmp(pucData, pucHost, ulSize) == 0);
+    CHECK(g_psState[ulIndex].ulTxComplete == (pulComplete[ulIndex] + 1));
+    CHECK(g_psState[ulOther].ulTxComplete == pulComplete[ulOther]);
+}
+
+//*****************************************************************************
+//
+// Brings up a device on each controller then checks that they run
+// independently.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulIndex, ulPacket, ulAvailable, pulInts[NUM_DEVICES];
+    unsigned char ucData, pucData[48];
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    SimIntHandlerSet(1, USB1DeviceIntHandler);
+
+    //
+    // Initialize and enumerate each device at its own address.  Each must
+    // report its own descriptor and connection.
+    //
+    for(ulIndex = 0; ulIndex < NUM_DEVICES; ulIndex++)
+    {
+        CHECK(USBDBulkInit(ulIndex, &g_psBulkDevice[ulIndex]) != 0);
+    }
+    CHECK(SimHostEnumerate(0, 5, 1));
+    CHECK(SimHostEnumerate(1, 9, 1));
+    for(ulIndex = 0; ulIndex < NUM_DEVICES; ulIndex++)
+    {
+        CHECK(SimDeviceConnected(ulIndex));
+        CHECK(g_psState[ulIndex].ulConnected == 1);
+        CheckDescriptor(ulIndex);
+        CheckConfigDescriptor(ulIndex);
+        CHECK(ConfigGet(ulIndex) == 1);
+        CHECK(SimUSBIntCount(ulIndex) != 0);
+    }
+    CHECK(SimDeviceAddress(0) == 5);
+    CHECK(SimDeviceAddress(1) == 9);
+
+    //
+    // Pass packets in both directions on both devices, alternating between
+    // them.
+    //
+    for(ulPacket = 0; ulPacket < NUM_PACKETS; ulPacket++)
+    {
+        for(ulIndex = 0; ulIndex < NUM_DEVICES; ulIndex++)
+        {
+            CheckOUT(ulIndex, 1 + ((ulPacket * 13) % 64),
+                     (unsigned char)((ulIndex << 7) + ulPacket));
+            CheckIN(ulIndex, 1 + ((ulPacket * 7) % 64),
+                    (unsigned char)((ulIndex << 7) ^ ulPacket));
+        }
+    }
+
+    //
+    // An unsupported request stalls endpoint 0 of one controller only, and
+    // leaves the other controller's interrupt count alone.
+    //
+    pulInts[1] = SimUSBIntCount(1);
+    CHECK(SimHostControl(0, USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                         USB_RTYPE_DEVICE, 0xFE, 0, 0, 1, &ucData) < 0);
+    CHECK(SimUSBIntCount(1) == pulInts[1]);
+    CHECK(ConfigGet(1) == 1);
+    CHECK(ConfigGet(0) == 1);
+
+    //
+    // A bus reset of controller 1 clears its device's address and nothing
+    // else.
+    //
+    pulInts[0] = SimUSBIntCount(0);
+    SimHostReset(1);
+    CHECK(SimUSBIntCount(0) == pulInts[0]);
+    CHECK(SimDeviceAddress(1) == 0);
+    CHECK(SimDeviceAddress(0) == 5);
+    CHECK(ConfigGet(0) == 1);
+    CheckOUT(0, 64, 0x3c);
+    CheckIN(0, 64, 0xc3);
+
+    //
+    // Once enumerated again, the device on controller 1 runs as before.
+    //
+    CHECK(SimHostEnumerate(1, 9, 1));
+    CheckConfigDescriptor(1);
+    CheckConfigDescriptor(0);
+    CheckOUT(1, 32, 0x55);
+    CheckIN(1, 32, 0xaa);
+
+    //
+    // A packet held by the device on controller 1 stays in its endpoint.
+    // Resuming it must pend that controller's interrupt, not that of
+    // controller 0, and deliver the packet to that device alone.
+    //
+    g_psState[1].bRxHold = true;
+    ulAvailable = g_psState[1].ulRxAvailable;
+    for(ulPacket = 0; ulPacket < sizeof(pucData); ulPacket++)
+    {
+        pucData[ulPacket] = (unsigned char)(ulPacket * 11);
+    }
+    CHECK(SimHostOut(1, 1, pucData, sizeof(pucData)));
+    CHECK(SimPacketsQueued(1, 1, false) == 1);
+    CHECK(g_psState[1].ulRxAvailable == ulAvailable);
+
+    g_psState[1].bRxHold = false;
+    pulInts[0] = SimIntPendCount(INT_USB0);
+    pulInts[1] = SimIntPendCount(INT_USB1);
+    USBDBulkRxResume((void *)&g_psBulkDevice[1]);
+    CHECK(SimIntPendCount(INT_USB0) == pulInts[0]);
+    CHECK(SimIntPendCount(INT_USB1) == (pulInts[1] + 1));
+    CHECK(SimPacketsQueued(1, 1, false) == 0);
+    CHECK(g_psState[1].ulRxAvailable == (ulAvailable + 1));
+    CHECK(g_psState[1].ulRxSize == sizeof(pucData));
+    CHECK(memcmp(g_psState[1].pucRx, pucData, sizeof(pucData)) == 0);
+
+    return(SimResult("two_controllers"));
+}
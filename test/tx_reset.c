@@ -0,0 +1,246 @@
+//*****************************************************************************
+//
+// tx_reset.c - Checks that a USB transmit buffer sends everything written
+//              after a bus reset which dropped the packets it had queued.
+//
+// A bulk device sends a numbered byte stream to the host through a USB
+// transmit buffer which is flushed on USB_EVENT_CONNECTED, as the bulk
+// example does.  The buffer is filled so that packets are queued in the IN
+// endpoint, then the bus is reset and the device enumerated again before the
+// host reads them.  The reset drops the queued packets without completing
+// them, so the host must then receive the data written after the reset from
+// its first byte, with nothing lost or repeated.
+//
+// The buffer is also flushed while packets are queued without a reset.  The
+// queued packets are still sent and their completion must not be taken as
+// the completion of data written after the flush.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdbulk.h"
+#include "simbulk.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The size of the transmit buffer and of the packets sent to the host.
+//
+//*****************************************************************************
+#define TX_BUFFER_SIZE          256
+#define PACKET_SIZE             64
+
+//*****************************************************************************
+//
+// The value of byte ulPos of stream ucStream.
+//
+//*****************************************************************************
+#define STREAM_BYTE(ucStream, ulPos)                                          \
+        ((unsigned char)(((ucStream) << 5) ^ (ulPos) ^ ((ulPos) >> 8)))
+
+//*****************************************************************************
+//
+// The bulk device and its transmit buffer.  The workspace is larger than
+// USB_BUFFER_WORKSPACE_SIZE since pointers are wider on the host.
+//
+//*****************************************************************************
+static tBulkInstance g_sBulkInst;
+static unsigned char g_pucTxBuffer[TX_BUFFER_SIZE];
+static unsigned char g_pucTxWorkspace[256];
+static const tUSBBuffer g_sTxBuffer;
+
+//*****************************************************************************
+//
+// The number of times the device has been connected.
+//
+//*****************************************************************************
+static unsigned long g_ulConnected;
+
+//*****************************************************************************
+//
+// The receive and control callback.  The transmit buffer is flushed each
+// time the host configures the device.
+//
+//*****************************************************************************
+static unsigned long
+RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    if(ulEvent == USB_EVENT_CONNECTED)
+    {
+        g_ulConnected++;
+        USBBufferFlush(&g_sTxBuffer);
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The transmit buffer callback.
+//
+//*****************************************************************************
+static unsigned long
+TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    return(0);
+}
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    0x1cbe,
+    0x0003,
+    100,
+    USB_CONF_ATTR_SELF_PWR,
+    RxHandler,
+    0,
+    USBBufferEventCallback,
+    (void *)&g_sTxBuffer,
+    g_ppucSimBulkStrings,
+    SIM_BULK_NUM_STRINGS,
+    &g_sBulkInst,
+    0,
+    0,
+    0
+};
+
+static const tUSBBuffer g_sTxBuffer =
+{
+    true,
+    TxHandler,
+    0,
+    USBDBulkPacketWrite,
+    USBDBulkTxPacketAvailable,
+    (void *)&g_sBulkDevice,
+    g_pucTxBuffer,
+    TX_BUFFER_SIZE,
+    g_pucTxWorkspace,
+    USB_RING_FLAG_SPSC | USB_RING_FLAG_POW2,
+    0,
+    0,
+    0,
+    0
+};
+
+//*****************************************************************************
+//
+// Writes ulCount bytes of stream ucStream, from byte ulPos, to the transmit
+// buffer.
+//
+//*****************************************************************************
+static void
+StreamWrite(unsigned char ucStream, unsigned long ulPos,
+            unsigned long ulCount)
+{
+    unsigned char pucData[TX_BUFFER_SIZE];
+    unsigned long ulLoop;
+
+    for(ulLoop = 0; ulLoop < ulCount; ulLoop++)
+    {
+        pucData[ulLoop] = STREAM_BYTE(ucStream, ulPos + ulLoop);
+    }
+    CHECK(USBBufferWrite(&g_sTxBuffer, pucData, ulCount) == ulCount);
+}
+
+//*****************************************************************************
+//
+// Reads ulCount bytes from the host and checks that they are stream ucStream
+// from byte ulPos.
+//
+//*****************************************************************************
+static void
+StreamCheck(unsigned char ucStream, unsigned long ulPos,
+            unsigned long ulCount)
+{
+    unsigned char pucData[PACKET_SIZE];
+    unsigned long ulLoop, ulErrors;
+    long lSize;
+
+    ulErrors = 0;
+    while(ulCount)
+    {
+        lSize = SimHostIn(0, 1, pucData);
+        CHECK(lSize == ((ulCount < PACKET_SIZE) ? ulCount : PACKET_SIZE));
+        if(lSize <= 0)
+        {
+            return;
+        }
+
+        for(ulLoop = 0; ulLoop < (unsigned long)lSize; ulLoop++)
+        {
+            if(pucData[ulLoop] != STREAM_BYTE(ucStream, ulPos + ulLoop))
+            {
+                ulErrors++;
+            }
+        }
+        ulPos += lSize;
+        ulCount -= lSize;
+    }
+
+    CHECK(ulErrors == 0);
+}
+
+//*****************************************************************************
+//
+// Resets the bus with packets queued, then flushes the buffer with packets
+// queued, and checks what the host receives each time.
+//
+//*****************************************************************************
+int
+main(void)
+{
+    unsigned long ulQueued;
+
+    SimReset();
+    SimIntHandlerSet(0, USB0DeviceIntHandler);
+    USBBufferInit(&g_sTxBuffer);
+    CHECK(USBDBulkInit(0, &g_sBulkDevice) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+    CHECK(g_ulConnected == 1);
+
+    //
+    // Fill the endpoint and leave more in the buffer, then reset the bus and
+    // enumerate the device again before the host reads anything.
+    //
+    StreamWrite(0, 0, 3 * PACKET_SIZE);
+    CHECK(SimPacketsQueued(0, 1, true) != 0);
+    CHECK(SimHostEnumerate(0, 5, 1));
+    CHECK(g_ulConnected == 2);
+    CHECK(SimPacketsQueued(0, 1, true) == 0);
+    CHECK(USBBufferDataAvailable(&g_sTxBuffer) == 0);
+
+    //
+    // Everything written after the reset must reach the host from its first
+    // byte, both a single packet and a stream longer than the endpoint holds.
+    //
+    StreamWrite(1, 0, PACKET_SIZE);
+    StreamCheck(1, 0, PACKET_SIZE);
+    StreamWrite(1, PACKET_SIZE, 2 * PACKET_SIZE);
+    StreamCheck(1, PACKET_SIZE, 2 * PACKET_SIZE);
+    StreamWrite(1, 3 * PACKET_SIZE, 40);
+    StreamCheck(1, 3 * PACKET_SIZE, 40);
+    CHECK(SimPacketsQueued(0, 1, true) == 0);
+
+    //
+    // Flushing the buffer with packets queued leaves them to be sent, and
+    // their completion must not remove the data written after the flush.
+    //
+    StreamWrite(2, 0, 3 * PACKET_SIZE);
+    ulQueued = SimPacketsQueued(0, 1, true);
+    CHECK(ulQueued != 0);
+    USBBufferFlush(&g_sTxBuffer);
+    CHECK(USBBufferDataAvailable(&g_sTxBuffer) == 0);
+    StreamWrite(3, 0, PACKET_SIZE + 16);
+    StreamCheck(2, 0, ulQueued * PACKET_SIZE);
+    StreamCheck(3, 0, PACKET_SIZE + 16);
+    CHECK(SimPacketsQueued(0, 1, true) == 0);
+    CHECK(USBBufferDataAvailable(&g_sTxBuffer) == 0);
+
+    return(SimResult("tx_reset"));
+}
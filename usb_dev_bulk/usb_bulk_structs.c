@@ -177,7 +177,13 @@ const tUSBBuffer g_sRxBuffer =
     (void *)&g_sBulkDevice,          // pvHandle
     g_pucUSBRxBuffer,                // pcBuffer
     BULK_BUFFER_SIZE,                // ulBufferSize
-    g_pucRxBufferWorkspace           // pvWorkspace
+    g_pucRxBufferWorkspace,          // pvWorkspace
+    USB_RING_FLAG_SPSC |             // ulRingFlags
+    USB_RING_FLAG_POW2,
+    0,                               // ulSlackSize
+    0,                               // ulRxThreshold
+    0,                               // ulRxTimeoutmS
+    USBDBulkRxResume                 // pfnResume
 };
 
 //*****************************************************************************
@@ -185,7 +191,7 @@ const tUSBBuffer g_sRxBuffer =
 // Transmit buffer (from the USB perspective).
 //
 //*****************************************************************************
-unsigned char g_pucUSBTxBuffer[BULK_BUFFER_SIZE];
+unsigned char g_pucUSBTxBuffer[BULK_BUFFER_SIZE + BULK_BUFFER_SLACK];
 unsigned char g_pucTxBufferWorkspace[USB_BUFFER_WORKSPACE_SIZE];
 const tUSBBuffer g_sTxBuffer =
 {
@@ -197,5 +203,11 @@ const tUSBBuffer g_sTxBuffer =
     (void *)&g_sBulkDevice,          // pvHandle
     g_pucUSBTxBuffer,                // pcBuffer
     BULK_BUFFER_SIZE,                // ulBufferSize
-    g_pucTxBufferWorkspace           // pvWorkspace
+    g_pucTxBufferWorkspace,          // pvWorkspace
+    USB_RING_FLAG_SPSC |             // ulRingFlags
+    USB_RING_FLAG_POW2,
+    BULK_BUFFER_SLACK,               // ulSlackSize
+    0,                               // ulRxThreshold
+    0,                               // ulRxTimeoutmS
+    0                                // pfnResume
 };
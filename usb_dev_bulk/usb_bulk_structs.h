@@ -29,11 +29,21 @@
 //
 // The size of the transmit and receive buffers used. 256 is chosen pretty
 // much at random though the buffer should be at least twice the size of
-// a maximum-sized USB packet.
+// a maximum-sized USB packet.  The buffers use power-of-two ring mode so this
+// must be a power of two.
 //
 //*****************************************************************************
 #define BULK_BUFFER_SIZE 256
 
+//*****************************************************************************
+//
+// The size of the slack area following the transmit ring buffer.  This is set
+// to the maximum packet size of the bulk IN endpoint so that packets which
+// straddle the buffer wrap can always be sent in a single transfer.
+//
+//*****************************************************************************
+#define BULK_BUFFER_SLACK 64
+
 extern unsigned long RxHandler(void *pvCBData, unsigned long ulEvent,
                                unsigned long ulMsgValue, void *pvMsgData);
 extern unsigned long TxHandler(void *pvlCBData, unsigned long ulEvent,
@@ -24,6 +24,7 @@
 
 #include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
+#include "inc/hw_nvic.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
 #include "driverlib/fpu.h"
@@ -56,6 +57,24 @@
 //! Data received from the host is assumed to be ASCII text and it is
 //! echoed back with the case of all alphabetic characters swapped.
 //!
+//! The processing applied to received data is a pipeline of stages which the
+//! host may change using a vendor request.  Stages are available to swap
+//! character case, accumulate a CRC32, count bytes and discard the data
+//! rather than echoing it, allowing the same image to be used for loopback,
+//! checksum and sink tests.
+//!
+//! For throughput measurements which do not mix the limits of the two
+//! directions, the host may also select a test mode in which the device
+//! either sends a continuous test pattern or discards received data after
+//! checking it against the pattern.  The number of bytes transferred, the
+//! number of pattern errors and the elapsed time are kept for each test and
+//! may be read back by the host.
+//!
+//! A ping test mode is also provided to measure per-message latency.  The
+//! device replies to each ping record from the host with the time at which
+//! the ping was received and the time at which the reply was queued, allowing
+//! host tools to separate bus latency from firmware processing time.
+//!
 //! A Windows INF file for the device is provided on the installation CD and
 //! in the C:/StellarisWare/windows_drivers directory of StellarisWare
 //! releases.  This INF contains information required to install the WinUSB
@@ -84,6 +103,16 @@
 #define SYSTICKS_PER_SECOND     100
 #define SYSTICK_PERIOD_MS       (1000 / SYSTICKS_PER_SECOND)
 
+//*****************************************************************************
+//
+// The number of system ticks for which the LEDs are lit after traffic is
+// seen and the minimum number of system ticks between updates of the byte
+// counts shown on the UART.
+//
+//*****************************************************************************
+#define LED_FLASH_TICKS         2
+#define DISPLAY_UPDATE_TICKS    10
+
 //*****************************************************************************
 //
 // The global system tick counter.
@@ -91,6 +120,13 @@
 //*****************************************************************************
 volatile unsigned long g_ulSysTickCount = 0;
 
+//*****************************************************************************
+//
+// The number of processor clocks in each system tick.
+//
+//*****************************************************************************
+static unsigned long g_ulSysTickPeriod;
+
 //*****************************************************************************
 //
 // Variables tracking transmit and receive counts.
@@ -102,6 +138,89 @@ volatile unsigned long g_ulRxCount = 0;
 unsigned long g_ulUARTRxErrors = 0;
 #endif
 
+//*****************************************************************************
+//
+// The messages which may be logged from interrupt context.  Each is
+// identified by its index in g_ppcLogFormats.
+//
+//*****************************************************************************
+#define LOG_HOST_CONNECTED      0
+#define LOG_HOST_DISCONNECTED   1
+#define LOG_RX_BYTES            2
+#define LOG_TX_BYTES            3
+#define LOG_TX_COMPLETE         4
+#define LOG_EP0_SEND            5
+#define LOG_PIPELINE_SET        6
+#define LOG_TEST_MODE_SET       7
+#define LOG_VENDOR_REQUEST      8
+#define LOG_STRING_REQUEST      9
+#define LOG_MS_OS_STRING        10
+#define NUM_LOG_FORMATS         11
+
+//*****************************************************************************
+//
+// The format strings for the logged messages, indexed by message identifier.
+// Each is passed to UARTprintf with the five arguments of the log record.
+//
+//*****************************************************************************
+static const char * const g_ppcLogFormats[NUM_LOG_FORMATS] =
+{
+    "Host connected.\n",
+    "Host disconnected.\n",
+    "Received %d bytes\n",
+    "Wrote %d bytes\n",
+    "TX complete %d\n",
+    "Sending %u bytes\n",
+    "Pipeline set to 0x%x\n",
+    "Test mode set to %d\n",
+    "Received Vendor request: Type=0x%X Request=0x%X Value=0x%X "
+    "Index=0x%X Length=0x%X\n",
+    "Received String Descriptor request: 0x%X\n",
+    "Sending MS OS String Descriptor 'MSFT100'\n"
+};
+
+//*****************************************************************************
+//
+// The log ring.  Messages from interrupt context are recorded here as a
+// message identifier and its arguments, which takes only a few cycles, then
+// formatted and written to the UART by the main loop.  This prevents slow
+// UART output from stalling the USB interrupt handler.  The ring size must
+// be a power of two.
+//
+// Records are written from the USB interrupt handler and from the vendor
+// request handler, which runs in the main loop since vendor requests are
+// deferred, so interrupts are disabled while a record is written.  Records
+// are read only by the main loop.  If the ring is full, the message is
+// dropped and counted.
+//
+//*****************************************************************************
+#define LOG_RING_SIZE           32
+#define LOG_NUM_ARGS            5
+
+typedef struct
+{
+    unsigned long ulFormat;
+    unsigned long pulArgs[LOG_NUM_ARGS];
+}
+tLogRecord;
+
+static volatile tLogRecord g_psLogRing[LOG_RING_SIZE];
+static volatile unsigned long g_ulLogWrite = 0;
+static volatile unsigned long g_ulLogRead = 0;
+static volatile unsigned long g_ulLogDropped = 0;
+
+//*****************************************************************************
+//
+// Macros used to log messages with different numbers of arguments.
+//
+//*****************************************************************************
+#define LOG0(ulFormat)                                                        \
+        LogEvent((ulFormat), 0, 0, 0, 0, 0)
+#define LOG1(ulFormat, ulA)                                                   \
+        LogEvent((ulFormat), (ulA), 0, 0, 0, 0)
+#define LOG5(ulFormat, ulA, ulB, ulC, ulD, ulE)                               \
+        LogEvent((ulFormat), (ulA), (ulB), (ulC), (ulD), (ulE))
+
 //*****************************************************************************
 //
 // Debug-related definitions and declarations.
@@ -112,19 +231,19 @@ unsigned long g_ulUARTRxErrors = 0;
 #ifdef DEBUG
 //*****************************************************************************
 //
-// Map all debug print calls to UARTprintf in debug builds.
+// Map all debug messages to the log in debug builds.
 //
 //*****************************************************************************
-#define DEBUG_PRINT UARTprintf
+#define DEBUG_LOG1              LOG1
 
 #else
 
 //*****************************************************************************
 //
-// Compile out all debug print calls in release builds.
+// Compile out all debug messages in release builds.
 //
 //*****************************************************************************
-#define DEBUG_PRINT while(0) ((int (*)(char *, ...))0)
+#define DEBUG_LOG1(ulFormat, ulA)
 #endif
 
 //*****************************************************************************
@@ -161,6 +280,112 @@ __error__(char *pcFilename, unsigned long ulLine)
 }
 #endif
 
+//*****************************************************************************
+//
+// Record a message in the log ring.
+//
+// \param ulFormat identifies the message.
+// \param ulArg0 to ulArg4 are the arguments for the message's format string.
+//
+// This function may be called from interrupt context or from the main loop.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+LogEvent(unsigned long ulFormat, unsigned long ulArg0, unsigned long ulArg1,
+         unsigned long ulArg2, unsigned long ulArg3, unsigned long ulArg4)
+{
+    volatile tLogRecord *psRecord;
+    unsigned long ulWrite;
+    tBoolean bIntsOff;
+
+    //
+    // Make sure that the interrupt handler cannot write a record while this
+    // one is being written.
+    //
+    bIntsOff = IntMasterDisable();
+
+    ulWrite = g_ulLogWrite;
+
+    //
+    // Drop the message if the ring is full.
+    //
+    if((ulWrite - g_ulLogRead) >= LOG_RING_SIZE)
+    {
+        g_ulLogDropped++;
+    }
+    else
+    {
+        //
+        // Fill in the record then make it visible to the main loop.
+        //
+        psRecord = &g_psLogRing[ulWrite & (LOG_RING_SIZE - 1)];
+        psRecord->ulFormat = ulFormat;
+        psRecord->pulArgs[0] = ulArg0;
+        psRecord->pulArgs[1] = ulArg1;
+        psRecord->pulArgs[2] = ulArg2;
+        psRecord->pulArgs[3] = ulArg3;
+        psRecord->pulArgs[4] = ulArg4;
+        g_ulLogWrite = ulWrite + 1;
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+}
+
+//*****************************************************************************
+//
+// Write any messages waiting in the log ring to the UART.  This is called
+// from the main loop.
+//
+//*****************************************************************************
+static void
+LogDrain(void)
+{
+    static unsigned long ulReported = 0;
+    unsigned long ulDropped;
+    tLogRecord sRecord;
+    unsigned long ulLoop;
+
+    while(g_ulLogRead != g_ulLogWrite)
+    {
+        //
+        // Take a copy of the record then free its slot before the slow
+        // part of the job.
+        //
+        sRecord.ulFormat = g_psLogRing[g_ulLogRead &
+                                       (LOG_RING_SIZE - 1)].ulFormat;
+        for(ulLoop = 0; ulLoop < LOG_NUM_ARGS; ulLoop++)
+        {
+            sRecord.pulArgs[ulLoop] =
+                g_psLogRing[g_ulLogRead & (LOG_RING_SIZE - 1)].pulArgs[ulLoop];
+        }
+        g_ulLogRead++;
+
+        if(sRecord.ulFormat < NUM_LOG_FORMATS)
+        {
+            UARTprintf(g_ppcLogFormats[sRecord.ulFormat],
+                       sRecord.pulArgs[0], sRecord.pulArgs[1],
+                       sRecord.pulArgs[2], sRecord.pulArgs[3],
+                       sRecord.pulArgs[4]);
+        }
+    }
+
+    //
+    // Report any messages lost since we last checked.
+    //
+    ulDropped = g_ulLogDropped;
+    if(ulDropped != ulReported)
+    {
+        UARTprintf("%d log messages dropped\n", ulDropped - ulReported);
+        ulReported = ulDropped;
+    }
+}
+
 //*****************************************************************************
 //
 // Interrupt handler for the system tick counter.
@@ -177,133 +402,1018 @@ SysTickIntHandler(void)
 
 //*****************************************************************************
 //
-// Receive new data and echo it back to the host.
+// The type of the word holding the four characters converted at a time by
+// SWAP_CASE_WORD().  This must be 32 bits wide so a build for a processor
+// whose long type is wider, such as the host tests, must define it.
 //
-// \param psDevice points to the instance data for the device whose data is to
-// be processed.
-// \param pcData points to the newly received data in the USB receive buffer.
-// \param ulNumBytes is the number of bytes of data available to be processed.
+//*****************************************************************************
+#ifndef CASE_WORD
+#define CASE_WORD               unsigned long
+#endif
+
+//*****************************************************************************
 //
-// This function is called whenever we receive a notification that data is
-// available from the host. We read the data, byte-by-byte and swap the case
-// of any alphabetical characters found then write it back out to be
-// transmitted back to the host.
+// Swap the case of any alphabetic characters in a word holding four
+// characters.
 //
-// \return Returns the number of bytes of data processed.
+// Each byte is tested in parallel.  A byte is alphabetic if, with bit 5 set,
+// it lies in the range 'a' to 'z'.  With the top bit of each byte masked off,
+// adding a constant to the word sets the top bit of any byte above the
+// constant's complement without carrying into the next byte, giving the two
+// range tests.  Bytes with the top bit set are never alphabetic.  The
+// resulting 0x80 marker bits are shifted down to bit 5 to flip the case.
 //
 //*****************************************************************************
-static unsigned long
-EchoNewDataToHost(tUSBDBulkDevice *psDevice, unsigned char *pcData,
-                  unsigned long ulNumBytes)
+#define SWAP_CASE_WORD(ulWord)                                               \
+        ((ulWord) ^                                                          \
+         ((((((ulWord) | 0x20202020) & 0x7f7f7f7f) + 0x1f1f1f1f) &           \
+           ~((((ulWord) | 0x20202020) & 0x7f7f7f7f) + 0x05050505) &          \
+           ~(ulWord) & 0x80808080) >> 2))
+
+//*****************************************************************************
+//
+// Swap the case of a single character if it is alphabetic.
+//
+//*****************************************************************************
+static unsigned char
+SwapCaseChar(unsigned char ucChar)
+{
+    //
+    // Is this a lower case character?
+    //
+    if((ucChar >= 'a') && (ucChar <= 'z'))
+    {
+        //
+        // Convert to upper case.
+        //
+        ucChar = (ucChar - 'a') + 'A';
+    }
+    else
+    {
+        //
+        // Is this an upper case character?
+        //
+        if((ucChar >= 'A') && (ucChar <= 'Z'))
+        {
+            //
+            // Convert to lower case.
+            //
+            ucChar = (ucChar - 'Z') + 'z';
+        }
+    }
+
+    return(ucChar);
+}
+
+//*****************************************************************************
+//
+// Copy a contiguous span of characters, swapping the case of any alphabetic
+// characters found.
+//
+// \param pucDst points to the destination in the USB transmit buffer.
+// \param pucSrc points to the source data in the USB receive buffer.
+// \param ulCount is the number of characters to process.
+//
+// Characters are converted one at a time until the destination is word
+// aligned, then four at a time using SWAP_CASE_WORD().  If the source is not
+// also word aligned, each source word is assembled from individual bytes
+// since the two rings need not be at the same alignment.  Any characters left
+// over at the end of the span are converted one at a time.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+SwapCaseSpan(unsigned char *pucDst, const unsigned char *pucSrc,
+             unsigned long ulCount)
 {
-    unsigned long ulLoop, ulSpace, ulCount;
-    unsigned long ulReadIndex;
-    unsigned long ulWriteIndex;
-    tUSBRingBufObject sTxRing;
+    CASE_WORD ulWord;
+
+    //
+    // Convert characters individually until the destination is aligned.
+    //
+    while(ulCount && ((unsigned long)pucDst & 3))
+    {
+        *pucDst++ = SwapCaseChar(*pucSrc++);
+        ulCount--;
+    }
+
+    if(!((unsigned long)pucSrc & 3))
+    {
+        //
+        // Both pointers are aligned so convert a word at a time.
+        //
+        while(ulCount >= 4)
+        {
+            ulWord = *(const CASE_WORD *)pucSrc;
+            *(CASE_WORD *)pucDst = SWAP_CASE_WORD(ulWord);
+            pucSrc += 4;
+            pucDst += 4;
+            ulCount -= 4;
+        }
+    }
+    else
+    {
+        //
+        // The source is misaligned so gather each word from its bytes.  The
+        // target is little-endian.
+        //
+        while(ulCount >= 4)
+        {
+            ulWord = ((CASE_WORD)pucSrc[0] |
+                      ((CASE_WORD)pucSrc[1] << 8) |
+                      ((CASE_WORD)pucSrc[2] << 16) |
+                      ((CASE_WORD)pucSrc[3] << 24));
+            *(CASE_WORD *)pucDst = SWAP_CASE_WORD(ulWord);
+            pucSrc += 4;
+            pucDst += 4;
+            ulCount -= 4;
+        }
+    }
 
     //
-    // Get the current buffer information to allow us to write directly to
-    // the transmit buffer (we already have enough information from the
-    // parameters to access the receive buffer directly).
+    // Convert any characters left at the end of the span.
     //
-    USBBufferInfoGet(&g_sTxBuffer, &sTxRing);
+    while(ulCount--)
+    {
+        *pucDst++ = SwapCaseChar(*pucSrc++);
+    }
+}
+
+//*****************************************************************************
+//
+// The identifiers of the stream processing stages which may be placed in the
+// pipeline applied to data received from the host.  A pipeline is described
+// by a word holding up to PIPELINE_MAX_STAGES of these identifiers, one per
+// nibble, with the first stage in the least significant nibble and the chain
+// ending at the first zero nibble.
+//
+// STAGE_CASE_FLIP swaps the case of alphabetic characters.
+// STAGE_CRC32 accumulates a CRC32 of the data passing through it.
+// STAGE_COUNT counts the bytes passing through it.
+// STAGE_SINK discards the data rather than echoing it back to the host.  If
+// present, this must be the last stage.
+//
+//*****************************************************************************
+#define STAGE_NONE              0
+#define STAGE_CASE_FLIP         1
+#define STAGE_CRC32             2
+#define STAGE_COUNT             3
+#define STAGE_SINK              4
+#define NUM_STAGES              5
+
+#define PIPELINE_MAX_STAGES     4
+
+//*****************************************************************************
+//
+// The pipeline used until the host selects another.  This echoes data back to
+// the host with the case of alphabetic characters swapped.
+//
+//*****************************************************************************
+#ifndef DEFAULT_PIPELINE
+#define DEFAULT_PIPELINE        STAGE_CASE_FLIP
+#endif
+
+//*****************************************************************************
+//
+// The vendor requests used by the host to select the processing pipeline and
+// to read back its results.  Both are device requests.  For
+// VENDOR_REQUEST_PIPELINE_SET, wValue holds the pipeline description and
+// there is no data stage.  Setting a pipeline resets the CRC and byte count.
+// VENDOR_REQUEST_PIPELINE_GET returns a tPipelineReport structure.
+//
+//*****************************************************************************
+#define VENDOR_REQUEST_PIPELINE_SET 0x10
+#define VENDOR_REQUEST_PIPELINE_GET 0x11
 
+//*****************************************************************************
+//
+// A function applying a processing stage to a contiguous span of data.
+// Stages which transform the data read from pucSrc and write to pucDst, which
+// may be the same as pucSrc.  Stages which only observe the data ignore
+// pucDst.
+//
+//*****************************************************************************
+typedef void (* tStageSpan)(void *pvState, unsigned char *pucDst,
+                            const unsigned char *pucSrc,
+                            unsigned long ulCount);
+
+//*****************************************************************************
+//
+// A processing stage which may be placed in the pipeline.
+//
+//*****************************************************************************
+typedef struct
+{
     //
-    // How much space is there in the transmit buffer?
+    // The function which processes a span of data or 0 if the stage does not
+    // touch the data.
     //
-    ulSpace = USBBufferSpaceAvailable(&g_sTxBuffer);
+    tStageSpan pfnSpan;
 
     //
-    // How many characters can we process this time round?
+    // The state passed to pfnSpan.
     //
-    ulLoop = (ulSpace < ulNumBytes) ? ulSpace : ulNumBytes;
-    ulCount = ulLoop;
+    void *pvState;
 
     //
-    // Update our receive counter.
+    // STAGE_FLAG_WRITES if pfnSpan writes every byte of its output span.
+    // STAGE_FLAG_SINK if the data is discarded after this stage.
     //
-    g_ulRxCount += ulNumBytes;
+    unsigned long ulFlags;
+}
+tStreamStage;
 
+#define STAGE_FLAG_WRITES       0x00000001
+#define STAGE_FLAG_SINK         0x00000002
+
+//*****************************************************************************
+//
+// The results of the pipeline, as returned to the host in response to
+// VENDOR_REQUEST_PIPELINE_GET.
+//
+//*****************************************************************************
+typedef struct
+{
     //
-    // Dump a debug message.
+    // The current pipeline description.
     //
-    DEBUG_PRINT("Received %d bytes\n", ulNumBytes);
+    unsigned long ulPipeline;
 
     //
-    // Set up to process the characters by directly accessing the USB buffers.
+    // The number of bytes counted by STAGE_COUNT.
     //
-    ulReadIndex = (unsigned long)(pcData - g_pucUSBRxBuffer);
-    ulWriteIndex = sTxRing.ulWriteIndex;
+    unsigned long ulByteCount;
 
-    while(ulLoop)
+    //
+    // The CRC32 of the data seen by STAGE_CRC32.
+    //
+    unsigned long ulCRC;
+}
+tPipelineReport;
+
+//*****************************************************************************
+//
+// A table used to calculate the CRC32 (polynomial 0x04C11DB7, reflected) a
+// nibble at a time.
+//
+//*****************************************************************************
+static const unsigned long g_pulCRC32Table[16] =
+{
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+//*****************************************************************************
+//
+// The state of the processing stages.  The CRC is held without its final
+// inversion.
+//
+//*****************************************************************************
+static unsigned long g_ulStageCRC = 0xffffffff;
+static unsigned long g_ulStageCount = 0;
+
+//*****************************************************************************
+//
+// The current pipeline, both as described by the host and as the list of
+// stages applied to each span of received data.
+//
+//*****************************************************************************
+static unsigned long g_ulPipeline;
+static const tStreamStage *g_ppsPipeline[PIPELINE_MAX_STAGES];
+static unsigned long g_ulPipelineStages;
+static tBoolean g_bPipelineSink;
+
+//*****************************************************************************
+//
+// The buffer from which the pipeline results are sent to the host.
+//
+//*****************************************************************************
+static tPipelineReport g_sPipelineReport;
+
+//*****************************************************************************
+//
+// The case-flip stage.
+//
+//*****************************************************************************
+static void
+StageCaseFlip(void *pvState, unsigned char *pucDst,
+              const unsigned char *pucSrc, unsigned long ulCount)
+{
+    SwapCaseSpan(pucDst, pucSrc, ulCount);
+}
+
+//*****************************************************************************
+//
+// The CRC32 stage.
+//
+//*****************************************************************************
+static void
+StageCRC32(void *pvState, unsigned char *pucDst, const unsigned char *pucSrc,
+           unsigned long ulCount)
+{
+    unsigned long ulCRC;
+
+    ulCRC = *(unsigned long *)pvState;
+
+    while(ulCount--)
     {
-        //
-        // Copy from the receive buffer to the transmit buffer converting
-        // character case on the way.
-        //
+        ulCRC ^= *pucSrc++;
+        ulCRC = (ulCRC >> 4) ^ g_pulCRC32Table[ulCRC & 0xf];
+        ulCRC = (ulCRC >> 4) ^ g_pulCRC32Table[ulCRC & 0xf];
+    }
 
-        //
-        // Is this a lower case character?
-        //
-        if((g_pucUSBRxBuffer[ulReadIndex] >= 'a') &&
-           (g_pucUSBRxBuffer[ulReadIndex] <= 'z'))
-        {
-            //
-            // Convert to upper case and write to the transmit buffer.
-            //
-            g_pucUSBTxBuffer[ulWriteIndex] =
-                (g_pucUSBRxBuffer[ulReadIndex] - 'a') + 'A';
-        }
-        else
-        {
-            //
-            // Is this an upper case character?
-            //
-            if((g_pucUSBRxBuffer[ulReadIndex] >= 'A') &&
-               (g_pucUSBRxBuffer[ulReadIndex] <= 'Z'))
-            {
-                //
-                // Convert to lower case and write to the transmit buffer.
-                //
-                g_pucUSBTxBuffer[ulWriteIndex] =
-                    (g_pucUSBRxBuffer[ulReadIndex] - 'Z') + 'z';
-            }
-            else
-            {
-                //
-                // Copy the received character to the transmit buffer.
-                //
-                g_pucUSBTxBuffer[ulWriteIndex] = g_pucUSBRxBuffer[ulReadIndex];
-            }
+    *(unsigned long *)pvState = ulCRC;
+}
+
+//*****************************************************************************
+//
+// The byte counting stage.
+//
+//*****************************************************************************
+static void
+StageCount(void *pvState, unsigned char *pucDst, const unsigned char *pucSrc,
+           unsigned long ulCount)
+{
+    *(unsigned long *)pvState += ulCount;
+}
+
+//*****************************************************************************
+//
+// The processing stages, indexed by stage identifier.
+//
+//*****************************************************************************
+static const tStreamStage g_psStreamStages[NUM_STAGES] =
+{
+    { 0, 0, 0 },
+    { StageCaseFlip, 0, STAGE_FLAG_WRITES },
+    { StageCRC32, &g_ulStageCRC, 0 },
+    { StageCount, &g_ulStageCount, 0 },
+    { 0, 0, STAGE_FLAG_SINK }
+};
+
+//*****************************************************************************
+//
+// Select the pipeline applied to data received from the host.
+//
+// \param ulPipeline describes the stages in the pipeline as a list of stage
+// identifiers, one per nibble, starting with the least significant.
+//
+// This function replaces the current pipeline and resets the state of the
+// processing stages.  It must be called with the USB interrupt disabled or
+// from the USB interrupt handler.
+//
+// \return Returns \b false if the pipeline description is invalid, in which
+// case the current pipeline is left unchanged, or \b true otherwise.
+//
+//*****************************************************************************
+static tBoolean
+PipelineSet(unsigned long ulPipeline)
+{
+    unsigned long ulLoop, ulStage;
+
+    //
+    // Check that all stages are known, that nothing follows the end of the
+    // chain and that the sink, if present, is last.
+    //
+    for(ulLoop = 0; ulLoop < 8; ulLoop++)
+    {
+        ulStage = (ulPipeline >> (ulLoop * 4)) & 0xf;
+
+        if((ulStage >= NUM_STAGES) ||
+           ((ulStage != STAGE_NONE) && (ulLoop >= PIPELINE_MAX_STAGES)) ||
+           ((ulStage == STAGE_NONE) && (ulPipeline >> (ulLoop * 4))) ||
+           ((ulStage == STAGE_SINK) && (ulPipeline >> ((ulLoop + 1) * 4))))
+        {
+            return(false);
+        }
+    }
+
+    //
+    // Build the list of stages.
+    //
+    g_ulPipeline = ulPipeline;
+    g_ulPipelineStages = 0;
+    g_bPipelineSink = false;
+
+    while(ulPipeline)
+    {
+        ulStage = ulPipeline & 0xf;
+        g_ppsPipeline[g_ulPipelineStages++] = &g_psStreamStages[ulStage];
+
+        if(g_psStreamStages[ulStage].ulFlags & STAGE_FLAG_SINK)
+        {
+            g_bPipelineSink = true;
+        }
+
+        ulPipeline >>= 4;
+    }
+
+    //
+    // Start the CRC and byte count afresh.
+    //
+    g_ulStageCRC = 0xffffffff;
+    g_ulStageCount = 0;
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Pass a span of data through each stage of the pipeline.
+//
+// \param pucDst points to the span to which the output is to be written.
+// This is in the USB transmit buffer if data is being echoed or is the same as
+// pucSrc if it is being discarded.
+// \param pucSrc points to the span of data in the USB receive buffer.
+// \param ulCount is the number of bytes in the span.
+//
+// The first stage which writes its output copies the data from the receive
+// buffer to the destination and all later stages work on the destination in
+// place, so no intermediate copies are made.  If no stage writes its output,
+// the data is copied to the destination at the end.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+PipelineSpan(unsigned char *pucDst, const unsigned char *pucSrc,
+             unsigned long ulCount)
+{
+    unsigned long ulLoop;
+    const tStreamStage *psStage;
+
+    for(ulLoop = 0; ulLoop < g_ulPipelineStages; ulLoop++)
+    {
+        psStage = g_ppsPipeline[ulLoop];
+
+        if(psStage->pfnSpan)
+        {
+            psStage->pfnSpan(psStage->pvState, pucDst, pucSrc, ulCount);
+
+            //
+            // Later stages read this stage's output.
+            //
+            if(psStage->ulFlags & STAGE_FLAG_WRITES)
+            {
+                pucSrc = pucDst;
+            }
+        }
+    }
+
+    //
+    // Copy the data if no stage has done so.
+    //
+    if(pucSrc != pucDst)
+    {
+        while(ulCount--)
+        {
+            *pucDst++ = *pucSrc++;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Receive new data and pass it through the processing pipeline.
+//
+// \param psDevice points to the instance data for the device whose data is to
+// be processed.
+// \param pcData points to the newly received data in the USB receive buffer.
+// \param ulNumBytes is the number of bytes of data available to be processed.
+//
+// This function is called whenever we receive a notification that data is
+// available from the host.  The data is processed in place by the stages of
+// the current pipeline.  Unless the pipeline ends with a sink, the output is
+// written directly into the transmit buffer then scheduled to be transmitted
+// back to the host.
+//
+// \return Returns the number of bytes of data processed.
+//
+//*****************************************************************************
+static unsigned long
+ProcessNewData(tUSBDBulkDevice *psDevice, unsigned char *pcData,
+               unsigned long ulNumBytes)
+{
+    unsigned long ulLoop, ulSpace, ulCount, ulSpan;
+    unsigned long ulRxLeft, ulTxLeft;
+    unsigned char *pucRx, *pucTx;
+    tUSBBufferRegion sRxRegion, sTxRegion;
+
+    //
+    // Get the data waiting in the receive buffer and the free space in the
+    // transmit buffer, each as up to two contiguous segments.  This allows us
+    // to process the data in place without knowledge of the ring layout.  If
+    // the data is to be discarded, the output is written back over the
+    // received data so the transmit buffer space is not needed.
+    //
+    USBBufferReadRegionGet(&g_sRxBuffer, &sRxRegion);
+    if(g_bPipelineSink)
+    {
+        ulSpace = ulNumBytes;
+        sTxRegion = sRxRegion;
+    }
+    else
+    {
+        ulSpace = USBBufferWriteRegionGet(&g_sTxBuffer, &sTxRegion);
+    }
+
+    //
+    // How many characters can we process this time round?
+    //
+    ulLoop = (ulSpace < ulNumBytes) ? ulSpace : ulNumBytes;
+    ulCount = ulLoop;
+
+    //
+    // Update our receive counter.
+    //
+    g_ulRxCount += ulNumBytes;
+
+    //
+    // Dump a debug message.
+    //
+    DEBUG_LOG1(LOG_RX_BYTES, ulNumBytes);
+
+    //
+    // Start with the first segment of each buffer.
+    //
+    pucRx = sRxRegion.pucData[0];
+    ulRxLeft = sRxRegion.ulLength[0];
+    pucTx = sTxRegion.pucData[0];
+    ulTxLeft = sTxRegion.ulLength[0];
+
+    while(ulLoop)
+    {
+        //
+        // Move on to the second segment of either buffer once the first has
+        // been used up.
+        //
+        if(!ulRxLeft)
+        {
+            pucRx = sRxRegion.pucData[1];
+            ulRxLeft = sRxRegion.ulLength[1];
+        }
+        if(!ulTxLeft)
+        {
+            pucTx = sTxRegion.pucData[1];
+            ulTxLeft = sTxRegion.ulLength[1];
+        }
+
+        //
+        // How many characters can we process before reaching the end of
+        // either segment?
+        //
+        ulSpan = (ulRxLeft < ulTxLeft) ? ulRxLeft : ulTxLeft;
+        ulSpan = (ulSpan < ulLoop) ? ulSpan : ulLoop;
+
+        //
+        // Pass the span through the pipeline on its way from the receive
+        // buffer to the transmit buffer.
+        //
+        PipelineSpan(pucTx, pucRx, ulSpan);
+
+        pucRx += ulSpan;
+        pucTx += ulSpan;
+        ulRxLeft -= ulSpan;
+        ulTxLeft -= ulSpan;
+        ulLoop -= ulSpan;
+    }
+
+    //
+    // We've processed the data in place so now send the processed data
+    // back to the host unless it is being discarded.
+    //
+    if(!g_bPipelineSink)
+    {
+        USBBufferDataWritten(&g_sTxBuffer, ulCount);
+
+        DEBUG_LOG1(LOG_TX_BYTES, ulCount);
+    }
+
+    //
+    // We processed as much data as we can directly from the receive buffer so
+    // we need to return the number of bytes to allow the lower layer to
+    // update its read pointer appropriately.
+    //
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+// The throughput test modes which the host may select using
+// VENDOR_REQUEST_TEST_MODE_SET.
+//
+// TEST_MODE_LOOPBACK passes received data through the processing pipeline and
+// echoes the result back to the host.  This is the default.
+// TEST_MODE_SOURCE keeps the IN endpoint busy sending the test pattern and
+// discards anything received.
+// TEST_MODE_SINK discards received data after checking it against the test
+// pattern.
+// TEST_MODE_PING replies to each ping record received with a record giving
+// the time at which the ping was received and its reply queued.
+//
+// The test pattern is a sequence of bytes each one greater than the last,
+// starting at 0 when the mode is selected and wrapping from 0xFF to 0.
+//
+//*****************************************************************************
+#define TEST_MODE_LOOPBACK      0
+#define TEST_MODE_SOURCE        1
+#define TEST_MODE_SINK          2
+#define TEST_MODE_PING          3
+#define NUM_TEST_MODES          4
+
+//*****************************************************************************
+//
+// In TEST_MODE_PING, the host sends ping records of PING_RECORD_SIZE bytes,
+// each being the 32-bit value PING_SIGNATURE followed by a 32-bit sequence
+// number, both little-endian.  The device replies to each with a record of
+// PING_REPLY_SIZE bytes holding the sequence number, the time at which the
+// USB interrupt handler was passed the ping, the time at which the reply was
+// queued for transmission and the rate at which time is counted, each as a
+// little-endian 32-bit value.  Times are in processor clocks and wrap.
+//
+// Data which does not start with PING_SIGNATURE is skipped a byte at a time,
+// each byte being counted as a pattern error.
+//
+//*****************************************************************************
+#define PING_SIGNATURE          0x474e4950
+#define PING_RECORD_SIZE        8
+#define PING_REPLY_SIZE         16
+
+//*****************************************************************************
+//
+// The vendor requests used by the host to select the test mode and read the
+// test results.  Both are device requests.  For VENDOR_REQUEST_TEST_MODE_SET,
+// wValue holds the mode and there is no data stage.  Selecting a mode resets
+// the results.  VENDOR_REQUEST_TEST_RESULTS_GET returns a tTestReport
+// structure.
+//
+//*****************************************************************************
+#define VENDOR_REQUEST_TEST_MODE_SET    0x12
+#define VENDOR_REQUEST_TEST_RESULTS_GET 0x13
+
+//*****************************************************************************
+//
+// The results of the current test, as returned to the host in response to
+// VENDOR_REQUEST_TEST_RESULTS_GET.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The current test mode.
+    //
+    unsigned long ulMode;
+
+    //
+    // The number of bytes sent to the host in TEST_MODE_SOURCE or received
+    // from it in the other modes.
+    //
+    unsigned long ulBytes;
+
+    //
+    // The number of received bytes which did not match the test pattern in
+    // TEST_MODE_SINK or were not part of a ping record in TEST_MODE_PING.
+    //
+    unsigned long ulErrors;
+
+    //
+    // The number of system ticks between the first and last transfer of data
+    // in this test.
+    //
+    unsigned long ulTicks;
+
+    //
+    // The number of system ticks per second.
+    //
+    unsigned long ulTicksPerSecond;
+}
+tTestReport;
+
+//*****************************************************************************
+//
+// The state of the current test.
+//
+//*****************************************************************************
+static unsigned long g_ulTestMode = TEST_MODE_LOOPBACK;
+static unsigned long g_ulTestBytes;
+static unsigned long g_ulTestErrors;
+static unsigned long g_ulTestStartTick;
+static unsigned long g_ulTestLastTick;
+static unsigned char g_ucTestPattern;
+
+//*****************************************************************************
+//
+// The buffer from which the test results are sent to the host.
+//
+//*****************************************************************************
+static tTestReport g_sTestReport;
+
+//*****************************************************************************
+//
+// Account for data transferred during the current test.
+//
+//*****************************************************************************
+static void
+TestBytesCount(unsigned long ulCount)
+{
+    if(ulCount)
+    {
+        //
+        // Start timing at the first transfer of the test.
+        //
+        if(!g_ulTestBytes)
+        {
+            g_ulTestStartTick = g_ulSysTickCount;
+        }
+
+        g_ulTestBytes += ulCount;
+        g_ulTestLastTick = g_ulSysTickCount;
+    }
+}
+
+//*****************************************************************************
+//
+// Fill all free space in the transmit buffer with the test pattern and
+// schedule it for transmission to the host.
+//
+//*****************************************************************************
+static void
+TestSourceFill(void)
+{
+    tUSBBufferRegion sTxRegion;
+    unsigned long ulSpace, ulSeg, ulCount;
+    unsigned char *pucTx;
+    unsigned char ucPattern;
+
+    ulSpace = USBBufferWriteRegionGet(&g_sTxBuffer, &sTxRegion);
+    ucPattern = g_ucTestPattern;
+
+    for(ulSeg = 0; ulSeg < 2; ulSeg++)
+    {
+        pucTx = sTxRegion.pucData[ulSeg];
+        ulCount = sTxRegion.ulLength[ulSeg];
+
+        while(ulCount--)
+        {
+            *pucTx++ = ucPattern++;
+        }
+    }
+
+    g_ucTestPattern = ucPattern;
+
+    if(ulSpace)
+    {
+        USBBufferDataWritten(&g_sTxBuffer, ulSpace);
+    }
+}
+
+//*****************************************************************************
+//
+// Receive new data, check it against the test pattern and discard it.
+//
+// \param ulNumBytes is the number of bytes of data available to be processed.
+//
+// \return Returns the number of bytes of data processed.
+//
+//*****************************************************************************
+static unsigned long
+TestSinkNewData(unsigned long ulNumBytes)
+{
+    tUSBBufferRegion sRxRegion;
+    unsigned long ulSeg, ulCount, ulLeft;
+    const unsigned char *pucRx;
+    unsigned char ucPattern;
+
+    USBBufferReadRegionGet(&g_sRxBuffer, &sRxRegion);
+    ucPattern = g_ucTestPattern;
+    ulLeft = ulNumBytes;
+
+    for(ulSeg = 0; (ulSeg < 2) && ulLeft; ulSeg++)
+    {
+        pucRx = sRxRegion.pucData[ulSeg];
+        ulCount = sRxRegion.ulLength[ulSeg];
+        ulCount = (ulCount < ulLeft) ? ulCount : ulLeft;
+        ulLeft -= ulCount;
+
+        while(ulCount--)
+        {
+            //
+            // On a mismatch, count the error and resynchronize to the data
+            // received so that a single bad byte is only counted once.
+            //
+            if(*pucRx != ucPattern)
+            {
+                g_ulTestErrors++;
+                ucPattern = *pucRx;
+            }
+            pucRx++;
+            ucPattern++;
+        }
+    }
+
+    g_ucTestPattern = ucPattern;
+    TestBytesCount(ulNumBytes);
+
+    return(ulNumBytes);
+}
+
+//*****************************************************************************
+//
+// Read the current time in processor clocks.
+//
+// The time is made up of the system tick count and the current value of the
+// SysTick counter.  If the SysTick interrupt is pending, as it may be when
+// this is called from another interrupt handler, the counter has wrapped
+// without the tick count yet being incremented, so this is corrected for.
+//
+// The tick count is read again at the end only to detect the SysTick handler
+// running part way through, which can happen when this is called from the
+// main loop.  The count as read, not the corrected one, is compared since the
+// handler cannot run when this is called from an interrupt handler of the
+// same priority and the corrected count would never be seen.
+//
+//*****************************************************************************
+static unsigned long
+TimeNowGet(void)
+{
+    unsigned long ulCount, ulTicks, ulValue;
+
+    do
+    {
+        ulCount = g_ulSysTickCount;
+        ulTicks = ulCount;
+        ulValue = ROM_SysTickValueGet();
+
+        //
+        // If the tick interrupt is pending, re-read the counter so that we
+        // know it is from after the wrap.
+        //
+        if(HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_PEND_SYST)
+        {
+            ulValue = ROM_SysTickValueGet();
+            ulTicks++;
+        }
+    }
+    while(ulCount != g_ulSysTickCount);
+
+    return((ulTicks * g_ulSysTickPeriod) + (g_ulSysTickPeriod - 1 - ulValue));
+}
+
+//*****************************************************************************
+//
+// The vendor request used by the host to read the enumeration trace recorded
+// by the USB library.  This is a device request with no data stage from the
+// host.  It returns up to TRACE_NUM_EVENTS tUSBDTraceEvent structures, oldest
+// first, with times and durations in processor clocks.
+//
+//*****************************************************************************
+#define VENDOR_REQUEST_TRACE_GET 0x14
+#define TRACE_NUM_EVENTS        48
+
+//*****************************************************************************
+//
+// The ring in which the USB library records the enumeration trace and the
+// buffer from which a copy of it is sent to the host.
+//
+//*****************************************************************************
+static tUSBDTraceEvent g_psTraceEvents[TRACE_NUM_EVENTS];
+static tUSBDTraceEvent g_psTraceReport[TRACE_NUM_EVENTS];
+
+//*****************************************************************************
+//
+// Read a little-endian 32-bit value from a receive buffer region at a given
+// offset, allowing for the region wrapping.
+//
+//*****************************************************************************
+static unsigned long
+RegionWordGet(const tUSBBufferRegion *psRegion, unsigned long ulOffset)
+{
+    unsigned long ulLoop, ulWord;
+    unsigned char ucByte;
+
+    ulWord = 0;
+
+    for(ulLoop = 0; ulLoop < 4; ulLoop++, ulOffset++)
+    {
+        if(ulOffset < psRegion->ulLength[0])
+        {
+            ucByte = psRegion->pucData[0][ulOffset];
+        }
+        else
+        {
+            ucByte = psRegion->pucData[1][ulOffset - psRegion->ulLength[0]];
+        }
+
+        ulWord |= (unsigned long)ucByte << (ulLoop * 8);
+    }
+
+    return(ulWord);
+}
+
+//*****************************************************************************
+//
+// Reply to the ping records which have been received.
+//
+// \param ulNumBytes is the number of bytes of data available to be processed.
+// \param ulRxTime is the time at which the USB interrupt handler was told
+// that the data was available.
+//
+// Complete ping records are consumed only if there is space in the transmit
+// buffer for the reply.  Any partial record is left in the receive buffer
+// until the rest of it arrives.
+//
+// \return Returns the number of bytes of data processed.
+//
+//*****************************************************************************
+static unsigned long
+TestPingNewData(unsigned long ulNumBytes, unsigned long ulRxTime)
+{
+    tUSBBufferRegion sRxRegion;
+    unsigned long ulOffset;
+    unsigned long pulReply[PING_REPLY_SIZE / 4];
+
+    USBBufferReadRegionGet(&g_sRxBuffer, &sRxRegion);
+    ulOffset = 0;
+
+    while((ulNumBytes - ulOffset) >= PING_RECORD_SIZE)
+    {
+        //
+        // Skip anything which is not the start of a ping record.
+        //
+        if(RegionWordGet(&sRxRegion, ulOffset) != PING_SIGNATURE)
+        {
+            g_ulTestErrors++;
+            ulOffset++;
+            continue;
+        }
+
+        //
+        // Stop if there is no room for the reply.  The record will be
+        // processed when more data arrives.
+        //
+        if(USBBufferSpaceAvailable(&g_sTxBuffer) < PING_REPLY_SIZE)
+        {
+            break;
         }
 
         //
-        // Move to the next character taking care to adjust the pointer for
-        // the buffer wrap if necessary.
+        // Build the reply and queue it for transmission.  The target is
+        // little-endian so the words can be sent as they are.
         //
-        ulWriteIndex++;
-        ulWriteIndex = (ulWriteIndex == BULK_BUFFER_SIZE) ? 0 : ulWriteIndex;
+        pulReply[0] = RegionWordGet(&sRxRegion, ulOffset + 4);
+        pulReply[1] = ulRxTime;
+        pulReply[3] = g_ulSysTickPeriod * SYSTICKS_PER_SECOND;
+        pulReply[2] = TimeNowGet();
+        USBBufferWrite(&g_sTxBuffer, (unsigned char *)pulReply,
+                       PING_REPLY_SIZE);
+
+        ulOffset += PING_RECORD_SIZE;
+    }
 
-        ulReadIndex++;
-        ulReadIndex = (ulReadIndex == BULK_BUFFER_SIZE) ? 0 : ulReadIndex;
+    TestBytesCount(ulOffset);
 
-        ulLoop--;
-    }
+    return(ulOffset);
+}
 
-    //
-    // We've processed the data in place so now send the processed data
-    // back to the host.
-    //
-    USBBufferDataWritten(&g_sTxBuffer, ulCount);
+//*****************************************************************************
+//
+// Select the throughput test mode.
+//
+// \param ulMode is the new test mode, one of the TEST_MODE_xxx values.
+//
+// This function resets the test results and starts the new mode.  It must be
+// called with the USB interrupt disabled or from the USB interrupt handler.
+//
+// \return Returns \b false if the mode is invalid or \b true otherwise.
+//
+//*****************************************************************************
+static tBoolean
+TestModeSet(unsigned long ulMode)
+{
+    if(ulMode >= NUM_TEST_MODES)
+    {
+        return(false);
+    }
 
-    DEBUG_PRINT("Wrote %d bytes\n", ulCount);
+    g_ulTestMode = ulMode;
+    g_ulTestBytes = 0;
+    g_ulTestErrors = 0;
+    g_ulTestStartTick = g_ulSysTickCount;
+    g_ulTestLastTick = g_ulTestStartTick;
+    g_ucTestPattern = 0;
 
     //
-    // We processed as much data as we can directly from the receive buffer so
-    // we need to return the number of bytes to allow the lower layer to
-    // update its read pointer appropriately.
+    // Start sending the pattern if we are now the data source.
     //
-    return(ulCount);
+    if((ulMode == TEST_MODE_SOURCE) && g_bUSBConfigured)
+    {
+        TestSourceFill();
+    }
+
+    return(true);
 }
 
 //*****************************************************************************
@@ -334,12 +1444,22 @@ TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
     if(ulEvent == USB_EVENT_TX_COMPLETE)
     {
         g_ulTxCount += ulMsgValue;
+
+        //
+        // If we are the source of a throughput test, count the data sent and
+        // refill the space it has left in the transmit buffer.
+        //
+        if(g_ulTestMode == TEST_MODE_SOURCE)
+        {
+            TestBytesCount(ulMsgValue);
+            TestSourceFill();
+        }
     }
 
     //
     // Dump a debug message.
     //
-    DEBUG_PRINT("TX complete %d\n", ulMsgValue);
+    DEBUG_LOG1(LOG_TX_COMPLETE, ulMsgValue);
 
     return(0);
 }
@@ -365,6 +1485,13 @@ unsigned long
 RxHandler(void *pvCBData, unsigned long ulEvent,
                unsigned long ulMsgValue, void *pvMsgData)
 {
+    unsigned long ulRxTime;
+
+    //
+    // Note when we were told about any ping which has arrived.
+    //
+    ulRxTime = (g_ulTestMode == TEST_MODE_PING) ? TimeNowGet() : 0;
+
     //
     // Which event are we being sent?
     //
@@ -376,7 +1503,7 @@ RxHandler(void *pvCBData, unsigned long ulEvent,
         case USB_EVENT_CONNECTED:
         {
             g_bUSBConfigured = true;
-            UARTprintf("Host connected.\n");
+            LOG0(LOG_HOST_CONNECTED);
 
             //
             // Flush our buffers.
@@ -384,6 +1511,11 @@ RxHandler(void *pvCBData, unsigned long ulEvent,
             USBBufferFlush(&g_sTxBuffer);
             USBBufferFlush(&g_sRxBuffer);
 
+            //
+            // Restart the current test.
+            //
+            TestModeSet(g_ulTestMode);
+
             break;
         }
 
@@ -393,7 +1525,7 @@ RxHandler(void *pvCBData, unsigned long ulEvent,
         case USB_EVENT_DISCONNECTED:
         {
             g_bUSBConfigured = false;
-            UARTprintf("Host disconnected.\n");
+            LOG0(LOG_HOST_DISCONNECTED);
             break;
         }
 
@@ -411,9 +1543,37 @@ RxHandler(void *pvCBData, unsigned long ulEvent,
             psDevice = (tUSBDBulkDevice *)pvCBData;
 
             //
-            // Read the new packet and echo it back to the host.
+            // In the sink test mode, check the data and discard it.
+            //
+            if(g_ulTestMode == TEST_MODE_SINK)
+            {
+                return(TestSinkNewData(ulMsgValue));
+            }
+
+            //
+            // In the ping test mode, reply to each ping received.
+            //
+            if(g_ulTestMode == TEST_MODE_PING)
+            {
+                g_ulRxCount += ulMsgValue;
+                return(TestPingNewData(ulMsgValue, ulRxTime));
+            }
+
+            //
+            // When we are the source of data, anything received is discarded.
+            //
+            if(g_ulTestMode == TEST_MODE_SOURCE)
+            {
+                g_ulRxCount += ulMsgValue;
+                return(ulMsgValue);
+            }
+
+            //
+            // Read the new packet and pass it through the pipeline.
             //
-            return(EchoNewDataToHost(psDevice, pvMsgData, ulMsgValue));
+            ulMsgValue = ProcessNewData(psDevice, pvMsgData, ulMsgValue);
+            TestBytesCount(ulMsgValue);
+            return(ulMsgValue);
         }
 
         //
@@ -452,112 +1612,401 @@ Windows doesn't care what the number is. It doesn't really matter what it is...
 */
 #define VENDOR_REQUEST_GET_MS_OS_DESCRIPTOR 7
 
+/**
+The vendor request number used by Windows to read the Microsoft OS 2.0 descriptor set.  The descriptor set itself is
+generated and served by usblib once we give it a description in ConfigureAutoWinUsbInstall().
+*/
+#define VENDOR_REQUEST_GET_MS_OS_20_DESCRIPTOR 8
+
+/**
+The Device Interface GUID from TI's usb_dev_bulk.inf, reported through both the original and 2.0 Microsoft OS
+descriptors.
+*/
+#define DEVICE_INTERFACE_GUID "{6E45736A-2B1B-4078-B772-B3AF2B6FDE1C}"
+
+/**
+The request handler of the bulk device class, to which any vendor requests not handled here are passed.
+*/
+static tStdRequest g_pfnBulkRequestHandler;
+
+/**
+A vendor command handler.  The handler must answer the request using VendorReplyData(), VendorReplyStream() or
+VendorReplyAck(), or return false to have the request stalled.  Vendor requests are deferred to the main loop, so the
+USB interrupt may run at any point and the handler must disable interrupts while it touches state that is also used
+from interrupt context.
+*/
+typedef tBoolean (* tVendorCommandHandler)(tUSBRequest *pUSBRequest);
+
+/**
+An entry in the vendor command table.  Commands are matched on the type and recipient bits of bmRequestType, bRequest
+and wIndex.  A command whose usIndex is VENDOR_INDEX_ANY matches any wIndex for which there is no exact match.
+If pfnHandler is 0, the command is answered with the ulSize bytes at pucData.
+*/
+typedef struct
+{
+	unsigned char ucRequestType;
+	unsigned char ucRequest;
+	unsigned short usIndex;
+	tVendorCommandHandler pfnHandler;
+	const unsigned char *pucData;
+	unsigned long ulSize;
+}
+tVendorCommand;
+
+#define VENDOR_INDEX_ANY 0xFFFF
+
+/**
+The vendor commands are looked up through an open-addressed hash table so that dispatch takes constant time however
+many commands are registered.  The table is kept no more than half full to keep probe sequences short.
+*/
+#define VENDOR_HASH_BITS 5
+#define VENDOR_HASH_SIZE (1 << VENDOR_HASH_BITS)
+
+static const tVendorCommand *g_ppsVendorHash[VENDOR_HASH_SIZE];
+static unsigned long g_ulVendorCommands;
+
 /**
 Transmit the argument buffer to the host, using the smaller of the buffer size or the length specified by the host.
 */
 static void SendEP0Data(unsigned char * pbySendBuffer, unsigned uBufferBytes, tUSBRequest *pUSBRequest)
 {
     const unsigned long ulSize = pUSBRequest->wLength < uBufferBytes ? pUSBRequest->wLength : uBufferBytes;
-    UARTprintf("Sending %u bytes\n", ulSize);
+    LOG1(LOG_EP0_SEND, ulSize);
 
     USBDCDSendDataEP0(0, pbySendBuffer, ulSize);
 }
 
 /**
-Inspect the EP0 Vendor Request details and handle according to what is recognized.
-If the request is indeed handled, pbySendBuffer_out will be set to the buffer to send to the host, along with
-puBufferBytes_out indicating the number of bytes to send.
-Otherwise, these two values will not be changed.
+Answer a vendor command by sending a buffer which must remain unchanged until it has been sent.
+*/
+static void VendorReplyData(tUSBRequest *pUSBRequest, const unsigned char *pucData, unsigned long ulSize)
+{
+	MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+	SendEP0Data((unsigned char *)pucData, ulSize, pUSBRequest);
+}
 
-We are expecting the "Microsoft Compatible ID Feature Descriptor" request, for which
-we'll respond with the magic "WINUSB" descriptor, as well as the "Microsoft Extended Properties Feature Descriptor"
-request that we will respond with the DeviceInterfaceGUID.
+/**
+Answer a vendor command by streaming ulSize bytes, each packet of which is provided by pfnFill as it is needed.
 */
-static void DispatchVendorRequest(tUSBRequest *pUSBRequest, unsigned char ** pbySendBuffer_out, unsigned * puBufferBytes_out)
+static void VendorReplyStream(tUSBRequest *pUSBRequest, unsigned long ulSize, tUSBEP0Fill pfnFill, void *pvFillData)
 {
-	if((pUSBRequest->bmRequestType & USB_RTYPE_TYPE_M) != USB_RTYPE_VENDOR) return;
+	if(ulSize > pUSBRequest->wLength) ulSize = pUSBRequest->wLength;
+	LOG1(LOG_EP0_SEND, ulSize);
 
-	if(VENDOR_REQUEST_GET_MS_OS_DESCRIPTOR == pUSBRequest->bRequest &&
-		4 == pUSBRequest->wIndex &&
-		USB_RTYPE_DEVICE == (pUSBRequest->bmRequestType & USB_RTYPE_RECIPIENT_M))
-	{
-		UARTprintf("Sending Microsoft Compatible ID Feature Descriptor 'WINUSB'\n");
+	MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+	USBDCDSendStreamEP0(0, ulSize, pfnFill, pvFillData);
+}
 
-		static unsigned char abyCIDFDesc[] =
+/**
+Answer a vendor command which has no data stage.
+*/
+static void VendorReplyAck(void)
+{
+	MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+}
+
+/**
+Return the hash table slot at which to start looking for a command.
+*/
+static unsigned long VendorHash(unsigned long ulRequestType, unsigned long ulRequest, unsigned long ulIndex)
+{
+	unsigned long ulKey = (ulRequestType << 24) | (ulRequest << 16) | ulIndex;
+
+	return ((ulKey * 0x9E3779B1) >> (32 - VENDOR_HASH_BITS)) & (VENDOR_HASH_SIZE - 1);
+}
+
+/**
+Find the command with the given key, returning 0 if there is none.
+*/
+static const tVendorCommand *VendorCommandFind(unsigned long ulRequestType, unsigned long ulRequest, unsigned long ulIndex)
+{
+	unsigned long ulSlot = VendorHash(ulRequestType, ulRequest, ulIndex);
+	const tVendorCommand *psCommand;
+
+	while((psCommand = g_ppsVendorHash[ulSlot]) != 0)
+	{
+		if(psCommand->ucRequestType == ulRequestType && psCommand->ucRequest == ulRequest &&
+		   psCommand->usIndex == ulIndex)
 		{
-			0x28, 0x00, 0x00, 0x00,	// DWORD (LE)	 Descriptor length (40 bytes)
-			0x00, 0x01,	 			// BCD WORD (LE)	 Version ('1.0')
-			0x04, 0x00,				// WORD (LE)	 Compatibility ID Descriptor index (0x0004)
-			0x01, 					// BYTE	 Number of sections (1)
-			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 7 BYTES	 Reserved
-			0x00, //	 BYTE	 Interface Number (Interface #0)
-			0x01, //	 BYTE	 Reserved
-			0x57, 0x49, 0x4E, 0x55, 0x53, 0x42, 0x00, 0x00, //8 BYTES ASCII String Compatible ID ("WINUSB\0\0")
-			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //8 BYTES ASCII String	 Sub-Compatible ID (unused)
-			0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // 6 BYTES Reserved
-		};
-
-		*pbySendBuffer_out = abyCIDFDesc;
-		*puBufferBytes_out = sizeof abyCIDFDesc;
+			return psCommand;
+		}
+		ulSlot = (ulSlot + 1) & (VENDOR_HASH_SIZE - 1);
 	}
-	else if(VENDOR_REQUEST_GET_MS_OS_DESCRIPTOR == pUSBRequest->bRequest &&
-		5 == pUSBRequest->wIndex &&
-		USB_RTYPE_INTERFACE == (pUSBRequest->bmRequestType & USB_RTYPE_RECIPIENT_M))
+
+	return 0;
+}
+
+/**
+Add a command to the vendor command table.  Returns false if the table is full or the command is already registered.
+This must not be called while the device is connected.
+*/
+static tBoolean VendorCommandRegister(const tVendorCommand *psCommand)
+{
+	unsigned long ulSlot;
+
+	if((g_ulVendorCommands >= VENDOR_HASH_SIZE / 2) ||
+	   VendorCommandFind(psCommand->ucRequestType, psCommand->ucRequest, psCommand->usIndex))
+	{
+		return false;
+	}
+
+	ulSlot = VendorHash(psCommand->ucRequestType, psCommand->ucRequest, psCommand->usIndex);
+	while(g_ppsVendorHash[ulSlot])
 	{
-		UARTprintf("Sending Microsoft Extended Properties Feature Descriptor\n");
+		ulSlot = (ulSlot + 1) & (VENDOR_HASH_SIZE - 1);
+	}
 
-		// This sends the Device Interface GUID from TI's usb_dev_bulk.inf
-		//
-		static unsigned char abyEPFDesc[] =
-		{
-			0x92, 0x00, 0x00, 0x00,	// DWORD (LE)	 Descriptor length (146 bytes)
-			0x00, 0x01,	 			// BCD WORD (LE) Version ('1.0')
-			0x05, 0x00,				// WORD (LE)	 Extended Property Descriptor index (0x0005)
-			0x01, 0x00,				// WORD          Number of sections (1)
-			0x88, 0x00, 0x00, 0x00,	// DWORD (LE)	 Size of the property section (136 bytes)
-			0x07, 0x00, 0x00, 0x00,	// DWORD (LE)	 Property data type (7 = Unicode REG_MULTI_SZ)
-			0x2A, 0x00,				// WORD (LE)	 Property name length (42 bytes)
-									// NULL-terminated Unicode String (LE)	 Property Name (L"DeviceInterfaceGUIDs")
-			'D',0,'e',0,'v',0,'i',0,'c',0,'e',0,'I',0,'n',0,'t',0,'e',0,'r',0,'f',0,'a',0,'c',0,'e',0,'G',0,'U',0,'I',0,'D',0,'s',0, 0x00, 0x00,
-			0x50, 0x00, 0x00, 0x00,	// DWORD (LE)	 Property data length (80 bytes)
-
-									// NULL-terminated Unicode String (LE), followed by another Unicode NULL
-									// Property Name ("{6E45736A-2B1B-4078-B772-B3AF2B6FDE1C}")
-			'{',0,'6',0,'E',0,'4',0,'5',0,'7',0,'3',0,'6',0,'A',0,'-',0,'2',0,'B',0,'1',0,'B',0,'-',0,'4',0,'0',0,'7',0,'8',0,'-',0,'B',0,'7',0,'7',0,'2',0,'-',0,'B',0,'3',0,'A',0,'F',0,'2',0,'B',0,'6',0,'F',0,'D',0,'E',0,'1',0,'C',0,'}',0, 0x00,0x00, 0x00,0x00
-		};
-
-		*pbySendBuffer_out = abyEPFDesc;
-		*puBufferBytes_out = sizeof abyEPFDesc;
+	g_ppsVendorHash[ulSlot] = psCommand;
+	g_ulVendorCommands++;
+
+	return true;
+}
+
+/**
+The "Microsoft Compatible ID Feature Descriptor", for which we respond with the magic "WINUSB" descriptor.
+*/
+static const unsigned char g_pucMSCompatIDDesc[] =
+{
+	0x28, 0x00, 0x00, 0x00,	// DWORD (LE)	 Descriptor length (40 bytes)
+	0x00, 0x01,	 			// BCD WORD (LE)	 Version ('1.0')
+	0x04, 0x00,				// WORD (LE)	 Compatibility ID Descriptor index (0x0004)
+	0x01, 					// BYTE	 Number of sections (1)
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 7 BYTES	 Reserved
+	0x00, //	 BYTE	 Interface Number (Interface #0)
+	0x01, //	 BYTE	 Reserved
+	0x57, 0x49, 0x4E, 0x55, 0x53, 0x42, 0x00, 0x00, //8 BYTES ASCII String Compatible ID ("WINUSB\0\0")
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //8 BYTES ASCII String	 Sub-Compatible ID (unused)
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // 6 BYTES Reserved
+};
+
+/**
+The layout of the "Microsoft Extended Properties Feature Descriptor", which holds the DeviceInterfaceGUIDs property.
+The descriptor is larger than a control packet so rather than holding it in memory, ExtPropsFill() generates it a
+packet at a time as it is sent.
+*/
+static const char g_pcExtPropsName[] = "DeviceInterfaceGUIDs";
+static const char g_pcExtPropsGUID[] = DEVICE_INTERFACE_GUID;
+
+#define EXT_PROPS_HEADER_SIZE  10
+#define EXT_PROPS_NAME_SIZE    (sizeof(g_pcExtPropsName) * 2)        // NULL-terminated Unicode
+#define EXT_PROPS_DATA_SIZE    ((sizeof(g_pcExtPropsGUID) + 1) * 2)  // REG_MULTI_SZ, so an extra Unicode NULL
+#define EXT_PROPS_SECTION_SIZE (14 + EXT_PROPS_NAME_SIZE + EXT_PROPS_DATA_SIZE)
+#define EXT_PROPS_SIZE         (EXT_PROPS_HEADER_SIZE + EXT_PROPS_SECTION_SIZE)
+
+/**
+Return byte ulByte of the little-endian representation of ulValue.
+*/
+static unsigned char LEByte(unsigned long ulValue, unsigned long ulByte)
+{
+	return (unsigned char)(ulValue >> (ulByte * 8));
+}
+
+/**
+Return byte ulOffset of an ASCII string expanded to Unicode, with zeros past the end of the string.
+*/
+static unsigned char UnicodeByte(const char *pcString, unsigned long ulLength, unsigned long ulOffset)
+{
+	return ((ulOffset & 1) || (ulOffset / 2 >= ulLength)) ? 0 : pcString[ulOffset / 2];
+}
+
+/**
+Return the byte at ulOffset in the "Microsoft Extended Properties Feature Descriptor".
+*/
+static unsigned char ExtPropsByte(unsigned long ulOffset)
+{
+	if(ulOffset < 4) return LEByte(EXT_PROPS_SIZE, ulOffset);		// DWORD (LE)	Descriptor length
+	if(ulOffset < 6) return LEByte(0x0100, ulOffset - 4);			// BCD WORD (LE)	Version ('1.0')
+	if(ulOffset < 8) return LEByte(0x0005, ulOffset - 6);			// WORD (LE)	Extended Property Descriptor index
+	if(ulOffset < 10) return LEByte(1, ulOffset - 8);				// WORD	Number of sections (1)
+	ulOffset -= EXT_PROPS_HEADER_SIZE;
+
+	if(ulOffset < 4) return LEByte(EXT_PROPS_SECTION_SIZE, ulOffset);	// DWORD (LE)	Size of the property section
+	if(ulOffset < 8) return LEByte(7, ulOffset - 4);					// DWORD (LE)	Property data type (REG_MULTI_SZ)
+	if(ulOffset < 10) return LEByte(EXT_PROPS_NAME_SIZE, ulOffset - 8);	// WORD (LE)	Property name length
+	ulOffset -= 10;
+
+	if(ulOffset < EXT_PROPS_NAME_SIZE)									// Property name (L"DeviceInterfaceGUIDs")
+		return UnicodeByte(g_pcExtPropsName, sizeof(g_pcExtPropsName) - 1, ulOffset);
+	ulOffset -= EXT_PROPS_NAME_SIZE;
+
+	if(ulOffset < 4) return LEByte(EXT_PROPS_DATA_SIZE, ulOffset);		// DWORD (LE)	Property data length
+	ulOffset -= 4;
+
+	return UnicodeByte(g_pcExtPropsGUID, sizeof(g_pcExtPropsGUID) - 1, ulOffset);	// Property data (the GUID)
+}
+
+/**
+Provide a packet of the "Microsoft Extended Properties Feature Descriptor" as it is streamed to the host.
+*/
+static void ExtPropsFill(void *pvFillData, unsigned long ulOffset, unsigned char *pucBuffer, unsigned long ulSize)
+{
+	while(ulSize--)
+	{
+		*pucBuffer++ = ExtPropsByte(ulOffset++);
 	}
 }
 
 /**
-This handler will be invoked by usblib whenever the host performs a Vendor request.
-We are expecting the "Microsoft Compatible ID Feature Descriptor" request, for which
-we'll respond with the magic "WINUSB" descriptor, as well as the "Microsoft Extended Properties Feature Descriptor"
-request that we will respond with the DeviceInterfaceGUID.
+Handle the "Microsoft Extended Properties Feature Descriptor" request, for which we respond with the
+DeviceInterfaceGUID.
+*/
+static tBoolean HandleExtPropsRequest(tUSBRequest *pUSBRequest)
+{
+	VendorReplyStream(pUSBRequest, EXT_PROPS_SIZE, ExtPropsFill, 0);
+	return true;
+}
+
+/**
+Handle the vendor request which selects the processing pipeline.
+*/
+static tBoolean HandlePipelineSet(tUSBRequest *pUSBRequest)
+{
+	tBoolean bIntsOff = IntMasterDisable();
+	tBoolean bValid = PipelineSet(pUSBRequest->wValue);
+
+	if(!bIntsOff) IntMasterEnable();
+	if(!bValid) return false;
+
+	LOG1(LOG_PIPELINE_SET, pUSBRequest->wValue);
+	VendorReplyAck();
+	return true;
+}
+
+/**
+Handle the vendor request which reads back the results of the processing pipeline.
+*/
+static tBoolean HandlePipelineGet(tUSBRequest *pUSBRequest)
+{
+	tBoolean bIntsOff = IntMasterDisable();
+
+	g_sPipelineReport.ulPipeline = g_ulPipeline;
+	g_sPipelineReport.ulByteCount = g_ulStageCount;
+	g_sPipelineReport.ulCRC = ~g_ulStageCRC;
+	if(!bIntsOff) IntMasterEnable();
+
+	VendorReplyData(pUSBRequest, (unsigned char *)&g_sPipelineReport, sizeof g_sPipelineReport);
+	return true;
+}
+
+/**
+Handle the vendor request which selects the throughput test mode.
+*/
+static tBoolean HandleTestModeSet(tUSBRequest *pUSBRequest)
+{
+	tBoolean bIntsOff = IntMasterDisable();
+	tBoolean bValid = TestModeSet(pUSBRequest->wValue);
+
+	if(!bIntsOff) IntMasterEnable();
+	if(!bValid) return false;
+
+	LOG1(LOG_TEST_MODE_SET, pUSBRequest->wValue);
+	VendorReplyAck();
+	return true;
+}
+
+/**
+Handle the vendor request which reads back the results of the throughput test.
+*/
+static tBoolean HandleTestResultsGet(tUSBRequest *pUSBRequest)
+{
+	tBoolean bIntsOff = IntMasterDisable();
+
+	g_sTestReport.ulMode = g_ulTestMode;
+	g_sTestReport.ulBytes = g_ulTestBytes;
+	g_sTestReport.ulErrors = g_ulTestErrors;
+	g_sTestReport.ulTicks = g_ulTestLastTick - g_ulTestStartTick;
+	g_sTestReport.ulTicksPerSecond = SYSTICKS_PER_SECOND;
+	if(!bIntsOff) IntMasterEnable();
+
+	VendorReplyData(pUSBRequest, (unsigned char *)&g_sTestReport, sizeof g_sTestReport);
+	return true;
+}
+
+/**
+Handle the vendor request which reads back the enumeration trace.
+*/
+static tBoolean HandleTraceGet(tUSBRequest *pUSBRequest)
+{
+	unsigned long ulCount = USBDCDTraceRead(0, g_psTraceReport, TRACE_NUM_EVENTS);
+
+	VendorReplyData(pUSBRequest, (unsigned char *)g_psTraceReport, ulCount * sizeof(tUSBDTraceEvent));
+	return true;
+}
+
+/**
+The vendor commands understood by this device.  To add a command, add an entry here.
+*/
+static const tVendorCommand g_psVendorCommands[] =
+{
+	// Microsoft OS descriptors
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_GET_MS_OS_DESCRIPTOR, 4,
+	  0, g_pucMSCompatIDDesc, sizeof g_pucMSCompatIDDesc },
+	{ USB_RTYPE_VENDOR | USB_RTYPE_INTERFACE, VENDOR_REQUEST_GET_MS_OS_DESCRIPTOR, 5,
+	  HandleExtPropsRequest, 0, 0 },
+
+	// Processing pipeline
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_PIPELINE_SET, VENDOR_INDEX_ANY,
+	  HandlePipelineSet, 0, 0 },
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_PIPELINE_GET, VENDOR_INDEX_ANY,
+	  HandlePipelineGet, 0, 0 },
+
+	// Throughput tests
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_TEST_MODE_SET, VENDOR_INDEX_ANY,
+	  HandleTestModeSet, 0, 0 },
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_TEST_RESULTS_GET, VENDOR_INDEX_ANY,
+	  HandleTestResultsGet, 0, 0 },
+
+	// Enumeration trace
+	{ USB_RTYPE_VENDOR | USB_RTYPE_DEVICE, VENDOR_REQUEST_TRACE_GET, VENDOR_INDEX_ANY,
+	  HandleTraceGet, 0, 0 }
+};
+
+#define NUM_VENDOR_COMMANDS (sizeof(g_psVendorCommands) / sizeof(tVendorCommand))
+
+/**
+This handler will be invoked by usblib whenever the host performs a Vendor request.  The request is looked up in the
+vendor command table and, if not found there, passed on to the bulk device.  It is called from USBDCDProcessDeferred()
+in the main loop rather than from the USB interrupt handler.
 */
 static void VendorRequestHandler(void *pvInstance, tUSBRequest *pUSBRequest)
 {
-	unsigned char * pbySendBuffer = 0;
-	unsigned uBufferBytes = 0;
+	const unsigned long ulRequestType = pUSBRequest->bmRequestType & (USB_RTYPE_TYPE_M | USB_RTYPE_RECIPIENT_M);
+	const tVendorCommand *psCommand;
 
-	UARTprintf("Received Vendor request: Type=0x%X Request=0x%X Value=0x%X Index=0x%X Length=0x%X\n",
+	LOG5(LOG_VENDOR_REQUEST,
 			pUSBRequest->bmRequestType,
 			pUSBRequest->bRequest,
 			pUSBRequest->wValue,
 			pUSBRequest->wIndex,
 			pUSBRequest->wLength);
 
-	MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+	psCommand = VendorCommandFind(ulRequestType, pUSBRequest->bRequest, pUSBRequest->wIndex);
+	if(!psCommand)
+	{
+		psCommand = VendorCommandFind(ulRequestType, pUSBRequest->bRequest, VENDOR_INDEX_ANY);
+	}
 
-	DispatchVendorRequest(pUSBRequest, &pbySendBuffer, &uBufferBytes);
-	if(pbySendBuffer && uBufferBytes)
+	if(psCommand)
+	{
+		if(!psCommand->pfnHandler)
+		{
+			VendorReplyData(pUSBRequest, psCommand->pucData, psCommand->ulSize);
+		}
+		else if(!psCommand->pfnHandler(pUSBRequest))
+		{
+			USBDCDStallEP0(0);
+		}
+	}
+	else if(g_pfnBulkRequestHandler)
 	{
-		SendEP0Data(pbySendBuffer, uBufferBytes, pUSBRequest);
+		//
+		// Let the bulk device handle its own requests, such as those reading its statistics.
+		//
+		g_pfnBulkRequestHandler(pvInstance, pUSBRequest);
 	}
 	else
 	{
+		MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
 		USBDCDStallEP0(0);
 	}
 }
@@ -573,7 +2022,7 @@ request and give Windows what it wants.
  */
 static void GetStringDescriptorHandler(void *pvInstance, tUSBRequest *pUSBRequest)
 {
-	UARTprintf("Received String Descriptor request: 0x%X\n", pUSBRequest->wValue);
+	LOG1(LOG_STRING_REQUEST, pUSBRequest->wValue);
 
 	if((pUSBRequest->wValue & 0xFF) != MS_OS_STRING_DESCRIPTOR)
 	{
@@ -581,7 +2030,7 @@ static void GetStringDescriptorHandler(void *pvInstance, tUSBRequest *pUSBReques
 		return;
 	}
 
-	UARTprintf("Sending MS OS String Descriptor 'MSFT100'\n");
+	LOG0(LOG_MS_OS_STRING);
 
     static unsigned char abyOsDescriptor[] =
     {
@@ -596,32 +2045,64 @@ static void GetStringDescriptorHandler(void *pvInstance, tUSBRequest *pUSBReques
 }
 
 /**
-This kludge hijacks the USB version in usblib from 1.1 to 2.0, otherwise Windows will never bother to ask for the 0xEE
-OS String Descriptor.
+This kludge hijacks the USB version in usblib from 1.1 to 2.1, otherwise Windows will never bother to ask for the 0xEE
+OS String Descriptor or, from Windows 8.1, the BOS descriptor leading to the Microsoft OS 2.0 descriptors.
 It doesn't make sense that usblib defaults to 1.1.  Certainly you can have FS devices under 2.0 spec!
 At the very least, usblib should allow a more elegant way to set this... but really I think it should just set it
 to 2.0 and be done with it.
 */
-static void ConfigureUsb200()
+static void ConfigureUsb210()
 {
 	unsigned short * const pwUsbVersion = (unsigned short *)(g_sBulkDeviceInfo.pDeviceDescriptor + 2);
-	*pwUsbVersion = 0x200;
+	*pwUsbVersion = 0x210;
 }
 
+/**
+The Microsoft OS 2.0 descriptors which usblib generates for us.  Windows 8.1 and later read these in a single
+request following the BOS descriptor, rather than making the three requests needed by the original descriptors.
+*/
+static const tUSBMSOS20Config g_sMSOS20Config =
+{
+	VENDOR_REQUEST_GET_MS_OS_20_DESCRIPTOR,
+	USB_MSOS20_DEVICE,
+	"WINUSB",
+	DEVICE_INTERFACE_GUID
+};
+
 /**
 This will setup the callbacks needed to handle Window's attempts to get the MS OS String Descriptor and
 Microsoft Compatible ID Feature Descriptor that ultimately leads to the automatic installation of the
-WinUSB.sys driver.
+WinUSB.sys driver.  It also registers the vendor commands and the Microsoft OS 2.0 descriptors.
  */
 static void ConfigureAutoWinUsbInstall()
 {
-	ConfigureUsb200();
+	unsigned long ulLoop;
+
+	ConfigureUsb210();
+	USBDCDMSOS20Set(0, &g_sMSOS20Config);
+
+	for(ulLoop = 0; ulLoop < NUM_VENDOR_COMMANDS; ulLoop++)
+	{
+		VendorCommandRegister(&g_psVendorCommands[ulLoop]);
+	}
+
+	g_pfnBulkRequestHandler = g_sBulkDeviceInfo.sCallbacks.pfnRequestHandler;
 	g_sBulkDeviceInfo.sCallbacks.pfnRequestHandler = VendorRequestHandler;
 	g_sBulkDeviceInfo.sCallbacks.pfnGetStringDescriptor = GetStringDescriptorHandler;
 }
 
 /** @endregion */
 
+//*****************************************************************************
+//
+// The buffer holding our configuration descriptor once the USB library has
+// gathered its sections together.  This lets the descriptor be sent to the
+// host as a single block rather than being assembled packet by packet.
+//
+//*****************************************************************************
+#define CONFIG_DESC_BUFFER_SIZE 64
+static unsigned char g_pucConfigDescriptor[CONFIG_DESC_BUFFER_SIZE];
+
 //*****************************************************************************
 //
 // This is the main application entry function.
@@ -630,9 +2111,13 @@ static void ConfigureAutoWinUsbInstall()
 int
 main(void)
 {
-    volatile unsigned long ulLoop;
     unsigned long ulTxCount;
     unsigned long ulRxCount;
+    unsigned long ulLEDs;
+    unsigned long ulFlash;
+    unsigned long ulLEDTick;
+    unsigned long ulDisplayTick;
+    tBoolean bDisplay;
 
     //
     // Enable lazy stacking for interrupt handlers.  This allows floating-point
@@ -687,7 +2172,8 @@ main(void)
     //
     // Enable the system tick.
     //
-    ROM_SysTickPeriodSet(ROM_SysCtlClockGet() / SYSTICKS_PER_SECOND);
+    g_ulSysTickPeriod = ROM_SysCtlClockGet() / SYSTICKS_PER_SECOND;
+    ROM_SysTickPeriodSet(g_ulSysTickPeriod);
     ROM_SysTickIntEnable();
     ROM_SysTickEnable();
 
@@ -702,6 +2188,11 @@ main(void)
     USBBufferInit((tUSBBuffer *)&g_sTxBuffer);
     USBBufferInit((tUSBBuffer *)&g_sRxBuffer);
 
+    //
+    // Select the initial processing pipeline for received data.
+    //
+    PipelineSet(DEFAULT_PIPELINE);
+
     //
     // Set the USB stack mode to Device mode with VBUS monitoring.
     //
@@ -709,93 +2200,120 @@ main(void)
 
     ConfigureAutoWinUsbInstall();
 
+    //
+    // Trace enumeration from the first bus reset so that the host can find
+    // out where the time goes.  TimeNowGet() never waits for the SysTick
+    // handler so it is safe to call from the USB interrupt handler.
+    //
+    USBDCDTraceSet(0, g_psTraceEvents, TRACE_NUM_EVENTS, TimeNowGet);
+
     //
     // Pass our device information to the USB library and place the device
     // on the bus.
     //
     USBDBulkInit(0, (tUSBDBulkDevice *)&g_sBulkDevice);
 
+    //
+    // The USB library checks the string descriptor table when the device is
+    // initialized.  Report it if the table has been rejected.
+    //
+    if(!USBDCDStringTableValid(0))
+    {
+        UARTprintf("String descriptor table is invalid.\n");
+    }
+
+    //
+    // Now that the bulk class has filled in its interface and endpoint
+    // numbers, serve the configuration descriptor from a single buffer.  If
+    // the buffer is too small the library carries on sending the descriptor
+    // section by section.
+    //
+    if(!USBDCDConfigDescFlatten(0, g_pucConfigDescriptor,
+                                sizeof(g_pucConfigDescriptor)))
+    {
+        UARTprintf("Configuration descriptor is too large to flatten.\n");
+    }
+
+    //
+    // Handle vendor requests from the main loop so that slow commands do not
+    // hold up service of the bulk endpoints.
+    //
+    USBDCDDeferRequests(0, USBD_DEFER_VENDOR);
+
     //
     // Wait for initial configuration to complete.
     //
     UARTprintf("Waiting for host...\n");
 
     //
-    // Clear our local byte counters.
+    // Clear our local byte counters and LED and display state.
     //
     ulRxCount = 0;
     ulTxCount = 0;
+    ulLEDs = 0;
+    ulLEDTick = 0;
+    ulDisplayTick = g_ulSysTickCount;
+    bDisplay = false;
 
     //
-    // Main application loop.
+    // Main application loop.  Nothing here waits, so that logged messages
+    // and deferred vendor requests are handled on every pass.
     //
     while(1)
     {
         //
-        // See if any data has been transferred.
+        // Write out any messages logged from interrupt context.
+        //
+        LogDrain();
+
+        //
+        // Handle any vendor request waiting for a response.
+        //
+        USBDCDProcessDeferred(0);
+
+        //
+        // Turn off the LEDs once they have been lit for long enough.
         //
-        if((ulTxCount != g_ulTxCount) || (ulRxCount != g_ulRxCount))
+        if(ulLEDs && ((g_ulSysTickCount - ulLEDTick) >= LED_FLASH_TICKS))
         {
-            //
-            // Has there been any transmit traffic since we last checked?
-            //
-            if(ulTxCount != g_ulTxCount)
-            {
-                //
-                // Turn on the Green LED.
-                //
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, GPIO_PIN_3);
-
-                //
-                // Delay for a bit.
-                //
-                for(ulLoop = 0; ulLoop < 150000; ulLoop++)
-                {
-                }
-            
-                //
-                // Turn off the Green LED.
-                //
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, 0);
-                
-                //
-                // Take a snapshot of the latest transmit count.
-                //
-                ulTxCount = g_ulTxCount;
-            }
+            GPIOPinWrite(GPIO_PORTF_BASE, ulLEDs, 0);
+            ulLEDs = 0;
+        }
 
-            //
-            // Has there been any receive traffic since we last checked?
-            //
-            if(ulRxCount != g_ulRxCount)
-            {
-                //
-                // Turn on the Blue LED.
-                //
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_2, GPIO_PIN_2);
-
-                //
-                // Delay for a bit.
-                //
-                for(ulLoop = 0; ulLoop < 150000; ulLoop++)
-                {
-                }
-            
-                //
-                // Turn off the Blue LED.
-                //
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_2, 0);
-
-                //
-                // Take a snapshot of the latest receive count.
-                //
-                ulRxCount = g_ulRxCount;
-            }
+        //
+        // Light the Green LED if there has been any transmit traffic and the
+        // Blue LED if there has been any receive traffic since we last
+        // checked, taking a snapshot of the latest counts.
+        //
+        ulFlash = 0;
+        if(ulTxCount != g_ulTxCount)
+        {
+            ulFlash |= GPIO_PIN_3;
+            ulTxCount = g_ulTxCount;
+        }
+        if(ulRxCount != g_ulRxCount)
+        {
+            ulFlash |= GPIO_PIN_2;
+            ulRxCount = g_ulRxCount;
+        }
+        if(ulFlash)
+        {
+            GPIOPinWrite(GPIO_PORTF_BASE, ulFlash, ulFlash);
+            ulLEDs |= ulFlash;
+            ulLEDTick = g_ulSysTickCount;
+            bDisplay = true;
+        }
 
-            //
-            // Update the display of bytes transferred.
-            //
+        //
+        // Update the display of bytes transferred, but not so often that
+        // writing to the UART holds up the loop.
+        //
+        if(bDisplay &&
+           ((g_ulSysTickCount - ulDisplayTick) >= DISPLAY_UPDATE_TICKS))
+        {
             UARTprintf("\rTx: %d  Rx: %d", ulTxCount, ulRxCount);
+            ulDisplayTick = g_ulSysTickCount;
+            bDisplay = false;
         }
     }
 }
@@ -418,7 +418,9 @@ static void HandleDevice(void *pvInstance, unsigned long ulRequest,
 
 //*****************************************************************************
 //
-// The FIFO configuration for USB audio device class.
+// The FIFO configuration for USB audio device class.  The isochronous OUT
+// endpoint is kept single-buffered since the uDMA transfer handling expects
+// its FIFO to hold no more than one packet.
 //
 //*****************************************************************************
 const tFIFOConfig g_sUSBAudioFIFOConfig =
@@ -448,7 +450,8 @@ const tFIFOConfig g_sUSBAudioFIFOConfig =
     // OUT endpoints.
     //
     {
-        { false, USB_EP_DEV_OUT | USB_EP_DMA_MODE_1 | USB_EP_AUTO_CLEAR },
+        { false, USB_EP_DEV_OUT | USB_EP_DMA_MODE_1 | USB_EP_AUTO_CLEAR,
+          true },
         { false, USB_EP_DEV_OUT },
         { false, USB_EP_DEV_OUT },
         { false, USB_EP_DEV_OUT },
@@ -22,11 +22,14 @@
 //
 //*****************************************************************************
 
+#include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
+#include "driverlib/udma.h"
 #include "driverlib/usb.h"
 #include "usblib/usblib.h"
 #include "usblib/device/usbdevice.h"
@@ -62,13 +65,32 @@
 
 //*****************************************************************************
 //
-// Macros to convert between USB controller base address and an index.  These
-// are currently trivial but are included to allow for the possibility of
-// supporting more than one controller in the future.
+// The interval, in milliseconds, after which a deferred receive is signaled
+// to the client again from tick processing.  Normally the client calls
+// USBDBulkRxResume() as soon as it can accept the packet so this is only a
+// safety net.
 //
 //*****************************************************************************
-#define USB_BASE_TO_INDEX(BaseAddr) (0)
-#define USB_INDEX_TO_BASE(Index) (USB0_BASE)
+#define BULK_RX_RETRY_MS            10
+
+//*****************************************************************************
+//
+// Flags that may appear in the tBulkInstance ulFlags field to indicate that
+// a uDMA transfer is in progress on an endpoint.
+//
+//*****************************************************************************
+#define BULK_FLAG_DMA_IN            0x00000001
+#define BULK_FLAG_DMA_OUT           0x00000002
+
+//*****************************************************************************
+//
+// The value used in the ucINDMA and ucOUTDMA fields of tBulkInstance to
+// indicate that the endpoint has no uDMA channel and the CPU must be used to
+// access its FIFO.  Dedicated uDMA channels exist only for endpoints 1 to 3.
+//
+//*****************************************************************************
+#define BULK_DMA_CHANNEL_NONE       0xff
+#define BULK_MAX_DMA_ENDPOINT       3
 
 //*****************************************************************************
 //
@@ -150,7 +172,9 @@ unsigned char g_pBulkDescriptor[] =
 //*****************************************************************************
 //
 // The remainder of the configuration descriptor is stored in flash since we
-// don't need to modify anything in it at runtime.
+// don't need to modify anything in it at runtime.  The number of endpoints in
+// the interface descriptor is changed in each instance's copy if the client
+// requests more than one endpoint pair.
 //
 //*****************************************************************************
 const unsigned char g_pBulkInterface[] =
@@ -191,11 +215,24 @@ const unsigned char g_pBulkInterface[] =
     0,                               // The polling interval for this endpoint.
 };
 
+//
+// The offset of the bNumEndpoints field in g_pBulkInterface.
+//
+#define BULK_IFACE_NUM_EPS      4
+
+//
+// The offset of the first endpoint pair's descriptors in g_pBulkInterface.
+//
+#define BULK_IFACE_EP_OFFSET    9
+
 //*****************************************************************************
 //
 // The serial config descriptor is defined as two sections, one containing
 // just the 9 byte USB configuration descriptor and the other containing
-// everything else that is sent to the host along with it.
+// everything else that is sent to the host along with it.  Each instance
+// builds its own copy of these sections in USBDBulkCompositeInit(), adding a
+// third section holding the additional endpoint pairs if the client requests
+// more than one pair.
 //
 //*****************************************************************************
 const tConfigSection g_sBulkConfigSection =
@@ -260,6 +297,7 @@ static void HandleSuspend(void *pvInstance);
 static void HandleResume(void *pvInstance);
 static void HandleDevice(void *pvInstance, unsigned long ulRequest,
                          void *pvRequestData);
+static void HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest);
 
 //*****************************************************************************
 //
@@ -273,7 +311,7 @@ tDeviceInfo g_sBulkDeviceInfo =
     //
     {
         0,                     // GetDescriptor
-        0,                     // RequestHandler
+        HandleRequests,        // RequestHandler
         0,                     // InterfaceChange
         HandleConfigChange,    // ConfigChange
         0,                     // DataReceived
@@ -320,271 +358,1048 @@ SetDeferredOpFlag(volatile unsigned short *pusDeferredOp, unsigned short usBit,
 
 //*****************************************************************************
 //
-// Receives notifications related to data received from the host.
+// Returns the device structure describing one of the endpoint pairs offered
+// by a bulk device.  Pair 0 is described by the main device structure itself
+// and pairs 1 onwards by the entries of its ppsPipes array.
 //
-// \param psDevice is the device instance whose endpoint is to be processed.
-// \param ulStatus is the USB interrupt status that caused this function to
-// be called.
+// \param psDevice points to the main bulk device structure.
+// \param ulPipe is the index of the endpoint pair whose device structure is
+// required.  This must not be greater than psDevice->ulNumPipes.
 //
-// This function is called from HandleEndpoints for all interrupts signaling
-// the arrival of data on the bulk OUT endpoint (in other words, whenever the
-// host has sent us a packet of data).  We inform the client that a packet
-// is available and, on return, check to see if the packet has been read.  If
-// not, we schedule another notification to the client for a later time.
+// \return Returns a pointer to the device structure for the endpoint pair.
 //
-// \return Returns \b true on success or \b false on failure.
+//*****************************************************************************
+static const tUSBDBulkDevice *
+BulkPipeGet(const tUSBDBulkDevice *psDevice, unsigned long ulPipe)
+{
+    if(ulPipe == 0)
+    {
+        return(psDevice);
+    }
+
+    ASSERT(ulPipe <= psDevice->ulNumPipes);
+
+    return(psDevice->ppsPipes[ulPipe - 1]);
+}
+
+//*****************************************************************************
+//
+// The buffer from which a statistics snapshot is sent to the host in response
+// to a USBD_BULK_REQ_STATS_GET request.
 //
 //*****************************************************************************
-static tBoolean
-ProcessDataFromHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
+static tUSBDBulkStats g_sBulkStatsReport;
+
+//*****************************************************************************
+//
+// Clears the statistics gathered for an endpoint pair.
+//
+// \param psInst points to the instance data for the endpoint pair.
+//
+// This function must not be interrupted by the USB interrupt handler, which
+// also updates the statistics.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BulkStatsClear(tBulkInstance *psInst)
 {
-    unsigned long ulEPStatus;
-    unsigned long ulSize;
-    tBulkInstance *psInst;
+    psInst->sStats.ulTxPackets = 0;
+    psInst->sStats.ulTxBytes = 0;
+    psInst->sStats.ulTxZLPs = 0;
+    psInst->sStats.ulTxBusy = 0;
+    psInst->sStats.ulRxPackets = 0;
+    psInst->sStats.ulRxBytes = 0;
+    psInst->sStats.ulRxDeferred = 0;
+    psInst->sStats.ulRxErrors = 0;
+    psInst->sStats.ulRxErrorFlags = 0;
+    psInst->sStats.ulLatencyCount = 0;
+    psInst->sStats.ulLatencyMin = 0xffffffff;
+    psInst->sStats.ulLatencyAvg = 0;
+    psInst->sStats.ulLatencyMax = 0;
+    psInst->ulLatencyTotal = 0;
+}
 
-    //
-    // Get a pointer to our instance data.
-    //
-    psInst = psDevice->psPrivateBulkData;
+//*****************************************************************************
+//
+// Records a packet received from the host in the statistics.
+//
+//*****************************************************************************
+static void
+BulkStatsRxPacket(tBulkInstance *psInst, unsigned long ulSize)
+{
+    psInst->sStats.ulRxPackets++;
+    psInst->sStats.ulRxBytes += ulSize;
+}
 
-    //
-    // Get the endpoint status to see why we were called.
-    //
-    ulEPStatus = MAP_USBEndpointStatus(USB0_BASE, psInst->ucOUTEndpoint);
+//*****************************************************************************
+//
+// Records the time between entry to our interrupt handling and a callback to
+// the client.  This is called immediately before the callback is made.
+//
+//*****************************************************************************
+static void
+BulkStatsLatency(tBulkInstance *psInst)
+{
+    unsigned long ulLatency;
 
     //
-    // Clear the status bits.
+    // Nothing can be measured without a counter.
     //
-    MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucOUTEndpoint, ulEPStatus);
+    if(!psInst->pfnCounter)
+    {
+        return;
+    }
 
-    //
-    // Has a packet been received?
-    //
-    if(ulEPStatus & USB_DEV_RX_PKT_RDY)
+    ulLatency = psInst->pfnCounter() - psInst->ulISRTime;
+
+    if(ulLatency < psInst->sStats.ulLatencyMin)
     {
-        //
-        // Set the flag we use to indicate that a packet read is pending.  This
-        // will be cleared if the packet is read.  If the client doesn't read
-        // the packet in the context of the USB_EVENT_RX_AVAILABLE callback,
-        // the event will be signaled later during tick processing.
-        //
-        SetDeferredOpFlag(&psInst->usDeferredOpFlags, BULK_DO_PACKET_RX, true);
+        psInst->sStats.ulLatencyMin = ulLatency;
+    }
+    if(ulLatency > psInst->sStats.ulLatencyMax)
+    {
+        psInst->sStats.ulLatencyMax = ulLatency;
+    }
+    psInst->ulLatencyTotal += ulLatency;
+    psInst->sStats.ulLatencyCount++;
+}
 
-        //
-        // How big is the packet we've just been sent?
-        //
-        ulSize = MAP_USBEndpointDataAvail(psInst->ulUSBBase,
-                                          psInst->ucOUTEndpoint);
+//*****************************************************************************
+//
+// Takes a consistent snapshot of the statistics for an endpoint pair.
+//
+//*****************************************************************************
+static void
+BulkStatsSnapshot(tBulkInstance *psInst, tUSBDBulkStats *psStats)
+{
+    tBoolean bIntsOff;
 
-        //
-        // The receive channel is not blocked so let the caller know
-        // that a packet is waiting.  The parameters are set to indicate
-        // that the packet has not been read from the hardware FIFO yet.
-        //
-        psDevice->pfnRxCallback(psDevice->pvRxCBData,
-                                USB_EVENT_RX_AVAILABLE, ulSize,
-                                (void *)0);
+    //
+    // The statistics are updated by the USB interrupt handler so make sure
+    // that they do not change while we copy them.
+    //
+    bIntsOff = IntMasterDisable();
+
+    *psStats = psInst->sStats;
+    if(psStats->ulLatencyCount)
+    {
+        psStats->ulLatencyAvg = psInst->ulLatencyTotal /
+                                psStats->ulLatencyCount;
     }
     else
     {
-        //
-        // No packet was received.  Some error must have been reported.  Check
-        // and pass this on to the client if necessary.
-        //
-        if(ulEPStatus & USB_RX_ERROR_FLAGS)
-        {
-            //
-            // This is an error we report to the client so...
-            //
-            psDevice->pfnRxCallback(psDevice->pvRxCBData,
-                                    USB_EVENT_ERROR,
-                                    (ulEPStatus & USB_RX_ERROR_FLAGS),
-                                    (void *)0);
-        }
-        return(false);
+        psStats->ulLatencyMin = 0;
     }
 
-    return(true);
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
 }
 
 //*****************************************************************************
 //
-// Receives notifications related to data sent to the host.
+// Assigns uDMA channels to the bulk endpoints if the client has requested
+// uDMA operation.
 //
-// \param psDevice is the device instance whose endpoint is to be processed.
-// \param ulStatus is the USB interrupt status that caused this function to
-// be called.
+// \param psDevice points to the bulk device whose endpoints are to be
+// assigned uDMA channels.
 //
-// This function is called from HandleEndpoints for all interrupts originating
-// from the bulk IN endpoint (in other words, whenever data has been
-// transmitted to the USB host).  We examine the cause of the interrupt and,
-// if due to completion of a transmission, notify the client.
+// This function is called whenever the endpoints used by the device are set
+// or changed.  Any endpoint for which no uDMA channel is available is marked
+// so that the CPU will be used to access its FIFO instead.
 //
-// \return Returns \b true on success or \b false on failure.
+// \return None.
 //
 //*****************************************************************************
-static tBoolean
-ProcessDataToHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
+static void
+BulkDMAChannelsAssign(const tUSBDBulkDevice *psDevice)
 {
     tBulkInstance *psInst;
-    unsigned long ulEPStatus;
-    unsigned long ulSize;
+    unsigned long ulIndex;
 
     //
     // Get a pointer to our instance data.
     //
     psInst = psDevice->psPrivateBulkData;
 
+    psInst->ucINDMA = BULK_DMA_CHANNEL_NONE;
+    psInst->ucOUTDMA = BULK_DMA_CHANNEL_NONE;
+
     //
-    // Get the endpoint status to see why we were called.
+    // If the client has not asked for uDMA, there is nothing else to do.
     //
-    ulEPStatus = MAP_USBEndpointStatus(psInst->ulUSBBase, psInst->ucINEndpoint);
+    if(!(psDevice->ulFlags & USBD_BULK_FLAG_DMA))
+    {
+        return;
+    }
 
     //
-    // Clear the status bits.
+    // Select the channel for the IN endpoint if it has one.  This only
+    // affects the endpoint on devices that have this feature.
     //
-    MAP_USBDevEndpointStatusClear(psInst->ulUSBBase, psInst->ucINEndpoint,
-                                  ulEPStatus);
+    ulIndex = USB_EP_TO_INDEX(psInst->ucINEndpoint);
+    if((ulIndex >= 1) && (ulIndex <= BULK_MAX_DMA_ENDPOINT))
+    {
+        psInst->ucINDMA = UDMA_CHANNEL_USBEP1TX + ((ulIndex - 1) * 2);
+        MAP_USBEndpointDMAChannel(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                  psInst->ucINDMA);
+    }
 
     //
-    // Our last transmission completed.  Clear our state back to idle and
-    // see if we need to send any more data.
+    // Select the channel for the OUT endpoint if it has one.
     //
-    psInst->eBulkTxState = BULK_STATE_IDLE;
+    ulIndex = USB_EP_TO_INDEX(psInst->ucOUTEndpoint);
+    if((ulIndex >= 1) && (ulIndex <= BULK_MAX_DMA_ENDPOINT))
+    {
+        psInst->ucOUTDMA = UDMA_CHANNEL_USBEP1RX + ((ulIndex - 1) * 2);
+        MAP_USBEndpointDMAChannel(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                  psInst->ucOUTDMA);
+    }
+}
 
+//*****************************************************************************
+//
+// Queues a packet which has been loaded into the IN endpoint FIFO and
+// schedules its transmission.
+//
+// \param psInst points to the instance data for the device.
+//
+// \return Returns -1 on failure or any other value on success.
+//
+//*****************************************************************************
+static long
+BulkTxPacketSend(tBulkInstance *psInst)
+{
     //
-    // Notify the client that the last transmission completed.
+    // Add the packet to our transmit queue before sending it since the
+    // completion interrupt may occur immediately.  If the FIFO is now full,
+    // we must wait for a packet to be sent before accepting another.
     //
-    ulSize = psInst->usLastTxSize;
+    psInst->usTxPacketSize[psInst->ucTxPackets] = psInst->usLastTxSize;
     psInst->usLastTxSize = 0;
-    psDevice->pfnTxCallback(psDevice->pvTxCBData, USB_EVENT_TX_COMPLETE,
-                            ulSize, (void *)0);
+    psInst->ucTxPackets++;
+    psInst->eBulkTxState = (psInst->ucTxPackets >= psInst->ucTxDepth) ?
+                           BULK_STATE_WAIT_DATA : BULK_STATE_IDLE;
 
-    return(true);
+    //
+    // Send the packet to the host.
+    //
+    return(MAP_USBEndpointDataSend(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                   USB_TRANS_IN));
 }
 
 //*****************************************************************************
 //
-// Called by the USB stack for any activity involving one of our endpoints
-// other than EP0.  This function is a fan out that merely directs the call to
-// the correct handler depending upon the endpoint and transaction direction
-// signaled in ulStatus.
+// Checks for and handles completion of uDMA transfers on the bulk endpoints.
+//
+// \param psDevice points to the bulk device instance.
+//
+// This function is called on every USB interrupt since completion of a uDMA
+// transfer for a USB endpoint is signaled via the USB interrupt.  When the
+// IN endpoint FIFO has been loaded, the packet is sent.  When a packet has
+// been read from the OUT endpoint FIFO, it is acknowledged and passed to the
+// client.
+//
+// \return None.
 //
 //*****************************************************************************
 static void
-HandleEndpoints(void *pvInstance, unsigned long ulStatus)
+BulkDMAHandler(const tUSBDBulkDevice *psDevice)
 {
-    const tUSBDBulkDevice *psBulkInst;
     tBulkInstance *psInst;
 
-    ASSERT(pvInstance != 0);
-
     //
-    // Determine if the serial device is in single or composite mode because
-    // the meaning of ulIndex is different in both cases.
+    // Get a pointer to our instance data.
     //
-    psBulkInst = (const tUSBDBulkDevice *)pvInstance;
-    psInst = psBulkInst->psPrivateBulkData;
+    psInst = psDevice->psPrivateBulkData;
 
     //
-    // Handler for the bulk OUT data endpoint.
+    // Has the uDMA controller finished loading a packet into the IN FIFO?
     //
-    if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+    if((psInst->ulFlags & BULK_FLAG_DMA_IN) &&
+       (MAP_uDMAChannelModeGet(psInst->ucINDMA) == UDMA_MODE_STOP))
     {
         //
-        // Data is being sent to us from the host.
+        // Disable uDMA on the endpoint and send the packet.
         //
-        ProcessDataFromHost(pvInstance, ulStatus);
+        psInst->ulFlags &= ~BULK_FLAG_DMA_IN;
+        MAP_USBEndpointDMADisable(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                  USB_EP_DEV_IN);
+        BulkTxPacketSend(psInst);
     }
 
     //
-    // Handler for the bulk IN data endpoint.
+    // Has the uDMA controller finished reading a packet from the OUT FIFO?
     //
-    if(ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucINEndpoint)))
+    if((psInst->ulFlags & BULK_FLAG_DMA_OUT) &&
+       (MAP_uDMAChannelModeGet(psInst->ucOUTDMA) == UDMA_MODE_STOP))
     {
-        ProcessDataToHost(pvInstance, ulStatus);
+        //
+        // Disable uDMA on the endpoint and acknowledge the data, thus
+        // freeing the host to send the next packet.
+        //
+        psInst->ulFlags &= ~BULK_FLAG_DMA_OUT;
+        MAP_USBEndpointDMADisable(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                  USB_EP_DEV_OUT);
+        MAP_USBDevEndpointDataAck(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                  true);
+        psInst->ulRxDirectCount++;
+        BulkStatsRxPacket(psInst, psInst->ulRxDMASize);
+
+        //
+        // Let the client know that the packet is now in its buffer.
+        //
+        BulkStatsLatency(psInst);
+        psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_RX_AVAILABLE,
+                                psInst->ulRxDMASize, psInst->pucRxDMABuffer);
     }
 }
 
 //*****************************************************************************
 //
-// Called by the USB stack whenever a configuration change occurs.
+// Passes as much of the current transmit transfer as possible to the IN
+// endpoint.
+//
+// \param pvInstance points to the bulk device instance.
+//
+// This function is called when a transmit transfer is started and each time
+// a packet from the transfer has been sent.  It splits the remaining data
+// into packets and queues them for as long as the endpoint can accept them,
+// following the last with a zero-length packet if the transfer size is a
+// multiple of the maximum packet size.
+//
+// \return None.
 //
 //*****************************************************************************
 static void
-HandleConfigChange(void *pvInstance, unsigned long ulInfo)
+BulkTxXferFill(void *pvInstance)
 {
     tBulkInstance *psInst;
-    const tUSBDBulkDevice *psDevice;
-
-    ASSERT(pvInstance != 0);
-
-    //
-    // Create a device instance pointer.
-    //
-    psDevice = (const tUSBDBulkDevice *)pvInstance;
+    unsigned long ulPacket;
 
     //
     // Get a pointer to our instance data.
     //
-    psInst = psDevice->psPrivateBulkData;
-
-    //
-    // Set all our endpoints to idle state.
-    //
-    psInst->eBulkRxState = BULK_STATE_IDLE;
-    psInst->eBulkTxState = BULK_STATE_IDLE;
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
 
-    //
-    // If we have a control callback, let the client know we are open for
-    // business.
-    //
-    if(psDevice->pfnRxCallback)
+    while(psInst->pucTxXfer && USBDBulkTxPacketAvailable(pvInstance))
     {
         //
-        // Pass the connected event to the client.
+        // How much of the transfer remains to be sent?
         //
-        psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_CONNECTED, 0,
-                                (void *)0);
-    }
+        ulPacket = psInst->ulTxXferSize - psInst->ulTxXferSent;
 
-    //
-    // Remember that we are connected.
-    //
-    psInst->bConnected = true;
+        if(ulPacket)
+        {
+            //
+            // Send the next packet.
+            //
+            ulPacket = (ulPacket > DATA_IN_EP_MAX_SIZE) ? DATA_IN_EP_MAX_SIZE :
+                       ulPacket;
+            if(!USBDBulkPacketWrite(pvInstance,
+                                    psInst->pucTxXfer + psInst->ulTxXferSent,
+                                    ulPacket, true))
+            {
+                break;
+            }
+            psInst->ulTxXferSent += ulPacket;
+        }
+        else if(psInst->bTxXferZLP)
+        {
+            //
+            // All the data has been queued so terminate the transfer with a
+            // zero-length packet.
+            //
+            psInst->bTxXferZLP = false;
+            BulkTxPacketSend(psInst);
+        }
+        else
+        {
+            //
+            // The whole transfer has been queued.
+            //
+            break;
+        }
+    }
 }
 
 //*****************************************************************************
 //
-// Device instance specific handler.
+// Completes the current receive transfer and passes it to the client.
+//
+// \param psDevice points to the bulk device instance.
+//
+// \return None.
 //
 //*****************************************************************************
 static void
-HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
+BulkRxXferComplete(const tUSBDBulkDevice *psDevice)
 {
     tBulkInstance *psInst;
     unsigned char *pucData;
 
     //
-    // Create the serial instance data.
+    // Get a pointer to our instance data.
     //
-    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+    psInst = psDevice->psPrivateBulkData;
 
     //
-    // Create the char array used by the events supported by the USB CDC
-    // serial class.
+    // Mark the transfer as complete before notifying the client so that it
+    // can start another transfer from within the callback.
     //
-    pucData = (unsigned char *)pvRequestData;
+    pucData = psInst->pucRxXfer;
+    psInst->pucRxXfer = (unsigned char *)0;
+    psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_RX_AVAILABLE,
+                            psInst->ulRxXferCount, pucData);
+}
 
-    switch(ulRequest)
-    {
-        //
-        // This was an interface change event.
-        //
-        case USB_EVENT_COMP_IFACE_CHANGE:
-        {
-            psInst->ucInterface = pucData[1];
-            break;
+//*****************************************************************************
+//
+// Reads a received packet into the buffer for the current receive transfer.
+//
+// \param psDevice points to the bulk device instance.
+// \param ulSize is the size of the packet waiting in the OUT endpoint FIFO.
+//
+// This function reads the packet waiting in the OUT endpoint FIFO into the
+// transfer buffer.  The transfer completes if the packet is short or the
+// buffer is full.  If the packet is too large for the space remaining in the
+// buffer, the transfer completes without reading it.
+//
+// \return Returns \b true if the packet was read or \b false if it remains
+// in the FIFO.
+//
+//*****************************************************************************
+static tBoolean
+BulkRxXferPacket(const tUSBDBulkDevice *psDevice, unsigned long ulSize)
+{
+    tBulkInstance *psInst;
+    unsigned long ulCount;
+
+    //
+    // Get a pointer to our instance data.
+    //
+    psInst = psDevice->psPrivateBulkData;
+
+    //
+    // If the packet will not fit in the space remaining, end the transfer
+    // here and leave the packet for the normal receive path.
+    //
+    if(ulSize > (psInst->ulRxXferSize - psInst->ulRxXferCount))
+    {
+        BulkRxXferComplete(psDevice);
+        return(false);
+    }
+
+    //
+    // Read the packet into the transfer buffer and acknowledge it, freeing
+    // the host to send the next packet.
+    //
+    ulCount = ulSize;
+    MAP_USBEndpointDataGet(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                           psInst->pucRxXfer + psInst->ulRxXferCount,
+                           &ulCount);
+    MAP_USBDevEndpointDataAck(psInst->ulUSBBase, psInst->ucOUTEndpoint, true);
+    SetDeferredOpFlag(&psInst->usDeferredOpFlags, BULK_DO_PACKET_RX, false);
+    BulkStatsRxPacket(psInst, ulCount);
+    psInst->ulRxXferCount += ulCount;
+
+    //
+    // A short packet or a full buffer ends the transfer.
+    //
+    if((ulCount < DATA_OUT_EP_MAX_SIZE) ||
+       (psInst->ulRxXferCount == psInst->ulRxXferSize))
+    {
+        BulkRxXferComplete(psDevice);
+    }
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Signals a packet whose reception was previously deferred to the client
+// again.
+//
+// \param psDevice points to the bulk device instance.
+//
+// This function is called when the client resumes reception and from tick
+// processing.  If the client has since started a receive transfer, the
+// packet is read into it, otherwise the client is sent another
+// USB_EVENT_RX_AVAILABLE event.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BulkRxDeferredNotify(const tUSBDBulkDevice *psDevice)
+{
+    tBulkInstance *psInst;
+    unsigned long ulSize;
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = psDevice->psPrivateBulkData;
+    psInst->ulRxRetrymS = 0;
+
+    //
+    // How big is the waiting packet?
+    //
+    ulSize = MAP_USBEndpointDataAvail(psInst->ulUSBBase,
+                                      psInst->ucOUTEndpoint);
+
+    //
+    // If the client has since started a receive transfer, read the packet
+    // into it.
+    //
+    if(psInst->pucRxXfer && BulkRxXferPacket(psDevice, ulSize))
+    {
+        return;
+    }
+
+    //
+    // Tell the client that there is a packet waiting for it.
+    //
+    psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_RX_AVAILABLE,
+                            ulSize, (void *)0);
+}
+
+//*****************************************************************************
+//
+// Receives notifications related to data received from the host.
+//
+// \param psDevice is the device instance whose endpoint is to be processed.
+// \param ulStatus is the USB interrupt status that caused this function to
+// be called.
+//
+// This function is called from HandleEndpoints for all interrupts signaling
+// the arrival of data on the bulk OUT endpoint (in other words, whenever the
+// host has sent us a packet of data).  We inform the client that a packet
+// is available and, on return, check to see if the packet has been read.  If
+// not, we schedule another notification to the client for a later time.
+//
+// \return Returns \b true on success or \b false on failure.
+//
+//*****************************************************************************
+static tBoolean
+ProcessDataFromHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
+{
+    unsigned long ulEPStatus;
+    unsigned long ulSize, ulCount;
+    unsigned char *pucBuffer;
+    tBulkInstance *psInst;
+
+    //
+    // Get a pointer to our instance data.
+    //
+    psInst = psDevice->psPrivateBulkData;
+
+    //
+    // Get the endpoint status to see why we were called.
+    //
+    ulEPStatus = MAP_USBEndpointStatus(psInst->ulUSBBase,
+                                       psInst->ucOUTEndpoint);
+
+    //
+    // Clear the status bits.
+    //
+    MAP_USBDevEndpointStatusClear(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                  ulEPStatus);
+
+    //
+    // Has a packet been received?
+    //
+    if(ulEPStatus & USB_DEV_RX_PKT_RDY)
+    {
+        //
+        // How big is the packet we've just been sent?
+        //
+        ulSize = MAP_USBEndpointDataAvail(psInst->ulUSBBase,
+                                          psInst->ucOUTEndpoint);
+
+        //
+        // If a receive transfer is in progress, read the packet into it.
+        //
+        if(psInst->pucRxXfer && BulkRxXferPacket(psDevice, ulSize))
+        {
+            return(true);
+        }
+
+        //
+        // Ask the client for a buffer large enough to hold the whole packet.
+        // Clients which do not handle this event return 0.
+        //
+        pucBuffer = (unsigned char *)0;
+        if(ulSize &&
+           (psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                                    USB_EVENT_REQUEST_BUFFER, ulSize,
+                                    &pucBuffer) >= ulSize) && pucBuffer)
+        {
+            //
+            // If we have a uDMA channel for the endpoint, have the uDMA
+            // controller read the packet into the buffer.  We pass the
+            // packet to the client once the transfer completes.
+            //
+            if(psInst->ucOUTDMA != BULK_DMA_CHANNEL_NONE)
+            {
+                psInst->pucRxDMABuffer = pucBuffer;
+                psInst->ulRxDMASize = ulSize;
+                psInst->ulFlags |= BULK_FLAG_DMA_OUT;
+                MAP_uDMAChannelControlSet(psInst->ucOUTDMA,
+                                          (UDMA_SIZE_8 | UDMA_SRC_INC_NONE |
+                                           UDMA_DST_INC_8 | UDMA_ARB_64));
+                MAP_uDMAChannelTransferSet(psInst->ucOUTDMA, UDMA_MODE_BASIC,
+                                           (void *)USBFIFOAddrGet(
+                                               psInst->ulUSBBase,
+                                               psInst->ucOUTEndpoint),
+                                           pucBuffer, ulSize);
+                MAP_USBEndpointDMAEnable(psInst->ulUSBBase,
+                                         psInst->ucOUTEndpoint,
+                                         USB_EP_DEV_OUT);
+                MAP_uDMAChannelEnable(psInst->ucOUTDMA);
+                return(true);
+            }
+
+            //
+            // We were given a buffer so read the packet straight into it
+            // and acknowledge it, freeing the host to send the next packet.
+            //
+            ulCount = ulSize;
+            MAP_USBEndpointDataGet(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                   pucBuffer, &ulCount);
+            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                      true);
+            psInst->ulRxDirectCount++;
+            BulkStatsRxPacket(psInst, ulCount);
+
+            //
+            // Let the client know that the packet is now in its buffer.
+            //
+            BulkStatsLatency(psInst);
+            psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                                    USB_EVENT_RX_AVAILABLE, ulCount,
+                                    pucBuffer);
+        }
+        else
+        {
+            //
+            // Set the flag we use to indicate that a packet read is pending.
+            // This will be cleared if the packet is read.  If the client
+            // doesn't read the packet in the context of the
+            // USB_EVENT_RX_AVAILABLE callback, the event will be signaled
+            // again when the client calls USBDBulkRxResume() or, failing
+            // that, during tick processing.
+            //
+            SetDeferredOpFlag(&psInst->usDeferredOpFlags, BULK_DO_PACKET_RX,
+                              true);
+            psInst->ulRxIndirectCount++;
+            psInst->ulRxRetrymS = 0;
+
+            //
+            // The receive channel is not blocked so let the caller know
+            // that a packet is waiting.  The parameters are set to indicate
+            // that the packet has not been read from the hardware FIFO yet.
+            //
+            BulkStatsLatency(psInst);
+            psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                                    USB_EVENT_RX_AVAILABLE, ulSize,
+                                    (void *)0);
+
+            //
+            // If the client did not read the packet, the host is NAKed until
+            // it does so count this as a deferred packet.
+            //
+            if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+            {
+                psInst->sStats.ulRxDeferred++;
+            }
+        }
+    }
+    else
+    {
+        //
+        // No packet was received.  Some error must have been reported.  Check
+        // and pass this on to the client if necessary.
+        //
+        if(ulEPStatus & USB_RX_ERROR_FLAGS)
+        {
+            psInst->sStats.ulRxErrors++;
+            psInst->sStats.ulRxErrorFlags |= ulEPStatus & USB_RX_ERROR_FLAGS;
+
+            //
+            // This is an error we report to the client so...
+            //
+            psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                                    USB_EVENT_ERROR,
+                                    (ulEPStatus & USB_RX_ERROR_FLAGS),
+                                    (void *)0);
+        }
+        return(false);
+    }
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Receives notifications related to data sent to the host.
+//
+// \param psDevice is the device instance whose endpoint is to be processed.
+// \param ulStatus is the USB interrupt status that caused this function to
+// be called.
+//
+// This function is called from HandleEndpoints for all interrupts originating
+// from the bulk IN endpoint (in other words, whenever data has been
+// transmitted to the USB host).  We examine the cause of the interrupt and,
+// if due to completion of a transmission, notify the client.
+//
+// \return Returns \b true on success or \b false on failure.
+//
+//*****************************************************************************
+static tBoolean
+ProcessDataToHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
+{
+    tBulkInstance *psInst;
+    unsigned long ulEPStatus;
+    unsigned long ulSize, ulPending;
+    unsigned char *pucData;
+
+    //
+    // Get a pointer to our instance data.
+    //
+    psInst = psDevice->psPrivateBulkData;
+
+    //
+    // Get the endpoint status to see why we were called.
+    //
+    ulEPStatus = MAP_USBEndpointStatus(psInst->ulUSBBase, psInst->ucINEndpoint);
+
+    //
+    // Clear the status bits.
+    //
+    MAP_USBDevEndpointStatusClear(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                  ulEPStatus);
+
+    //
+    // Work out how many of our queued packets are still in the FIFO.  With a
+    // single-buffered FIFO, this interrupt means that the only packet has
+    // been sent.  With a double-buffered FIFO, the interrupt occurs whenever
+    // a FIFO buffer becomes free so one or both packets may remain.
+    //
+    if(psInst->ucTxDepth > 1)
+    {
+        ulPending = (ulEPStatus & USB_DEV_TX_TXPKTRDY) ? 2 :
+                    ((ulEPStatus & USB_DEV_TX_FIFO_NE) ? 1 : 0);
+    }
+    else
+    {
+        ulPending = 0;
+    }
+
+    //
+    // Retire each packet which has been sent, totaling up the number of bytes
+    // they contained.
+    //
+    ulSize = 0;
+    while(psInst->ucTxPackets > ulPending)
+    {
+        psInst->sStats.ulTxPackets++;
+        psInst->sStats.ulTxBytes += psInst->usTxPacketSize[0];
+        if(!psInst->usTxPacketSize[0])
+        {
+            psInst->sStats.ulTxZLPs++;
+        }
+        ulSize += psInst->usTxPacketSize[0];
+        psInst->usTxPacketSize[0] = psInst->usTxPacketSize[1];
+        psInst->ucTxPackets--;
+    }
+
+    //
+    // If there is now space in the FIFO for another packet and the uDMA
+    // controller is not still loading one, clear our state back to idle.
+    //
+    if((psInst->ucTxPackets < psInst->ucTxDepth) &&
+       !(psInst->ulFlags & BULK_FLAG_DMA_IN))
+    {
+        psInst->eBulkTxState = BULK_STATE_IDLE;
+    }
+
+    //
+    // If a transmit transfer is in progress, the client is notified only
+    // once the whole transfer has been sent.
+    //
+    if(psInst->pucTxXfer)
+    {
+        if((psInst->ulTxXferSent == psInst->ulTxXferSize) &&
+           !psInst->bTxXferZLP && !psInst->ucTxPackets &&
+           !(psInst->ulFlags & BULK_FLAG_DMA_IN))
+        {
+            //
+            // The transfer is complete.
+            //
+            pucData = psInst->pucTxXfer;
+            psInst->pucTxXfer = (unsigned char *)0;
+            BulkStatsLatency(psInst);
+            psDevice->pfnTxCallback(psDevice->pvTxCBData,
+                                    USB_EVENT_TX_COMPLETE,
+                                    psInst->ulTxXferSize, pucData);
+        }
+        else
+        {
+            //
+            // Send more of the transfer.
+            //
+            BulkTxXferFill((void *)psDevice);
+        }
+        return(true);
+    }
+
+    //
+    // Notify the client of the number of bytes transmitted.  This may be 0
+    // if space has become available in a double-buffered FIFO but no packet
+    // has yet been sent, in which case the client may queue another packet.
+    //
+    BulkStatsLatency(psInst);
+    psDevice->pfnTxCallback(psDevice->pvTxCBData, USB_EVENT_TX_COMPLETE,
+                            ulSize, (void *)0);
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Called by the USB stack for any activity involving one of our endpoints
+// other than EP0.  This function is a fan out that merely directs the call to
+// the correct handler depending upon the endpoint and transaction direction
+// signaled in ulStatus.
+//
+//*****************************************************************************
+static void
+HandleEndpoints(void *pvInstance, unsigned long ulStatus)
+{
+    const tUSBDBulkDevice *psDevice;
+    const tUSBDBulkDevice *psBulkInst;
+    tBulkInstance *psInst;
+    unsigned long ulPipe;
+
+    ASSERT(pvInstance != 0);
+
+    //
+    // Determine if the serial device is in single or composite mode because
+    // the meaning of ulIndex is different in both cases.
+    //
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    //
+    // Each endpoint pair is handled independently using its own instance
+    // data and callbacks.
+    //
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        psBulkInst = BulkPipeGet(psDevice, ulPipe);
+        psInst = psBulkInst->psPrivateBulkData;
+
+        //
+        // Note when we started handling the interrupt so that we can measure
+        // how long it takes to notify the client.
+        //
+        if(psInst->pfnCounter)
+        {
+            psInst->ulISRTime = psInst->pfnCounter();
+        }
+
+        //
+        // Handle completion of any uDMA transfers.
+        //
+        if(psInst->ulFlags & (BULK_FLAG_DMA_IN | BULK_FLAG_DMA_OUT))
+        {
+            BulkDMAHandler(psBulkInst);
+        }
+
+        //
+        // If the client has asked for a deferred receive to be resumed,
+        // signal the waiting packet to it again.
+        //
+        if(psInst->bRxResume)
+        {
+            psInst->bRxResume = false;
+            if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+            {
+                BulkRxDeferredNotify(psBulkInst);
+            }
+        }
+
+        //
+        // Handler for the bulk OUT data endpoint.
+        //
+        if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+        {
+            //
+            // Data is being sent to us from the host.
+            //
+            ProcessDataFromHost(psBulkInst, ulStatus);
+        }
+
+        //
+        // Handler for the bulk IN data endpoint.
+        //
+        if(ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucINEndpoint)))
+        {
+            ProcessDataToHost(psBulkInst, ulStatus);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Resets the state of one endpoint pair following a configuration change and
+// informs its client that the device is now connected.
+//
+// \param psDevice points to the device structure for the endpoint pair.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BulkPipeConfigure(const tUSBDBulkDevice *psDevice)
+{
+    tBulkInstance *psInst;
+
+    //
+    // Get a pointer to our instance data.
+    //
+    psInst = psDevice->psPrivateBulkData;
+
+    //
+    // Set all our endpoints to idle state.
+    //
+    psInst->eBulkRxState = BULK_STATE_IDLE;
+    psInst->eBulkTxState = BULK_STATE_IDLE;
+    psInst->usLastTxSize = 0;
+    psInst->ucTxPackets = 0;
+
+    //
+    // Make sure that no uDMA transfer remains from a previous configuration.
+    //
+    if(psInst->ucINDMA != BULK_DMA_CHANNEL_NONE)
+    {
+        MAP_uDMAChannelDisable(psInst->ucINDMA);
+        MAP_USBEndpointDMADisable(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                  USB_EP_DEV_IN);
+    }
+    if(psInst->ucOUTDMA != BULK_DMA_CHANNEL_NONE)
+    {
+        MAP_uDMAChannelDisable(psInst->ucOUTDMA);
+        MAP_USBEndpointDMADisable(psInst->ulUSBBase, psInst->ucOUTEndpoint,
+                                  USB_EP_DEV_OUT);
+    }
+    psInst->ulFlags = 0;
+    psInst->pucTxXfer = (unsigned char *)0;
+    psInst->pucRxXfer = (unsigned char *)0;
+
+    //
+    // Determine how many packets we can queue in the IN endpoint FIFO.
+    //
+    if(USBDCDEndpointDoubleBuffered(USB_BASE_TO_INDEX(psInst->ulUSBBase),
+                                    psInst->ucINEndpoint, USB_EP_DEV_IN))
+    {
+        psInst->ucTxDepth = BULK_MAX_TX_PACKETS;
+    }
+    else
+    {
+        psInst->ucTxDepth = 1;
+    }
+
+    //
+    // If we have a control callback, let the client know we are open for
+    // business.
+    //
+    if(psDevice->pfnRxCallback)
+    {
+        //
+        // Pass the connected event to the client.
+        //
+        psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_CONNECTED, 0,
+                                (void *)0);
+    }
+
+    //
+    // Remember that we are connected.
+    //
+    psInst->bConnected = true;
+}
+
+//*****************************************************************************
+//
+// Called by the USB stack whenever a configuration change occurs.
+//
+//*****************************************************************************
+static void
+HandleConfigChange(void *pvInstance, unsigned long ulInfo)
+{
+    const tUSBDBulkDevice *psDevice;
+    unsigned long ulPipe;
+
+    ASSERT(pvInstance != 0);
+
+    //
+    // Create a device instance pointer.
+    //
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    //
+    // Reset each of our endpoint pairs.
+    //
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        BulkPipeConfigure(BulkPipeGet(psDevice, ulPipe));
+    }
+}
+
+//*****************************************************************************
+//
+// Device instance specific handler.
+//
+//*****************************************************************************
+static void
+HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
+{
+    const tUSBDBulkDevice *psDevice;
+    const tUSBDBulkDevice *psPipe;
+    tBulkInstance *psInst;
+    unsigned char *pucData;
+    unsigned long ulPipe;
+
+    //
+    // Create the device instance pointer.
+    //
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    //
+    // Create the char array used by the events supported by the USB CDC
+    // serial class.
+    //
+    pucData = (unsigned char *)pvRequestData;
+
+    switch(ulRequest)
+    {
+        //
+        // This was an interface change event.
+        //
+        case USB_EVENT_COMP_IFACE_CHANGE:
+        {
+            //
+            // All endpoint pairs share the same interface.
+            //
+            for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+            {
+                psInst = BulkPipeGet(psDevice, ulPipe)->psPrivateBulkData;
+                psInst->ucInterface = pucData[1];
+            }
+            break;
         }
 
         //
@@ -592,6 +1407,19 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
         //
         case USB_EVENT_COMP_EP_CHANGE:
         {
+            //
+            // Determine which endpoint pair the endpoint belongs to from
+            // its original endpoint number.
+            //
+            ulPipe = ((unsigned long)pucData[0] & 0x7f) -
+                     USB_EP_TO_INDEX(DATA_IN_ENDPOINT);
+            if(ulPipe > psDevice->ulNumPipes)
+            {
+                break;
+            }
+            psPipe = BulkPipeGet(psDevice, ulPipe);
+            psInst = psPipe->psPrivateBulkData;
+
             //
             // Determine if this is an IN or OUT endpoint that has changed.
             //
@@ -606,6 +1434,11 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
                 //
                 psInst->ucOUTEndpoint = INDEX_TO_USB_EP(pucData[1] & 0x7f);
             }
+
+            //
+            // Select the uDMA channels for the new endpoints.
+            //
+            BulkDMAChannelsAssign(psPipe);
             break;
         }
         default:
@@ -617,45 +1450,161 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
 
 //*****************************************************************************
 //
-// This function is called by the USB device stack whenever the device is
-// disconnected from the host.
+// This function is called by the USB device stack whenever a non-standard
+// request is received.  The bulk device handles the vendor-specific
+// statistics requests and stalls anything else.
 //
 //*****************************************************************************
 static void
-HandleDisconnect(void *pvInstance)
+HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest)
 {
-    const tUSBDBulkDevice *psBulkDevice;
+    const tUSBDBulkDevice *psDevice;
     tBulkInstance *psInst;
+    unsigned long ulSize;
+    tBoolean bIntsOff;
 
     ASSERT(pvInstance != 0);
 
     //
-    // Create the instance pointer.
+    // Which device are we dealing with?
     //
-    psBulkDevice = (const tUSBDBulkDevice *)pvInstance;
+    psDevice = pvInstance;
 
     //
     // Get a pointer to our instance data.
     //
-    psInst = psBulkDevice->psPrivateBulkData;
+    psInst = psDevice->psPrivateBulkData;
+
+    //
+    // Make sure that this is a vendor request for this interface and that it
+    // refers to one of our endpoint pairs.
+    //
+    if(((pUSBRequest->bmRequestType & USB_RTYPE_TYPE_M) != USB_RTYPE_VENDOR) ||
+       (pUSBRequest->wIndex != psInst->ucInterface) ||
+       (pUSBRequest->wValue > psDevice->ulNumPipes))
+    {
+        USBDCDStallEP0(USB_BASE_TO_INDEX(psInst->ulUSBBase));
+        return;
+    }
 
     //
-    // If we are not currently connected so let the client know we are open
-    // for business.
+    // Get the instance data for the endpoint pair the request refers to.
     //
-    if(psInst->bConnected)
+    psInst = BulkPipeGet(psDevice, pUSBRequest->wValue)->psPrivateBulkData;
+
+    switch(pUSBRequest->bRequest)
     {
         //
-        // Pass the disconnected event to the client.
+        // The host wants to read the statistics for an endpoint pair.
         //
-        psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData,
-                                    USB_EVENT_DISCONNECTED, 0, (void *)0);
+        case USBD_BULK_REQ_STATS_GET:
+        {
+            //
+            // Need to ACK the data on end point 0 in this case.
+            //
+            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, true);
+
+            //
+            // Take a snapshot of the statistics and send back as much of it
+            // as the host asked for.
+            //
+            BulkStatsSnapshot(psInst, &g_sBulkStatsReport);
+            ulSize = sizeof(tUSBDBulkStats);
+            if(pUSBRequest->wLength < ulSize)
+            {
+                ulSize = pUSBRequest->wLength;
+            }
+            USBDCDSendDataEP0(USB_BASE_TO_INDEX(psInst->ulUSBBase),
+                              (unsigned char *)&g_sBulkStatsReport, ulSize);
+
+            break;
+        }
+
+        //
+        // The host wants to reset the statistics for an endpoint pair.
+        //
+        case USBD_BULK_REQ_STATS_RESET:
+        {
+            //
+            // Need to ACK the data on end point 0 in this case.
+            //
+            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, true);
+
+            //
+            // This request may be handled outside interrupt context if the
+            // application has deferred vendor requests so make sure that the
+            // interrupt handler does not update the statistics while they are
+            // cleared.
+            //
+            bIntsOff = IntMasterDisable();
+            BulkStatsClear(psInst);
+            if(!bIntsOff)
+            {
+                IntMasterEnable();
+            }
+
+            break;
+        }
+
+        //
+        // This request is not handled by this device.
+        //
+        default:
+        {
+            USBDCDStallEP0(USB_BASE_TO_INDEX(psInst->ulUSBBase));
+            break;
+        }
     }
+}
+
+//*****************************************************************************
+//
+// This function is called by the USB device stack whenever the device is
+// disconnected from the host.
+//
+//*****************************************************************************
+static void
+HandleDisconnect(void *pvInstance)
+{
+    const tUSBDBulkDevice *psDevice;
+    const tUSBDBulkDevice *psBulkDevice;
+    tBulkInstance *psInst;
+    unsigned long ulPipe;
+
+    ASSERT(pvInstance != 0);
 
     //
-    // Remember that we are no longer connected.
+    // Create the instance pointer.
     //
-    psInst->bConnected = false;
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        //
+        // Get a pointer to the instance data for this endpoint pair.
+        //
+        psBulkDevice = BulkPipeGet(psDevice, ulPipe);
+        psInst = psBulkDevice->psPrivateBulkData;
+
+        //
+        // If we are not currently connected so let the client know we are
+        // open for business.
+        //
+        if(psInst->bConnected)
+        {
+            //
+            // Pass the disconnected event to the client.
+            //
+            psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData,
+                                        USB_EVENT_DISCONNECTED, 0,
+                                        (void *)0);
+        }
+
+        //
+        // Remember that we are no longer connected.
+        //
+        psInst->bConnected = false;
+    }
 }
 
 //*****************************************************************************
@@ -667,20 +1616,26 @@ HandleDisconnect(void *pvInstance)
 static void
 HandleSuspend(void *pvInstance)
 {
+    const tUSBDBulkDevice *psDevice;
     const tUSBDBulkDevice *psBulkDevice;
+    unsigned long ulPipe;
 
     ASSERT(pvInstance != 0);
 
     //
     // Create the instance pointer.
     //
-    psBulkDevice = (const tUSBDBulkDevice *)pvInstance;
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
 
     //
-    // Pass the event on to the client.
+    // Pass the event on to the client of each endpoint pair.
     //
-    psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData, USB_EVENT_SUSPEND, 0,
-                                (void *)0);
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        psBulkDevice = BulkPipeGet(psDevice, ulPipe);
+        psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData,
+                                    USB_EVENT_SUSPEND, 0, (void *)0);
+    }
 }
 
 //*****************************************************************************
@@ -692,20 +1647,26 @@ HandleSuspend(void *pvInstance)
 static void
 HandleResume(void *pvInstance)
 {
+    const tUSBDBulkDevice *psDevice;
     const tUSBDBulkDevice *psBulkDevice;
+    unsigned long ulPipe;
 
     ASSERT(pvInstance != 0);
 
     //
     // Create the instance pointer.
     //
-    psBulkDevice = (const tUSBDBulkDevice *)pvInstance;
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
 
     //
-    // Pass the event on to the client.
+    // Pass the event on to the client of each endpoint pair.
     //
-    psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData, USB_EVENT_RESUME, 0,
-                                (void *)0);
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        psBulkDevice = BulkPipeGet(psDevice, ulPipe);
+        psBulkDevice->pfnRxCallback(psBulkDevice->pvRxCBData,
+                                    USB_EVENT_RESUME, 0, (void *)0);
+    }
 }
 
 //*****************************************************************************
@@ -722,43 +1683,195 @@ HandleResume(void *pvInstance)
 //
 //*****************************************************************************
 static void
-BulkTickHandler(void *pvInstance, unsigned long ulTimemS)
+BulkTickHandler(void *pvInstance, unsigned long ulTimemS)
+{
+    tBulkInstance *psInst;
+    unsigned long ulPipe;
+    const tUSBDBulkDevice *psDevice;
+    const tUSBDBulkDevice *psBulkDevice;
+
+    ASSERT(pvInstance != 0);
+
+    //
+    // Create the instance pointer.
+    //
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        //
+        // Get the instance data pointer for this endpoint pair.
+        //
+        psBulkDevice = BulkPipeGet(psDevice, ulPipe);
+        psInst = psBulkDevice->psPrivateBulkData;
+
+        //
+        // Do we have a deferred receive waiting?  If so, signal it again if
+        // the client has not resumed reception for a while.
+        //
+        if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+        {
+            psInst->ulRxRetrymS += ulTimemS;
+            if(psInst->ulRxRetrymS >= BULK_RX_RETRY_MS)
+            {
+                BulkRxDeferredNotify(psBulkDevice);
+            }
+        }
+    }
+
+    return;
+}
+
+//*****************************************************************************
+//
+// Initializes the instance data for one endpoint pair of the bulk device on
+// the USB controller at ulUSBBase.  Pair n is assigned endpoint
+// DATA_IN_ENDPOINT + n in both directions.
+//
+// \param psDevice points to the device structure for the endpoint pair.
+// \param ulPipe is the index of the endpoint pair.
+// \param ulUSBBase is the base address of the USB controller in use.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BulkPipeInit(const tUSBDBulkDevice *psDevice, unsigned long ulPipe,
+             unsigned long ulUSBBase)
+{
+    tBulkInstance *psInst;
+    unsigned long ulIndex;
+
+    ASSERT(psDevice->psPrivateBulkData);
+    ASSERT(psDevice->pfnRxCallback);
+    ASSERT(psDevice->pfnTxCallback);
+
+    //
+    // Initialize the workspace in the passed instance structure.
+    //
+    psInst = psDevice->psPrivateBulkData;
+    psInst->psConfDescriptor = (tConfigDescriptor *)g_pBulkDescriptor;
+    psInst->psDevInfo = &g_sBulkDeviceInfo;
+    psInst->ulUSBBase = ulUSBBase;
+    psInst->eBulkRxState = BULK_STATE_UNCONFIGURED;
+    psInst->eBulkTxState = BULK_STATE_UNCONFIGURED;
+    psInst->usDeferredOpFlags = 0;
+    psInst->usLastTxSize = 0;
+    psInst->ucTxPackets = 0;
+    psInst->ucTxDepth = 1;
+    psInst->ulRxDirectCount = 0;
+    psInst->ulRxIndirectCount = 0;
+    psInst->ulRxRetrymS = 0;
+    psInst->bRxResume = false;
+    psInst->pfnCounter = 0;
+    psInst->ulISRTime = 0;
+    BulkStatsClear(psInst);
+    psInst->ulFlags = 0;
+    psInst->pucTxXfer = (unsigned char *)0;
+    psInst->pucRxXfer = (unsigned char *)0;
+    psInst->bConnected = false;
+
+    //
+    // Set the default endpoint and interface assignments.
+    //
+    ulIndex = USB_EP_TO_INDEX(DATA_IN_ENDPOINT) + ulPipe;
+    psInst->ucINEndpoint = INDEX_TO_USB_EP(ulIndex);
+    psInst->ucOUTEndpoint = INDEX_TO_USB_EP(ulIndex);
+    psInst->ucInterface = 0;
+
+    //
+    // Assign uDMA channels to the endpoints if the client wants them.
+    //
+    BulkDMAChannelsAssign(psDevice);
+}
+
+//*****************************************************************************
+//
+// Builds an instance's own copy of the configuration descriptor for a bulk
+// device offering ulNumPipes endpoint pairs in addition to the first.  The
+// copy is made from the configuration descriptor template so that devices on
+// different controllers may use different power settings and numbers of
+// endpoint pairs.  The additional pairs' descriptors are copies of the first
+// pair's with the endpoint numbers adjusted to match the assignments made in
+// BulkPipeInit().
+//
+// \param psInst is the instance which is to hold the descriptor.
+// \param ulNumPipes is the number of endpoint pairs offered in addition to
+// the first.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BulkConfigDescriptorBuild(tBulkInstance *psInst, unsigned long ulNumPipes)
 {
-    tBulkInstance *psInst;
-    unsigned long ulSize;
-    const tUSBDBulkDevice *psDevice;
-
-    ASSERT(pvInstance != 0);
+    unsigned char *pucEndpoints;
+    unsigned long ulPipe;
+    unsigned long ulIdx;
 
     //
-    // Create the instance pointer.
+    // Copy the configuration descriptor and the interface and first endpoint
+    // pair's descriptors from the template.
     //
-    psDevice = (const tUSBDBulkDevice *)pvInstance;
+    psInst->sConfDescriptor = *(const tConfigDescriptor *)g_pBulkDescriptor;
+    for(ulIdx = 0; ulIdx < sizeof(g_pBulkInterface); ulIdx++)
+    {
+        psInst->pucInterface[ulIdx] = g_pBulkInterface[ulIdx];
+    }
 
     //
-    // Get our instance data pointer.
+    // All endpoints are offered on the one interface.
     //
-    psInst = psDevice->psPrivateBulkData;
+    psInst->pucInterface[BULK_IFACE_NUM_EPS] =
+        (unsigned char)((ulNumPipes + 1) * 2);
 
-    //
-    // Do we have a deferred receive waiting
-    //
-    if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+    for(ulPipe = 1; ulPipe <= ulNumPipes; ulPipe++)
     {
-        //
-        // Yes - how big is the waiting packet?
-        //
-        ulSize = MAP_USBEndpointDataAvail(psInst->ulUSBBase,
-                                          psInst->ucOUTEndpoint);
+        pucEndpoints = psInst->pucPipeEndpoints +
+                       ((ulPipe - 1) * COMPOSITE_DBULK_PIPE_SIZE);
+
+        for(ulIdx = 0; ulIdx < COMPOSITE_DBULK_PIPE_SIZE; ulIdx++)
+        {
+            pucEndpoints[ulIdx] =
+                psInst->pucInterface[BULK_IFACE_EP_OFFSET + ulIdx];
+        }
 
         //
-        // Tell the client that there is a packet waiting for it.
+        // Fix up the bEndpointAddress field of the IN and OUT endpoint
+        // descriptors.
         //
-        psDevice->pfnRxCallback(psDevice->pvRxCBData, USB_EVENT_RX_AVAILABLE,
-                                ulSize, (void *)0);
+        pucEndpoints[2] += (unsigned char)ulPipe;
+        pucEndpoints[9] += (unsigned char)ulPipe;
     }
 
-    return;
+    //
+    // Describe the sections, including the additional endpoint descriptors
+    // only if there are any.
+    //
+    psInst->psConfigSections[0].usSize = sizeof(g_pBulkDescriptor);
+    psInst->psConfigSections[0].pucData =
+        (const unsigned char *)&psInst->sConfDescriptor;
+    psInst->psConfigSections[1].usSize = sizeof(g_pBulkInterface);
+    psInst->psConfigSections[1].pucData = psInst->pucInterface;
+    psInst->psConfigSections[2].usSize =
+        (unsigned short)(ulNumPipes * COMPOSITE_DBULK_PIPE_SIZE);
+    psInst->psConfigSections[2].pucData = psInst->pucPipeEndpoints;
+
+    for(ulIdx = 0; ulIdx < BULK_NUM_SECTIONS; ulIdx++)
+    {
+        psInst->ppsConfigSections[ulIdx] = &psInst->psConfigSections[ulIdx];
+    }
+
+    psInst->sConfigHeader.ucNumSections = (ulNumPipes ? BULK_NUM_SECTIONS :
+                                           (BULK_NUM_SECTIONS - 1));
+    psInst->sConfigHeader.psSections = psInst->ppsConfigSections;
+    psInst->ppsConfigDescriptors[0] = &psInst->sConfigHeader;
+
+    //
+    // Use the instance's descriptor in place of the template.
+    //
+    psInst->sDevInfo.ppConfigDescriptors = psInst->ppsConfigDescriptors;
+    psInst->psConfDescriptor = &psInst->sConfDescriptor;
 }
 
 //*****************************************************************************
@@ -787,19 +1900,38 @@ BulkTickHandler(void *pvInstance, unsigned long ulTimemS)
 //! Transmit Operation:
 //!
 //! Calls to USBDBulkPacketWrite must send no more than 64 bytes of data at a
-//! time and may only be made when no other transmission is currently
-//! outstanding.
+//! time and may only be made when USBDBulkTxPacketAvailable() indicates that
+//! the IN endpoint FIFO has space for another packet.  The IN endpoint FIFO
+//! is double-buffered whenever there is enough FIFO RAM, in which case up to
+//! two packets may be outstanding at once.
 //!
 //! Once a packet of data has been acknowledged by the USB host, a
 //! USB_EVENT_TX_COMPLETE event is sent to the application callback to inform
-//! it that another packet may be transmitted.
+//! it that another packet may be transmitted.  The event's ulMsgValue gives
+//! the total number of bytes in all packets sent since the previous event.
+//! This may be 0 if the event indicates only that the FIFO has space to
+//! accept another packet.
 //!
 //! Receive Operation:
 //!
-//! An incoming USB data packet will result in a call to the application
-//! callback with event USBD_EVENT_RX_AVAILABLE.  The application must then
-//! call USBDBulkPacketRead(), passing a buffer capable of holding 64 bytes, to
-//! retrieve the data and acknowledge reception to the USB host.
+//! An incoming USB data packet will first result in a call to the application
+//! callback with event USB_EVENT_REQUEST_BUFFER.  If the application returns
+//! a buffer large enough to hold the whole packet, the packet is read into it
+//! and passed to the application callback with event USB_EVENT_RX_AVAILABLE.
+//! Otherwise, the application callback is sent USB_EVENT_RX_AVAILABLE with
+//! a NULL data pointer.  The application must then call USBDBulkPacketRead(),
+//! passing a buffer capable of holding 64 bytes, to retrieve the data and
+//! acknowledge reception to the USB host.
+//!
+//! Multiple Endpoint Pairs:
+//!
+//! A bulk device may offer up to USBD_BULK_MAX_PIPES independent IN/OUT
+//! endpoint pairs on its single interface.  Additional pairs are described by
+//! the structures listed in the \e ppsPipes field of \e psDevice and are
+//! assigned endpoint numbers following those of the first pair.  Each pair
+//! operates exactly as described above using its own callbacks and instance
+//! data.  To use a pair, pass its own tUSBDBulkDevice structure pointer as
+//! the \e pvInstance parameter to the remaining USBDBulk APIs.
 //!
 //! \note The application must not make any calls to the low level USB Device
 //! API if interacting with USB via the USB bulk device class API.  Doing so
@@ -816,7 +1948,7 @@ USBDBulkInit(unsigned long ulIndex, const tUSBDBulkDevice *psDevice)
     //
     // Check parameter validity.
     //
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
     ASSERT(psDevice);
 
     pvInstance = USBDBulkCompositeInit(ulIndex, psDevice);
@@ -848,6 +1980,12 @@ USBDBulkInit(unsigned long ulIndex, const tUSBDBulkDevice *psDevice)
 //! This call is very similar to USBDBulkInit() except that it is used for
 //! initializing an instance of the bulk device for use in a composite device.
 //!
+//! Each instance builds its own copy of the device information structure and
+//! descriptors.  If the device offers more than one endpoint pair, the
+//! composite device entry for it must use the instance's copy,
+//! \e psDevice->psPrivateBulkData->psDevInfo, rather than
+//! \e g_sBulkDeviceInfo which describes only a single pair.
+//!
 //! \return Returns zero on failure or a non-zero value that should be
 //! used with the remaining USB HID Bulk APIs.
 //
@@ -857,35 +1995,48 @@ USBDBulkCompositeInit(unsigned long ulIndex, const tUSBDBulkDevice *psDevice)
 {
     tBulkInstance *psInst;
     tDeviceDescriptor *psDevDesc;
+    unsigned long ulPipe;
 
     //
     // Check parameter validity.
     //
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
     ASSERT(psDevice);
     ASSERT(psDevice->ppStringDescriptors);
     ASSERT(psDevice->psPrivateBulkData);
     ASSERT(psDevice->pfnRxCallback);
     ASSERT(psDevice->pfnTxCallback);
+    ASSERT(psDevice->ulNumPipes < USBD_BULK_MAX_PIPES);
+    ASSERT(psDevice->ppsPipes || (psDevice->ulNumPipes == 0));
 
     //
-    // Initialize the workspace in the passed instance structure.
+    // Initialize the workspace for each of the endpoint pairs.
     //
+    for(ulPipe = 0; ulPipe <= psDevice->ulNumPipes; ulPipe++)
+    {
+        BulkPipeInit(BulkPipeGet(psDevice, ulPipe), ulPipe,
+                     USB_INDEX_TO_BASE(ulIndex));
+    }
+
     psInst = psDevice->psPrivateBulkData;
-    psInst->psConfDescriptor = (tConfigDescriptor *)g_pBulkDescriptor;
-    psInst->psDevInfo = &g_sBulkDeviceInfo;
-    psInst->ulUSBBase = USB0_BASE;
-    psInst->eBulkRxState = BULK_STATE_UNCONFIGURED;
-    psInst->eBulkTxState = BULK_STATE_UNCONFIGURED;
-    psInst->usDeferredOpFlags = 0;
-    psInst->bConnected = false;
 
     //
-    // Set the default endpoint and interface assignments.
+    // Give the instance its own copy of the device information and the
+    // device and configuration descriptors, so that a device on another
+    // controller is not changed by the fix ups below.  Changes made to
+    // g_sBulkDeviceInfo before this call are kept.
     //
-    psInst->ucINEndpoint = DATA_IN_ENDPOINT;
-    psInst->ucOUTEndpoint = DATA_OUT_ENDPOINT;
-    psInst->ucInterface = 0;
+    psInst->sDevInfo = g_sBulkDeviceInfo;
+    psInst->sDevDescriptor =
+        *(const tDeviceDescriptor *)g_sBulkDeviceInfo.pDeviceDescriptor;
+    psInst->sDevInfo.pDeviceDescriptor =
+        (const unsigned char *)&psInst->sDevDescriptor;
+    psInst->psDevInfo = &psInst->sDevInfo;
+
+    //
+    // Build the configuration descriptor for the endpoint pairs.
+    //
+    BulkConfigDescriptorBuild(psInst, psDevice->ulNumPipes);
 
     //
     // Fix up the device descriptor with the client-supplied values.
@@ -1120,9 +2271,38 @@ USBDBulkPacketWrite(void *pvInstance, unsigned char *pcData,
         // Either the packet was too big or we are in the middle of sending
         // another packet.  Return 0 to indicate that we can't send this data.
         //
+        if(ulLength <= DATA_IN_EP_MAX_SIZE)
+        {
+            psInst->sStats.ulTxBusy++;
+        }
         return(0);
     }
 
+    //
+    // If we have a uDMA channel for the endpoint and the whole packet is
+    // being provided in this call, have the uDMA controller load the FIFO.
+    // The packet is sent once the transfer completes and no further packet
+    // is accepted until then.
+    //
+    if((psInst->ucINDMA != BULK_DMA_CHANNEL_NONE) && bLast && ulLength &&
+       !psInst->usLastTxSize)
+    {
+        psInst->usLastTxSize = (unsigned short)ulLength;
+        psInst->eBulkTxState = BULK_STATE_WAIT_DATA;
+        psInst->ulFlags |= BULK_FLAG_DMA_IN;
+        MAP_uDMAChannelControlSet(psInst->ucINDMA,
+                                  (UDMA_SIZE_8 | UDMA_SRC_INC_8 |
+                                   UDMA_DST_INC_NONE | UDMA_ARB_64));
+        MAP_uDMAChannelTransferSet(psInst->ucINDMA, UDMA_MODE_BASIC, pcData,
+                                   (void *)USBFIFOAddrGet(psInst->ulUSBBase,
+                                                   psInst->ucINEndpoint),
+                                   ulLength);
+        MAP_USBEndpointDMAEnable(psInst->ulUSBBase, psInst->ucINEndpoint,
+                                 USB_EP_DEV_IN);
+        MAP_uDMAChannelEnable(psInst->ucINDMA);
+        return(ulLength);
+    }
+
     //
     // Copy the data into the USB endpoint FIFO.
     //
@@ -1148,10 +2328,7 @@ USBDBulkPacketWrite(void *pvInstance, unsigned char *pcData,
             // Send the packet to the host if we have received all the data we
             // can expect for this packet.
             //
-            psInst->eBulkTxState = BULK_STATE_WAIT_DATA;
-            lRetcode = MAP_USBEndpointDataSend(psInst->ulUSBBase,
-                                               psInst->ucINEndpoint,
-                                               USB_TRANS_IN);
+            lRetcode = BulkTxPacketSend(psInst);
         }
     }
 
@@ -1254,6 +2431,7 @@ USBDBulkPacketRead(void *pvInstance, unsigned char *pcData,
             //
             MAP_USBDevEndpointDataAck(psInst->ulUSBBase, psInst->ucOUTEndpoint,
                                       true);
+            BulkStatsRxPacket(psInst, ulPkt);
 
             //
             // Clear the flag we set to indicate that a packet read is
@@ -1279,6 +2457,184 @@ USBDBulkPacketRead(void *pvInstance, unsigned char *pcData,
     return(0);
 }
 
+//*****************************************************************************
+//
+//! Transmits a block of data of any size to the USB host.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param pucData points to the data to transmit.  This memory must remain
+//! valid and unchanged until the transfer completes.
+//! \param ulLength is the number of bytes of data to transmit.
+//!
+//! This function starts a transfer which sends the supplied data to the host
+//! as a sequence of maximum-sized packets followed by any remaining bytes in a
+//! short packet.  If \e ulLength is a multiple of the maximum packet size,
+//! including 0, a zero-length packet is sent to terminate the transfer.
+//!
+//! Rather than receiving USB_EVENT_TX_COMPLETE for each packet, the transmit
+//! channel callback receives a single USB_EVENT_TX_COMPLETE event once the
+//! whole transfer has been sent.  In this case, the event's ulMsgValue
+//! parameter contains \e ulLength and pvMsgData contains \e pucData.
+//!
+//! A transfer may only be started when no other transfer is in progress and
+//! all packets written using USBDBulkPacketWrite() have been sent.  This
+//! function must not be used if the transmit channel is serviced by a USB
+//! buffer.
+//!
+//! \return Returns \b true if the transfer was started or \b false if the
+//! transmit channel is busy.
+//
+//*****************************************************************************
+tBoolean
+USBDBulkTransferWrite(void *pvInstance, unsigned char *pucData,
+                      unsigned long ulLength)
+{
+    tBulkInstance *psInst;
+    tBoolean bIntsOff;
+
+    ASSERT(pvInstance && pucData);
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // Is the transmit channel free?
+    //
+    if(psInst->pucTxXfer || psInst->ucTxPackets ||
+       (psInst->eBulkTxState != BULK_STATE_IDLE))
+    {
+        return(false);
+    }
+
+    //
+    // Set up the transfer.
+    //
+    psInst->ulTxXferSize = ulLength;
+    psInst->ulTxXferSent = 0;
+    psInst->bTxXferZLP = (ulLength % DATA_IN_EP_MAX_SIZE) ? false : true;
+
+    //
+    // Start sending the data.  The transmit interrupt also sends data from
+    // the transfer so turn interrupts off while we queue the first packets.
+    //
+    bIntsOff = IntMasterDisable();
+    psInst->pucTxXfer = pucData;
+    BulkTxXferFill(pvInstance);
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Receives a block of data of any size from the USB host.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param pucData points to the buffer into which data is to be received.
+//! \param ulLength is the size of the buffer pointed to by \e pucData.
+//!
+//! This function starts a transfer which reads packets from the host into
+//! the supplied buffer.  The transfer completes when a short or zero-length
+//! packet is received, when the buffer is full or when a packet arrives
+//! which is too large to fit into the space remaining in the buffer.  In the
+//! last case, the packet is then passed to the receive channel callback in
+//! the usual way once the transfer has completed.
+//!
+//! Rather than receiving USB_EVENT_RX_AVAILABLE for each packet, the receive
+//! channel callback receives a single USB_EVENT_RX_AVAILABLE event once the
+//! transfer has completed.  In this case, the event's ulMsgValue parameter
+//! contains the number of bytes received and pvMsgData contains \e pucData.
+//! A new transfer may be started from within this callback.
+//!
+//! This function must not be used if the receive channel is serviced by a
+//! USB buffer.
+//!
+//! \return Returns \b true if the transfer was started or \b false if a
+//! receive transfer is already in progress.
+//
+//*****************************************************************************
+tBoolean
+USBDBulkTransferRead(void *pvInstance, unsigned char *pucData,
+                     unsigned long ulLength)
+{
+    tBulkInstance *psInst;
+
+    ASSERT(pvInstance && pucData && ulLength);
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // Is a transfer already in progress?
+    //
+    if(psInst->pucRxXfer)
+    {
+        return(false);
+    }
+
+    //
+    // Set up the transfer.  Setting the buffer pointer last starts the
+    // transfer.
+    //
+    psInst->ulRxXferSize = ulLength;
+    psInst->ulRxXferCount = 0;
+    psInst->pucRxXfer = pucData;
+
+    //
+    // Read any packet that is already waiting into the new buffer.
+    //
+    USBDBulkRxResume(pvInstance);
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of packets received via each receive path.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param pulDirect points to storage which will be written with the number
+//! of packets read directly into a buffer supplied by the application in
+//! response to USB_EVENT_REQUEST_BUFFER.
+//! \param pulIndirect points to storage which will be written with the
+//! number of packets left in the endpoint FIFO for the application to read
+//! using USBDBulkPacketRead().
+//!
+//! This function allows an application to determine how often the bulk
+//! device is able to read received packets directly into the application's
+//! buffer.  A high indirect count when using a USB buffer typically indicates
+//! that the buffer is too small or is not being emptied quickly enough.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDBulkRxPathCountsGet(void *pvInstance, unsigned long *pulDirect,
+                        unsigned long *pulIndirect)
+{
+    tBulkInstance *psInst;
+
+    ASSERT(pvInstance && pulDirect && pulIndirect);
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    *pulDirect = psInst->ulRxDirectCount;
+    *pulIndirect = psInst->ulRxIndirectCount;
+}
+
 //*****************************************************************************
 //
 //! Returns the number of free bytes in the transmit buffer.
@@ -1288,8 +2644,10 @@ USBDBulkPacketRead(void *pvInstance, unsigned char *pcData,
 //!
 //! This function returns the maximum number of bytes that can be passed on a
 //! call to USBDBulkPacketWrite and accepted for transmission.  The value
-//! returned will be the maximum USB packet size (64) if no transmission is
-//! currently outstanding or 0 if a transmission is in progress.
+//! returned will be the maximum USB packet size (64) if the endpoint FIFO
+//! can accept another packet or 0 if it is full.  If the IN endpoint FIFO is
+//! double-buffered, a second packet may be accepted while the first is still
+//! waiting to be sent.
 //!
 //! \return Returns the number of bytes available in the transmit buffer.
 //
@@ -1307,9 +2665,14 @@ USBDBulkTxPacketAvailable(void *pvInstance)
     psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
 
     //
-    // Do we have a packet transmission currently ongoing?
+    // Do we have a packet transmission currently ongoing which fills the
+    // FIFO or is the hardware still moving the previous packet into the
+    // second FIFO buffer?
     //
-    if(psInst->eBulkTxState != BULK_STATE_IDLE)
+    if((psInst->eBulkTxState != BULK_STATE_IDLE) ||
+       (psInst->ucTxPackets &&
+        (MAP_USBEndpointStatus(psInst->ulUSBBase, psInst->ucINEndpoint) &
+         USB_DEV_TX_TXPKTRDY)))
     {
         //
         // We are not ready to receive a new packet so return 0.
@@ -1381,6 +2744,158 @@ USBDBulkRxPacketAvailable(void *pvInstance)
     }
 }
 
+//*****************************************************************************
+//
+//! Tells the bulk device that the client can now accept a received packet.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//!
+//! If the client is unable to read a packet when it receives the
+//! USB_EVENT_RX_AVAILABLE event, the packet remains in the endpoint FIFO and
+//! the host is held off until it is read.  The client should call this
+//! function as soon as it has made room for the packet.  If a packet is
+//! waiting, the USB interrupt is triggered and the client is sent
+//! USB_EVENT_RX_AVAILABLE again from the interrupt handler.  If the client
+//! does not call this function, the event is signaled again every few
+//! milliseconds during tick processing.
+//!
+//! USB buffers call this function automatically when the pfnResume field of
+//! their tUSBBuffer structure is set to point to it.  This function may be
+//! called from interrupt context.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDBulkRxResume(void *pvInstance)
+{
+    tBulkInstance *psInst;
+
+    ASSERT(pvInstance);
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // If a packet is waiting, ask for it to be signaled from the USB
+    // interrupt handler so that the client sees all receive events in the
+    // same context.
+    //
+    if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+    {
+        psInst->bRxResume = true;
+        MAP_IntPendSet(
+            USB_INDEX_TO_INT(USB_BASE_TO_INDEX(psInst->ulUSBBase)));
+    }
+}
+
+//*****************************************************************************
+//
+//! Sets the counter used to measure bulk device event latency.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit() or to one of the additional endpoint pair
+//! structures.
+//! \param pfnCounter is a pointer to a function returning the current value
+//! of a free-running counter or 0 to stop taking latency samples.
+//!
+//! The bulk device gathers throughput statistics for each of its endpoint
+//! pairs at all times but can only measure the time taken to pass events to
+//! the client if it is given a counter to read.  The counter is read on entry
+//! to the bulk device's USB interrupt handling and again immediately before
+//! each USB_EVENT_RX_AVAILABLE or USB_EVENT_TX_COMPLETE callback.  Since the
+//! counter is read twice in each USB interrupt, it should be fast to read.
+//!
+//! Changing the counter does not clear the latency samples already taken.
+//! Call USBDBulkStatsReset() if these should be discarded.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDBulkStatsCounterSet(void *pvInstance, tUSBDBulkCounter pfnCounter)
+{
+    tBulkInstance *psInst;
+    tBoolean bIntsOff;
+
+    ASSERT(pvInstance);
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // Make sure we don't take a sample using a time stamp from the old
+    // counter.
+    //
+    bIntsOff = IntMasterDisable();
+    psInst->pfnCounter = pfnCounter;
+    psInst->ulISRTime = pfnCounter ? pfnCounter() : 0;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the statistics gathered for a bulk device endpoint pair.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit() or to one of the additional endpoint pair
+//! structures.
+//! \param psStats points to the structure which will be written with the
+//! statistics.
+//!
+//! This function takes a consistent snapshot of the statistics which the bulk
+//! device has gathered for an endpoint pair since it was initialized or since
+//! the statistics were last reset.  It may be called from interrupt context.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDBulkStatsGet(void *pvInstance, tUSBDBulkStats *psStats)
+{
+    ASSERT(pvInstance && psStats);
+
+    BulkStatsSnapshot(((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData,
+                      psStats);
+}
+
+//*****************************************************************************
+//
+//! Resets the statistics gathered for a bulk device endpoint pair.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit() or to one of the additional endpoint pair
+//! structures.
+//!
+//! This function clears all the statistics for an endpoint pair.  The host
+//! can do the same using the \b USBD_BULK_REQ_STATS_RESET vendor request.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDBulkStatsReset(void *pvInstance)
+{
+    tBoolean bIntsOff;
+
+    ASSERT(pvInstance);
+
+    bIntsOff = IntMasterDisable();
+    BulkStatsClear(((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData);
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
 //*****************************************************************************
 //
 //! Reports the device power status (bus- or self-powered) to the USB library.
@@ -1401,12 +2916,16 @@ USBDBulkRxPacketAvailable(void *pvInstance)
 void
 USBDBulkPowerStatusSet(void *pvInstance, unsigned char ucPower)
 {
+    tBulkInstance *psInst;
+
     ASSERT(pvInstance);
 
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
     //
     // Pass the request through to the lower layer.
     //
-    USBDCDPowerStatusSet(0, ucPower);
+    USBDCDPowerStatusSet(USB_BASE_TO_INDEX(psInst->ulUSBBase), ucPower);
 }
 
 //*****************************************************************************
@@ -1431,12 +2950,16 @@ USBDBulkPowerStatusSet(void *pvInstance, unsigned char ucPower)
 tBoolean
 USBDBulkRemoteWakeupRequest(void *pvInstance)
 {
+    tBulkInstance *psInst;
+
     ASSERT(pvInstance);
 
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
     //
     // Pass the request through to the lower layer.
     //
-    return(USBDCDRemoteWakeupRequest(0));
+    return(USBDCDRemoteWakeupRequest(USB_BASE_TO_INDEX(psInst->ulUSBBase)));
 }
 
 //*****************************************************************************
@@ -84,6 +84,161 @@ typedef enum
     BULK_STATE_WAIT_CLIENT
 } tBulkState;
 
+//*****************************************************************************
+//
+//! This structure holds the statistics that the bulk device gathers for each
+//! of its endpoint pairs.  A snapshot may be read using USBDBulkStatsGet() or
+//! by the host using the \b USBD_BULK_REQ_STATS_GET vendor request, in which
+//! case the fields are sent in order as little-endian 32-bit values.  All
+//! counters wrap on overflow.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The number of packets sent to the host, including zero-length
+    //! packets.
+    //
+    unsigned long ulTxPackets;
+
+    //
+    //! The number of bytes sent to the host.
+    //
+    unsigned long ulTxBytes;
+
+    //
+    //! The number of zero-length packets sent to the host.
+    //
+    unsigned long ulTxZLPs;
+
+    //
+    //! The number of packets that the client tried to write while the IN
+    //! endpoint was still busy sending an earlier packet, and which were
+    //! therefore refused.  Checks made with USBDBulkTxPacketAvailable() are
+    //! not counted since the USB buffer makes one each time it schedules data.
+    //
+    unsigned long ulTxBusy;
+
+    //
+    //! The number of packets received from the host.
+    //
+    unsigned long ulRxPackets;
+
+    //
+    //! The number of bytes received from the host.
+    //
+    unsigned long ulRxBytes;
+
+    //
+    //! The number of received packets that the client could not accept
+    //! immediately.  The host's packets are NAKed until such a packet is read.
+    //
+    unsigned long ulRxDeferred;
+
+    //
+    //! The number of receive errors reported by the OUT endpoint.
+    //
+    unsigned long ulRxErrors;
+
+    //
+    //! The logical OR of all the \b USBERR_DEV_RX_xxx error flags reported by
+    //! the OUT endpoint.
+    //
+    unsigned long ulRxErrorFlags;
+
+    //
+    //! The number of latency samples taken.  Latency is measured from entry
+    //! to the bulk device's USB interrupt handling to the point at which it
+    //! calls the client's USB_EVENT_RX_AVAILABLE or USB_EVENT_TX_COMPLETE
+    //! callback, using the counter function passed to
+    //! USBDBulkStatsCounterSet().  No samples are taken if no counter
+    //! function has been provided.
+    //
+    unsigned long ulLatencyCount;
+
+    //
+    //! The smallest latency seen in counter ticks or 0 if there are no
+    //! samples.
+    //
+    unsigned long ulLatencyMin;
+
+    //
+    //! The mean latency in counter ticks or 0 if there are no samples.  This
+    //! is calculated when the snapshot is taken.
+    //
+    unsigned long ulLatencyAvg;
+
+    //
+    //! The largest latency seen in counter ticks.
+    //
+    unsigned long ulLatencyMax;
+}
+tUSBDBulkStats;
+
+//*****************************************************************************
+//
+//! A function pointer type describing a free-running counter used to time
+//! stamp events for the bulk device statistics.  The function must return a
+//! count that increments at a constant rate and wraps from 0xFFFFFFFF to 0,
+//! such as a processor cycle counter.
+//
+//*****************************************************************************
+typedef unsigned long (* tUSBDBulkCounter)(void);
+
+//*****************************************************************************
+//
+//! The size of the memory that should be allocated to create a configuration
+//! descriptor for a single instance of the USB Bulk Device.
+//! This does not include the configuration descriptor which is automatically
+//! ignored by the composite device class.
+//
+// For reference this is sizeof(g_sCDCSerIfaceHeaderSectionNOINT) +
+// sizeof(g_sCDCSerInterfaceSection) + sizeof(g_sCDCSerIfaceEndpointsNOINT)
+//
+//*****************************************************************************
+#define COMPOSITE_DBULK_SIZE     (23)
+
+//*****************************************************************************
+//
+//! The number of additional bytes of configuration descriptor required for
+//! each bulk endpoint pair beyond the first.  A bulk device with \e n pairs
+//! in a composite device requires COMPOSITE_DBULK_SIZE +
+//! ((n - 1) * COMPOSITE_DBULK_PIPE_SIZE) bytes.
+//
+//*****************************************************************************
+#define COMPOSITE_DBULK_PIPE_SIZE (14)
+
+//*****************************************************************************
+//
+//! The maximum number of bulk IN/OUT endpoint pairs that a single bulk device
+//! may offer, including the first pair described by the tUSBDBulkDevice
+//! structure itself.
+//
+//*****************************************************************************
+#define USBD_BULK_MAX_PIPES     4
+
+//*****************************************************************************
+//
+// PRIVATE
+//
+// The maximum number of packets that the bulk device can have queued for
+// transmission in the IN endpoint FIFO at any one time.  This is reached only
+// if the FIFO is configured to be double-buffered.
+//
+//*****************************************************************************
+#define BULK_MAX_TX_PACKETS     2
+
+//*****************************************************************************
+//
+// PRIVATE
+//
+// The number of sections in the bulk device's configuration descriptor: the
+// configuration descriptor itself, the interface and first endpoint pair and
+// the endpoints of any additional pairs.
+//
+//*****************************************************************************
+#define BULK_NUM_SECTIONS       3
+
 //*****************************************************************************
 //
 // PRIVATE
@@ -103,10 +258,43 @@ typedef struct
     volatile tBulkState eBulkTxState;
     volatile unsigned short usDeferredOpFlags;
     unsigned short usLastTxSize;
+    unsigned short usTxPacketSize[BULK_MAX_TX_PACKETS];
+    volatile unsigned char ucTxPackets;
+    unsigned char ucTxDepth;
+    unsigned long ulRxDirectCount;
+    unsigned long ulRxIndirectCount;
+    unsigned long ulRxRetrymS;
+    volatile tBoolean bRxResume;
+    tUSBDBulkStats sStats;
+    unsigned long ulLatencyTotal;
+    tUSBDBulkCounter pfnCounter;
+    unsigned long ulISRTime;
+    volatile unsigned long ulFlags;
+    unsigned char *pucRxDMABuffer;
+    unsigned long ulRxDMASize;
+    unsigned char *pucTxXfer;
+    unsigned long ulTxXferSize;
+    unsigned long ulTxXferSent;
+    tBoolean bTxXferZLP;
+    unsigned char *pucRxXfer;
+    unsigned long ulRxXferSize;
+    unsigned long ulRxXferCount;
     volatile tBoolean bConnected;
     unsigned char ucINEndpoint;
     unsigned char ucOUTEndpoint;
     unsigned char ucInterface;
+    unsigned char ucINDMA;
+    unsigned char ucOUTDMA;
+    tDeviceInfo sDevInfo;
+    tDeviceDescriptor sDevDescriptor;
+    tConfigDescriptor sConfDescriptor;
+    unsigned char pucInterface[COMPOSITE_DBULK_SIZE];
+    unsigned char pucPipeEndpoints[(USBD_BULK_MAX_PIPES - 1) *
+                                   COMPOSITE_DBULK_PIPE_SIZE];
+    tConfigSection psConfigSections[BULK_NUM_SECTIONS];
+    const tConfigSection *ppsConfigSections[BULK_NUM_SECTIONS];
+    tConfigHeader sConfigHeader;
+    const tConfigHeader *ppsConfigDescriptors[1];
 }
 tBulkInstance;
 
@@ -124,26 +312,13 @@ tBulkInstance;
 #define USB_BULK_WORKSPACE_SIZE (sizeof(tBulkInstance))
 #endif
 
-//*****************************************************************************
-//
-//! The size of the memory that should be allocated to create a configuration
-//! descriptor for a single instance of the USB Bulk Device.
-//! This does not include the configuration descriptor which is automatically
-//! ignored by the composite device class.
-//
-// For reference this is sizeof(g_sCDCSerIfaceHeaderSectionNOINT) +
-// sizeof(g_sCDCSerInterfaceSection) + sizeof(g_sCDCSerIfaceEndpointsNOINT)
-//
-//*****************************************************************************
-#define COMPOSITE_DBULK_SIZE     (23)
-
 //*****************************************************************************
 //
 //! The structure used by the application to define operating parameters for
 //! the bulk device.
 //
 //*****************************************************************************
-typedef struct
+typedef struct tUSBDBulkDevice
 {
     //
     //! The vendor ID that this device is to present in the device descriptor.
@@ -220,9 +395,68 @@ typedef struct
     //! be modified by any code outside the bulk class driver.
     //
     tBulkInstance *psPrivateBulkData;
+
+    //
+    //! A set of flags enabling optional features of the bulk device.  This
+    //! is a logical OR of \b USBD_BULK_FLAG_xxx values or 0 if no optional
+    //! features are required.
+    //
+    unsigned long ulFlags;
+
+    //
+    //! A pointer to an array of structures describing additional bulk
+    //! IN/OUT endpoint pairs offered on the same interface, or NULL if the
+    //! device offers only a single pair.  Each additional pair has its own
+    //! callbacks, callback data, private instance data and flags and its
+    //! structure pointer is passed to the USBDBulk APIs to operate on that
+    //! pair.  The VID, PID, power and string fields of these structures are
+    //! ignored.
+    //
+    const struct tUSBDBulkDevice * const *ppsPipes;
+
+    //
+    //! The number of entries in the ppsPipes array.  This must not exceed
+    //! USBD_BULK_MAX_PIPES - 1.
+    //
+    unsigned long ulNumPipes;
 }
 tUSBDBulkDevice;
 
+//*****************************************************************************
+//
+//! When set in the ulFlags field of tUSBDBulkDevice, the bulk device uses
+//! the uDMA controller to move packet data between the application's buffers
+//! and the endpoint FIFOs.  The application must enable the uDMA controller
+//! and set its control table base before calling USBDBulkInit().  Endpoints
+//! which have no uDMA channel continue to use CPU copies.  When using uDMA,
+//! data passed to USBDBulkPacketWrite() must remain valid until the
+//! USB_EVENT_TX_COMPLETE event for the packet is received.
+//
+//*****************************************************************************
+#define USBD_BULK_FLAG_DMA      0x00000001
+
+//*****************************************************************************
+//
+//! The vendor-specific request which the host may send to read the
+//! statistics for one of the bulk device's endpoint pairs.  This is a
+//! device-to-host request whose wValue is the index of the endpoint pair,
+//! 0 being the first, and whose wIndex is the bulk interface number.  The
+//! device returns the tUSBDBulkStats structure for
+//! the pair.
+//
+//*****************************************************************************
+#define USBD_BULK_REQ_STATS_GET   0x01
+
+//*****************************************************************************
+//
+//! The vendor-specific request which the host may send to reset the
+//! statistics for one of the bulk device's endpoint pairs.  This is a
+//! host-to-device request with no data stage whose wValue is the index of the
+//! endpoint pair and whose wIndex is the bulk interface number.
+//
+//*****************************************************************************
+#define USBD_BULK_REQ_STATS_RESET 0x02
+
 extern tDeviceInfo g_sBulkDeviceInfo;
 
 //*****************************************************************************
@@ -247,6 +481,20 @@ extern unsigned long USBDBulkPacketRead(void *pvInstance,
                                         tBoolean bLast);
 extern unsigned long USBDBulkTxPacketAvailable(void *pvInstance);
 extern unsigned long USBDBulkRxPacketAvailable(void *pvInstance);
+extern tBoolean USBDBulkTransferWrite(void *pvInstance,
+                                      unsigned char *pucData,
+                                      unsigned long ulLength);
+extern tBoolean USBDBulkTransferRead(void *pvInstance,
+                                     unsigned char *pucData,
+                                     unsigned long ulLength);
+extern void USBDBulkRxResume(void *pvInstance);
+extern void USBDBulkStatsCounterSet(void *pvInstance,
+                                    tUSBDBulkCounter pfnCounter);
+extern void USBDBulkStatsGet(void *pvInstance, tUSBDBulkStats *psStats);
+extern void USBDBulkStatsReset(void *pvInstance);
+extern void USBDBulkRxPathCountsGet(void *pvInstance,
+                                    unsigned long *pulDirect,
+                                    unsigned long *pulIndirect);
 extern void USBDBulkPowerStatusSet(void *pvInstance, unsigned char ucPower);
 extern tBoolean USBDBulkRemoteWakeupRequest(void *pvInstance);
 
@@ -116,16 +116,6 @@
                       (1 << CDC_DO_LINE_CODING_CHANGE) |                      \
                       (1 << CDC_DO_LINE_STATE_CHANGE))
 
-//*****************************************************************************
-//
-// Macros to convert between USB controller base address and an index.  These
-// are currently trivial but are included to allow for the possibility of
-// supporting more than one controller in the future.
-//
-//*****************************************************************************
-#define USB_BASE_TO_INDEX(BaseAddr) (0)
-#define USB_INDEX_TO_BASE(Index) (USB0_BASE)
-
 //*****************************************************************************
 //
 // Endpoints to use for each of the required endpoints in the driver.
@@ -1160,6 +1150,37 @@ ProcessNotificationToHost(const tUSBDCDCDevice *psDevice,
     return(bRetcode);
 }
 
+//*****************************************************************************
+//
+// Queues a packet which has been loaded into the bulk IN endpoint FIFO and
+// schedules its transmission.
+//
+// \param psInst points to the instance data for the device.
+//
+// \return Returns the value returned by USBEndpointDataSend().
+//
+//*****************************************************************************
+static long
+CDCTxPacketSend(tCDCSerInstance *psInst)
+{
+    //
+    // Add the packet to our transmit queue before sending it since the
+    // completion interrupt may occur immediately.  If the FIFO is now full,
+    // we must wait for a packet to be sent before accepting another.
+    //
+    psInst->usTxPacketSize[psInst->ucTxPackets] = psInst->usLastTxSize;
+    psInst->usLastTxSize = 0;
+    psInst->ucTxPackets++;
+    psInst->eCDCTxState = (psInst->ucTxPackets >= psInst->ucTxDepth) ?
+                          CDC_STATE_WAIT_DATA : CDC_STATE_IDLE;
+
+    //
+    // Send the packet to the host.
+    //
+    return(MAP_USBEndpointDataSend(psInst->ulUSBBase, psInst->ucBulkINEndpoint,
+                                   USB_TRANS_IN));
+}
+
 //*****************************************************************************
 //
 // Receives notifications related to data sent to the host.
@@ -1180,7 +1201,7 @@ tBoolean
 ProcessDataToHost(const tUSBDCDCDevice *psDevice, unsigned long ulStatus)
 {
     tCDCSerInstance *psInst;
-    unsigned long ulEPStatus, ulSize;
+    unsigned long ulEPStatus, ulSize, ulPending;
     tBoolean bSentFullPacket;
 
     //
@@ -1201,52 +1222,66 @@ ProcessDataToHost(const tUSBDCDCDevice *psDevice, unsigned long ulStatus)
                                   psInst->ucBulkINEndpoint, ulEPStatus);
 
     //
-    // Our last transmission completed.  Clear our state back to idle and
-    // see if we need to send any more data.
+    // Work out how many of our queued packets are still in the FIFO.  With a
+    // single-buffered FIFO, this interrupt means that the only packet has
+    // been sent.  With a double-buffered FIFO, the interrupt occurs whenever
+    // a FIFO buffer becomes free so one or both packets may remain.
     //
-    psInst->eCDCTxState = CDC_STATE_IDLE;
+    if(psInst->ucTxDepth > 1)
+    {
+        ulPending = (ulEPStatus & USB_DEV_TX_TXPKTRDY) ? 2 :
+                    ((ulEPStatus & USB_DEV_TX_FIFO_NE) ? 1 : 0);
+    }
+    else
+    {
+        ulPending = 0;
+    }
 
     //
-    // If this notification isn't as a result of sending a zero-length packet,
-    // call back to the client to let it know we sent the last thing it passed
-    // us.
+    // Retire each packet which has been sent, totaling up the number of bytes
+    // they contained and noting whether the last one was a full packet.
     //
-    if(psInst->usLastTxSize)
+    ulSize = 0;
+    bSentFullPacket = false;
+    while(psInst->ucTxPackets > ulPending)
     {
-        //
-        // Have we just sent a 64 byte packet?
-        //
-        bSentFullPacket = (psInst->usLastTxSize == DATA_IN_EP_MAX_SIZE) ?
-                           true : false;
+        bSentFullPacket = (psInst->usTxPacketSize[0] == DATA_IN_EP_MAX_SIZE) ?
+                          true : false;
+        ulSize += psInst->usTxPacketSize[0];
+        psInst->usTxPacketSize[0] = psInst->usTxPacketSize[1];
+        psInst->ucTxPackets--;
+    }
 
-        //
-        // Notify the client that the last transmission completed.
-        //
-        ulSize = (unsigned long)psInst->usLastTxSize;
-        psInst->usLastTxSize = 0;
+    //
+    // If there is now space in the FIFO for another packet, clear our state
+    // back to idle.
+    //
+    if(psInst->ucTxPackets < psInst->ucTxDepth)
+    {
+        psInst->eCDCTxState = CDC_STATE_IDLE;
+    }
+
+    //
+    // If this notification isn't solely as a result of sending a zero-length
+    // packet, call back to the client to let it know how much of the data it
+    // passed us has been sent.  With a double-buffered FIFO, this may be 0 if
+    // the FIFO merely has space for another packet.
+    //
+    if(ulSize || (psInst->ucTxDepth > 1))
+    {
         psDevice->pfnTxCallback(psDevice->pvTxCBData, USB_EVENT_TX_COMPLETE,
                                 ulSize, (void *)0);
+    }
 
-        //
-        // If we had previously sent a full packet and the callback didn't
-        // schedule a new transmission, send a zero length packet to indicate
-        // the end of the transfer.
-        //
-        if(bSentFullPacket && !psInst->usLastTxSize)
-        {
-            //
-            // We can expect another transmit complete notification after doing
-            // this.
-            //
-            psInst->eCDCTxState = CDC_STATE_WAIT_DATA;
-
-            //
-            // Send the zero-length packet.
-            //
-            MAP_USBEndpointDataSend(psInst->ulUSBBase,
-                                    psInst->ucBulkINEndpoint,
-                                    USB_TRANS_IN);
-        }
+    //
+    // If we had previously sent a full packet and neither the FIFO nor the
+    // callback scheduled a new transmission, send a zero length packet to
+    // indicate the end of the transfer.  We can expect another transmit
+    // complete notification after doing this.
+    //
+    if(bSentFullPacket && !psInst->ucTxPackets && !psInst->usLastTxSize)
+    {
+        CDCTxPacketSend(psInst);
     }
 
     return(true);
@@ -1336,6 +1371,16 @@ HandleConfigChange(void *pvInstance, unsigned long ulInfo)
     psInst->eCDCRequestState = CDC_STATE_IDLE;
     psInst->eCDCRxState = CDC_STATE_IDLE;
     psInst->eCDCTxState = CDC_STATE_IDLE;
+    psInst->usLastTxSize = 0;
+    psInst->ucTxPackets = 0;
+
+    //
+    // Determine how many packets we can queue in the bulk IN endpoint FIFO.
+    //
+    psInst->ucTxDepth = USBDCDEndpointDoubleBuffered(0,
+                                                     psInst->ucBulkINEndpoint,
+                                                     USB_EP_DEV_IN) ?
+                        CDC_MAX_TX_PACKETS : 1;
 
     //
     // If we are not currently connected so let the client know we are open
@@ -2163,6 +2208,9 @@ USBDCDCCompositeInit(unsigned long ulIndex, const tUSBDCDCDevice *psCDCDevice)
     psInst->eCDCTxState = CDC_STATE_UNCONFIGURED;
     psInst->eCDCInterruptState = CDC_STATE_UNCONFIGURED;
     psInst->eCDCRequestState = CDC_STATE_UNCONFIGURED;
+    psInst->usLastTxSize = 0;
+    psInst->ucTxPackets = 0;
+    psInst->ucTxDepth = 1;
     psInst->ucPendingRequest = 0;
     psInst->usBreakDuration = 0;
     psInst->usSerialState = 0;
@@ -2560,10 +2608,7 @@ USBDCDCPacketWrite(void *pvInstance, unsigned char *pcData,
             // Send the packet to the host if we have received all the data we
             // can expect for this packet.
             //
-            psInst->eCDCTxState = CDC_STATE_WAIT_DATA;
-            lRetcode = MAP_USBEndpointDataSend(psInst->ulUSBBase,
-                                               psInst->ucBulkINEndpoint,
-                                               USB_TRANS_IN);
+            lRetcode = CDCTxPacketSend(psInst);
         }
     }
 
@@ -2716,8 +2761,10 @@ USBDCDCPacketRead(void *pvInstance, unsigned char *pcData,
 //!
 //! This function returns the maximum number of bytes that can be passed on a
 //! call to USBDCDCPacketWrite and accepted for transmission.  The value
-//! returned will be the maximum USB packet size (64) if no transmission is
-//! currently outstanding or 0 if a transmission is in progress.
+//! returned will be the maximum USB packet size (64) if the bulk IN endpoint
+//! FIFO can accept another packet or 0 if it is full.  If the FIFO is
+//! double-buffered, a second packet may be accepted while the first is still
+//! waiting to be sent.
 //!
 //! \return Returns the number of bytes available in the transmit buffer.
 //
@@ -2735,9 +2782,14 @@ USBDCDCTxPacketAvailable(void *pvInstance)
     psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
 
     //
-    // Do we have a packet transmission currently ongoing?
+    // Do we have a packet transmission currently ongoing which fills the
+    // FIFO or is the hardware still moving the previous packet into the
+    // second FIFO buffer?
     //
-    if(psInst->eCDCTxState != CDC_STATE_IDLE)
+    if((psInst->eCDCTxState != CDC_STATE_IDLE) ||
+       (psInst->ucTxPackets &&
+        (MAP_USBEndpointStatus(psInst->ulUSBBase, psInst->ucBulkINEndpoint) &
+         USB_DEV_TX_TXPKTRDY)))
     {
         //
         // We are not ready to receive a new packet so return 0.
@@ -85,6 +85,17 @@ typedef enum
 }
 tCDCState;
 
+//*****************************************************************************
+//
+// PRIVATE
+//
+// The maximum number of packets that the CDC device can have queued for
+// transmission in the bulk IN endpoint FIFO at any one time.  This is reached
+// only if the FIFO is double-buffered.
+//
+//*****************************************************************************
+#define CDC_MAX_TX_PACKETS      2
+
 //*****************************************************************************
 //
 // PRIVATE
@@ -110,6 +121,9 @@ typedef struct
     unsigned short usSerialState;
     volatile unsigned short usDeferredOpFlags;
     unsigned short usLastTxSize;
+    unsigned short usTxPacketSize[CDC_MAX_TX_PACKETS];
+    volatile unsigned char ucTxPackets;
+    unsigned char ucTxDepth;
     tLineCoding sLineCoding;
     volatile tBoolean bRxBlocked;
     volatile tBoolean bControlBlocked;
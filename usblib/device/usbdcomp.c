@@ -125,16 +125,6 @@ static const unsigned char g_pCompConfigDescriptor[] =
 //****************************************************************************
 #define INVALID_DEVICE_INDEX 0xFFFFFFFF
 
-//*****************************************************************************
-//
-// Macros to convert between USB controller base address and an index.  These
-// are currently trivial but are included to allow for the possibility of
-// supporting more than one controller in the future.
-//
-//*****************************************************************************
-#define USB_BASE_TO_INDEX(BaseAddr) (0)
-#define USB_INDEX_TO_BASE(Index)    (USB0_BASE)
-
 //****************************************************************************
 //
 // Various internal handlers needed by this class.
@@ -1007,6 +997,9 @@ CompositeEPChange(tCompositeEntry *pCompDevice, unsigned char ucOld,
 
             g_sUSBCompositeFIFOConfig.sIn[ucNew].usEPFlags =
                 pCompDevice->psDevice->psFIFOConfig->sIn[ucIndex].usEPFlags;
+
+            g_sUSBCompositeFIFOConfig.sIn[ucNew].bSingleBuffer =
+                pCompDevice->psDevice->psFIFOConfig->sIn[ucIndex].bSingleBuffer;
         }
         else
         {
@@ -1017,6 +1010,9 @@ CompositeEPChange(tCompositeEntry *pCompDevice, unsigned char ucOld,
 
             g_sUSBCompositeFIFOConfig.sOut[ucNew].usEPFlags =
                 pCompDevice->psDevice->psFIFOConfig->sOut[ucIndex].usEPFlags;
+
+            g_sUSBCompositeFIFOConfig.sOut[ucNew].bSingleBuffer =
+               pCompDevice->psDevice->psFIFOConfig->sOut[ucIndex].bSingleBuffer;
         }
         //
         // Call the device handler to inform the class of the interface number
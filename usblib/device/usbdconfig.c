@@ -54,6 +54,7 @@
 typedef struct
 {
     unsigned long ulSize[2];
+    unsigned char ucType[2];
 }
 tUSBEndpointInfo;
 
@@ -67,13 +68,21 @@ tUSBEndpointInfo;
 
 //*****************************************************************************
 //
-// Given a maximum packet size and the user's FIFO scaling requirements,
-// determine the flags to use to configure the endpoint FIFO and the number
-// of bytes of FIFO space occupied.
+// The number of bytes of FIFO RAM in the USB controller.  This is shared by
+// all endpoints, including endpoint 0.
+//
+//*****************************************************************************
+#define USB_FIFO_RAM_SIZE       4096
+
+//*****************************************************************************
+//
+// Given a maximum packet size and whether or not the FIFO is to be
+// double-buffered, determine the flags to use to configure the endpoint FIFO
+// and the number of bytes of FIFO space occupied.
 //
 //*****************************************************************************
 static unsigned long
-GetEndpointFIFOSize(unsigned long ulMaxPktSize, const tFIFOEntry *psFIFOParams,
+GetEndpointFIFOSize(unsigned long ulMaxPktSize, tBoolean bDoubleBuffer,
                     unsigned long *pupBytesUsed)
 {
     unsigned long ulBytes;
@@ -107,7 +116,7 @@ GetEndpointFIFOSize(unsigned long ulMaxPktSize, const tFIFOEntry *psFIFOParams,
             // Yes - are we being asked to double-buffer the FIFO for this
             // endpoint?
             //
-            if(psFIFOParams->bDoubleBuffer)
+            if(bDoubleBuffer)
             {
                 //
                 // Yes - FIFO requirement is double in this case.
@@ -136,6 +145,120 @@ GetEndpointFIFOSize(unsigned long ulMaxPktSize, const tFIFOEntry *psFIFOParams,
     return(USB_FIFO_SZ_8);
 }
 
+//*****************************************************************************
+//
+// Decide which endpoint FIFOs are to be double-buffered and determine the
+// total amount of FIFO RAM the configuration requires.
+//
+// Every endpoint is first given a single-buffered FIFO unless the
+// application asks for it to be double-buffered.  Then, in endpoint order,
+// each bulk and isochronous endpoint whose FIFO entry does not prevent it is
+// double-buffered for as long as the extra space fits in the FIFO RAM.  The
+// resulting plan is stored in the device instance.
+//
+// Returns \b false if any endpoint's packet size cannot be supported.
+//
+//*****************************************************************************
+static tBoolean
+PlanEndpointFIFOs(tDeviceInstance *psDevInst,
+                  const tUSBEndpointInfo *psEPInfo,
+                  const tFIFOConfig *psFIFOConfig)
+{
+    unsigned long ulLoop;
+    unsigned long ulDir;
+    unsigned long ulBytesUsed;
+    unsigned long ulTotal;
+    unsigned long ulType;
+    unsigned short usDB[2];
+    const tFIFOEntry *psEntry;
+
+    //
+    // Endpoint 0 always occupies the start of the FIFO.
+    //
+    ulTotal = MAX_PACKET_SIZE_EP0;
+    usDB[EP_INFO_IN] = 0;
+    usDB[EP_INFO_OUT] = 0;
+
+    //
+    // Add up the space needed by each endpoint with the buffering that the
+    // application requires.
+    //
+    for(ulLoop = 1; ulLoop < NUM_USB_EP; ulLoop++)
+    {
+        for(ulDir = EP_INFO_IN; ulDir <= EP_INFO_OUT; ulDir++)
+        {
+            if(!psEPInfo[ulLoop - 1].ulSize[ulDir])
+            {
+                continue;
+            }
+
+            psEntry = (ulDir == EP_INFO_IN) ? &psFIFOConfig->sIn[ulLoop - 1] :
+                                              &psFIFOConfig->sOut[ulLoop - 1];
+
+            GetEndpointFIFOSize(psEPInfo[ulLoop - 1].ulSize[ulDir],
+                                psEntry->bDoubleBuffer, &ulBytesUsed);
+
+            //
+            // If we are told that 0 bytes of FIFO will be used, this implies
+            // that there is an error in psFIFOConfig or the descriptor
+            // somewhere so return an error indicator to the caller.
+            //
+            if(!ulBytesUsed)
+            {
+                return(false);
+            }
+
+            if(psEntry->bDoubleBuffer)
+            {
+                usDB[ulDir] |= (1 << ulLoop);
+            }
+            ulTotal += ulBytesUsed;
+        }
+    }
+
+    //
+    // Now double-buffer any remaining bulk and isochronous endpoints for
+    // which there is space.  This allows the next packet to be loaded while
+    // the previous one is being transferred.
+    //
+    for(ulLoop = 1; ulLoop < NUM_USB_EP; ulLoop++)
+    {
+        for(ulDir = EP_INFO_IN; ulDir <= EP_INFO_OUT; ulDir++)
+        {
+            psEntry = (ulDir == EP_INFO_IN) ? &psFIFOConfig->sIn[ulLoop - 1] :
+                                              &psFIFOConfig->sOut[ulLoop - 1];
+            ulType = psEPInfo[ulLoop - 1].ucType[ulDir];
+
+            if(!psEPInfo[ulLoop - 1].ulSize[ulDir] ||
+               (usDB[ulDir] & (1 << ulLoop)) || psEntry->bSingleBuffer ||
+               ((ulType != USB_EP_ATTR_BULK) && (ulType != USB_EP_ATTR_ISOC)))
+            {
+                continue;
+            }
+
+            //
+            // Double-buffering needs the same amount of space again.
+            //
+            GetEndpointFIFOSize(psEPInfo[ulLoop - 1].ulSize[ulDir], false,
+                                &ulBytesUsed);
+            if((ulTotal + ulBytesUsed) <= USB_FIFO_RAM_SIZE)
+            {
+                usDB[ulDir] |= (1 << ulLoop);
+                ulTotal += ulBytesUsed;
+            }
+        }
+    }
+
+    //
+    // Remember the plan.
+    //
+    psDevInst->usINDoubleBuffered = usDB[EP_INFO_IN];
+    psDevInst->usOUTDoubleBuffered = usDB[EP_INFO_OUT];
+    psDevInst->usFIFOUsed = (unsigned short)ulTotal;
+
+    return(true);
+}
+
 //*****************************************************************************
 //
 // Translate a USB endpoint descriptor into the values we need to pass to the
@@ -205,6 +328,14 @@ GetEPDescriptorType(tEndpointDescriptor *psEndpoint, unsigned long *pulEPIndex,
 //! function, the USB controller is configured for correct operation of
 //! the default configuration of the device described by the descriptor passed.
 //!
+//! Bulk and isochronous endpoint FIFOs are double-buffered automatically
+//! whenever there is enough FIFO RAM to do so, working upwards from the
+//! lowest numbered endpoint.  An application can prevent this for a given
+//! endpoint by setting \e bSingleBuffer in its FIFO configuration entry or
+//! force double-buffering of any endpoint by setting \e bDoubleBuffer.  If
+//! the configuration does not fit in the FIFO RAM, no endpoint is configured
+//! and USBDCDFIFOUsageGet() may be used to find how much space was required.
+//!
 //! USBDCDConfig() is an optional call and applications may chose to make
 //! direct calls to SysCtlPeripheralEnable(), SysCtlUSBPLLEnable(),
 //! USBDevEndpointConfigSet() and USBFIFOConfigSet() instead of using this
@@ -252,6 +383,8 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
     {
         psEPInfo[ulLoop].ulSize[EP_INFO_IN] = 0;
         psEPInfo[ulLoop].ulSize[EP_INFO_OUT] = 0;
+        psEPInfo[ulLoop].ucType[EP_INFO_IN] = USB_EP_ATTR_INT;
+        psEPInfo[ulLoop].ucType[EP_INFO_OUT] = USB_EP_ATTR_INT;
     }
 
     //
@@ -311,6 +444,30 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
             psEPInfo[ulEpIndex - 1].ulSize[ulEpType] =
                 psEndpoint->wMaxPacketSize;
         }
+
+        //
+        // Remember if the endpoint is used for bulk or isochronous transfers
+        // by any alternate setting since it is then a candidate for
+        // double-buffering.
+        //
+        if((psEndpoint->bmAttributes & USB_EP_ATTR_TYPE_M) !=
+           USB_EP_ATTR_INT)
+        {
+            psEPInfo[ulEpIndex - 1].ucType[ulEpType] =
+                psEndpoint->bmAttributes & USB_EP_ATTR_TYPE_M;
+        }
+    }
+
+    //
+    // Decide how the FIFO is to be partitioned and make sure that the
+    // configuration fits in the FIFO RAM before we touch any endpoint.  The
+    // space required remains available via USBDCDFIFOUsageGet() in case
+    // the layout does not fit.
+    //
+    if(!PlanEndpointFIFOs(psDevInst, psEPInfo, psFIFOConfig) ||
+       (psDevInst->usFIFOUsed > USB_FIFO_RAM_SIZE))
+    {
+        return(false);
     }
 
     //
@@ -398,9 +555,10 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
                     //
                     // Set the endpoint configuration.
                     //
-                    USBDevEndpointConfigSet(USB0_BASE,
-                                            INDEX_TO_USB_EP(ulEpIndex),
-                                            ulMaxPkt, ulFlags);
+                    USBDevEndpointConfigSet(
+                                    USB_INDEX_TO_BASE(psDevInst->ulIndex),
+                                    INDEX_TO_USB_EP(ulEpIndex),
+                                    ulMaxPkt, ulFlags);
                 }
             }
         }
@@ -410,8 +568,9 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
     // At this point, we have configured all the endpoints that are to be
     // used by this configuration's alternate setting 0.  Now we go on and
     // partition the FIFO based on the maximum packet size information we
-    // extracted earlier.  Endpoint 0 is automatically configured to use the
-    // first MAX_PACKET_SIZE_EP0 bytes of the FIFO so we start from there.
+    // extracted earlier and the buffering we planned.  Endpoint 0 is
+    // automatically configured to use the first MAX_PACKET_SIZE_EP0 bytes of
+    // the FIFO so we start from there.
     //
     ulCount = MAX_PACKET_SIZE_EP0;
     for(ulLoop = 1; ulLoop < NUM_USB_EP; ulLoop++)
@@ -427,23 +586,15 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
             //
             ulMaxPkt = GetEndpointFIFOSize(
                                      psEPInfo[ulLoop - 1].ulSize[EP_INFO_IN],
-                                     &(psFIFOConfig->sIn[ulLoop - 1]),
+                                     (psDevInst->usINDoubleBuffered &
+                                      (1 << ulLoop)) ? true : false,
                                      &ulBytesUsed);
 
-            //
-            // If we are told that 0 bytes of FIFO will be used, this implies
-            // that there is an error in psFIFOConfig or the descriptor
-            // somewhere so return an error indicator to the caller.
-            //
-            if(!ulBytesUsed)
-            {
-                return(false);
-            }
-
             //
             // Now actually configure the FIFO for this endpoint.
             //
-            USBFIFOConfigSet(USB0_BASE, INDEX_TO_USB_EP(ulLoop), ulCount,
+            USBFIFOConfigSet(USB_INDEX_TO_BASE(psDevInst->ulIndex),
+                             INDEX_TO_USB_EP(ulLoop), ulCount,
                              ulMaxPkt, USB_EP_DEV_IN);
             ulCount += ulBytesUsed;
         }
@@ -458,23 +609,15 @@ USBDeviceConfig(tDeviceInstance *psDevInst, const tConfigHeader *psConfig)
             //
             ulMaxPkt = GetEndpointFIFOSize(
                                      psEPInfo[ulLoop - 1].ulSize[EP_INFO_OUT],
-                                     &(psFIFOConfig->sOut[ulLoop - 1]),
+                                     (psDevInst->usOUTDoubleBuffered &
+                                      (1 << ulLoop)) ? true : false,
                                      &ulBytesUsed);
 
-            //
-            // If we are told that 0 bytes of FIFO will be used, this implies
-            // that there is an error in psFIFOConfig or the descriptor
-            // somewhere so return an error indicator to the caller.
-            //
-            if(!ulBytesUsed)
-            {
-                return(false);
-            }
-
             //
             // Now actually configure the FIFO for this endpoint.
             //
-            USBFIFOConfigSet(USB0_BASE, INDEX_TO_USB_EP(ulLoop), ulCount,
+            USBFIFOConfigSet(USB_INDEX_TO_BASE(psDevInst->ulIndex),
+                             INDEX_TO_USB_EP(ulLoop), ulCount,
                              ulMaxPkt, USB_EP_DEV_OUT);
             ulCount += ulBytesUsed;
         }
@@ -629,9 +772,10 @@ USBDeviceConfigAlternate(tDeviceInstance *psDevInst, const tConfigHeader *psConf
                     //
                     // Set the endpoint configuration.
                     //
-                    USBDevEndpointConfigSet(USB0_BASE,
-                                            INDEX_TO_USB_EP(ulEpIndex),
-                                            ulMaxPkt, ulFlags);
+                    USBDevEndpointConfigSet(
+                                    USB_INDEX_TO_BASE(psDevInst->ulIndex),
+                                    INDEX_TO_USB_EP(ulEpIndex),
+                                    ulMaxPkt, ulFlags);
                 }
             }
 
@@ -646,6 +790,75 @@ USBDeviceConfigAlternate(tDeviceInstance *psDevInst, const tConfigHeader *psConf
     return(false);
 }
 
+//*****************************************************************************
+//
+//! Determines whether an endpoint's FIFO is double-buffered in the current
+//! configuration.
+//!
+//! \param ulIndex is the index of the USB controller.
+//! \param ulEndpoint is the endpoint to query, specified as one of the
+//! \b USB_EP_x values.
+//! \param ulFlags specifies the direction of the endpoint and must be either
+//! \b USB_EP_DEV_IN or \b USB_EP_DEV_OUT.
+//!
+//! This function allows a class driver to find out whether it may queue a
+//! second packet in an endpoint's FIFO while the first is being transferred.
+//! The result is only meaningful once the host has selected a configuration,
+//! so class drivers typically call this from their configuration change
+//! handler.
+//!
+//! \return Returns \b true if the endpoint FIFO is double-buffered or
+//! \b false otherwise.
+//
+//*****************************************************************************
+tBoolean
+USBDCDEndpointDoubleBuffered(unsigned long ulIndex, unsigned long ulEndpoint,
+                             unsigned long ulFlags)
+{
+    unsigned short usDB;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT((ulFlags == USB_EP_DEV_IN) || (ulFlags == USB_EP_DEV_OUT));
+
+    usDB = (ulFlags == USB_EP_DEV_IN) ?
+           g_psUSBDevice[ulIndex].usINDoubleBuffered :
+           g_psUSBDevice[ulIndex].usOUTDoubleBuffered;
+
+    return((usDB & (1 << USB_EP_TO_INDEX(ulEndpoint))) ? true : false);
+}
+
+//*****************************************************************************
+//
+//! Reports the amount of endpoint FIFO RAM used by the current configuration.
+//!
+//! \param ulIndex is the index of the USB controller.
+//! \param pulAvailable points to storage which is written with the total
+//! size of the USB controller's FIFO RAM in bytes.  This may be NULL if the
+//! caller does not need this value.
+//!
+//! This function returns the number of bytes of FIFO RAM, including that used
+//! by endpoint 0, that the most recently selected configuration requires.
+//! If this exceeds the value written to \e pulAvailable, the configuration
+//! did not fit and its endpoints were not configured.  An application may
+//! then reduce its packet sizes or mark endpoints as single-buffered in its
+//! tFIFOConfig structure.
+//!
+//! \return Returns the number of bytes of FIFO RAM required.
+//
+//*****************************************************************************
+unsigned long
+USBDCDFIFOUsageGet(unsigned long ulIndex, unsigned long *pulAvailable)
+{
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+
+    if(pulAvailable)
+    {
+        *pulAvailable = USB_FIFO_RAM_SIZE;
+    }
+
+    return((unsigned long)g_psUSBDevice[ulIndex].usFIFOUsed);
+}
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
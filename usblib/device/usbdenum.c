@@ -64,7 +64,13 @@ static void USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest);
 static void USBDSyncFrame(void *pvInstance, tUSBRequest *pUSBRequest);
 static void USBDEP0StateTx(unsigned long ulIndex);
 static void USBDEP0StateTxConfig(unsigned long ulIndex);
-static long USBDStringIndexFromRequest(unsigned short usLang,
+static void USBDStringTableInit(unsigned long ulIndex,
+                                const tDeviceInfo *psDevice);
+static void USBDTraceEvent(tDeviceInstance *psDevInst, unsigned long ulEvent,
+                           const tUSBRequest *pRequest);
+static void USBDTraceEnd(tDeviceInstance *psDevInst, unsigned long ulFlags);
+static long USBDStringIndexFromRequest(unsigned long ulIndex,
+                                       unsigned short usLang,
                                        unsigned short usIndex);
 
 //*****************************************************************************
@@ -77,13 +83,14 @@ static long USBDStringIndexFromRequest(unsigned short usLang,
 //*****************************************************************************
 //
 //! The default USB endpoint FIFO configuration structure.  This structure
-//! contains definitions to set all USB FIFOs into single buffered mode with
-//! no DMA use.  Each endpoint's FIFO is sized to hold the largest maximum
-//! packet size for any interface alternate setting in the current
-//! configuration descriptor.  A pointer to this structure may be passed in the
-//! psFIFOConfig field of the tDeviceInfo structure passed to USBCDCInit if the
-//! application does not require any special handling of the USB controller
-//! FIFO.
+//! contains definitions which leave the buffering of each USB FIFO to be
+//! planned automatically, with no DMA use.  Each endpoint's FIFO is sized to
+//! hold the largest maximum packet size for any interface alternate setting
+//! in the current configuration descriptor and bulk and isochronous endpoint
+//! FIFOs are double-buffered if space permits.  A pointer to this structure
+//! may be passed in the psFIFOConfig field of the tDeviceInfo structure passed
+//! to USBCDCInit if the application does not require any special handling of
+//! the USB controller FIFO.
 //
 //*****************************************************************************
 const tFIFOConfig g_sUSBDefaultFIFOConfig =
@@ -180,12 +187,112 @@ const tFIFOConfig g_sUSBDefaultFIFOConfig =
 
 //*****************************************************************************
 //
-// The buffer for reading data coming into EP0
+// The buffers for reading data coming into EP0 on each controller.
 //
 //*****************************************************************************
-static unsigned char g_pucDataBufferIn[EP0_MAX_PACKET_SIZE];
+static unsigned char
+    g_ppucDataBufferIn[USB_NUM_DEVICE_CONTROLLERS][EP0_MAX_PACKET_SIZE];
 
-tDeviceInstance g_psUSBDevice[1];
+//*****************************************************************************
+//
+// The buffers into which each packet of data streamed to the host on EP0 is
+// written before it is sent, one for each controller.
+//
+//*****************************************************************************
+static unsigned char
+    g_ppucEP0Chunk[USB_NUM_DEVICE_CONTROLLERS][EP0_MAX_PACKET_SIZE];
+
+//*****************************************************************************
+//
+// Definitions used to build the BOS descriptor and Microsoft OS 2.0
+// descriptor set.
+//
+//*****************************************************************************
+#define BOS_HEADER_SIZE         5
+#define BOS_USB20_EXT_SIZE      7
+#define BOS_PLATFORM_SIZE       28
+#define BOS_SIZE                (BOS_HEADER_SIZE + BOS_USB20_EXT_SIZE +       \
+                                 BOS_PLATFORM_SIZE)
+#define BOS_CAP_USB20_EXT       2
+#define BOS_CAP_PLATFORM        5
+
+#define MSOS20_SET_HEADER       0
+#define MSOS20_SUBSET_CONFIG    1
+#define MSOS20_SUBSET_FUNCTION  2
+#define MSOS20_COMPATIBLE_ID    3
+#define MSOS20_REG_PROPERTY     4
+
+#define MSOS20_SET_HEADER_SIZE  10
+#define MSOS20_SUBSET_SIZE      8
+#define MSOS20_COMPAT_ID_SIZE   20
+#define MSOS20_REG_HEADER_SIZE  10
+#define MSOS20_REG_MULTI_SZ     7
+#define MSOS20_WINDOWS_VERSION  0x06030000
+#define MSOS20_MAX_GUID_CHARS   38
+#define MSOS20_SET_MAX_SIZE     (MSOS20_SET_HEADER_SIZE +                     \
+                                 (2 * MSOS20_SUBSET_SIZE) +                   \
+                                 MSOS20_COMPAT_ID_SIZE +                      \
+                                 MSOS20_REG_HEADER_SIZE +                     \
+                                 sizeof(g_pcMSOS20GUIDName) * 2 +             \
+                                 (MSOS20_MAX_GUID_CHARS + 2) * 2)
+
+//*****************************************************************************
+//
+// The UUID identifying the Microsoft OS 2.0 platform capability,
+// {D8DD60DF-4589-4CC7-9CD2-659D9E648A9F}, in the order sent on the bus.
+//
+//*****************************************************************************
+static const unsigned char g_pucMSOS20PlatformUUID[16] =
+{
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,
+    0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F
+};
+
+//*****************************************************************************
+//
+// The name of the registry property which holds the device interface GUIDs.
+//
+//*****************************************************************************
+static const char g_pcMSOS20GUIDName[] = "DeviceInterfaceGUIDs";
+
+//*****************************************************************************
+//
+// The BOS descriptor and Microsoft OS 2.0 descriptor set generated by
+// USBDCDMSOS20Set() for each controller.  The BOS descriptor is only served
+// if the descriptor set size is non-zero.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char pucBOSDescriptor[BOS_SIZE];
+    unsigned char pucSet[MSOS20_SET_MAX_SIZE];
+    unsigned long ulSetSize;
+    unsigned char ucVendorCode;
+}
+tMSOS20Descriptors;
+
+static tMSOS20Descriptors g_psMSOS20Descriptors[USB_NUM_DEVICE_CONTROLLERS];
+
+tDeviceInstance g_psUSBDevice[USB_NUM_DEVICE_CONTROLLERS];
+
+//*****************************************************************************
+//
+// The index of the controller whose start of frame interrupts drive the USB
+// tick or USB_SOF_TICK_NONE if no controller has been chosen.  Only one
+// controller is used so that the tick does not run faster when several are
+// connected to hosts.
+//
+//*****************************************************************************
+#define USB_SOF_TICK_NONE       0xFFFFFFFF
+static unsigned long g_ulSOFTickIndex = USB_SOF_TICK_NONE;
+
+//*****************************************************************************
+//
+// Returns the USBD_DEFER_xxx flag for the type of a request.
+//
+//*****************************************************************************
+#define USBD_DEFER_FLAG(ucRequestType)                                        \
+        (1 << (((ucRequestType) & USB_RTYPE_TYPE_M) >> 5))
 
 //*****************************************************************************
 //
@@ -240,6 +347,11 @@ static const tStdRequest g_psUSBDStdRequests[] =
 //! unchanged between this call and any matching call to USBDCDTerm() since
 //! it is not copied by the USB library.
 //!
+//! On parts with more than one USB controller, each controller has its own
+//! device state and may be initialized with a different device information
+//! structure so that several devices operate at the same time.  The mode set
+//! by USBStackModeSet() applies only to controller 0.
+//!
 //! The USBStackModeSet() function can be called with USB_MODE_FORCE_DEVICE in
 //! order to cause the USB library to force the USB operating mode to a device
 //! controller.  This allows the application to used the USBVBUS and USBID pins
@@ -259,54 +371,75 @@ USBDCDInit(unsigned long ulIndex, tDeviceInfo *psDevice)
 {
     const tConfigHeader *psHdr;
     const tConfigDescriptor *psDesc;
+    tUSBMode eMode;
 
     //
     // Check the arguments.
     //
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
     ASSERT(psDevice != 0);
 
     //
-    // Should not call this if the stack is in host mode.
+    // Initialize a couple of fields in the device state structure.
     //
-    ASSERT(g_eUSBMode != USB_MODE_HOST);
-    ASSERT(g_eUSBMode != USB_MODE_FORCE_HOST);
+    g_psUSBDevice[ulIndex].ulIndex = ulIndex;
+    g_psUSBDevice[ulIndex].ulConfiguration = DEFAULT_CONFIG_ID;
+    g_psUSBDevice[ulIndex].ulDefaultConfiguration = DEFAULT_CONFIG_ID;
 
     //
-    // Initialize a couple of fields in the device state structure.
+    // Remember the device information pointer.
     //
-    g_psUSBDevice[0].ulConfiguration = DEFAULT_CONFIG_ID;
-    g_psUSBDevice[0].ulDefaultConfiguration = DEFAULT_CONFIG_ID;
+    g_psUSBDevice[ulIndex].psInfo = psDevice;
+    g_psUSBDevice[ulIndex].pvInstance = psDevice->pvInstance;
+    g_psUSBDevice[ulIndex].eEP0State = USB_STATE_IDLE;
 
     //
-    // Remember the device information pointer.
+    // Check the layout of the string descriptor table and build the table
+    // used to find the strings for each language.
     //
-    g_psUSBDevice[0].psInfo = psDevice;
-    g_psUSBDevice[0].pvInstance = psDevice->pvInstance;
-    g_psUSBDevice[0].eEP0State = USB_STATE_IDLE;
+    USBDStringTableInit(ulIndex, psDevice);
 
     //
-    // Default to device mode if no mode was set.
+    // The mode set by USBStackModeSet() applies to controller 0 only.  Any
+    // other controller always operates as a device.
     //
-    if(g_eUSBMode == USB_MODE_NONE)
+    if(ulIndex == 0)
     {
-        g_eUSBMode = USB_MODE_DEVICE;
+        //
+        // Should not call this if the stack is in host mode.
+        //
+        ASSERT(g_eUSBMode != USB_MODE_HOST);
+        ASSERT(g_eUSBMode != USB_MODE_FORCE_HOST);
+
+        //
+        // Default to device mode if no mode was set.
+        //
+        if(g_eUSBMode == USB_MODE_NONE)
+        {
+            g_eUSBMode = USB_MODE_DEVICE;
+        }
+
+        eMode = g_eUSBMode;
+    }
+    else
+    {
+        eMode = USB_MODE_DEVICE;
     }
 
     //
     // Only do hardware update if the stack is in not in OTG mode.
     //
-    if(g_eUSBMode != USB_MODE_OTG)
+    if(eMode != USB_MODE_OTG)
     {
         //
         // Reset the USB controller.
         //
-        MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_USB0);
+        MAP_SysCtlPeripheralReset(USB_INDEX_TO_PERIPH(ulIndex));
 
         //
         // Enable Clocking to the USB controller.
         //
-        MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_USB0);
+        MAP_SysCtlPeripheralEnable(USB_INDEX_TO_PERIPH(ulIndex));
 
         //
         // Turn on USB Phy clock.
@@ -318,26 +451,29 @@ USBDCDInit(unsigned long ulIndex, tDeviceInfo *psDevice)
         // detection to OTG.  If the mode was device then the rest of the library
         // should make sure that no OTG signaling actually occurs.
         //
-        if((g_eUSBMode == USB_MODE_DEVICE) || (g_eUSBMode == USB_MODE_OTG))
+        if((eMode == USB_MODE_DEVICE) || (eMode == USB_MODE_OTG))
         {
             //
             // Switch to OTG mode to detect VBUS changes.
             //
-            MAP_USBOTGMode(USB0_BASE);
+            MAP_USBOTGMode(USB_INDEX_TO_BASE(ulIndex));
         }
         else
         {
             //
             // Force device mode on devices that support forcing mode.
             //
-            MAP_USBDevMode(USB0_BASE);
+            MAP_USBDevMode(USB_INDEX_TO_BASE(ulIndex));
         }
 
         //
         // In all other cases, set the mode to device this function should not
         // be called in OTG mode.
         //
-        g_eUSBMode = USB_MODE_DEVICE;
+        if(ulIndex == 0)
+        {
+            g_eUSBMode = USB_MODE_DEVICE;
+        }
     }
 
     //
@@ -349,57 +485,84 @@ USBDCDInit(unsigned long ulIndex, tDeviceInfo *psDevice)
     // Get a pointer to the default configuration descriptor.
     //
     psHdr = psDevice->ppConfigDescriptors[
-                g_psUSBDevice[0].ulDefaultConfiguration - 1];
+                g_psUSBDevice[ulIndex].ulDefaultConfiguration - 1];
     psDesc = (const tConfigDescriptor *)(psHdr->psSections[0]->pucData);
 
     //
     // Default to the state where remote wake up is disabled.
     //
-    g_psUSBDevice[0].ucStatus = 0;
-    g_psUSBDevice[0].bRemoteWakeup = false;
+    g_psUSBDevice[ulIndex].ucStatus = 0;
+    g_psUSBDevice[ulIndex].bRemoteWakeup = false;
+
+    //
+    // No endpoint FIFOs have been planned until a configuration is selected.
+    //
+    g_psUSBDevice[ulIndex].usINDoubleBuffered = 0;
+    g_psUSBDevice[ulIndex].usOUTDoubleBuffered = 0;
+    g_psUSBDevice[ulIndex].usFIFOUsed = 0;
+
+    //
+    // No data is being streamed on endpoint zero.
+    //
+    g_psUSBDevice[ulIndex].pfnEP0Fill = 0;
+    g_psUSBDevice[ulIndex].pvEP0FillData = 0;
+
+    //
+    // Configuration descriptors are sent section by section until the
+    // application flattens them.
+    //
+    g_psUSBDevice[ulIndex].pucFlatConfig = 0;
+
+    //
+    // All requests are handled from the interrupt handler until the
+    // application calls USBDCDDeferRequests().
+    //
+    g_psUSBDevice[ulIndex].ulDeferTypes = 0;
+    g_psUSBDevice[ulIndex].bRequestDeferred = false;
 
     //
     // Determine the self- or bus-powered state based on the flags the
     // user provided.
     //
-    g_psUSBDevice[0].bPwrSrcSet = false;
+    g_psUSBDevice[ulIndex].bPwrSrcSet = false;
 
     if((psDesc->bmAttributes & USB_CONF_ATTR_PWR_M) == USB_CONF_ATTR_SELF_PWR)
     {
-        g_psUSBDevice[0].ucStatus |= USB_STATUS_SELF_PWR;
+        g_psUSBDevice[ulIndex].ucStatus |= USB_STATUS_SELF_PWR;
     }
     else
     {
-        g_psUSBDevice[0].ucStatus &= ~USB_STATUS_SELF_PWR;
+        g_psUSBDevice[ulIndex].ucStatus &= ~USB_STATUS_SELF_PWR;
     }
 
     //
     // Only do hardware update if the stack is not in OTG mode.
     //
-    if(g_eUSBMode != USB_MODE_OTG)
+    if(eMode != USB_MODE_OTG)
     {
         //
         // Get the current interrupt status.to clear all pending USB interrupts.
         //
-        MAP_USBIntStatusControl(USB0_BASE);
-        MAP_USBIntStatusEndpoint(USB0_BASE);
+        MAP_USBIntStatusControl(USB_INDEX_TO_BASE(ulIndex));
+        MAP_USBIntStatusEndpoint(USB_INDEX_TO_BASE(ulIndex));
 
         //
         // Enable USB Interrupts.
         //
-        MAP_USBIntEnableControl(USB0_BASE, USB_INTCTRL_RESET |
-                                           USB_INTCTRL_DISCONNECT |
-                                           USB_INTCTRL_RESUME |
-                                           USB_INTCTRL_SUSPEND |
-                                           USB_INTCTRL_SOF);
-        MAP_USBIntEnableEndpoint(USB0_BASE, USB_INTEP_ALL);
+        MAP_USBIntEnableControl(USB_INDEX_TO_BASE(ulIndex),
+                                USB_INTCTRL_RESET |
+                                USB_INTCTRL_DISCONNECT |
+                                USB_INTCTRL_RESUME |
+                                USB_INTCTRL_SUSPEND |
+                                USB_INTCTRL_SOF);
+        MAP_USBIntEnableEndpoint(USB_INDEX_TO_BASE(ulIndex), USB_INTEP_ALL);
 
         //
         // Make sure we disconnect from the host for a while.  This ensures
         // that the host will enumerate us even if we were previously
         // connected to the bus.
         //
-        MAP_USBDevDisconnect(USB0_BASE);
+        MAP_USBDevDisconnect(USB_INDEX_TO_BASE(ulIndex));
 
         //
         // Wait about 100mS.
@@ -409,15 +572,37 @@ USBDCDInit(unsigned long ulIndex, tDeviceInfo *psDevice)
         //
         // Attach the device using the soft connect.
         //
-        MAP_USBDevConnect(USB0_BASE);
+        MAP_USBDevConnect(USB_INDEX_TO_BASE(ulIndex));
 
         //
         // Enable the USB interrupt.
         //
-        OS_INT_ENABLE(INT_USB0);
+        OS_INT_ENABLE(USB_INDEX_TO_INT(ulIndex));
     }
 }
 
+//*****************************************************************************
+//
+// Determines whether any USB controller currently has a device attached to
+// it via USBDCDInit().
+//
+//*****************************************************************************
+static tBoolean
+USBDControllersInUse(void)
+{
+    unsigned long ulLoop;
+
+    for(ulLoop = 0; ulLoop < USB_NUM_DEVICE_CONTROLLERS; ulLoop++)
+    {
+        if(g_psUSBDevice[ulLoop].psInfo)
+        {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
 //*****************************************************************************
 //
 //! Free the USB library device control driver for a given hardware controller.
@@ -441,45 +626,61 @@ USBDCDTerm(unsigned long ulIndex)
     //
     // Check the arguments.
     //
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
     // Disable the USB interrupts.
     //
-    OS_INT_DISABLE(INT_USB0);
+    OS_INT_DISABLE(USB_INDEX_TO_INT(ulIndex));
+
+    g_psUSBDevice[ulIndex].psInfo = (tDeviceInfo *)0;
+    g_psUSBDevice[ulIndex].pvInstance = 0;
 
     //
-    // Reset the tick handlers so that they can be reconfigured when and if
-    // USBDCDInit() is called.
+    // Stop using this controller's start of frame interrupts to drive the
+    // USB tick.
     //
-    InternalUSBTickReset();
+    if(g_ulSOFTickIndex == ulIndex)
+    {
+        g_ulSOFTickIndex = USB_SOF_TICK_NONE;
+    }
 
-    g_psUSBDevice[0].psInfo = (tDeviceInfo *)0;
-    g_psUSBDevice[0].pvInstance = 0;
+    //
+    // Reset the tick handlers so that they can be reconfigured when and if
+    // USBDCDInit() is called.  These are shared by all controllers so are
+    // left alone until the last one is freed.
+    //
+    if(!USBDControllersInUse())
+    {
+        InternalUSBTickReset();
+    }
 
-    MAP_USBIntDisableControl(USB0_BASE, USB_INTCTRL_ALL);
-    MAP_USBIntDisableEndpoint(USB0_BASE, USB_INTEP_ALL);
+    MAP_USBIntDisableControl(USB_INDEX_TO_BASE(ulIndex), USB_INTCTRL_ALL);
+    MAP_USBIntDisableEndpoint(USB_INDEX_TO_BASE(ulIndex), USB_INTEP_ALL);
 
     //
     // Detach the device using the soft connect.
     //
-    MAP_USBDevDisconnect(USB0_BASE);
+    MAP_USBDevDisconnect(USB_INDEX_TO_BASE(ulIndex));
 
     //
     // Clear any pending interrupts.
     //
-    MAP_USBIntStatusControl(USB0_BASE);
-    MAP_USBIntStatusEndpoint(USB0_BASE);
+    MAP_USBIntStatusControl(USB_INDEX_TO_BASE(ulIndex));
+    MAP_USBIntStatusEndpoint(USB_INDEX_TO_BASE(ulIndex));
 
     //
-    // Turn off USB Phy clock.
+    // Turn off USB Phy clock unless another controller is still using it.
     //
-    MAP_SysCtlUSBPLLDisable();
+    if(!USBDControllersInUse())
+    {
+        MAP_SysCtlUSBPLLDisable();
+    }
 
     //
     // Disable the USB peripheral
     //
-    MAP_SysCtlPeripheralDisable(SYSCTL_PERIPH_USB0);
+    MAP_SysCtlPeripheralDisable(USB_INDEX_TO_PERIPH(ulIndex));
 }
 
 //*****************************************************************************
@@ -504,79 +705,897 @@ USBDCDTerm(unsigned long ulIndex)
 //! \return None.
 //
 //*****************************************************************************
-void
-USBDCDRequestDataEP0(unsigned long ulIndex, unsigned char *pucData,
-                     unsigned long ulSize)
+void
+USBDCDRequestDataEP0(unsigned long ulIndex, unsigned char *pucData,
+                     unsigned long ulSize)
+{
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+
+    //
+    // This may be called from USBDCDProcessDeferred() so make sure that the
+    // endpoint zero interrupt cannot see the state change before the buffer
+    // has been set up.
+    //
+    bIntsOff = IntMasterDisable();
+
+    //
+    // Save the pointer to the data.
+    //
+    g_psUSBDevice[ulIndex].pEP0Data = pucData;
+
+    //
+    // Location to save the current number of bytes received.
+    //
+    g_psUSBDevice[ulIndex].ulOUTDataSize = ulSize;
+
+    //
+    // Bytes remaining to be received.
+    //
+    g_psUSBDevice[ulIndex].ulEP0DataRemain = ulSize;
+
+    //
+    // Enter the RX state on end point 0.
+    //
+    g_psUSBDevice[ulIndex].eEP0State = USB_STATE_RX;
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! This function requests transfer of data to the host on endpoint zero.
+//!
+//! \param ulIndex is the index of the USB controller which is to be used to
+//! send the data.
+//! \param pucData is a pointer to the buffer to send via endpoint zero.
+//! \param ulSize is the amount of data to send in bytes.
+//!
+//! This function handles sending data to the host when a custom command is
+//! issued or non-standard descriptor has been requested on endpoint zero.  If
+//! the application needs notification when this is complete,
+//! <tt>tDeviceInfo.sCallbacks.pfnDataSent</tt> should contain a valid function
+//! pointer.  This callback could be used to free up the buffer passed into
+//! this function in the \e pucData parameter.  The contents of the \e pucData
+//! buffer must remain unchanged until the <tt>pfnDataSent</tt> callback is
+//! received.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDSendDataEP0(unsigned long ulIndex, unsigned char *pucData,
+                  unsigned long ulSize)
+{
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+
+    //
+    // This may be called from USBDCDProcessDeferred() so make sure that the
+    // endpoint zero interrupt cannot run until the first packet has been
+    // queued and the endpoint zero state is complete.
+    //
+    bIntsOff = IntMasterDisable();
+
+    //
+    // The data is sent from the buffer rather than streamed.
+    //
+    g_psUSBDevice[ulIndex].pfnEP0Fill = 0;
+
+    //
+    // Return the externally provided device descriptor.
+    //
+    g_psUSBDevice[ulIndex].pEP0Data = pucData;
+
+    //
+    // The size of the device descriptor is in the first byte.
+    //
+    g_psUSBDevice[ulIndex].ulEP0DataRemain = ulSize;
+
+    //
+    // Save the total size of the data sent.
+    //
+    g_psUSBDevice[ulIndex].ulOUTDataSize = ulSize;
+
+    //
+    // Now in the transmit data state.
+    //
+    USBDEP0StateTx(ulIndex);
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! This function requests transfer of streamed data to the host on endpoint
+//! zero.
+//!
+//! \param ulIndex is the index of the USB controller which is to be used to
+//! send the data.
+//! \param ulSize is the amount of data to send in bytes.
+//! \param pfnFill is a pointer to the function which provides the data.
+//! \param pvFillData is a pointer which is passed to \e pfnFill.
+//!
+//! This function may be used in place of USBDCDSendDataEP0() when the data to
+//! be sent in response to a custom command is not held in a single buffer,
+//! for example because it is generated on the fly or is larger than the
+//! application can afford to hold in RAM.  Rather than sending data from a
+//! buffer, the library calls \e pfnFill each time it needs another packet of
+//! up to 64 bytes, passing the offset of the packet within the data and a
+//! buffer into which the packet is to be written.  The function is called
+//! from interrupt context.
+//!
+//! The caller is responsible for limiting \e ulSize to the length requested
+//! by the host.  As with USBDCDSendDataEP0(), the
+//! <tt>tDeviceInfo.sCallbacks.pfnDataSent</tt> callback is made when the last
+//! packet has been sent.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDSendStreamEP0(unsigned long ulIndex, unsigned long ulSize,
+                    tUSBEP0Fill pfnFill, void *pvFillData)
+{
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT(pfnFill);
+
+    //
+    // As for USBDCDSendDataEP0(), keep the endpoint zero interrupt out until
+    // the first packet has been queued.
+    //
+    bIntsOff = IntMasterDisable();
+
+    //
+    // Remember where the data is to come from.
+    //
+    g_psUSBDevice[ulIndex].pfnEP0Fill = pfnFill;
+    g_psUSBDevice[ulIndex].pvEP0FillData = pvFillData;
+    g_psUSBDevice[ulIndex].pEP0Data = g_ppucEP0Chunk[ulIndex];
+
+    //
+    // Set the size of the data to send and save the total size.
+    //
+    g_psUSBDevice[ulIndex].ulEP0DataRemain = ulSize;
+    g_psUSBDevice[ulIndex].ulOUTDataSize = ulSize;
+
+    //
+    // Now in the transmit data state.
+    //
+    USBDEP0StateTx(ulIndex);
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+// Writes a 16-bit little-endian value into a descriptor.
+//
+//*****************************************************************************
+static void
+USBDWriteShort(unsigned char *pucDst, unsigned long ulValue)
+{
+    pucDst[0] = (unsigned char)ulValue;
+    pucDst[1] = (unsigned char)(ulValue >> 8);
+}
+
+//*****************************************************************************
+//
+// Writes a 32-bit little-endian value into a descriptor.
+//
+//*****************************************************************************
+static void
+USBDWriteLong(unsigned char *pucDst, unsigned long ulValue)
+{
+    USBDWriteShort(pucDst, ulValue);
+    USBDWriteShort(pucDst + 2, ulValue >> 16);
+}
+
+//*****************************************************************************
+//
+// Writes an ASCII string into a descriptor as a NULL-terminated UTF-16LE
+// string, returning the number of bytes written.
+//
+//*****************************************************************************
+static unsigned long
+USBDWriteUnicode(unsigned char *pucDst, const char *pcString)
+{
+    unsigned long ulSize;
+
+    ulSize = 0;
+
+    do
+    {
+        pucDst[ulSize++] = (unsigned char)*pcString;
+        pucDst[ulSize++] = 0;
+    }
+    while(*pcString++);
+
+    return(ulSize);
+}
+
+//*****************************************************************************
+//
+//! This function sets the Microsoft OS 2.0 descriptors for the device.
+//!
+//! \param ulIndex is the index of the USB controller whose descriptors are to
+//! be set.
+//! \param psConfig is a pointer to a structure describing the descriptors or
+//! 0 to remove any descriptors previously set.
+//!
+//! Windows 8.1 and later read a device's BOS descriptor during enumeration
+//! and, if it contains a Microsoft OS 2.0 platform capability, read the
+//! Microsoft OS 2.0 descriptor set using a single vendor request.  This allows
+//! a driver such as WinUSB to be bound to the device without the separate
+//! string descriptor, compatible ID and extended properties requests used by
+//! the original Microsoft OS descriptors.
+//!
+//! This function generates the BOS descriptor and a descriptor set holding
+//! the compatible ID and, optionally, the DeviceInterfaceGUIDs registry
+//! property from the compact description in \e psConfig.  The library then
+//! answers GET_DESCRIPTOR requests for the BOS descriptor and the vendor
+//! request with bRequest \e psConfig->ucVendorCode and wIndex
+//! \b USB_MSOS20_DESCRIPTOR_INDEX itself.  Other vendor requests with the same
+//! bRequest value are still passed to the device's request handler.
+//!
+//! The host only asks for the BOS descriptor if the bcdUSB field of the device
+//! descriptor is 0x0201 or greater.  The application must set this.
+//!
+//! \return Returns \b false if the compatible ID or interface GUID is too long
+//! or \b true otherwise.
+//
+//*****************************************************************************
+tBoolean
+USBDCDMSOS20Set(unsigned long ulIndex, const tUSBMSOS20Config *psConfig)
+{
+    unsigned long ulPos, ulLoop, ulConfigPos, ulFuncPos, ulRegPos;
+    unsigned char *pucSet;
+    tMSOS20Descriptors *psMSOS20;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+
+    psMSOS20 = &g_psMSOS20Descriptors[ulIndex];
+
+    //
+    // Stop serving any previous descriptors.
+    //
+    psMSOS20->ulSetSize = 0;
+
+    if(!psConfig)
+    {
+        return(true);
+    }
+
+    //
+    // Make sure that the strings will fit.
+    //
+    for(ulLoop = 0; psConfig->pcCompatibleID[ulLoop]; ulLoop++)
+    {
+    }
+    if(ulLoop > 8)
+    {
+        return(false);
+    }
+    if(psConfig->pcInterfaceGUID)
+    {
+        for(ulLoop = 0; psConfig->pcInterfaceGUID[ulLoop]; ulLoop++)
+        {
+        }
+        if(ulLoop > MSOS20_MAX_GUID_CHARS)
+        {
+            return(false);
+        }
+    }
+
+    pucSet = psMSOS20->pucSet;
+
+    //
+    // The descriptor set header.  The total length is filled in at the end.
+    //
+    USBDWriteShort(pucSet, MSOS20_SET_HEADER_SIZE);
+    USBDWriteShort(pucSet + 2, MSOS20_SET_HEADER);
+    USBDWriteLong(pucSet + 4, MSOS20_WINDOWS_VERSION);
+    ulPos = MSOS20_SET_HEADER_SIZE;
+    ulConfigPos = 0;
+    ulFuncPos = 0;
+
+    //
+    // If the descriptors apply to a single function, add the configuration
+    // and function subset headers.  Their lengths are filled in at the end.
+    //
+    if(psConfig->ucFirstInterface != USB_MSOS20_DEVICE)
+    {
+        ulConfigPos = ulPos;
+        USBDWriteShort(pucSet + ulPos, MSOS20_SUBSET_SIZE);
+        USBDWriteShort(pucSet + ulPos + 2, MSOS20_SUBSET_CONFIG);
+        pucSet[ulPos + 4] = 0;
+        pucSet[ulPos + 5] = 0;
+        ulPos += MSOS20_SUBSET_SIZE;
+
+        ulFuncPos = ulPos;
+        USBDWriteShort(pucSet + ulPos, MSOS20_SUBSET_SIZE);
+        USBDWriteShort(pucSet + ulPos + 2, MSOS20_SUBSET_FUNCTION);
+        pucSet[ulPos + 4] = psConfig->ucFirstInterface;
+        pucSet[ulPos + 5] = 0;
+        ulPos += MSOS20_SUBSET_SIZE;
+    }
+
+    //
+    // The compatible ID, padded with zeros, and an empty sub-compatible ID.
+    //
+    USBDWriteShort(pucSet + ulPos, MSOS20_COMPAT_ID_SIZE);
+    USBDWriteShort(pucSet + ulPos + 2, MSOS20_COMPATIBLE_ID);
+    for(ulLoop = 0; ulLoop < 16; ulLoop++)
+    {
+        pucSet[ulPos + 4 + ulLoop] = 0;
+    }
+    for(ulLoop = 0; psConfig->pcCompatibleID[ulLoop]; ulLoop++)
+    {
+        pucSet[ulPos + 4 + ulLoop] = psConfig->pcCompatibleID[ulLoop];
+    }
+    ulPos += MSOS20_COMPAT_ID_SIZE;
+
+    //
+    // The DeviceInterfaceGUIDs registry property, if required.  This is a
+    // REG_MULTI_SZ holding a single string so an extra NULL terminates it.
+    //
+    if(psConfig->pcInterfaceGUID)
+    {
+        ulRegPos = ulPos;
+        USBDWriteShort(pucSet + ulPos + 2, MSOS20_REG_PROPERTY);
+        USBDWriteShort(pucSet + ulPos + 4, MSOS20_REG_MULTI_SZ);
+        ulLoop = USBDWriteUnicode(pucSet + ulPos + 8, g_pcMSOS20GUIDName);
+        USBDWriteShort(pucSet + ulPos + 6, ulLoop);
+        ulPos += 8 + ulLoop;
+        ulLoop = USBDWriteUnicode(pucSet + ulPos + 2,
+                                  psConfig->pcInterfaceGUID);
+        USBDWriteShort(pucSet + ulPos + 2 + ulLoop, 0);
+        ulLoop += 2;
+        USBDWriteShort(pucSet + ulPos, ulLoop);
+        ulPos += 2 + ulLoop;
+        USBDWriteShort(pucSet + ulRegPos, ulPos - ulRegPos);
+    }
+
+    //
+    // Fill in the lengths of the set and any subsets.
+    //
+    USBDWriteShort(pucSet + 8, ulPos);
+    if(ulConfigPos)
+    {
+        USBDWriteShort(pucSet + ulConfigPos + 6, ulPos - ulConfigPos);
+        USBDWriteShort(pucSet + ulFuncPos + 6, ulPos - ulFuncPos);
+    }
+
+    //
+    // Build the BOS descriptor.  This holds the USB 2.0 extension capability,
+    // required of devices with bcdUSB 0x0201 or greater, with no link power
+    // management support, followed by the Microsoft OS 2.0 platform
+    // capability.
+    //
+    pucSet = psMSOS20->pucBOSDescriptor;
+    pucSet[0] = BOS_HEADER_SIZE;
+    pucSet[1] = USB_DTYPE_BOS;
+    USBDWriteShort(pucSet + 2, BOS_SIZE);
+    pucSet[4] = 2;
+    pucSet += BOS_HEADER_SIZE;
+
+    pucSet[0] = BOS_USB20_EXT_SIZE;
+    pucSet[1] = USB_DTYPE_DEVICE_CAP;
+    pucSet[2] = BOS_CAP_USB20_EXT;
+    USBDWriteLong(pucSet + 3, 0);
+    pucSet += BOS_USB20_EXT_SIZE;
+
+    pucSet[0] = BOS_PLATFORM_SIZE;
+    pucSet[1] = USB_DTYPE_DEVICE_CAP;
+    pucSet[2] = BOS_CAP_PLATFORM;
+    pucSet[3] = 0;
+    for(ulLoop = 0; ulLoop < 16; ulLoop++)
+    {
+        pucSet[4 + ulLoop] = g_pucMSOS20PlatformUUID[ulLoop];
+    }
+    USBDWriteLong(pucSet + 20, MSOS20_WINDOWS_VERSION);
+    USBDWriteShort(pucSet + 24, ulPos);
+    pucSet[26] = psConfig->ucVendorCode;
+    pucSet[27] = 0;
+
+    //
+    // Start serving the descriptors.
+    //
+    psMSOS20->ucVendorCode = psConfig->ucVendorCode;
+    psMSOS20->ulSetSize = ulPos;
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! This function copies the device's configuration descriptors into a single
+//! buffer from which they are then served.
+//!
+//! \param ulIndex is the index of the USB controller whose configuration
+//! descriptors are to be flattened.
+//! \param pucBuffer is a pointer to the buffer which is to hold the
+//! descriptors or 0 to query the buffer size required.
+//! \param ulSize is the size of the buffer pointed to by \e pucBuffer.
+//!
+//! Configuration descriptors are normally built from a list of sections which
+//! USBDEP0StateTxConfig() gathers into each packet sent on endpoint zero as
+//! the host reads the descriptor.  This function concatenates the sections of
+//! every configuration, in order, into \e pucBuffer with the wTotalLength
+//! field of each configuration descriptor filled in.  Requests for
+//! configuration descriptors are then answered from this buffer in the same
+//! way as any other contiguous descriptor.
+//!
+//! The class drivers fill in interface and endpoint numbers in their
+//! descriptors when they are initialized so this function must be called
+//! after the class initialization function, USBDBulkInit() for example.  The
+//! buffer must not be changed while the device is in use.  Any later call to
+//! USBDCDInit() returns to serving the descriptors section by section.
+//!
+//! \return Returns the number of bytes required to hold the descriptors or 0
+//! if \e ulSize is too small, in which case the descriptors continue to be
+//! served section by section.
+//
+//*****************************************************************************
+unsigned long
+USBDCDConfigDescFlatten(unsigned long ulIndex, unsigned char *pucBuffer,
+                        unsigned long ulSize)
+{
+    const tDeviceInfo *psDevice;
+    const tDeviceDescriptor *psDeviceDesc;
+    const tConfigHeader *psConfig;
+    const tConfigSection *psSection;
+    unsigned long ulConfig, ulSection, ulLoop, ulPos, ulTotal;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT(g_psUSBDevice[ulIndex].psInfo);
+
+    psDevice = g_psUSBDevice[ulIndex].psInfo;
+    psDeviceDesc = (const tDeviceDescriptor *)psDevice->pDeviceDescriptor;
+
+    //
+    // Determine the space needed for all of the configurations.
+    //
+    ulTotal = 0;
+    for(ulConfig = 0; ulConfig < psDeviceDesc->bNumConfigurations; ulConfig++)
+    {
+        ulTotal +=
+            USBDCDConfigDescGetSize(psDevice->ppConfigDescriptors[ulConfig]);
+    }
+
+    //
+    // If this is only a query, or the buffer is too small, return without
+    // changing how the descriptors are served.
+    //
+    if(!pucBuffer)
+    {
+        return(ulTotal);
+    }
+    if(ulTotal > ulSize)
+    {
+        return(0);
+    }
+
+    //
+    // Stop serving any previously flattened descriptors while the buffer is
+    // being filled.
+    //
+    g_psUSBDevice[ulIndex].pucFlatConfig = 0;
+
+    ulPos = 0;
+    for(ulConfig = 0; ulConfig < psDeviceDesc->bNumConfigurations; ulConfig++)
+    {
+        psConfig = psDevice->ppConfigDescriptors[ulConfig];
+        ulTotal = ulPos;
+
+        //
+        // Copy each of the sections that make up this configuration.
+        //
+        for(ulSection = 0; ulSection < psConfig->ucNumSections; ulSection++)
+        {
+            psSection = psConfig->psSections[ulSection];
+            for(ulLoop = 0; ulLoop < psSection->usSize; ulLoop++)
+            {
+                pucBuffer[ulPos++] = psSection->pucData[ulLoop];
+            }
+        }
+
+        //
+        // Fill in the wTotalLength field of the configuration descriptor.
+        //
+        USBDWriteShort(pucBuffer + ulTotal + 2, ulPos - ulTotal);
+    }
+
+    //
+    // Start serving the descriptors from the buffer.
+    //
+    g_psUSBDevice[ulIndex].pucFlatConfig = pucBuffer;
+
+    return(ulPos);
+}
+
+//*****************************************************************************
+//
+//! This function selects the types of request which are to be handled outside
+//! interrupt context.
+//!
+//! \param ulIndex is the index of the USB controller whose requests are to be
+//! deferred.
+//! \param ulTypes is the logical OR of the types of request which are to be
+//! deferred, \b USBD_DEFER_CLASS and \b USBD_DEFER_VENDOR, or 0 to handle
+//! all requests from the interrupt handler.
+//!
+//! Non-standard requests are normally passed to the device's request handler
+//! from the USB interrupt handler, delaying service of every other endpoint
+//! until the handler returns.  When a request of one of the types given here
+//! is received, the interrupt handler instead saves it without acknowledging
+//! the setup packet, causing the controller to NAK the data and status stages
+//! of the transfer, and the request handler is called the next time the
+//! application calls USBDCDProcessDeferred().  The handler responds exactly as
+//! it would from the interrupt handler.
+//!
+//! A request handler called in this way can be interrupted by the USB
+//! interrupt handler so it must protect any state it shares with the device's
+//! other callbacks.  The host typically allows five seconds for a control
+//! transfer so USBDCDProcessDeferred() must be called frequently enough to
+//! answer within that time.
+//!
+//! A deferred handler which receives data from the host must call
+//! USBDCDRequestDataEP0() before acknowledging the setup packet since the
+//! data may arrive as soon as the setup packet is acknowledged.  The endpoint
+//! zero functions disable interrupts briefly while they update the endpoint
+//! zero state so that they are safe to call from a deferred handler.
+//!
+//! Standard requests and the Microsoft OS 2.0 descriptor request are always
+//! handled from the interrupt handler.  This function must be called after
+//! the class initialization function, USBDBulkInit() for example, since any
+//! later call to USBDCDInit() returns to handling all requests from the
+//! interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDDeferRequests(unsigned long ulIndex, unsigned long ulTypes)
+{
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT(!(ulTypes & ~(USBD_DEFER_CLASS | USBD_DEFER_VENDOR)));
+
+    g_psUSBDevice[ulIndex].ulDeferTypes = ulTypes;
+}
+
+//*****************************************************************************
+//
+//! This function handles any request which the USB interrupt handler has
+//! deferred.
+//!
+//! \param ulIndex is the index of the USB controller whose deferred request
+//! is to be handled.
+//!
+//! This function must be called periodically from the application's main
+//! loop when USBDCDDeferRequests() has been used to defer requests.  If a
+//! request is waiting, it is passed to the device's request handler with
+//! interrupts enabled.  If no request is waiting, the function returns
+//! immediately.  It must not be called from interrupt context.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDProcessDeferred(unsigned long ulIndex)
+{
+    tDeviceInstance *psUSBControl;
+    tUSBRequest sRequest;
+    tBoolean bIntsOff, bPending;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+
+    psUSBControl = &g_psUSBDevice[ulIndex];
+
+    //
+    // Return quickly in the usual case where nothing is waiting.
+    //
+    if(!psUSBControl->bRequestDeferred)
+    {
+        return;
+    }
+
+    //
+    // Take the request with interrupts disabled so that a bus reset or new
+    // setup packet cannot replace it while it is being copied.
+    //
+    bIntsOff = IntMasterDisable();
+
+    bPending = psUSBControl->bRequestDeferred;
+    if(bPending)
+    {
+        sRequest = psUSBControl->sDeferredRequest;
+        psUSBControl->bRequestDeferred = false;
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    //
+    // Pass the request to the handler, which acknowledges the setup packet
+    // and starts its response.
+    //
+    if(bPending)
+    {
+        psUSBControl->psInfo->sCallbacks.pfnRequestHandler(
+            psUSBControl->pvInstance, &sRequest);
+    }
+}
+
+//*****************************************************************************
+//
+//! This function starts or stops the enumeration tracer.
+//!
+//! \param ulIndex is the index of the USB controller whose events are to be
+//! traced.
+//! \param psEvents is a pointer to the ring in which events are to be
+//! recorded or 0 to stop tracing.
+//! \param ulNumEvents is the number of events that \e psEvents can hold.
+//! \param pfnCounter is the function used to time stamp each event.
+//!
+//! The counter function is called from the USB interrupt handler each time an
+//! event is recorded, including every bus reset and setup packet, so it must
+//! be quick and must not block or wait for any other interrupt to run.
+//!
+//! The enumeration tracer records bus resets, suspends, resumes and
+//! disconnects, and every setup packet received on endpoint zero, in a ring
+//! of tUSBDTraceEvent structures provided by the application.  The setup
+//! packet is recorded with each request so the descriptor type, index and
+//! length of a GET_DESCRIPTOR request, the address given by SET_ADDRESS and
+//! the configuration selected by SET_CONFIGURATION can all be seen.  When the
+//! status stage of the request completes, or the request is stalled, the time
+//! taken is recorded too.  Once the ring is full, each new event replaces the
+//! oldest.
+//!
+//! Each call to this function empties the ring.  It may be called before the
+//! class initialization function, USBDBulkInit() for example, so that the
+//! first enumeration is traced in full.  The ring must not be used by the
+//! application while tracing is enabled; use USBDCDTraceRead() to read it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDTraceSet(unsigned long ulIndex, tUSBDTraceEvent *psEvents,
+               unsigned long ulNumEvents, tUSBDTraceCounter pfnCounter)
+{
+    tDeviceInstance *psUSBControl;
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT(!psEvents || (ulNumEvents && pfnCounter));
+
+    psUSBControl = &g_psUSBDevice[ulIndex];
+
+    //
+    // Make sure that no event is recorded while the ring is changed.
+    //
+    bIntsOff = IntMasterDisable();
+
+    psUSBControl->psTrace = psEvents;
+    psUSBControl->ulTraceSize = ulNumEvents;
+    psUSBControl->pfnTraceCounter = pfnCounter;
+    psUSBControl->ulTraceNext = 0;
+    psUSBControl->ulTraceUsed = 0;
+    psUSBControl->psTraceOpen = 0;
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! This function reads the events recorded by the enumeration tracer.
+//!
+//! \param ulIndex is the index of the USB controller whose events are to be
+//! read.
+//! \param psEvents is a pointer to the buffer into which the events are to be
+//! copied.
+//! \param ulNumEvents is the number of events that \e psEvents can hold.
+//!
+//! This function copies the most recent events recorded by the tracer, oldest
+//! first, into \e psEvents.  The ring is left unchanged so later calls return
+//! the same events followed by any newer ones.  A request whose control
+//! transfer has not yet completed, such as the request being used to read the
+//! trace, does not have \b USBD_TRACE_FLAG_DONE set.
+//!
+//! Interrupts are disabled while the events are copied so that the copy is
+//! consistent.
+//!
+//! \return Returns the number of events copied.
+//
+//*****************************************************************************
+unsigned long
+USBDCDTraceRead(unsigned long ulIndex, tUSBDTraceEvent *psEvents,
+                unsigned long ulNumEvents)
+{
+    tDeviceInstance *psUSBControl;
+    unsigned long ulCount, ulPos, ulLoop;
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
+    ASSERT(psEvents);
+
+    psUSBControl = &g_psUSBDevice[ulIndex];
+
+    bIntsOff = IntMasterDisable();
+
+    //
+    // Find the oldest of the events to be copied.
+    //
+    ulCount = psUSBControl->ulTraceUsed;
+    if(ulCount > ulNumEvents)
+    {
+        ulCount = ulNumEvents;
+    }
+    ulPos = psUSBControl->ulTraceNext + psUSBControl->ulTraceSize - ulCount;
+
+    for(ulLoop = 0; ulLoop < ulCount; ulLoop++)
+    {
+        if(ulPos >= psUSBControl->ulTraceSize)
+        {
+            ulPos -= psUSBControl->ulTraceSize;
+        }
+        psEvents[ulLoop] = psUSBControl->psTrace[ulPos++];
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+// This internal function records an event in the enumeration tracer's ring.
+//
+// \param psDevInst is the device instance whose event is to be recorded.
+// \param ulEvent is the event, one of the USBD_TRACE_xxx values.
+// \param pRequest is the setup packet for a USBD_TRACE_REQUEST event or 0.
+//
+// This function is called from the USB interrupt handler.  Any request which
+// is still waiting for its control transfer to complete is abandoned, since a
+// new setup packet or bus event means that the transfer will not complete.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+USBDTraceEvent(tDeviceInstance *psDevInst, unsigned long ulEvent,
+               const tUSBRequest *pRequest)
+{
+    tUSBDTraceEvent *psEvent;
+
+    if(!psDevInst->psTrace)
+    {
+        return;
+    }
+
+    //
+    // Take the next entry in the ring, replacing the oldest if it is full.
+    //
+    psEvent = &psDevInst->psTrace[psDevInst->ulTraceNext];
+    if(++psDevInst->ulTraceNext == psDevInst->ulTraceSize)
+    {
+        psDevInst->ulTraceNext = 0;
+    }
+    if(psDevInst->ulTraceUsed < psDevInst->ulTraceSize)
+    {
+        psDevInst->ulTraceUsed++;
+    }
+
+    psEvent->ulTime = psDevInst->pfnTraceCounter();
+    psEvent->ulDuration = 0;
+    psEvent->ucEvent = (unsigned char)ulEvent;
+    psEvent->ucFlags = 0;
+    psEvent->usReserved = 0;
+
+    if(pRequest)
+    {
+        //
+        // Keep the request open until its control transfer completes.
+        //
+        psEvent->sRequest = *pRequest;
+        psDevInst->psTraceOpen = psEvent;
+    }
+    else
+    {
+        psEvent->sRequest.bmRequestType = 0;
+        psEvent->sRequest.bRequest = 0;
+        psEvent->sRequest.wValue = 0;
+        psEvent->sRequest.wIndex = 0;
+        psEvent->sRequest.wLength = 0;
+        psDevInst->psTraceOpen = 0;
+    }
+}
+
+//*****************************************************************************
+//
+// This internal function records the completion of the traced request.
+//
+// \param psDevInst is the device instance whose request has completed.
+// \param ulFlags is USBD_TRACE_FLAG_STALLED if the request was stalled or 0
+// if its status stage completed.
+//
+// Since a deferred request may be stalled from USBDCDProcessDeferred(),
+// interrupts are disabled while the event is updated.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+USBDTraceEnd(tDeviceInstance *psDevInst, unsigned long ulFlags)
 {
-    ASSERT(ulIndex == 0);
-
-    //
-    // Enter the RX state on end point 0.
-    //
-    g_psUSBDevice[0].eEP0State = USB_STATE_RX;
+    tUSBDTraceEvent *psEvent;
+    tBoolean bIntsOff;
 
-    //
-    // Save the pointer to the data.
-    //
-    g_psUSBDevice[0].pEP0Data = pucData;
+    bIntsOff = IntMasterDisable();
 
-    //
-    // Location to save the current number of bytes received.
-    //
-    g_psUSBDevice[0].ulOUTDataSize = ulSize;
+    psEvent = psDevInst->psTraceOpen;
+    if(psEvent)
+    {
+        psEvent->ulDuration = psDevInst->pfnTraceCounter() - psEvent->ulTime;
+        psEvent->ucFlags |= (unsigned char)(ulFlags | USBD_TRACE_FLAG_DONE);
+        psDevInst->psTraceOpen = 0;
+    }
 
-    //
-    // Bytes remaining to be received.
-    //
-    g_psUSBDevice[0].ulEP0DataRemain = ulSize;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
 }
 
 //*****************************************************************************
 //
-//! This function requests transfer of data to the host on endpoint zero.
+//! This function reports whether the device's string descriptor table is
+//! valid.
 //!
-//! \param ulIndex is the index of the USB controller which is to be used to
-//! send the data.
-//! \param pucData is a pointer to the buffer to send via endpoint zero.
-//! \param ulSize is the amount of data to send in bytes.
+//! \param ulIndex is the index of the USB controller whose string descriptor
+//! table is to be checked.
 //!
-//! This function handles sending data to the host when a custom command is
-//! issued or non-standard descriptor has been requested on endpoint zero.  If
-//! the application needs notification when this is complete,
-//! <tt>tDeviceInfo.sCallbacks.pfnDataSent</tt> should contain a valid function
-//! pointer.  This callback could be used to free up the buffer passed into
-//! this function in the \e pucData parameter.  The contents of the \e pucData
-//! buffer must remain unchanged until the <tt>pfnDataSent</tt> callback is
-//! received.
+//! The string descriptor table passed in the device information structure is
+//! checked once, when USBDCDInit() is called by the class initialization
+//! function.  It must hold the language descriptor followed by an equal
+//! number of strings for each language listed.  If it does not, only the
+//! language descriptor is served and all other string requests are passed to
+//! the pfnGetStringDescriptor callback, or stalled if there is none.  Debug
+//! builds also assert.  Applications may call this function after the class
+//! initialization function to find out whether the table was rejected.
 //!
-//! \return None.
+//! \return Returns \b true if the table is valid or the device has no
+//! strings, or \b false if the table was rejected.
 //
 //*****************************************************************************
-void
-USBDCDSendDataEP0(unsigned long ulIndex, unsigned char *pucData,
-                  unsigned long ulSize)
+tBoolean
+USBDCDStringTableValid(unsigned long ulIndex)
 {
-    ASSERT(ulIndex == 0);
-
-    //
-    // Return the externally provided device descriptor.
-    //
-    g_psUSBDevice[0].pEP0Data = pucData;
-
-    //
-    // The size of the device descriptor is in the first byte.
-    //
-    g_psUSBDevice[0].ulEP0DataRemain = ulSize;
-
-    //
-    // Save the total size of the data sent.
-    //
-    g_psUSBDevice[0].ulOUTDataSize = ulSize;
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
-    //
-    // Now in the transmit data state.
-    //
-    USBDEP0StateTx(0);
+    return(g_psUSBDevice[ulIndex].bStringTableValid);
 }
 
 //*****************************************************************************
@@ -614,9 +1633,9 @@ void
 USBDCDSetDefaultConfiguration(unsigned long ulIndex,
                               unsigned long ulDefaultConfig)
 {
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
-    g_psUSBDevice[0].ulDefaultConfiguration = ulDefaultConfig;
+    g_psUSBDevice[ulIndex].ulDefaultConfiguration = ulDefaultConfig;
 }
 
 //*****************************************************************************
@@ -628,9 +1647,10 @@ USBDCDSetDefaultConfiguration(unsigned long ulIndex,
 //!
 //! This function is typically called to signal an error condition to the host
 //! when an unsupported request is received by the device.  It should be
-//! called from within the callback itself (in interrupt context) and not
-//! deferred until later since it affects the operation of the endpoint zero
-//! state machine in the USB library.
+//! called from within the request callback itself and not deferred until
+//! later since it affects the operation of the endpoint zero state machine in
+//! the USB library.  The callback may be running in interrupt context or, for
+//! requests deferred by USBDCDDeferRequests(), from USBDCDProcessDeferred().
 //!
 //! \return None.
 //
@@ -638,17 +1658,36 @@ USBDCDSetDefaultConfiguration(unsigned long ulIndex,
 void
 USBDCDStallEP0(unsigned long ulIndex)
 {
-    ASSERT(ulIndex == 0);
+    tBoolean bIntsOff;
+
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
-    // Stall the endpoint in question.
+    // This may be called from USBDCDProcessDeferred() so make sure that the
+    // stall sent interrupt cannot be handled before the state is updated.
+    //
+    bIntsOff = IntMasterDisable();
+
     //
-    MAP_USBDevEndpointStall(USB0_BASE, USB_EP_0, USB_EP_DEV_OUT);
+    // Enter the stalled state before the stall can be sent.
+    //
+    g_psUSBDevice[ulIndex].eEP0State = USB_STATE_STALL;
+
+    //
+    // Record the stall against the request being traced.
+    //
+    USBDTraceEnd(&g_psUSBDevice[ulIndex], USBD_TRACE_FLAG_STALLED);
 
     //
-    // Enter the stalled state.
+    // Stall the endpoint in question.
     //
-    g_psUSBDevice[0].eEP0State = USB_STATE_STALL;
+    MAP_USBDevEndpointStall(USB_INDEX_TO_BASE(ulIndex),
+                            USB_EP_0, USB_EP_DEV_OUT);
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
 }
 
 //*****************************************************************************
@@ -677,14 +1716,14 @@ USBDCDPowerStatusSet(unsigned long ulIndex, unsigned char ucPower)
     //
     ASSERT((ucPower == USB_STATUS_BUS_PWR) ||
            (ucPower == USB_STATUS_SELF_PWR));
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
     // Update the device status with the new power status flag.
     //
-    g_psUSBDevice[0].bPwrSrcSet = true;
-    g_psUSBDevice[0].ucStatus &= ~USB_STATUS_PWR_M;
-    g_psUSBDevice[0].ucStatus |= ucPower;
+    g_psUSBDevice[ulIndex].bPwrSrcSet = true;
+    g_psUSBDevice[ulIndex].ucStatus &= ~USB_STATUS_PWR_M;
+    g_psUSBDevice[ulIndex].ucStatus |= ucPower;
 }
 
 //*****************************************************************************
@@ -713,26 +1752,26 @@ USBDCDRemoteWakeupRequest(unsigned long ulIndex)
     //
     // Check for parameter validity.
     //
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
     // Is remote wake up signaling currently enabled?
     //
-    if(g_psUSBDevice[0].ucStatus & USB_STATUS_REMOTE_WAKE)
+    if(g_psUSBDevice[ulIndex].ucStatus & USB_STATUS_REMOTE_WAKE)
     {
         //
         // The host has not disabled remote wake up. Are we still in the
         // middle of a previous wake up sequence?
         //
-        if(!g_psUSBDevice[0].bRemoteWakeup)
+        if(!g_psUSBDevice[ulIndex].bRemoteWakeup)
         {
             //
             // No - we are not in the middle of a wake up sequence so start
             // one here.
             //
-            g_psUSBDevice[0].ucRemoteWakeupCount = 0;
-            g_psUSBDevice[0].bRemoteWakeup = true;
-            MAP_USBHostResume(USB0_BASE, true);
+            g_psUSBDevice[ulIndex].ucRemoteWakeupCount = 0;
+            g_psUSBDevice[ulIndex].bRemoteWakeup = true;
+            MAP_USBHostResume(USB_INDEX_TO_BASE(ulIndex), true);
             return(true);
         }
     }
@@ -760,21 +1799,21 @@ USBDCDRemoteWakeupRequest(unsigned long ulIndex)
 void
 USBDeviceResumeTickHandler(tDeviceInstance *psDevInst)
 {
-    if(g_psUSBDevice[0].bRemoteWakeup)
+    if(psDevInst->bRemoteWakeup)
     {
         //
         // Increment the millisecond counter we use to time the resume
         // signaling.
         //
-        g_psUSBDevice[0].ucRemoteWakeupCount++;
+        psDevInst->ucRemoteWakeupCount++;
 
         //
         // Have we reached the 10mS mark? If so, we need to turn the signaling
         // off again.
         //
-        if(g_psUSBDevice[0].ucRemoteWakeupCount == REMOTE_WAKEUP_PULSE_MS)
+        if(psDevInst->ucRemoteWakeupCount == REMOTE_WAKEUP_PULSE_MS)
         {
-            MAP_USBHostResume(USB0_BASE, false);
+            MAP_USBHostResume(USB_INDEX_TO_BASE(psDevInst->ulIndex), false);
         }
 
         //
@@ -783,22 +1822,22 @@ USBDeviceResumeTickHandler(tDeviceInstance *psDevInst)
         // initiated the wake up signaling so we just wait until 20mS have
         // passed then tell the client all is well.
         //
-        if(g_psUSBDevice[0].ucRemoteWakeupCount == REMOTE_WAKEUP_READY_MS)
+        if(psDevInst->ucRemoteWakeupCount == REMOTE_WAKEUP_READY_MS)
         {
             //
             // We are now finished with the remote wake up signaling.
             //
-            g_psUSBDevice[0].bRemoteWakeup = false;
+            psDevInst->bRemoteWakeup = false;
 
             //
             // If the client has registered a resume callback, call it.  In the
             // case of a remote wake up request, we do not get a resume
             // interrupt from the controller so we need to fake it here.
             //
-            if(g_psUSBDevice[0].psInfo->sCallbacks.pfnResumeHandler)
+            if(psDevInst->psInfo->sCallbacks.pfnResumeHandler)
             {
-                g_psUSBDevice[0].psInfo->sCallbacks.pfnResumeHandler(
-                    g_psUSBDevice[0].pvInstance);
+                psDevInst->psInfo->sCallbacks.pfnResumeHandler(
+                    psDevInst->pvInstance);
             }
         }
     }
@@ -818,11 +1857,13 @@ USBDReadAndDispatchRequest(unsigned long ulIndex)
 {
     unsigned long ulSize;
     tUSBRequest *pRequest;
+    tMSOS20Descriptors *psMSOS20;
 
     //
     // Cast the buffer to a request structure.
     //
-    pRequest = (tUSBRequest *)g_pucDataBufferIn;
+    pRequest = (tUSBRequest *)g_ppucDataBufferIn[ulIndex];
+    psMSOS20 = &g_psMSOS20Descriptors[ulIndex];
 
     //
     // Set the buffer size.
@@ -832,9 +1873,9 @@ USBDReadAndDispatchRequest(unsigned long ulIndex)
     //
     // Get the data from the USB controller end point 0.
     //
-    MAP_USBEndpointDataGet(USB0_BASE,
+    MAP_USBEndpointDataGet(USB_INDEX_TO_BASE(ulIndex),
                            USB_EP_0,
-                           g_pucDataBufferIn,
+                           g_ppucDataBufferIn[ulIndex],
                            &ulSize);
 
     //
@@ -845,26 +1886,75 @@ USBDReadAndDispatchRequest(unsigned long ulIndex)
         return;
     }
 
+    //
+    // A new request cancels any data still being streamed for the last one
+    // and any request still waiting for USBDCDProcessDeferred().
+    //
+    g_psUSBDevice[ulIndex].pfnEP0Fill = 0;
+    g_psUSBDevice[ulIndex].bRequestDeferred = false;
+
+    //
+    // Record the request if the enumeration tracer is enabled.
+    //
+    USBDTraceEvent(&g_psUSBDevice[ulIndex], USBD_TRACE_REQUEST, pRequest);
+
     //
     // See if this is a standard request or not.
     //
     if((pRequest->bmRequestType & USB_RTYPE_TYPE_M) != USB_RTYPE_STANDARD)
     {
+        //
+        // If this is a request for the Microsoft OS 2.0 descriptor set and
+        // we have one, send it.
+        //
+        if(psMSOS20->ulSetSize &&
+           (pRequest->bmRequestType ==
+            (USB_RTYPE_DIR_IN | USB_RTYPE_VENDOR | USB_RTYPE_DEVICE)) &&
+           (pRequest->bRequest == psMSOS20->ucVendorCode) &&
+           (pRequest->wIndex == USB_MSOS20_DESCRIPTOR_INDEX))
+        {
+            MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0,
+                                      false);
+            USBDCDSendDataEP0(ulIndex, psMSOS20->pucSet,
+                              (pRequest->wLength < psMSOS20->ulSetSize) ?
+                              pRequest->wLength : psMSOS20->ulSetSize);
+        }
+
+        //
+        // If requests of this type are to be handled outside interrupt
+        // context, save the request for USBDCDProcessDeferred().  The setup
+        // packet is not acknowledged yet so the controller will NAK the rest
+        // of the transfer until the handler responds.
+        //
+        else if((g_psUSBDevice[ulIndex].ulDeferTypes &
+                 USBD_DEFER_FLAG(pRequest->bmRequestType)) &&
+                g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnRequestHandler)
+        {
+            g_psUSBDevice[ulIndex].sDeferredRequest = *pRequest;
+            g_psUSBDevice[ulIndex].bRequestDeferred = true;
+
+            if(g_psUSBDevice[ulIndex].psTraceOpen)
+            {
+                g_psUSBDevice[ulIndex].psTraceOpen->ucFlags |=
+                    USBD_TRACE_FLAG_DEFERRED;
+            }
+        }
+
         //
         // Since this is not a standard request, see if there is
         // an external handler present.
         //
-        if(g_psUSBDevice[0].psInfo->sCallbacks.pfnRequestHandler)
+        else if(g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnRequestHandler)
         {
-            g_psUSBDevice[0].psInfo->sCallbacks.pfnRequestHandler(
-                    g_psUSBDevice[0].pvInstance, pRequest);
+            g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnRequestHandler(
+                    g_psUSBDevice[ulIndex].pvInstance, pRequest);
         }
         else
         {
             //
             // If there is no handler then stall this request.
             //
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
         }
     }
     else
@@ -879,7 +1969,7 @@ USBDReadAndDispatchRequest(unsigned long ulIndex)
             //
             // Jump table to the appropriate handler.
             //
-            g_psUSBDStdRequests[pRequest->bRequest](&g_psUSBDevice[0],
+            g_psUSBDStdRequests[pRequest->bRequest](&g_psUSBDevice[ulIndex],
                                                     pRequest);
         }
         else
@@ -887,7 +1977,7 @@ USBDReadAndDispatchRequest(unsigned long ulIndex)
             //
             // If there is no handler then stall this request.
             //
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
         }
     }
 }
@@ -936,11 +2026,17 @@ void
 USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
 {
     unsigned long ulEPStatus;
+    unsigned long ulIndex;
+
+    //
+    // Find the controller that this interrupt came from.
+    //
+    ulIndex = pDevInstance->ulIndex;
 
     //
     // Get the end point 0 status.
     //
-    ulEPStatus = MAP_USBEndpointStatus(USB0_BASE, USB_EP_0);
+    ulEPStatus = MAP_USBEndpointStatus(USB_INDEX_TO_BASE(ulIndex), USB_EP_0);
 
     switch(pDevInstance->eEP0State)
     {
@@ -950,6 +2046,11 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
         //
         case USB_STATE_STATUS:
         {
+            //
+            // The control transfer is complete.
+            //
+            USBDTraceEnd(pDevInstance, 0);
+
             //
             // Just go back to the idle state.
             //
@@ -964,7 +2065,8 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 // Clear the pending address change and set the address.
                 //
                 pDevInstance->ulDevAddress &= ~DEV_ADDR_PENDING;
-                MAP_USBDevAddrSet(USB0_BASE, pDevInstance->ulDevAddress);
+                MAP_USBDevAddrSet(USB_INDEX_TO_BASE(ulIndex),
+                                  pDevInstance->ulDevAddress);
             }
 
             //
@@ -976,7 +2078,7 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 //
                 // Process the newly arrived packet.
                 //
-                USBDReadAndDispatchRequest(0);
+                USBDReadAndDispatchRequest(ulIndex);
             }
             break;
         }
@@ -994,7 +2096,15 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 //
                 // Yes - process it.
                 //
-                USBDReadAndDispatchRequest(0);
+                USBDReadAndDispatchRequest(ulIndex);
+            }
+            else
+            {
+                //
+                // Otherwise the status stage of a request without a data
+                // stage has completed.
+                //
+                USBDTraceEnd(pDevInstance, 0);
             }
             break;
         }
@@ -1005,7 +2115,7 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
         //
         case USB_STATE_TX:
         {
-            USBDEP0StateTx(0);
+            USBDEP0StateTx(ulIndex);
             break;
         }
 
@@ -1015,7 +2125,7 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
         //
         case USB_STATE_TX_CONFIG:
         {
-            USBDEP0StateTxConfig(0);
+            USBDEP0StateTxConfig(ulIndex);
             break;
         }
 
@@ -1048,7 +2158,8 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
             //
             // Get the data from the USB controller end point 0.
             //
-            MAP_USBEndpointDataGet(USB0_BASE, USB_EP_0, pDevInstance->pEP0Data,
+            MAP_USBEndpointDataGet(USB_INDEX_TO_BASE(ulIndex),
+                                   USB_EP_0, pDevInstance->pEP0Data,
                                    &ulDataSize);
 
             //
@@ -1063,7 +2174,8 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 // Need to ACK the data on end point 0 in this case and set the
                 // data end as this is the last of the data.
                 //
-                MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+                MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex),
+                                          USB_EP_0, true);
 
                 //
                 // Return to the idle state.
@@ -1097,7 +2209,8 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 // Need to ACK the data on end point 0 in this case
                 // without setting data end because more data is coming.
                 //
-                MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+                MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex),
+                                          USB_EP_0, false);
             }
 
             //
@@ -1126,7 +2239,8 @@ USBDeviceEnumHandler(tDeviceInstance *pDevInstance)
                 //
                 // Clear the Setup End condition.
                 //
-                MAP_USBDevEndpointStatusClear(USB0_BASE, USB_EP_0,
+                MAP_USBDevEndpointStatusClear(USB_INDEX_TO_BASE(ulIndex),
+                                              USB_EP_0,
                                               USB_DEV_EP0_SENT_STALL);
 
                 //
@@ -1170,6 +2284,11 @@ USBDeviceEnumResetHandler(tDeviceInstance *pDevInstance)
     pDevInstance->ucStatus &= ~USB_STATUS_REMOTE_WAKE;
     pDevInstance->bRemoteWakeup = false;
 
+    //
+    // Forget any request which was waiting to be handled.
+    //
+    pDevInstance->bRequestDeferred = false;
+
     //
     // Call the device dependent code to indicate a bus reset has occurred.
     //
@@ -1215,6 +2334,7 @@ USBDGetStatus(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     unsigned short usData;
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -1223,12 +2343,13 @@ USBDGetStatus(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 without setting last data as there
     // will be a data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, false);
 
     //
     // Determine what type of status was requested.
@@ -1279,7 +2400,7 @@ USBDGetStatus(void *pvInstance, tUSBRequest *pUSBRequest)
             //
             if((usIndex == 0) || (usIndex >= NUM_USB_EP))
             {
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
                 return;
             }
             else
@@ -1308,7 +2429,7 @@ USBDGetStatus(void *pvInstance, tUSBRequest *pUSBRequest)
             // Anything else causes a stall condition to indicate that the
             // command was not supported.
             //
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
             return;
         }
     }
@@ -1322,7 +2443,7 @@ USBDGetStatus(void *pvInstance, tUSBRequest *pUSBRequest)
     //
     // Send the response.
     //
-    USBDEP0StateTx(0);
+    USBDEP0StateTx(ulIndex);
 }
 
 //*****************************************************************************
@@ -1348,6 +2469,7 @@ static void
 USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -1356,12 +2478,13 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Determine what type of status was requested.
@@ -1385,7 +2508,7 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
             }
             else
             {
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
             }
             break;
         }
@@ -1408,7 +2531,7 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
             //
             if((usIndex == 0) || (usIndex > NUM_USB_EP))
             {
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
             }
             else
             {
@@ -1430,15 +2553,17 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
 
                     if(ulDir == HALT_EP_IN)
                     {
-                        MAP_USBDevEndpointStallClear(USB0_BASE,
-                                                     INDEX_TO_USB_EP(usIndex),
-                                                     USB_EP_DEV_IN);
+                        MAP_USBDevEndpointStallClear(
+                                                USB_INDEX_TO_BASE(ulIndex),
+                                                INDEX_TO_USB_EP(usIndex),
+                                                USB_EP_DEV_IN);
                     }
                     else
                     {
-                        MAP_USBDevEndpointStallClear(USB0_BASE,
-                                                     INDEX_TO_USB_EP(usIndex),
-                                                     USB_EP_DEV_OUT);
+                        MAP_USBDevEndpointStallClear(
+                                                USB_INDEX_TO_BASE(ulIndex),
+                                                INDEX_TO_USB_EP(usIndex),
+                                                USB_EP_DEV_OUT);
                     }
                 }
                 else
@@ -1446,7 +2571,7 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
                     //
                     // If any other feature is requested, this is an error.
                     //
-                    USBDCDStallEP0(0);
+                    USBDCDStallEP0(ulIndex);
                     return;
                 }
             }
@@ -1458,7 +2583,7 @@ USBDClearFeature(void *pvInstance, tUSBRequest *pUSBRequest)
         //
         default:
         {
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
             return;
         }
     }
@@ -1488,6 +2613,7 @@ static void
 USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -1496,12 +2622,13 @@ USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Determine what type of status was requested.
@@ -1526,7 +2653,7 @@ USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
             }
             else
             {
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
             }
             break;
         }
@@ -1549,7 +2676,7 @@ USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
             //
             if((usIndex == 0) || (usIndex >= NUM_USB_EP))
             {
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
             }
             else
             {
@@ -1574,7 +2701,7 @@ USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
                     //
                     // No other requests are supported.
                     //
-                    USBDCDStallEP0(0);
+                    USBDCDStallEP0(ulIndex);
                     return;
                 }
             }
@@ -1586,7 +2713,7 @@ USBDSetFeature(void *pvInstance, tUSBRequest *pUSBRequest)
         //
         default:
         {
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
             return;
         }
     }
@@ -1614,6 +2741,7 @@ static void
 USBDSetAddress(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -1622,12 +2750,13 @@ USBDSetAddress(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Save the device address as we cannot change address until the status
@@ -1672,6 +2801,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     tBoolean bConfig;
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
     tDeviceInfo *psDevice;
 
     ASSERT(pUSBRequest != 0);
@@ -1681,13 +2811,14 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
     psDevice = psUSBControl->psInfo;
 
     //
     // Need to ACK the data on end point 0 without setting last data as there
     // will be a data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, false);
 
     //
     // Assume we are not sending the configuration descriptor until we
@@ -1726,6 +2857,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
         {
             const tConfigHeader *psConfig;
             const tDeviceDescriptor *psDeviceDesc;
+            const unsigned char *pucFlat;
             unsigned char ucIndex;
 
             //
@@ -1745,10 +2877,30 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
                 // This is an invalid configuration index.  Stall EP0 to
                 // indicate a request error.
                 //
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
                 psUSBControl->pEP0Data = 0;
                 psUSBControl->ulEP0DataRemain = 0;
             }
+            else if(psUSBControl->pucFlatConfig)
+            {
+                //
+                // The configurations are held back to back in a single
+                // buffer so skip over those before the one requested using
+                // their wTotalLength fields.
+                //
+                pucFlat = psUSBControl->pucFlatConfig;
+                while(ucIndex--)
+                {
+                    pucFlat += pucFlat[2] | (pucFlat[3] << 8);
+                }
+
+                //
+                // Send the configuration descriptor as a single block.
+                //
+                psUSBControl->pEP0Data = (unsigned char *)pucFlat;
+                psUSBControl->ulEP0DataRemain = pucFlat[2] |
+                                                (pucFlat[3] << 8);
+            }
             else
             {
                 //
@@ -1794,7 +2946,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
             // Determine the correct descriptor index based on the requested
             // language ID and index.
             //
-            lIndex = USBDStringIndexFromRequest(pUSBRequest->wIndex,
+            lIndex = USBDStringIndexFromRequest(ulIndex, pUSBRequest->wIndex,
                                                 pUSBRequest->wValue & 0xFF);
 
             //
@@ -1812,7 +2964,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
             	}
             	else
             	{
-            		USBDCDStallEP0(0);
+            		USBDCDStallEP0(ulIndex);
             	}
                 break;
             }
@@ -1838,6 +2990,19 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
         //
         default:
         {
+            //
+            // Send the BOS descriptor if we have Microsoft OS 2.0 descriptors
+            // to advertise.
+            //
+            if(((pUSBRequest->wValue >> 8) == USB_DTYPE_BOS) &&
+               g_psMSOS20Descriptors[ulIndex].ulSetSize)
+            {
+                psUSBControl->pEP0Data =
+                    g_psMSOS20Descriptors[ulIndex].pucBOSDescriptor;
+                psUSBControl->ulEP0DataRemain = BOS_SIZE;
+                break;
+            }
+
             //
             // If there is a handler for requests that are not handled then
             // call it.
@@ -1853,7 +3018,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
                 // Whatever this was this handler does not understand it so
                 // just stall the request.
                 //
-                USBDCDStallEP0(0);
+                USBDCDStallEP0(ulIndex);
             }
 
             return;
@@ -1881,11 +3046,145 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
         //
         if(!bConfig)
         {
-            USBDEP0StateTx(0);
+            USBDEP0StateTx(ulIndex);
         }
         else
         {
-            USBDEP0StateTxConfig(0);
+            USBDEP0StateTxConfig(ulIndex);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the first slot to search in the language hash table for a given
+// language ID.  The sublanguage in the top 6 bits of the ID is folded into the
+// primary language in the bottom 10 bits, so that variants of the same
+// language do not collide, before taking a Fibonacci hash of the result.
+//
+//*****************************************************************************
+#define USBDLangSlot(usLang)                                                  \
+        (((((unsigned long)(usLang) ^ ((usLang) >> 10)) * 40503) & 0xFFFF) >> \
+         (16 - USB_STRING_LANG_BITS))
+
+//*****************************************************************************
+//
+// This function checks the layout of the device's string descriptor table and
+// builds the table used to map requests onto it.
+//
+// \param ulIndex is the index of the USB controller that the device is using.
+// \param psDevice is the device information structure holding the string
+// descriptor table.
+//
+// The string descriptor table holds the language descriptor followed by one
+// group of strings for each language listed in the language descriptor, in
+// the same order, with an equal number of strings in each group.  This
+// function checks this once when the device is initialized and records the
+// number of strings in each group and, in a small hash table, the group
+// holding the strings for each language ID.  This allows
+// USBDStringIndexFromRequest() to find a string without scanning the
+// language descriptor on every request.
+//
+// If the table is not laid out as expected, it is marked as invalid, which
+// the application can check with USBDCDStringTableValid(), and only the
+// language descriptor is served from it.  All other string requests are
+// passed to the pfnGetStringDescriptor callback, if one is provided.  A valid
+// table listing more than USB_MAX_STRING_LANGS languages is still served but
+// the language descriptor is searched on each request, as it was before the
+// hash table was added.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+USBDStringTableInit(unsigned long ulIndex, const tDeviceInfo *psDevice)
+{
+    tDeviceInstance *psUSBControl;
+    const tString0Descriptor *pLang;
+    unsigned long ulNumLangs;
+    unsigned long ulLoop;
+    unsigned long ulSlot;
+
+    psUSBControl = &g_psUSBDevice[ulIndex];
+
+    //
+    // Start with an empty table.
+    //
+    psUSBControl->ulStringsPerLang = 0;
+    psUSBControl->bStringTableValid = true;
+    psUSBControl->bStringLangHashed = true;
+    for(ulSlot = 0; ulSlot < USB_STRING_LANG_SLOTS; ulSlot++)
+    {
+        psUSBControl->pucLangGroup[ulSlot] = USB_STRING_LANG_NONE;
+    }
+
+    //
+    // There is nothing more to do if the device has no strings.
+    //
+    if((psDevice->ppStringDescriptors == 0) ||
+       (psDevice->ulNumStringDescriptors == 0))
+    {
+        return;
+    }
+
+    //
+    // How many languages does this device support?  This is determined by
+    // looking at the length of the first descriptor in the string table,
+    // subtracting 2 for the header and dividing by two (the size of each
+    // language code).
+    //
+    pLang = (const tString0Descriptor *)psDevice->ppStringDescriptors[0];
+    ulNumLangs = (pLang->bLength - 2) / 2;
+
+    //
+    // We assume that the table includes the same number of strings for each
+    // supported language.  This may seem an odd way to do this (why not just
+    // have the application tell us in the device info structure?) but it's
+    // needed since we didn't want to change the API after the first release
+    // which did not support multiple languages.  Make sure that the table
+    // contains (1 + (strings_per_language * languages)) entries.
+    //
+    if((pLang->bLength < 4) ||
+       ((psDevice->ulNumStringDescriptors - 1) % ulNumLangs))
+    {
+        ASSERT(0);
+        psUSBControl->bStringTableValid = false;
+        return;
+    }
+
+    psUSBControl->ulStringsPerLang =
+        (psDevice->ulNumStringDescriptors - 1) / ulNumLangs;
+
+    //
+    // If there are too many languages for the hash table, leave it empty and
+    // search the language descriptor on each request.
+    //
+    if(ulNumLangs > USB_MAX_STRING_LANGS)
+    {
+        psUSBControl->bStringLangHashed = false;
+        return;
+    }
+
+    //
+    // Add each language to the hash table.  If a language is listed more than
+    // once, the first group of strings for it is used.
+    //
+    for(ulLoop = 0; ulLoop < ulNumLangs; ulLoop++)
+    {
+        ulSlot = USBDLangSlot(pLang->wLANGID[ulLoop]);
+        while(psUSBControl->pucLangGroup[ulSlot] != USB_STRING_LANG_NONE)
+        {
+            if(psUSBControl->pusLangID[ulSlot] == pLang->wLANGID[ulLoop])
+            {
+                break;
+            }
+            ulSlot = (ulSlot + 1) & (USB_STRING_LANG_SLOTS - 1);
+        }
+
+        if(psUSBControl->pucLangGroup[ulSlot] == USB_STRING_LANG_NONE)
+        {
+            psUSBControl->pusLangID[ulSlot] = pLang->wLANGID[ulLoop];
+            psUSBControl->pucLangGroup[ulSlot] = (unsigned char)ulLoop;
         }
     }
 }
@@ -1895,6 +3194,8 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
 // This function determines which string descriptor to send to satisfy a
 // request for a given index and language.
 //
+// \param ulIndex is the index of the USB controller that received the
+// request.
 // \param usLang is the requested string language ID.
 // \param usIndex is the requested string descriptor index.
 //
@@ -1904,27 +3205,28 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
 // descriptor array which is arranged as multiple groups of strings with
 // one group for each language advertised via string descriptor 0.
 //
-// We assume that there are an equal number of strings per language and
-// that the first descriptor is the language descriptor and use this fact to
-// perform the mapping.
+// The position of each language's group of strings is found using the table
+// built by USBDStringTableInit() when the device was initialized.
 //
 // \return The index of the string descriptor to return or -1 if the string
 // could not be found.
 //
 //*****************************************************************************
 static long
-USBDStringIndexFromRequest(unsigned short usLang, unsigned short usIndex)
+USBDStringIndexFromRequest(unsigned long ulIndex, unsigned short usLang,
+                           unsigned short usIndex)
 {
-    tString0Descriptor *pLang;
-    unsigned long ulNumLangs;
-    unsigned long ulNumStringsPerLang;
-    unsigned long ulLoop;
+    tDeviceInstance *psUSBControl;
+    const tString0Descriptor *pLang;
+    unsigned long ulSlot, ulNumLangs;
+
+    psUSBControl = &g_psUSBDevice[ulIndex];
 
     //
     // Make sure we have a string table at all.
     //
-    if((g_psUSBDevice[0].psInfo == 0) ||
-       (g_psUSBDevice[0].psInfo->ppStringDescriptors == 0))
+    if((psUSBControl->psInfo == 0) ||
+       (psUSBControl->psInfo->ppStringDescriptors == 0))
     {
         return(-1);
     }
@@ -1940,63 +3242,54 @@ USBDStringIndexFromRequest(unsigned short usLang, unsigned short usIndex)
     }
 
     //
-    // How many languages does this device support?  This is determined by
-    // looking at the length of the first descriptor in the string table,
-    // subtracting 2 for the header and dividing by two (the size of each
-    // language code).
-    //
-    ulNumLangs = (g_psUSBDevice[0].psInfo->ppStringDescriptors[0][0] - 2) / 2;
-
-    //
-    // We assume that the table includes the same number of strings for each
-    // supported language.  We know the number of entries in the string table,
-    // so how many are there for each language?  This may seem an odd way to
-    // do this (why not just have the application tell us in the device info
-    // structure?) but it's needed since we didn't want to change the API
-    // after the first release which did not support multiple languages.
-    //
-    ulNumStringsPerLang = ((g_psUSBDevice[0].psInfo->ulNumStringDescriptors - 1) /
-                           ulNumLangs);
-
-    //
-    // Just to be sure, make sure that the calculation indicates an equal
-    // number of strings per language.  We expect the string table to contain
-    // (1 + (strings_per_language * languages)) entries.
+    // Is this string in the table at all?  This also catches tables which
+    // were found to be invalid when the device was initialized.
     //
-    if((1 + (ulNumStringsPerLang * ulNumLangs)) !=
-       g_psUSBDevice[0].psInfo->ulNumStringDescriptors)
+    if(usIndex > psUSBControl->ulStringsPerLang)
     {
         return(-1);
     }
 
     //
-    // Now determine which language we are looking for.  It is assumed that
-    // the order of the groups of strings per language in the table is the
-    // same as the order of the language IDs listed in the first descriptor.
+    // If the device lists too many languages for the hash table, search the
+    // language descriptor for the requested language.
     //
-    pLang = (tString0Descriptor *)(g_psUSBDevice[0].psInfo->ppStringDescriptors[0]);
+    if(!psUSBControl->bStringLangHashed)
+    {
+        pLang = (const tString0Descriptor *)
+                psUSBControl->psInfo->ppStringDescriptors[0];
+        ulNumLangs = (pLang->bLength - 2) / 2;
+        for(ulSlot = 0; ulSlot < ulNumLangs; ulSlot++)
+        {
+            if(pLang->wLANGID[ulSlot] == usLang)
+            {
+                return((psUSBControl->ulStringsPerLang * ulSlot) + usIndex);
+            }
+        }
+        return(-1);
+    }
 
     //
-    // Look through the supported languages looking for the one we were asked
-    // for.
+    // Look up the requested language.  The hash table is never more than
+    // half full so there is always an unused entry to end the search.
     //
-    for(ulLoop = 0; ulLoop < ulNumLangs; ulLoop++)
+    ulSlot = USBDLangSlot(usLang);
+    while(psUSBControl->pucLangGroup[ulSlot] != USB_STRING_LANG_NONE)
     {
-        //
-        // Have we found the requested language?
-        //
-        if(pLang->wLANGID[ulLoop] == usLang)
+        if(psUSBControl->pusLangID[ulSlot] == usLang)
         {
             //
-            // Yes - calculate the index of the descriptor to send.
+            // Calculate the index of the descriptor to send.
             //
-            return((ulNumStringsPerLang * ulLoop) + usIndex);
+            return((psUSBControl->ulStringsPerLang *
+                    psUSBControl->pucLangGroup[ulSlot]) + usIndex);
         }
+        ulSlot = (ulSlot + 1) & (USB_STRING_LANG_SLOTS - 1);
     }
 
     //
-    // If we drop out of the loop, the requested language was not found so
-    // return -1 to indicate the error.
+    // The requested language was not found so return -1 to indicate the
+    // error.
     //
     return(-1);
 }
@@ -2017,16 +3310,23 @@ USBDStringIndexFromRequest(unsigned short usLang, unsigned short usIndex)
 static void
 USBDSetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
 {
+    unsigned long ulIndex;
+
+    //
+    // Find the controller that this request arrived on.
+    //
+    ulIndex = ((tDeviceInstance *)pvInstance)->ulIndex;
+
     //
     // Need to ACK the data on end point 0 without setting last data as there
     // will be a data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, false);
 
     //
     // This function is not handled by default.
     //
-    USBDCDStallEP0(0);
+    USBDCDStallEP0(ulIndex);
 }
 
 //*****************************************************************************
@@ -2049,6 +3349,7 @@ USBDGetConfiguration(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     unsigned char ucValue;
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -2057,12 +3358,13 @@ USBDGetConfiguration(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 without setting last data as there
     // will be a data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, false);
 
     //
     // If we still have an address pending then the device is still not
@@ -2083,7 +3385,7 @@ USBDGetConfiguration(void *pvInstance, tUSBRequest *pUSBRequest)
     //
     // Send the single byte response.
     //
-    USBDEP0StateTx(0);
+    USBDEP0StateTx(ulIndex);
 }
 
 //*****************************************************************************
@@ -2108,19 +3410,21 @@ static void
 USBDSetConfiguration(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
     tDeviceInfo *psDevice;
 
     //
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
     psDevice = psUSBControl->psInfo;
 
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Cannot set the configuration to one that does not exist so check the
@@ -2132,7 +3436,7 @@ USBDSetConfiguration(void *pvInstance, tUSBRequest *pUSBRequest)
         // The passed configuration number is not valid.  Stall the endpoint to
         // signal the error to the host.
         //
-        USBDCDStallEP0(0);
+        USBDCDStallEP0(ulIndex);
     }
     else
     {
@@ -2212,6 +3516,7 @@ USBDGetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
 {
     unsigned char ucValue;
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -2220,12 +3525,13 @@ USBDGetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
 
     //
     // Need to ACK the data on end point 0 without setting last data as there
     // will be a data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, false);
 
     //
     // If we still have an address pending then the device is still not
@@ -2252,7 +3558,7 @@ USBDGetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
             //
             // An invalid interface number was specified.
             //
-            USBDCDStallEP0(0);
+            USBDCDStallEP0(ulIndex);
             return;
         }
     }
@@ -2266,7 +3572,7 @@ USBDGetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
     //
     // Send the single byte response.
     //
-    USBDEP0StateTx(0);
+    USBDEP0StateTx(ulIndex);
 }
 
 //*****************************************************************************
@@ -2296,6 +3602,7 @@ USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
     unsigned char ucInterface;
     tBoolean bRetcode;
     tDeviceInstance *psUSBControl;
+    unsigned long ulIndex;
     tDeviceInfo *psDevice;
 
     ASSERT(pUSBRequest != 0);
@@ -2305,13 +3612,14 @@ USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
     // Create the device information pointer.
     //
     psUSBControl = (tDeviceInstance *)pvInstance;
+    ulIndex = psUSBControl->ulIndex;
     psDevice = psUSBControl->psInfo;
 
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Use the current configuration.
@@ -2390,7 +3698,7 @@ USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
     // matching the requested number and alternate setting or there was an
     // error while trying to set up for the new alternate setting.
     //
-    USBDCDStallEP0(0);
+    USBDCDStallEP0(ulIndex);
 }
 
 //*****************************************************************************
@@ -2409,16 +3717,23 @@ USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest)
 static void
 USBDSyncFrame(void *pvInstance, tUSBRequest *pUSBRequest)
 {
+    unsigned long ulIndex;
+
+    //
+    // Find the controller that this request arrived on.
+    //
+    ulIndex = ((tDeviceInstance *)pvInstance)->ulIndex;
+
     //
     // Need to ACK the data on end point 0 with last data set as this has no
     // data phase.
     //
-    MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, true);
+    MAP_USBDevEndpointDataAck(USB_INDEX_TO_BASE(ulIndex), USB_EP_0, true);
 
     //
     // Not handled yet so stall this request.
     //
-    USBDCDStallEP0(0);
+    USBDCDStallEP0(ulIndex);
 }
 
 //*****************************************************************************
@@ -2437,17 +3752,17 @@ USBDEP0StateTx(unsigned long ulIndex)
     unsigned long ulNumBytes;
     unsigned char *pData;
 
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
     // In the TX state on endpoint zero.
     //
-    g_psUSBDevice[0].eEP0State = USB_STATE_TX;
+    g_psUSBDevice[ulIndex].eEP0State = USB_STATE_TX;
 
     //
     // Set the number of bytes to send this iteration.
     //
-    ulNumBytes = g_psUSBDevice[0].ulEP0DataRemain;
+    ulNumBytes = g_psUSBDevice[ulIndex].ulEP0DataRemain;
 
     //
     // Limit individual transfers to 64 bytes.
@@ -2461,18 +3776,34 @@ USBDEP0StateTx(unsigned long ulIndex)
     // Save the pointer so that it can be passed to the USBEndpointDataPut()
     // function.
     //
-    pData = (unsigned char *)g_psUSBDevice[0].pEP0Data;
+    pData = (unsigned char *)g_psUSBDevice[ulIndex].pEP0Data;
+
+    //
+    // If the data is being streamed, ask for the next packet.  Otherwise,
+    // advance the data pointer to the next data to be sent.
+    //
+    if(g_psUSBDevice[ulIndex].pfnEP0Fill)
+    {
+        g_psUSBDevice[ulIndex].pfnEP0Fill(g_psUSBDevice[ulIndex].pvEP0FillData,
+                                    (g_psUSBDevice[ulIndex].ulOUTDataSize -
+                                     g_psUSBDevice[ulIndex].ulEP0DataRemain),
+                                    pData, ulNumBytes);
+    }
+    else
+    {
+        g_psUSBDevice[ulIndex].pEP0Data += ulNumBytes;
+    }
 
     //
-    // Advance the data pointer and counter to the next data to be sent.
+    // Advance the counter to the next data to be sent.
     //
-    g_psUSBDevice[0].ulEP0DataRemain -= ulNumBytes;
-    g_psUSBDevice[0].pEP0Data += ulNumBytes;
+    g_psUSBDevice[ulIndex].ulEP0DataRemain -= ulNumBytes;
 
     //
     // Put the data in the correct FIFO.
     //
-    MAP_USBEndpointDataPut(USB0_BASE, USB_EP_0, pData, ulNumBytes);
+    MAP_USBEndpointDataPut(USB_INDEX_TO_BASE(ulIndex),
+                           USB_EP_0, pData, ulNumBytes);
 
     //
     // If this is exactly 64 then don't set the last packet yet.
@@ -2484,36 +3815,39 @@ USBDEP0StateTx(unsigned long ulIndex)
         // means that there is either more data coming or a null packet needs
         // to be sent to complete the transaction.
         //
-        MAP_USBEndpointDataSend(USB0_BASE, USB_EP_0, USB_TRANS_IN);
+        MAP_USBEndpointDataSend(USB_INDEX_TO_BASE(ulIndex),
+                                USB_EP_0, USB_TRANS_IN);
     }
     else
     {
         //
         // Now go to the status state and wait for the transmit to complete.
         //
-        g_psUSBDevice[0].eEP0State = USB_STATE_STATUS;
+        g_psUSBDevice[ulIndex].eEP0State = USB_STATE_STATUS;
 
         //
         // Send the last bit of data.
         //
-        MAP_USBEndpointDataSend(USB0_BASE, USB_EP_0, USB_TRANS_IN_LAST);
+        MAP_USBEndpointDataSend(USB_INDEX_TO_BASE(ulIndex),
+                                USB_EP_0, USB_TRANS_IN_LAST);
 
         //
         // If there is a sent callback then call it.
         //
-        if((g_psUSBDevice[0].psInfo->sCallbacks.pfnDataSent) &&
-           (g_psUSBDevice[0].ulOUTDataSize != 0))
+        if((g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnDataSent) &&
+           (g_psUSBDevice[ulIndex].ulOUTDataSize != 0))
         {
             //
             // Call the custom handler.
             //
-            g_psUSBDevice[0].psInfo->sCallbacks.pfnDataSent(
-                g_psUSBDevice[0].pvInstance, g_psUSBDevice[0].ulOUTDataSize);
+            g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnDataSent(
+                g_psUSBDevice[ulIndex].pvInstance,
+                g_psUSBDevice[ulIndex].ulOUTDataSize);
 
             //
             // There is no longer any data pending to be sent.
             //
-            g_psUSBDevice[0].ulOUTDataSize = 0;
+            g_psUSBDevice[ulIndex].ulOUTDataSize = 0;
         }
     }
 }
@@ -2540,23 +3874,23 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
     const tConfigHeader *psConfig;
     const tConfigSection *psSection;
 
-    ASSERT(ulIndex == 0);
+    ASSERT(ulIndex < USB_NUM_DEVICE_CONTROLLERS);
 
     //
     // In the TX state on endpoint zero.
     //
-    g_psUSBDevice[0].eEP0State = USB_STATE_TX_CONFIG;
+    g_psUSBDevice[ulIndex].eEP0State = USB_STATE_TX_CONFIG;
 
     //
     // Find the current configuration descriptor definition.
     //
-    psConfig = g_psUSBDevice[0].psInfo->ppConfigDescriptors[
-               g_psUSBDevice[0].ucConfigIndex];
+    psConfig = g_psUSBDevice[ulIndex].psInfo->ppConfigDescriptors[
+               g_psUSBDevice[ulIndex].ucConfigIndex];
 
     //
     // Set the number of bytes to send this iteration.
     //
-    ulNumBytes = g_psUSBDevice[0].ulEP0DataRemain;
+    ulNumBytes = g_psUSBDevice[ulIndex].ulEP0DataRemain;
 
     //
     // Limit individual transfers to 64 bytes.
@@ -2571,14 +3905,14 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
     // configuration descriptor.  This has already been determined and set in
     // g_sUSBDeviceState.ulEP0DataRemain.
     //
-    if((g_psUSBDevice[0].ucSectionOffset == 0) &&
-       (g_psUSBDevice[0].ucConfigSection == 0))
+    if((g_psUSBDevice[ulIndex].ucSectionOffset == 0) &&
+       (g_psUSBDevice[ulIndex].ucConfigSection == 0))
     {
         //
         // Copy the USB configuration descriptor from the beginning of the
         // first section of the current configuration.
         //
-        sConfDesc = *(tConfigDescriptor *)g_psUSBDevice[0].pEP0Data;
+        sConfDesc = *(tConfigDescriptor *)g_psUSBDevice[ulIndex].pEP0Data;
 
         //
         // Update the total size.
@@ -2591,7 +3925,8 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
         //
         ulToSend = (ulNumBytes < sizeof(tConfigDescriptor)) ? ulNumBytes :
                         sizeof(tConfigDescriptor);
-        MAP_USBEndpointDataPut(USB0_BASE, USB_EP_0, (unsigned char *)&sConfDesc,
+        MAP_USBEndpointDataPut(USB_INDEX_TO_BASE(ulIndex),
+                               USB_EP_0, (unsigned char *)&sConfDesc,
                            ulToSend);
 
         //
@@ -2603,15 +3938,15 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
             // Update our tracking indices to point to the start of the next
             // section.
             //
-            g_psUSBDevice[0].ucSectionOffset = 0;
-            g_psUSBDevice[0].ucConfigSection = 1;
+            g_psUSBDevice[ulIndex].ucSectionOffset = 0;
+            g_psUSBDevice[ulIndex].ucConfigSection = 1;
         }
         else
         {
             //
             // Note that we have sent the first few bytes of the descriptor.
             //
-            g_psUSBDevice[0].ucSectionOffset = (unsigned char)ulToSend;
+            g_psUSBDevice[ulIndex].ucSectionOffset = (unsigned char)ulToSend;
         }
 
         //
@@ -2635,20 +3970,21 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
         //
         // Get a pointer to the current configuration section.
         //
-        psSection = psConfig->psSections[g_psUSBDevice[0].ucConfigSection];
+        psSection =
+            psConfig->psSections[g_psUSBDevice[ulIndex].ucConfigSection];
 
         //
         // Calculate bytes are available in the current configuration section.
         //
         ulSecBytes = (unsigned long)(psSection->usSize -
-                     g_psUSBDevice[0].ucSectionOffset);
+                     g_psUSBDevice[ulIndex].ucSectionOffset);
 
         //
         // Save the pointer so that it can be passed to the
         // USBEndpointDataPut() function.
         //
         pData = (unsigned char *)psSection->pucData +
-                g_psUSBDevice[0].ucSectionOffset;
+                g_psUSBDevice[ulIndex].ucSectionOffset;
 
         //
         // Are there more bytes in this section that we still have to send?
@@ -2664,51 +4000,53 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
         //
         // Put the data in the correct FIFO.
         //
-        MAP_USBEndpointDataPut(USB0_BASE, USB_EP_0, pData, ulSecBytes);
+        MAP_USBEndpointDataPut(USB_INDEX_TO_BASE(ulIndex),
+                               USB_EP_0, pData, ulSecBytes);
 
         //
         // Fix up our pointers for the next iteration.
         //
         ulToSend -= ulSecBytes;
-        g_psUSBDevice[0].ucSectionOffset += (unsigned char)ulSecBytes;
+        g_psUSBDevice[ulIndex].ucSectionOffset += (unsigned char)ulSecBytes;
 
         //
         // Have we reached the end of a section?
         //
-        if(g_psUSBDevice[0].ucSectionOffset == psSection->usSize)
+        if(g_psUSBDevice[ulIndex].ucSectionOffset == psSection->usSize)
         {
             //
             // Yes - move to the next one.
             //
-            g_psUSBDevice[0].ucConfigSection++;
-            g_psUSBDevice[0].ucSectionOffset = 0;
+            g_psUSBDevice[ulIndex].ucConfigSection++;
+            g_psUSBDevice[ulIndex].ucSectionOffset = 0;
         }
     }
 
     //
     // Fix up the number of bytes remaining to be sent and the start pointer.
     //
-    g_psUSBDevice[0].ulEP0DataRemain -= ulNumBytes;
+    g_psUSBDevice[ulIndex].ulEP0DataRemain -= ulNumBytes;
 
     //
     // If we ran out of bytes in the configuration section, bail and just
     // send out what we have.
     //
-    if(psConfig->ucNumSections <= g_psUSBDevice[0].ucConfigSection)
+    if(psConfig->ucNumSections <= g_psUSBDevice[ulIndex].ucConfigSection)
     {
-        g_psUSBDevice[0].ulEP0DataRemain = 0;
+        g_psUSBDevice[ulIndex].ulEP0DataRemain = 0;
     }
 
     //
     // If there is no more data don't keep looking or ucConfigSection might
     // overrun the available space.
     //
-    if(g_psUSBDevice[0].ulEP0DataRemain != 0)
+    if(g_psUSBDevice[ulIndex].ulEP0DataRemain != 0)
     {
-        pData =(unsigned char *)
-            psConfig->psSections[g_psUSBDevice[0].ucConfigSection]->pucData;
-        ulToSend = g_psUSBDevice[0].ucSectionOffset;
-        g_psUSBDevice[0].pEP0Data = (pData + ulToSend);
+        pData = (unsigned char *)
+            psConfig->psSections[
+                g_psUSBDevice[ulIndex].ucConfigSection]->pucData;
+        ulToSend = g_psUSBDevice[ulIndex].ucSectionOffset;
+        g_psUSBDevice[ulIndex].pEP0Data = (pData + ulToSend);
     }
 
     //
@@ -2721,37 +4059,40 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
         // means that there is either more data coming or a null packet needs
         // to be sent to complete the transaction.
         //
-        MAP_USBEndpointDataSend(USB0_BASE, USB_EP_0, USB_TRANS_IN);
+        MAP_USBEndpointDataSend(USB_INDEX_TO_BASE(ulIndex),
+                                USB_EP_0, USB_TRANS_IN);
     }
     else
     {
         //
         // Send the last bit of data.
         //
-        MAP_USBEndpointDataSend(USB0_BASE, USB_EP_0, USB_TRANS_IN_LAST);
+        MAP_USBEndpointDataSend(USB_INDEX_TO_BASE(ulIndex),
+                                USB_EP_0, USB_TRANS_IN_LAST);
 
         //
         // If there is a sent callback then call it.
         //
-        if((g_psUSBDevice[0].psInfo->sCallbacks.pfnDataSent) &&
-           (g_psUSBDevice[0].ulOUTDataSize != 0))
+        if((g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnDataSent) &&
+           (g_psUSBDevice[ulIndex].ulOUTDataSize != 0))
         {
             //
             // Call the custom handler.
             //
-            g_psUSBDevice[0].psInfo->sCallbacks.pfnDataSent(
-                g_psUSBDevice[0].pvInstance, g_psUSBDevice[0].ulOUTDataSize);
+            g_psUSBDevice[ulIndex].psInfo->sCallbacks.pfnDataSent(
+                g_psUSBDevice[ulIndex].pvInstance,
+                g_psUSBDevice[ulIndex].ulOUTDataSize);
 
             //
             // There is no longer any data pending to be sent.
             //
-            g_psUSBDevice[0].ulOUTDataSize = 0;
+            g_psUSBDevice[ulIndex].ulOUTDataSize = 0;
         }
 
         //
         // Now go to the status state and wait for the transmit to complete.
         //
-        g_psUSBDevice[0].eEP0State = USB_STATE_STATUS;
+        g_psUSBDevice[ulIndex].eEP0State = USB_STATE_STATUS;
     }
 }
 
@@ -2764,7 +4105,8 @@ USBDEP0StateTxConfig(unsigned long ulIndex)
 // USBIntStatusControl().
 //
 // This function is called from either \e USB0DualModeIntHandler() or
-// \e USB0DeviceIntHandler() to process USB interrupts when in device mode.
+// \e USB0DeviceIntHandler(), or \e USB1DeviceIntHandler() for the second
+// controller, to process USB interrupts when in device mode.
 // This handler will branch the interrupt off to the appropriate application or
 // stack handlers depending on the current status of the USB controller.
 //
@@ -2787,21 +4129,22 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
     // If device initialization has not been performed then just disconnect
     // from the USB bus and return from the handler.
     //
-    if(g_psUSBDevice[0].psInfo == 0)
+    if(g_psUSBDevice[ulIndex].psInfo == 0)
     {
-        MAP_USBDevDisconnect(USB0_BASE);
+        MAP_USBDevDisconnect(USB_INDEX_TO_BASE(ulIndex));
         return;
     }
 
-    psInfo = g_psUSBDevice[0].psInfo;
-    pvInstance = g_psUSBDevice[0].pvInstance;
+    psInfo = g_psUSBDevice[ulIndex].psInfo;
+    pvInstance = g_psUSBDevice[ulIndex].pvInstance;
 
     //
     // Received a reset from the host.
     //
     if(ulStatus & USB_INTCTRL_RESET)
     {
-        USBDeviceEnumResetHandler(&g_psUSBDevice[0]);
+        USBDTraceEvent(&g_psUSBDevice[ulIndex], USBD_TRACE_RESET, 0);
+        USBDeviceEnumResetHandler(&g_psUSBDevice[ulIndex]);
     }
 
     //
@@ -2809,6 +4152,17 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
     //
     if(ulStatus & USB_INTCTRL_SUSPEND)
     {
+        USBDTraceEvent(&g_psUSBDevice[ulIndex], USBD_TRACE_SUSPEND, 0);
+
+        //
+        // There will be no more start of frame interrupts so let another
+        // controller drive the USB tick.
+        //
+        if(g_ulSOFTickIndex == ulIndex)
+        {
+            g_ulSOFTickIndex = USB_SOF_TICK_NONE;
+        }
+
         //
         // Call the SuspendHandler() if it was specified.
         //
@@ -2823,6 +4177,8 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
     //
     if(ulStatus & USB_INTCTRL_RESUME)
     {
+        USBDTraceEvent(&g_psUSBDevice[ulIndex], USBD_TRACE_RESUME, 0);
+
         //
         // Call the ResumeHandler() if it was specified.
         //
@@ -2837,6 +4193,17 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
     //
     if(ulStatus & USB_INTCTRL_DISCONNECT)
     {
+        USBDTraceEvent(&g_psUSBDevice[ulIndex], USBD_TRACE_DISCONNECT, 0);
+
+        //
+        // There will be no more start of frame interrupts so let another
+        // controller drive the USB tick.
+        //
+        if(g_ulSOFTickIndex == ulIndex)
+        {
+            g_ulSOFTickIndex = USB_SOF_TICK_NONE;
+        }
+
         //
         // Call the DisconnectHandler() if it was specified.
         //
@@ -2852,44 +4219,56 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
     if(ulStatus & USB_INTCTRL_SOF)
     {
         //
-        // Increment the global Start of Frame counter.
-        //
-        g_ulUSBSOFCount++;
-
-        //
-        // Increment our SOF divider.
+        // If no controller is driving the USB tick, use this one.
         //
-        ulSOFDivide++;
+        if(g_ulSOFTickIndex == USB_SOF_TICK_NONE)
+        {
+            g_ulSOFTickIndex = ulIndex;
+        }
 
         //
         // Handle resume signaling if required.
         //
-        USBDeviceResumeTickHandler(&g_psUSBDevice[0]);
+        USBDeviceResumeTickHandler(&g_psUSBDevice[ulIndex]);
 
-        //
-        // Have we counted enough SOFs to allow us to call the tick function?
-        //
-        if(ulSOFDivide == USB_SOF_TICK_DIVIDE)
+        if(g_ulSOFTickIndex == ulIndex)
         {
             //
-            // Yes - reset the divider and call the SOF tick handler.
+            // Increment the global Start of Frame counter.
+            //
+            g_ulUSBSOFCount++;
+
+            //
+            // Increment our SOF divider.
+            //
+            ulSOFDivide++;
+
+            //
+            // Have we counted enough SOFs to allow us to call the tick
+            // function?
             //
-            ulSOFDivide = 0;
-            InternalUSBStartOfFrameTick(USB_SOF_TICK_DIVIDE);
+            if(ulSOFDivide == USB_SOF_TICK_DIVIDE)
+            {
+                //
+                // Yes - reset the divider and call the SOF tick handler.
+                //
+                ulSOFDivide = 0;
+                InternalUSBStartOfFrameTick(USB_SOF_TICK_DIVIDE);
+            }
         }
     }
 
     //
     // Get the controller interrupt status.
     //
-    ulStatus = MAP_USBIntStatusEndpoint(USB0_BASE);
+    ulStatus = MAP_USBIntStatusEndpoint(USB_INDEX_TO_BASE(ulIndex));
 
     //
     // Handle end point 0 interrupts.
     //
     if(ulStatus & USB_INTEP_0)
     {
-        USBDeviceEnumHandler(&g_psUSBDevice[0]);
+        USBDeviceEnumHandler(&g_psUSBDevice[ulIndex]);
     }
 
     //
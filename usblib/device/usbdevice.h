@@ -54,6 +54,91 @@ extern "C"
 //*****************************************************************************
 #define USB_MAX_INTERFACES_PER_DEVICE 8
 
+//*****************************************************************************
+//
+//! The maximum number of languages that a device's string descriptor table can
+//! offer.  This is the number of language IDs in string descriptor 0.
+//
+//*****************************************************************************
+#define USB_MAX_STRING_LANGS 8
+
+//*****************************************************************************
+//
+//! Values of tUSBDTraceEvent.ucEvent identifying the events recorded by the
+//! enumeration tracer.
+//
+//*****************************************************************************
+#define USBD_TRACE_RESET        0
+#define USBD_TRACE_REQUEST      1
+#define USBD_TRACE_SUSPEND      2
+#define USBD_TRACE_RESUME       3
+#define USBD_TRACE_DISCONNECT   4
+
+//*****************************************************************************
+//
+//! Flags which may be set in tUSBDTraceEvent.ucFlags for a
+//! \b USBD_TRACE_REQUEST event.
+//
+//*****************************************************************************
+#define USBD_TRACE_FLAG_DONE     0x01
+#define USBD_TRACE_FLAG_STALLED  0x02
+#define USBD_TRACE_FLAG_DEFERRED 0x04
+
+//*****************************************************************************
+//
+//! An event recorded by the enumeration tracer.  The structure is 20 bytes
+//! long so that the trace can be passed to the host unchanged.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The time at which the event occurred, read from the counter function
+    //! passed to USBDCDTraceSet().
+    //
+    unsigned long ulTime;
+
+    //
+    //! For a request which has completed, the number of counter ticks from
+    //! the arrival of the setup packet to the completion of the status stage
+    //! or to the stall.  This is 0 for other events.
+    //
+    unsigned long ulDuration;
+
+    //
+    //! The event, one of the \b USBD_TRACE_xxx values.
+    //
+    unsigned char ucEvent;
+
+    //
+    //! For a request, the logical OR of the \b USBD_TRACE_FLAG_xxx flags
+    //! describing how it was handled.
+    //
+    unsigned char ucFlags;
+
+    //
+    //! Reserved for future use.
+    //
+    unsigned short usReserved;
+
+    //
+    //! For a request, the setup packet received from the host.
+    //
+    tUSBRequest sRequest;
+}
+tUSBDTraceEvent;
+
+//*****************************************************************************
+//
+//! A function pointer type describing a free-running counter used to time
+//! stamp the events recorded by the enumeration tracer.  The function must
+//! return a count that increments at a constant rate and wraps from
+//! 0xFFFFFFFF to 0, such as a processor cycle counter.  It is called from the
+//! USB interrupt handler and must not block.
+//
+//*****************************************************************************
+typedef unsigned long (* tUSBDTraceCounter)(void);
+
 #include "./usbdevicepriv.h"
 
 //*****************************************************************************
@@ -143,6 +228,67 @@ struct tDeviceInfo
     tDeviceInstance *psDevice;
 };
 
+//*****************************************************************************
+//
+//! The value of tUSBMSOS20Config.ucFirstInterface indicating that the
+//! Microsoft OS 2.0 descriptors apply to the whole device rather than to one
+//! function of a composite device.
+//
+//*****************************************************************************
+#define USB_MSOS20_DEVICE       0xFF
+
+//*****************************************************************************
+//
+//! The value of wIndex in the vendor request by which the host reads the
+//! Microsoft OS 2.0 descriptor set.
+//
+//*****************************************************************************
+#define USB_MSOS20_DESCRIPTOR_INDEX 7
+
+//*****************************************************************************
+//
+//! Flags passed to USBDCDDeferRequests() to select the types of non-standard
+//! request which are handled from USBDCDProcessDeferred() rather than from
+//! the USB interrupt handler.
+//
+//*****************************************************************************
+#define USBD_DEFER_CLASS        0x00000002
+#define USBD_DEFER_VENDOR       0x00000004
+
+//*****************************************************************************
+//
+//! This structure describes the Microsoft OS 2.0 descriptors which the USB
+//! library is to generate by a call to USBDCDMSOS20Set().
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The vendor-specific bRequest value which the host is to use to read
+    //! the descriptor set.
+    //
+    unsigned char ucVendorCode;
+
+    //
+    //! The first interface of the function to which the descriptors apply or
+    //! USB_MSOS20_DEVICE if they apply to the whole device.
+    //
+    unsigned char ucFirstInterface;
+
+    //
+    //! The compatible ID, such as "WINUSB", of up to 8 characters.
+    //
+    const char *pcCompatibleID;
+
+    //
+    //! The device interface GUID in registry format, such as
+    //! "{6E45736A-2B1B-4078-B772-B3AF2B6FDE1C}", or 0 if no
+    //! DeviceInterfaceGUIDs registry property is to be set.
+    //
+    const char *pcInterfaceGUID;
+}
+tUSBMSOS20Config;
+
 //*****************************************************************************
 //
 // The default USB endpoint FIFO configuration structure.  This structure
@@ -168,6 +314,22 @@ extern void USBDCDRequestDataEP0(unsigned long ulIndex, unsigned char *pucData,
                                  unsigned long ulSize);
 extern void USBDCDSendDataEP0(unsigned long ulIndex, unsigned char *pucData,
                               unsigned long ulSize);
+extern void USBDCDSendStreamEP0(unsigned long ulIndex, unsigned long ulSize,
+                                tUSBEP0Fill pfnFill, void *pvFillData);
+extern tBoolean USBDCDMSOS20Set(unsigned long ulIndex,
+                                const tUSBMSOS20Config *psConfig);
+extern unsigned long USBDCDConfigDescFlatten(unsigned long ulIndex,
+                                             unsigned char *pucBuffer,
+                                             unsigned long ulSize);
+extern void USBDCDDeferRequests(unsigned long ulIndex, unsigned long ulTypes);
+extern void USBDCDProcessDeferred(unsigned long ulIndex);
+extern void USBDCDTraceSet(unsigned long ulIndex, tUSBDTraceEvent *psEvents,
+                           unsigned long ulNumEvents,
+                           tUSBDTraceCounter pfnCounter);
+extern unsigned long USBDCDTraceRead(unsigned long ulIndex,
+                                     tUSBDTraceEvent *psEvents,
+                                     unsigned long ulNumEvents);
+extern tBoolean USBDCDStringTableValid(unsigned long ulIndex);
 extern void USBDCDSetDefaultConfiguration(unsigned long ulIndex,
                                           unsigned long ulDefaultConfig);
 extern unsigned long USBDCDConfigDescGetSize(const tConfigHeader *psConfig);
@@ -191,6 +353,11 @@ extern tEndpointDescriptor *
                                         unsigned long ulIndex);
 extern void USBDCDPowerStatusSet(unsigned long ulIndex, unsigned char ucPower);
 extern tBoolean USBDCDRemoteWakeupRequest(unsigned long ulIndex);
+extern tBoolean USBDCDEndpointDoubleBuffered(unsigned long ulIndex,
+                                             unsigned long ulEndpoint,
+                                             unsigned long ulFlags);
+extern unsigned long USBDCDFIFOUsageGet(unsigned long ulIndex,
+                                        unsigned long *pulAvailable);
 
 //*****************************************************************************
 //
@@ -210,6 +377,7 @@ extern tBoolean USBDCDRemoteWakeupRequest(unsigned long ulIndex);
 //
 //*****************************************************************************
 extern void USB0DeviceIntHandler(void);
+extern void USB1DeviceIntHandler(void);
 
 //*****************************************************************************
 //
@@ -39,6 +39,48 @@ extern "C"
 {
 #endif
 
+//*****************************************************************************
+//
+// The number of USB controllers that can operate as devices and macros to
+// convert between a controller's index and its base address, peripheral and
+// interrupt.  Parts with a second controller define USB1_BASE.
+//
+//*****************************************************************************
+#ifdef USB1_BASE
+#define USB_NUM_DEVICE_CONTROLLERS 2
+#define USB_INDEX_TO_BASE(Index)                                              \
+        ((Index) ? USB1_BASE : USB0_BASE)
+#define USB_BASE_TO_INDEX(BaseAddr)                                           \
+        (((BaseAddr) == USB1_BASE) ? 1 : 0)
+#define USB_INDEX_TO_PERIPH(Index)                                            \
+        ((Index) ? SYSCTL_PERIPH_USB1 : SYSCTL_PERIPH_USB0)
+#define USB_INDEX_TO_INT(Index)                                               \
+        ((Index) ? INT_USB1 : INT_USB0)
+#else
+#define USB_NUM_DEVICE_CONTROLLERS 1
+#define USB_INDEX_TO_BASE(Index)    (USB0_BASE)
+#define USB_BASE_TO_INDEX(BaseAddr) (0)
+#define USB_INDEX_TO_PERIPH(Index)  (SYSCTL_PERIPH_USB0)
+#define USB_INDEX_TO_INT(Index)     (INT_USB0)
+#endif
+
+//*****************************************************************************
+//
+// The size of the hash table used to find the group of string descriptors for
+// a language.  This must hold at least twice USB_MAX_STRING_LANGS entries so
+// that the table is never more than half full.
+//
+//*****************************************************************************
+#define USB_STRING_LANG_BITS    4
+#define USB_STRING_LANG_SLOTS   (1 << USB_STRING_LANG_BITS)
+
+//*****************************************************************************
+//
+// The value marking an unused entry in the language hash table.
+//
+//*****************************************************************************
+#define USB_STRING_LANG_NONE    0xFF
+
 //*****************************************************************************
 //
 // The states for endpoint zero during enumeration.
@@ -94,6 +136,11 @@ typedef struct tDeviceInstance tDeviceInstance;
 //*****************************************************************************
 struct tDeviceInstance
 {
+    //
+    // The index of the USB controller that this instance is using.
+    //
+    unsigned long ulIndex;
+
     //
     // The device information for the USB device.
     //
@@ -147,6 +194,13 @@ struct tDeviceInstance
     //
     unsigned long ulOUTDataSize;
 
+    //
+    // If data is being streamed to the host on endpoint zero, the function
+    // which provides each packet and the pointer passed to it.
+    //
+    tUSBEP0Fill pfnEP0Fill;
+    void *pvEP0FillData;
+
     //
     // Holds the current device status.
     //
@@ -176,6 +230,82 @@ struct tDeviceInstance
     //
     unsigned char ucConfigIndex;
 
+    //
+    // Points to the configuration descriptors flattened by
+    // USBDCDConfigDescFlatten() or is 0 if the descriptors are to be sent
+    // section by section.
+    //
+    const unsigned char *pucFlatConfig;
+
+    //
+    // A hash table holding each language ID from string descriptor 0 and the
+    // position of that language's group of strings in the string descriptor
+    // table.  Unused entries have a group of USB_STRING_LANG_NONE.
+    //
+    unsigned short pusLangID[USB_STRING_LANG_SLOTS];
+    unsigned char pucLangGroup[USB_STRING_LANG_SLOTS];
+
+    //
+    // The number of strings in each language group or 0 if the device's
+    // string descriptor table is not valid.
+    //
+    unsigned long ulStringsPerLang;
+
+    //
+    // This flag is false if the device's string descriptor table was found
+    // to be invalid when the device was initialized.
+    //
+    tBoolean bStringTableValid;
+
+    //
+    // This flag is true if the languages are held in the hash table or false
+    // if the language descriptor lists too many languages for the hash table
+    // and must be searched on each request instead.
+    //
+    tBoolean bStringLangHashed;
+
+    //
+    // The USBD_DEFER_xxx flags for the types of non-standard request which are
+    // passed to the request handler by USBDCDProcessDeferred() rather than
+    // from the interrupt handler.
+    //
+    unsigned long ulDeferTypes;
+
+    //
+    // The request waiting to be passed to the request handler by
+    // USBDCDProcessDeferred().  Only one control transfer can be in progress
+    // on endpoint zero so there is never more than one request waiting.
+    //
+    tUSBRequest sDeferredRequest;
+
+    //
+    // This flag is set by the interrupt handler when sDeferredRequest holds a
+    // request which has not yet been handled.
+    //
+    volatile tBoolean bRequestDeferred;
+
+    //
+    // The ring of events recorded by the enumeration tracer, the number of
+    // events it can hold and the counter used to time stamp them.  The tracer
+    // is disabled if psTrace is 0.
+    //
+    tUSBDTraceEvent *psTrace;
+    unsigned long ulTraceSize;
+    tUSBDTraceCounter pfnTraceCounter;
+
+    //
+    // The entry in psTrace to which the next event is written and the number
+    // of entries which hold events.
+    //
+    unsigned long ulTraceNext;
+    unsigned long ulTraceUsed;
+
+    //
+    // The request event waiting for its control transfer to complete or 0 if
+    // there is none.
+    //
+    tUSBDTraceEvent *psTraceOpen;
+
     //
     // This flag is set to true if the client has called USBDPowerStatusSet
     // and tells the USB library not to try to determine the current power
@@ -194,6 +324,18 @@ struct tDeviceInstance
     // number of milliseconds since the signaling was initiated.
     //
     unsigned char ucRemoteWakeupCount;
+
+    //
+    // Bit masks of the IN and OUT endpoints whose FIFOs are double-buffered
+    // in the current configuration.  Bit n corresponds to endpoint n.
+    //
+    unsigned short usINDoubleBuffered;
+    unsigned short usOUTDoubleBuffered;
+
+    //
+    // The number of bytes of FIFO RAM required by the current configuration.
+    //
+    unsigned short usFIFOUsed;
 };
 
 extern tDeviceInstance g_psUSBDevice[];
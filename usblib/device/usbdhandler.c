@@ -74,6 +74,36 @@ USB0DeviceIntHandler(void)
     USBDeviceIntHandlerInternal(0, ulStatus);
 }
 
+#ifdef USB1_BASE
+//*****************************************************************************
+//
+//! The USB device interrupt handler for the second USB controller.
+//!
+//! On parts with a second USB controller, applications using it as a device
+//! must ensure that a pointer to this function is installed in the interrupt
+//! vector table entry for the USB1 interrupt.  The device on this controller
+//! is initialized by passing index 1 to the class initialization function.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USB1DeviceIntHandler(void)
+{
+    unsigned long ulStatus;
+
+    //
+    // Get the controller interrupt status.
+    //
+    ulStatus = MAP_USBIntStatusControl(USB1_BASE);
+
+    //
+    // Call the internal handler.
+    //
+    USBDeviceIntHandlerInternal(1, ulStatus);
+}
+#endif
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
@@ -70,16 +70,6 @@
 #define HID_DO_PACKET_RX        5
 #define HID_DO_SEND_IDLE_REPORT 6
 
-//*****************************************************************************
-//
-// Macros to convert between USB controller base address and an index.  These
-// are currently trivial but are included to allow for the possibility of
-// supporting more than one controller in the future.
-//
-//*****************************************************************************
-#define USB_BASE_TO_INDEX(BaseAddr) (0)
-#define USB_INDEX_TO_BASE(Index)    (USB0_BASE)
-
 //*****************************************************************************
 //
 // Endpoints to use for each of the required endpoints in the driver.
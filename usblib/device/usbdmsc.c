@@ -314,7 +314,9 @@ static void HandleDevice(void *pvInstance, unsigned long ulRequest,
 
 //*****************************************************************************
 //
-// The FIFO configuration for USB mass storage class device.
+// The FIFO configuration for USB mass storage class device.  The endpoints
+// are kept single-buffered since the uDMA transfer handling expects each
+// FIFO to hold no more than one packet.
 //
 //*****************************************************************************
 const tFIFOConfig g_sUSBMSCFIFOConfig =
@@ -323,7 +325,7 @@ const tFIFOConfig g_sUSBMSCFIFOConfig =
     // IN endpoints.
     //
     {
-        { false, USB_EP_DEV_IN | USB_EP_DMA_MODE_1 | USB_EP_AUTO_SET },
+        { false, USB_EP_DEV_IN | USB_EP_DMA_MODE_1 | USB_EP_AUTO_SET, true },
         { false, USB_EP_DEV_IN },
         { false, USB_EP_DEV_IN },
         { false, USB_EP_DEV_IN },
@@ -344,7 +346,8 @@ const tFIFOConfig g_sUSBMSCFIFOConfig =
     // OUT endpoints.
     //
     {
-        { false, USB_EP_DEV_OUT | USB_EP_DMA_MODE_1 | USB_EP_AUTO_CLEAR },
+        { false, USB_EP_DEV_OUT | USB_EP_DMA_MODE_1 | USB_EP_AUTO_CLEAR,
+          true },
         { false, USB_EP_DEV_OUT },
         { false, USB_EP_DEV_OUT },
         { false, USB_EP_DEV_OUT },
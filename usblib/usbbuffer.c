@@ -24,6 +24,7 @@
 
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "usblib/usblib.h"
 #include "usblib/usblibpriv.h"
 
@@ -45,7 +46,11 @@ typedef struct
 {
     tUSBRingBufObject sRingBuf;
     unsigned long ulLastSent;
+    unsigned long ulInFlight;
+    unsigned long ulRxTime;
     unsigned long ulFlags;
+    unsigned long ulSplitCount;
+    volatile unsigned long ulSchedule;
 }
 tUSBBufferVars;
 
@@ -55,18 +60,133 @@ tUSBBufferVars;
 //
 //*****************************************************************************
 #define USB_BUFFER_FLAG_SEND_ZLP 0x00000001
+#define USB_BUFFER_FLAG_RX_TIMING 0x00000002
 
 //*****************************************************************************
 //
-// Schedule the next packet transmission to the host if data remains to be
+// Flags which may be set in the tUSBBufferVars ulSchedule field.  These are
+// kept apart from ulFlags since they are changed with interrupts disabled
+// from both the client and the USB interrupt handler.
+//
+//*****************************************************************************
+#define USB_BUFFER_SCHED_BUSY   0x00000001
+#define USB_BUFFER_SCHED_AGAIN  0x00000002
+
+//*****************************************************************************
+//
+// Copy data written to the start of the ring buffer into the slack area
+// which follows it.
+//
+// \param psBuffer points to the buffer whose slack area is to be updated.
+// \param ulStart is the offset within the ring of the first byte written.
+// \param ulEnd is the offset within the ring one past the last byte written.
+// \param pucSrc points to the data written at offset \e ulStart.
+//
+// Only those bytes falling within the first ulSlackSize bytes of the ring are
+// copied.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+MirrorSlack(const tUSBBuffer *psBuffer, unsigned long ulStart,
+            unsigned long ulEnd, const unsigned char *pucSrc)
+{
+    unsigned char *pucDst;
+
+    //
+    // Trim the range to the part which is mirrored.
+    //
+    if(ulEnd > psBuffer->ulSlackSize)
+    {
+        ulEnd = psBuffer->ulSlackSize;
+    }
+
+    //
+    // Copy the bytes to their mirror positions following the ring.
+    //
+    pucDst = psBuffer->pcBuffer + psBuffer->ulBufferSize + ulStart;
+    while(ulStart < ulEnd)
+    {
+        *pucDst++ = *pucSrc++;
+        ulStart++;
+    }
+}
+
+//*****************************************************************************
+//
+// Update the slack area of a transmit buffer before new data is added to it.
+//
+// \param psBuffer points to the buffer into which data is being written.
+// \param pucData points to the new data or is NULL if the data has already
+// been written into the ring buffer by the client.
+// \param ulLength is the number of bytes of new data.
+//
+// This function must be called before the ring buffer write index is advanced
+// so that the mirrored data is in place before it can be transmitted.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+UpdateSlack(const tUSBBuffer *psBuffer, const unsigned char *pucData,
+            unsigned long ulLength)
+{
+    tUSBBufferVars *psVars;
+    unsigned long ulStart, ulEnd;
+
+    //
+    // Get a pointer to our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Work out where in the ring the new data starts and ends.
+    //
+    ulStart = (unsigned long)(USBRingBufWritePtr(&psVars->sRingBuf) -
+                              psBuffer->pcBuffer);
+    ulEnd = ulStart + ulLength;
+
+    //
+    // Does the new data start within the mirrored part of the ring?
+    //
+    if(ulStart < psBuffer->ulSlackSize)
+    {
+        MirrorSlack(psBuffer, ulStart, ulEnd,
+                    pucData ? pucData : (psBuffer->pcBuffer + ulStart));
+    }
+
+    //
+    // Does the new data wrap back into the mirrored part of the ring?
+    //
+    if(ulEnd > psBuffer->ulBufferSize)
+    {
+        MirrorSlack(psBuffer, 0, ulEnd - psBuffer->ulBufferSize,
+                    pucData ? (pucData + (psBuffer->ulBufferSize - ulStart)) :
+                    psBuffer->pcBuffer);
+    }
+}
+
+//*****************************************************************************
+//
+// Schedule the next packet transmissions to the host if data remains to be
 // sent.
 //
-// \param psBuffer points to the buffer from which a packet transmission is
+// \param psBuffer points to the buffer from which packet transmissions are
 // to be scheduled.
 //
 // This function checks to determine whether the lower layer is capable of
 // accepting a new packet for transmission and, if so, schedules the next
-// packet transmission if data remains in the buffer.
+// packet transmission if data remains in the buffer.  This is repeated for as
+// long as the lower layer continues to accept packets so that a lower layer
+// which can queue more than one packet (for example, one using a
+// double-buffered endpoint FIFO) is kept fed with data.
+//
+// This function is called both from the client and from the USB interrupt.
+// Rather than keeping interrupts disabled while packets are passed to the
+// lower layer, only one caller at a time is allowed to schedule packets.  If
+// the USB interrupt calls this function while the client is scheduling, it
+// leaves a note for the client to check again once it has finished.
 //
 // \return None.
 //
@@ -75,113 +195,309 @@ static void
 ScheduleNextTransmission(const tUSBBuffer *psBuffer)
 {
     tUSBBufferVars *psVars;
-    unsigned long ulPacket, ulSpace, ulTotal, ulSent;
+    unsigned long ulPacket, ulSpace, ulTotal, ulSent, ulOffset, ulSize;
+    tBoolean bIntsOff, bAgain;
 
     //
     // Get a pointer to our workspace variables.
     //
     psVars = psBuffer->pvWorkspace;
+    ulSize = USBRingBufSize(&psVars->sRingBuf);
 
     //
-    // Ask the lower layer if it has space to accept another packet of data.
+    // If another caller is already scheduling packets, ask it to look again
+    // when it has finished and return.  Otherwise, claim the scheduler.
     //
-    ulPacket = psBuffer->pfnAvailable(psBuffer->pvHandle);
+    bIntsOff = IntMasterDisable();
+    bAgain = (psVars->ulSchedule & USB_BUFFER_SCHED_BUSY) ? true : false;
+    psVars->ulSchedule |= bAgain ? USB_BUFFER_SCHED_AGAIN :
+                                   USB_BUFFER_SCHED_BUSY;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+    if(bAgain)
+    {
+        return;
+    }
 
-    //
-    // If we were returned something other than zero, we can write that number
-    // of bytes to the lower layer.
-    //
-    if(ulPacket)
+    do
     {
         //
-        // How much contiguous data do we have in the buffer?
+        // Keep asking the lower layer if it has space to accept another
+        // packet of data.  If we are returned something other than zero, we
+        // can write that number of bytes to the lower layer.
         //
-        ulSpace = USBRingBufContigUsed(&psVars->sRingBuf);
+        while((ulPacket = psBuffer->pfnAvailable(psBuffer->pvHandle)) != 0)
+        {
+            //
+            // How much data do we have in the buffer which has not already
+            // been passed to the lower layer and where does it start?  The
+            // USB interrupt advances the read index and reduces the in-flight
+            // count together so read them with interrupts disabled.
+            //
+            bIntsOff = IntMasterDisable();
+            ulTotal = USBRingBufUsed(&psVars->sRingBuf);
+            ulSent = psVars->ulInFlight;
+            ulOffset = (unsigned long)(USBRingBufReadPtr(&psVars->sRingBuf) -
+                                       psVars->sRingBuf.pucBuf) + ulSent;
+            if(!bIntsOff)
+            {
+                IntMasterEnable();
+            }
+            ulTotal = (ulTotal > ulSent) ? (ulTotal - ulSent) : 0;
 
-        //
-        // How much total data do we have in the buffer?
-        //
-        ulTotal = USBRingBufUsed(&psVars->sRingBuf);
+            if(!ulTotal)
+            {
+                //
+                // There is no data to send.  Did we last send a full packet?
+                //
+                if(psVars->ulLastSent == ulPacket)
+                {
+                    //
+                    // Yes - if necessary, send a zero-length packet back to
+                    // the host to complete the last transaction.
+                    //
+                    if(psVars->ulFlags & USB_BUFFER_FLAG_SEND_ZLP)
+                    {
+                        psVars->ulLastSent = 0;
+                        psBuffer->pfnTransfer(psBuffer->pvHandle,
+                                              psVars->sRingBuf.pucBuf, 0,
+                                              true);
+                    }
+                }
 
-        //
-        // How much data will we be sending as a result of this call?
-        //
-        ulSent = (ulPacket < ulTotal) ? ulPacket : ulTotal;
+                //
+                // There is nothing more we can do until more data is written.
+                //
+                break;
+            }
 
-        //
-        // Write the contiguous bytes to the lower layer assuming there is
-        // something to send.
-        //
-        if(ulSpace)
-        {
             //
-            // There is data available to send.  Update our state to indicate
-            // the amount we will be sending in this packet.
+            // How much of the unsent data is contiguous?
             //
-            psVars->ulLastSent = ulSent;
+            if(ulOffset >= ulSize)
+            {
+                ulOffset -= ulSize;
+            }
+            ulSpace = ulSize - ulOffset;
+
+            //
+            // How much data will we be sending as a result of this call?
+            //
+            ulSent = (ulPacket < ulTotal) ? ulPacket : ulTotal;
 
             //
             // Determine the maximum sized block we can send in this transfer.
+            // If the packet straddles the buffer wrap but the remainder has
+            // been mirrored into the slack following the ring, the whole
+            // packet is contiguous.
             //
-            ulSpace = (ulSpace < ulPacket) ? ulSpace : ulPacket;
+            ulSpace = (ulSpace < ulSent) ? ulSpace : ulSent;
+            if((ulSpace < ulSent) &&
+               ((ulSent - ulSpace) <= psBuffer->ulSlackSize))
+            {
+                ulSpace = ulSent;
+            }
+
             //
             // Call the lower layer to send the new packet.  If the current
             // data spans the buffer wrap, tell the lower layer that it can
             // expect a second call to fill the whole packet before it
             // transmits it.
             //
-            psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                 (psVars->sRingBuf.pucBuf +
-                                  psVars->sRingBuf.ulReadIndex), ulSpace,
-                                  (((ulSpace < ulPacket) &&
-                                    (ulSpace < ulTotal)) ? false : true));
+            if(!psBuffer->pfnTransfer(psBuffer->pvHandle,
+                                      psVars->sRingBuf.pucBuf + ulOffset,
+                                      ulSpace,
+                                      (ulSpace < ulSent) ? false : true))
+            {
+                //
+                // The lower layer refused the packet so give up for now.
+                //
+                break;
+            }
 
             //
             // Do we need to send a second part to fill out the packet?  This
             // will occur if the current packet spans the buffer wrap.
             //
-            if((ulSpace < ulPacket) && (ulSpace < ulTotal))
+            if(ulSpace < ulSent)
             {
                 //
-                // The packet straddled the wrap.  How much space remains in
-                // the packet?
-                //
-                ulPacket -= ulSpace;
-
-                //
-                // How much data can we actually send?
+                // The packet straddled the wrap.  Keep track of how often
+                // this happens.
                 //
-                ulSpace = ulTotal - ulSpace;
-                ulSpace = (ulSpace > ulPacket) ? ulPacket : ulSpace;
+                psVars->ulSplitCount++;
 
                 psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                      psVars->sRingBuf.pucBuf, ulSpace, true);
+                                      psVars->sRingBuf.pucBuf,
+                                      ulSent - ulSpace, true);
             }
-        }
-        else
-        {
+
             //
-            // There is no data to send.  Did we last send a full packet?
+            // Update our state to indicate the amount we sent in this packet.
+            // Don't update the ring buffer read index yet.  We do this once
+            // we are sure the packet was correctly transmitted.  The USB
+            // interrupt reduces the in-flight count as packets complete so
+            // interrupts are disabled while it is increased.
             //
-            if(psVars->ulLastSent == ulPacket)
+            psVars->ulLastSent = ulSent;
+            bIntsOff = IntMasterDisable();
+            psVars->ulInFlight += ulSent;
+            if(!bIntsOff)
             {
-                //
-                // Yes - if necessary, send a zero-length packet back to the
-                // host to complete the last transaction.
-                //
-                if(psVars->ulFlags & USB_BUFFER_FLAG_SEND_ZLP)
-                {
-                    psVars->ulLastSent = 0;
-                    psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                          psVars->sRingBuf.pucBuf, 0, true);
-                }
+                IntMasterEnable();
             }
         }
 
         //
-        // Don't update the ring buffer read index yet.  We do this once we are
-        // sure the packet was correctly transmitted.
+        // Release the scheduler unless the USB interrupt asked for another
+        // look while we were busy.
+        //
+        bIntsOff = IntMasterDisable();
+        bAgain = (psVars->ulSchedule & USB_BUFFER_SCHED_AGAIN) ? true : false;
+        psVars->ulSchedule = bAgain ? USB_BUFFER_SCHED_BUSY : 0;
+        if(!bIntsOff)
+        {
+            IntMasterEnable();
+        }
+    }
+    while(bAgain);
+}
+
+//*****************************************************************************
+//
+// Tells the lower layer that space has been freed in a receive buffer.
+//
+// \param psBuffer points to the buffer in which space has been freed.
+//
+// This allows the lower layer to deliver any packet that it was holding back
+// because the buffer was full without waiting to retry it later.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+ResumeRx(const tUSBBuffer *psBuffer)
+{
+    if(!psBuffer->bTransmitBuffer && psBuffer->pfnResume)
+    {
+        psBuffer->pfnResume(psBuffer->pvHandle);
+    }
+}
+
+//*****************************************************************************
+//
+// Sends USB_EVENT_RX_AVAILABLE to the client of a receive buffer.
+//
+// \param psBuffer points to the buffer whose client is to be notified.
+//
+// This function passes the current read pointer and amount of data in the
+// buffer to the client then removes any data that the client reports it has
+// read.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+NotifyRxAvailable(const tUSBBuffer *psBuffer)
+{
+    tUSBBufferVars *psVars;
+    unsigned long ulAvail, ulRead;
+
+    //
+    // Get a pointer to our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // How much data do we have in the buffer?
+    //
+    ulAvail = USBRingBufUsed(&psVars->sRingBuf);
+
+    //
+    // Pass the event on to the client with the current read pointer and
+    // available data size.  The client is expected to understand the ring
+    // structure and be able to deal with wrap if it wants to read the data
+    // directly from the buffer.
+    //
+    ulRead = psBuffer->pfnCallback(psBuffer->pvCBData,
+                                   USB_EVENT_RX_AVAILABLE,
+                                   ulAvail,
+                                   USBRingBufReadPtr(&psVars->sRingBuf));
+
+    //
+    // If the client read anything from the buffer, update the read pointer
+    // and let the lower layer know that there is more space.
+    //
+    USBRingBufAdvanceRead(&psVars->sRingBuf, ulRead);
+    if(ulRead)
+    {
+        ResumeRx(psBuffer);
+    }
+
+    //
+    // If we are coalescing notifications, restart the timeout for any data
+    // the client left in the buffer.
+    //
+    if(USBRingBufEmpty(&psVars->sRingBuf))
+    {
+        psVars->ulFlags &= ~USB_BUFFER_FLAG_RX_TIMING;
+    }
+    else
+    {
+        psVars->ulRxTime = InternalUSBGetTime();
+    }
+}
+
+//*****************************************************************************
+//
+// Handles the USB library tick for a receive buffer which is coalescing
+// notifications.
+//
+// \param pvInstance is the buffer instance pointer that was registered with
+// the tick handler.
+// \param ulTicksmS is the number of milliseconds since the last tick.
+//
+// This function notifies the client of any data which has been waiting in
+// the buffer for longer than the buffer's ulRxTimeoutmS.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+BufferTickHandler(void *pvInstance, unsigned long ulTicksmS)
+{
+    const tUSBBuffer *psBuffer;
+    tUSBBufferVars *psVars;
+
+    //
+    // Get pointers to the buffer and our workspace variables.
+    //
+    psBuffer = (const tUSBBuffer *)pvInstance;
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Is there data waiting for the client?
+    //
+    if(psVars->ulFlags & USB_BUFFER_FLAG_RX_TIMING)
+    {
+        //
+        // If the client read the data without being notified, stop timing.
+        //
+        if(USBRingBufEmpty(&psVars->sRingBuf))
+        {
+            psVars->ulFlags &= ~USB_BUFFER_FLAG_RX_TIMING;
+        }
+
+        //
+        // Otherwise, notify the client if the data has waited long enough.
         //
+        else if((InternalUSBGetTime() - psVars->ulRxTime) >=
+                psBuffer->ulRxTimeoutmS)
+        {
+            NotifyRxAvailable(psBuffer);
+        }
     }
 }
 
@@ -289,8 +605,7 @@ HandleRxAvailable(tUSBBuffer *psBuffer, unsigned long ulSize,
         // Get as much of the packet as we can in the available space.
         //
         ulRead = psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                       (psVars->sRingBuf.pucBuf +
-                                        psVars->sRingBuf.ulWriteIndex),
+                                       USBRingBufWritePtr(&psVars->sRingBuf),
                                        ulAvail, true);
 
         //
@@ -319,8 +634,8 @@ HandleRxAvailable(tUSBBuffer *psBuffer, unsigned long ulSize,
             {
                 ulPacket =
                     psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                          (psVars->sRingBuf.pucBuf +
-                                           psVars->sRingBuf.ulWriteIndex),
+                                          USBRingBufWritePtr(
+                                              &psVars->sRingBuf),
                                           ulAvail, true);
 
                 //
@@ -342,26 +657,32 @@ HandleRxAvailable(tUSBBuffer *psBuffer, unsigned long ulSize,
     }
 
     //
-    // How much data do we have in the buffer?
+    // If we are coalescing notifications, start timing the new data if we
+    // are not already doing so then only tell the client about it if enough
+    // has arrived, the buffer is full or it has been waiting too long.
     //
-    ulAvail = USBRingBufUsed(&psVars->sRingBuf);
+    if(psBuffer->ulRxThreshold)
+    {
+        if(!(psVars->ulFlags & USB_BUFFER_FLAG_RX_TIMING))
+        {
+            psVars->ulFlags |= USB_BUFFER_FLAG_RX_TIMING;
+            psVars->ulRxTime = InternalUSBGetTime();
+        }
 
-    //
-    // Pass the event on to the client with the current read pointer and
-    // available data size.  The client is expected to understand the ring
-    // structure and be able to deal with wrap if it wants to read the data
-    // directly from the buffer.
-    //
-    ulRead = psBuffer->pfnCallback(psBuffer->pvCBData,
-                                   USB_EVENT_RX_AVAILABLE,
-                                   ulAvail,
-                                   (psVars->sRingBuf.pucBuf +
-                                    psVars->sRingBuf.ulReadIndex));
+        if((USBRingBufUsed(&psVars->sRingBuf) < psBuffer->ulRxThreshold) &&
+           !USBRingBufFull(&psVars->sRingBuf) &&
+           (!psBuffer->ulRxTimeoutmS ||
+            ((InternalUSBGetTime() - psVars->ulRxTime) <
+             psBuffer->ulRxTimeoutmS)))
+        {
+            return(ulRetCount);
+        }
+    }
 
     //
-    // If the client read anything from the buffer, update the read pointer.
+    // Tell the client about the data.
     //
-    USBRingBufAdvanceRead(&psVars->sRingBuf, ulRead);
+    NotifyRxAvailable(psBuffer);
 
     //
     // Return the correct value to the low level driver.
@@ -438,9 +759,17 @@ HandleTxComplete(tUSBBuffer *psBuffer, unsigned long ulSize)
 
     //
     // Update the transmit buffer read pointer to remove the data that has
-    // now been transmitted.
+    // now been transmitted.  The lower layer may report more than one packet
+    // at once if it had several queued.  A packet passed to it before the
+    // buffer was flushed is no longer in flight, so never remove more than
+    // is.
     //
+    if(ulSize > psVars->ulInFlight)
+    {
+        ulSize = psVars->ulInFlight;
+    }
     USBRingBufAdvanceRead(&psVars->sRingBuf, ulSize);
+    psVars->ulInFlight -= ulSize;
 
     //
     // Try to schedule the next packet transmission if data remains to be
@@ -506,7 +835,7 @@ HandleRequestBuffer(tUSBBuffer *psBuffer, unsigned long ulSize,
         //
         // Yes - return the current write pointer
         //
-        *ppucBuffer = psVars->sRingBuf.pucBuf + psVars->sRingBuf.ulWriteIndex;
+        *ppucBuffer = USBRingBufWritePtr(&psVars->sRingBuf);
         return(ulSize);
     }
     else
@@ -537,6 +866,14 @@ HandleRequestBuffer(tUSBBuffer *psBuffer, unsigned long ulSize,
 //! receive) and the functions to be called in the lower layer to transfer
 //! data to or from the USB controller.
 //!
+//! A receive buffer may be configured to coalesce its
+//! \b USB_EVENT_RX_AVAILABLE notifications by setting the \e ulRxThreshold
+//! and \e ulRxTimeoutmS fields of \e psBuffer.  In this case, the client is notified only once the
+//! threshold number of bytes has been received, the buffer is full or the
+//! oldest unnotified data has waited for the timeout period.  The timeout is
+//! driven by the USB library tick so this function registers a tick handler
+//! for the buffer and fails if none is available.
+//!
 //! \return Returns the original buffer structure pointer if successful or
 //! NULL if an error is detected.
 //
@@ -559,8 +896,28 @@ USBBufferInit(const tUSBBuffer *psBuffer)
     //
     psVars = psBuffer->pvWorkspace;
     psVars->ulFlags = 0;
-    USBRingBufInit(&psVars->sRingBuf, psBuffer->pcBuffer,
-                   psBuffer->ulBufferSize);
+    psVars->ulLastSent = 0;
+    psVars->ulInFlight = 0;
+    psVars->ulRxTime = 0;
+    psVars->ulSplitCount = 0;
+    psVars->ulSchedule = 0;
+    USBRingBufInitEx(&psVars->sRingBuf, psBuffer->pcBuffer,
+                     psBuffer->ulBufferSize, psBuffer->ulRingFlags);
+
+    //
+    // If this receive buffer coalesces notifications with a timeout, we need
+    // a tick to tell us when the timeout expires.
+    //
+    if(!psBuffer->bTransmitBuffer && psBuffer->ulRxThreshold &&
+       psBuffer->ulRxTimeoutmS)
+    {
+        InternalUSBTickInit();
+        if(InternalUSBRegisterTickHandler(BufferTickHandler,
+                                          (void *)psBuffer) < 0)
+        {
+            return((const tUSBBuffer *)0);
+        }
+    }
 
     //
     // If all is well, return the same pointer we were originally passed.
@@ -646,6 +1003,10 @@ USBBufferZeroLengthPacketInsert(const tUSBBuffer *psBuffer, tBoolean bSendZLP)
 //! client has written all data it wishes to send, it should call function
 //! USBBufferDataWritten() to indicate that transmission may begin.
 //!
+//! If the buffer was created with \b USB_RING_FLAG_POW2 in its \e ulRingFlags
+//! field, the indices returned are free-running and must be masked with
+//! (\e ulSize - 1) before being used as buffer offsets.
+//!
 //! \return None.
 //
 //*****************************************************************************
@@ -716,10 +1077,15 @@ USBBufferDataWritten(const tUSBBuffer *psBuffer, unsigned long ulLength)
 
     //
     // Advance the ring buffer write pointer to include the newly written
-    // data.
+    // data, first mirroring any of it which lies at the start of the ring
+    // into the slack area.
     //
     if(ulLength)
     {
+        if(psBuffer->ulSlackSize)
+        {
+            UpdateSlack(psBuffer, (unsigned char *)0, ulLength);
+        }
         USBRingBufAdvanceWrite(&psVars->sRingBuf, ulLength);
     }
 
@@ -773,9 +1139,167 @@ USBBufferDataRemoved(const tUSBBuffer *psBuffer, unsigned long ulLength)
     if(ulLength)
     {
         USBRingBufAdvanceRead(&psVars->sRingBuf, ulLength);
+        ResumeRx(psBuffer);
     }
 }
 
+//*****************************************************************************
+//
+//! Returns the data held in a USB buffer as up to two contiguous segments.
+//!
+//! \param psBuffer is the pointer to the buffer instance whose data is to be
+//! accessed.
+//! \param psRegion points to storage that will be written with the location
+//! and length of each segment of data in the buffer.
+//!
+//! This function allows a client to process the data in a buffer in place
+//! without copying it and without knowledge of the layout of the underlying
+//! ring buffer.  The oldest data is described by the first segment of
+//! \e psRegion.  If the data straddles the buffer wrap, the remainder is
+//! described by the second segment, otherwise the second segment has zero
+//! length.
+//!
+//! Once the client has finished with some or all of the data, it must call
+//! USBBufferDataRemoved() to commit the read, advancing the buffer read
+//! index in a single update.  A receive buffer client doing this from its
+//! \b USB_EVENT_RX_AVAILABLE callback should instead return the number of
+//! bytes consumed from the callback.
+//!
+//! \return Returns the total number of bytes described by \e psRegion.
+//
+//*****************************************************************************
+unsigned long
+USBBufferReadRegionGet(const tUSBBuffer *psBuffer, tUSBBufferRegion *psRegion)
+{
+    tUSBBufferVars *psVars;
+    unsigned long ulTotal, ulFirst;
+
+    //
+    // Check parameter validity.
+    //
+    ASSERT(psBuffer && psRegion);
+
+    //
+    // Get our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Take a single snapshot of the amount of data in the buffer and work
+    // out how much of it lies between the read pointer and the buffer end.
+    //
+    psRegion->pucData[0] = USBRingBufReadPtr(&psVars->sRingBuf);
+    ulTotal = USBRingBufUsed(&psVars->sRingBuf);
+    ulFirst = USBRingBufSize(&psVars->sRingBuf) -
+              (unsigned long)(psRegion->pucData[0] - psVars->sRingBuf.pucBuf);
+    ulFirst = (ulTotal < ulFirst) ? ulTotal : ulFirst;
+
+    //
+    // Any remaining data continues from the start of the buffer.
+    //
+    psRegion->ulLength[0] = ulFirst;
+    psRegion->pucData[1] = psVars->sRingBuf.pucBuf;
+    psRegion->ulLength[1] = ulTotal - ulFirst;
+
+    return(ulTotal);
+}
+
+//*****************************************************************************
+//
+//! Returns the free space in a USB buffer as up to two contiguous segments.
+//!
+//! \param psBuffer is the pointer to the buffer instance into which data is
+//! to be written.
+//! \param psRegion points to storage that will be written with the location
+//! and length of each segment of free space in the buffer.
+//!
+//! This function allows a client to build data directly in a buffer without
+//! copying it and without knowledge of the layout of the underlying ring
+//! buffer.  The free space immediately following the current data is
+//! described by the first segment of \e psRegion.  If the free space
+//! straddles the buffer wrap, the remainder is described by the second
+//! segment, otherwise the second segment has zero length.
+//!
+//! Once the client has written data into the region, filling the first
+//! segment before the second, it must call USBBufferDataWritten() to commit
+//! the write, advancing the buffer write index in a single update and, for a
+//! transmit buffer, scheduling transmission.
+//!
+//! \return Returns the total number of bytes described by \e psRegion.
+//
+//*****************************************************************************
+unsigned long
+USBBufferWriteRegionGet(const tUSBBuffer *psBuffer, tUSBBufferRegion *psRegion)
+{
+    tUSBBufferVars *psVars;
+    unsigned long ulTotal, ulFirst;
+
+    //
+    // Check parameter validity.
+    //
+    ASSERT(psBuffer && psRegion);
+
+    //
+    // Get our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Take a single snapshot of the amount of free space in the buffer and
+    // work out how much of it lies between the write pointer and the buffer
+    // end.
+    //
+    psRegion->pucData[0] = USBRingBufWritePtr(&psVars->sRingBuf);
+    ulTotal = USBRingBufFree(&psVars->sRingBuf);
+    ulFirst = USBRingBufSize(&psVars->sRingBuf) -
+              (unsigned long)(psRegion->pucData[0] - psVars->sRingBuf.pucBuf);
+    ulFirst = (ulTotal < ulFirst) ? ulTotal : ulFirst;
+
+    //
+    // Any remaining space continues from the start of the buffer.
+    //
+    psRegion->ulLength[0] = ulFirst;
+    psRegion->pucData[1] = psVars->sRingBuf.pucBuf;
+    psRegion->ulLength[1] = ulTotal - ulFirst;
+
+    return(ulTotal);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of packets which were split across the buffer wrap.
+//!
+//! \param psBuffer is the pointer to the transmit buffer instance whose
+//! information is being queried.
+//!
+//! When a packet of data straddles the wrap point of a transmit buffer and
+//! the remainder is not available in the slack area following the ring (see
+//! the \e ulSlackSize field of \e tUSBBuffer), the packet is passed to the
+//! lower layer in two transfers.  This function returns the number of times
+//! this has occurred since the buffer was initialized and may be used to
+//! check that the slack area is large enough.
+//!
+//! \return Returns the number of packets split across the buffer wrap.
+//
+//*****************************************************************************
+unsigned long
+USBBufferSplitCountGet(const tUSBBuffer *psBuffer)
+{
+    tUSBBufferVars *psVars;
+
+    //
+    // Check parameter validity.
+    //
+    ASSERT(psBuffer);
+
+    //
+    // Get our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    return(psVars->ulSplitCount);
+}
+
 //*****************************************************************************
 //
 //! Sets the callback pointer supplied to clients of this buffer.
@@ -875,6 +1399,10 @@ USBBufferWrite(const tUSBBuffer *psBuffer, const unsigned char *pucData,
     //
     if(ulLength)
     {
+        if(psBuffer->ulSlackSize)
+        {
+            UpdateSlack(psBuffer, pucData, ulLength);
+        }
         USBRingBufWrite(&psVars->sRingBuf, pucData, ulLength);
     }
 
@@ -900,6 +1428,13 @@ USBBufferWrite(const tUSBBuffer *psBuffer, const unsigned char *pucData,
 //! processing (transmitting it via the USB controller or passing it to the
 //! client depending upon the buffer mode).
 //!
+//! For a transmit buffer, packets already passed to the lower layer are
+//! forgotten too.  This is needed when the lower layer has dropped them
+//! without reporting their completion, as the bulk device does on a bus reset
+//! or configuration change, so the buffer should be flushed on
+//! \b USB_EVENT_CONNECTED.  Any such packet which is still sent is not taken
+//! as the completion of data written after the flush.
+//!
 //! \return None.
 //
 //*****************************************************************************
@@ -907,6 +1442,7 @@ void
 USBBufferFlush(const tUSBBuffer *psBuffer)
 {
     tUSBBufferVars *psVars;
+    tBoolean bIntsOff;
 
     //
     // Check parameter validity.
@@ -919,9 +1455,27 @@ USBBufferFlush(const tUSBBuffer *psBuffer)
     psVars = psBuffer->pvWorkspace;
 
     //
-    // Flush the ring buffer.
+    // Flush the ring buffer.  For a transmit buffer, forget the packets in
+    // flight at the same time since the USB interrupt reduces the in-flight
+    // count as it advances the read index.  Otherwise the first bytes written
+    // after the flush would be taken as already sent.
     //
-    USBRingBufFlush(&psVars->sRingBuf);
+    if(psBuffer->bTransmitBuffer)
+    {
+        bIntsOff = IntMasterDisable();
+        USBRingBufFlush(&psVars->sRingBuf);
+        psVars->ulInFlight = 0;
+        psVars->ulLastSent = 0;
+        if(!bIntsOff)
+        {
+            IntMasterEnable();
+        }
+    }
+    else
+    {
+        USBRingBufFlush(&psVars->sRingBuf);
+    }
+    ResumeRx(psBuffer);
 }
 
 //*****************************************************************************
@@ -977,6 +1531,7 @@ USBBufferRead(const tUSBBuffer *psBuffer, unsigned char *pucData,
     if(ulRead)
     {
         USBRingBufRead(&psVars->sRingBuf, pucData, ulRead);
+        ResumeRx(psBuffer);
     }
 
     //
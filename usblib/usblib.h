@@ -284,6 +284,8 @@ PACKED tUSBRequest;
 #define USB_DTYPE_INTERFACE_PWR 8
 #define USB_DTYPE_OTG           9
 #define USB_DTYPE_INTERFACE_ASC 11
+#define USB_DTYPE_BOS           15
+#define USB_DTYPE_DEVICE_CAP    16
 #define USB_DTYPE_CS_INTERFACE  36
 #define USB_DTYPE_HUB           41
 
@@ -912,6 +914,16 @@ typedef void (* tStdRequest)(void *pvInstance, tUSBRequest *pUSBRequest);
 //*****************************************************************************
 typedef void (* tInfoCallback)(void *pvInstance, unsigned long ulInfo);
 
+//*****************************************************************************
+//
+// Function prototype for a function which provides data to be streamed to the
+// host on endpoint zero.  The function is asked to write ulSize bytes,
+// starting ulOffset bytes into the data being sent, to pucBuffer.
+//
+//*****************************************************************************
+typedef void (* tUSBEP0Fill)(void *pvFillData, unsigned long ulOffset,
+                             unsigned char *pucBuffer, unsigned long ulSize);
+
 //*****************************************************************************
 //
 // Callback made to indicate that an interface alternate setting change has
@@ -1047,6 +1059,8 @@ typedef struct
     //! This field indicates whether to configure an endpoint's FIFO to be
     //! double- or single-buffered.  If true, a double-buffered FIFO is
     //! created and the amount of required FIFO storage is multiplied by two.
+    //! If false, bulk and isochronous endpoints are double-buffered
+    //! automatically when there is space in the FIFO RAM to do so.
     //
     tBoolean bDoubleBuffer;
 
@@ -1058,6 +1072,12 @@ typedef struct
     //! configures the endpoint using a call to USBDevEndpointConfigSet().
     //
     unsigned short usEPFlags;
+
+    //
+    //! This field prevents the endpoint's FIFO from being double-buffered
+    //! automatically.  It has no effect if bDoubleBuffer is true.
+    //
+    tBoolean bSingleBuffer;
 }
 tFIFOEntry;
 
@@ -1639,6 +1659,15 @@ typedef unsigned long (* tUSBPacketTransfer)(void *pvHandle,
 //*****************************************************************************
 typedef unsigned long (* tUSBPacketAvailable)(void *pvHandle);
 
+//*****************************************************************************
+//
+//! A function pointer type which describes a class driver function that a
+//! receive buffer calls whenever space is freed in the buffer.  This allows
+//! the class driver to deliver a packet it has been holding back.
+//
+//*****************************************************************************
+typedef void (* tUSBPacketResume)(void *pvHandle);
+
 //*****************************************************************************
 //
 //! The number of bytes of workspace that each USB buffer object requires.
@@ -1646,7 +1675,7 @@ typedef unsigned long (* tUSBPacketAvailable)(void *pvHandle);
 //! the \e pvWorkspace field of the \e tUSBBuffer structure.
 //
 //*****************************************************************************
-#define USB_BUFFER_WORKSPACE_SIZE 24
+#define USB_BUFFER_WORKSPACE_SIZE 44
 
 //*****************************************************************************
 //
@@ -1716,6 +1745,52 @@ typedef struct
     //! object can use for workspace.
     //
     void *pvWorkspace;
+
+    //
+    //! The mode flags passed to USBRingBufInitEx() when the ring buffer
+    //! underlying this instance is initialized.  This is a logical OR of
+    //! \b USB_RING_FLAG_xxx values or 0 for the default mode in which
+    //! index updates are made with interrupts disabled.
+    //
+    unsigned long ulRingFlags;
+
+    //
+    //! The number of bytes of slack memory following the ring buffer in a
+    //! transmit buffer or 0 if none is provided.  If non-zero, pcBuffer must
+    //! point to (ulBufferSize + ulSlackSize) bytes of memory.  Data written
+    //! to the start of the ring is mirrored into the slack so that packets
+    //! no larger than ulSlackSize which straddle the buffer wrap can still
+    //! be passed to the lower layer in a single transfer.  This is typically
+    //! set to the maximum packet size of the endpoint.
+    //
+    unsigned long ulSlackSize;
+
+    //
+    //! The number of bytes which a receive buffer must hold before the
+    //! client is sent \b USB_EVENT_RX_AVAILABLE or 0 to send the event on
+    //! every packet received.  If non-zero, the client is also notified when
+    //! the buffer becomes full or when ulRxTimeoutmS has elapsed.
+    //
+    unsigned long ulRxThreshold;
+
+    //
+    //! The maximum time, in milliseconds, that data may wait in a receive
+    //! buffer before the client is sent \b USB_EVENT_RX_AVAILABLE when
+    //! ulRxThreshold is non-zero.  This is measured from the arrival of the
+    //! first byte which the client has not yet been notified of, has a
+    //! resolution of the USB library tick and is only honored while the USB
+    //! library tick is running.  If 0, the client is notified only when the
+    //! threshold is reached.
+    //
+    unsigned long ulRxTimeoutmS;
+
+    //
+    //! The function which should be called whenever space is freed in a
+    //! receive buffer or NULL if the lower layer does not need to be told.
+    //! For a bulk device, this is USBDBulkRxResume().  It is ignored for
+    //! transmit buffers.
+    //
+    tUSBPacketResume pfnResume;
 }
 tUSBBuffer;
 
@@ -1746,9 +1821,54 @@ typedef struct
     //! The ring buffer.
     //
     unsigned char *pucBuf;
+
+    //
+    //! The mode flags passed to USBRingBufInitEx().
+    //
+    unsigned long ulFlags;
 }
 tUSBRingBufObject;
 
+//*****************************************************************************
+//
+//! The ring buffer is used by a single producer and a single consumer, each
+//! of which updates only its own index.  Index updates use ordered stores
+//! rather than disabling interrupts.
+//
+//*****************************************************************************
+#define USB_RING_FLAG_SPSC      0x00000001
+
+//*****************************************************************************
+//
+//! The ring buffer size is a power of two.  The read and write indices run
+//! freely and are masked to find the buffer offset, and the whole buffer can
+//! be used to hold data.
+//
+//*****************************************************************************
+#define USB_RING_FLAG_POW2      0x00000002
+
+//*****************************************************************************
+//
+//! The structure used to describe a region of a USB buffer as up to two
+//! contiguous segments.  The second segment is used only when the region
+//! spans the wrap point of the underlying ring buffer and, if unused, has
+//! zero length.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! Pointers to the first byte of each segment in the region.
+    //
+    unsigned char *pucData[2];
+
+    //
+    //! The number of bytes in each segment of the region.
+    //
+    unsigned long ulLength[2];
+}
+tUSBBufferRegion;
+
 //*****************************************************************************
 //
 // USB buffer API function prototypes.
@@ -1767,6 +1887,11 @@ extern void USBBufferDataWritten(const tUSBBuffer *psBuffer,
                                  unsigned long ulLength);
 extern void USBBufferDataRemoved(const tUSBBuffer *psBuffer,
                                  unsigned long ulLength);
+extern unsigned long USBBufferReadRegionGet(const tUSBBuffer *psBuffer,
+                                            tUSBBufferRegion *psRegion);
+extern unsigned long USBBufferWriteRegionGet(const tUSBBuffer *psBuffer,
+                                             tUSBBufferRegion *psRegion);
+extern unsigned long USBBufferSplitCountGet(const tUSBBuffer *psBuffer);
 extern void USBBufferFlush(const tUSBBuffer *psBuffer);
 extern unsigned long USBBufferRead(const tUSBBuffer *psBuffer,
                                    unsigned char *pucData,
@@ -1785,6 +1910,8 @@ extern unsigned long USBRingBufFree(tUSBRingBufObject *ptUSBRingBuf);
 extern unsigned long USBRingBufContigUsed(tUSBRingBufObject *ptUSBRingBuf);
 extern unsigned long USBRingBufContigFree(tUSBRingBufObject *ptUSBRingBuf);
 extern unsigned long USBRingBufSize(tUSBRingBufObject *ptUSBRingBuf);
+extern unsigned char *USBRingBufReadPtr(tUSBRingBufObject *ptUSBRingBuf);
+extern unsigned char *USBRingBufWritePtr(tUSBRingBufObject *ptUSBRingBuf);
 extern unsigned char USBRingBufReadOne(tUSBRingBufObject *ptUSBRingBuf);
 extern void USBRingBufRead(tUSBRingBufObject *ptUSBRingBuf,
                            unsigned char *pucData, unsigned long ulLength);
@@ -1799,6 +1926,9 @@ extern void USBRingBufAdvanceRead(tUSBRingBufObject *ptUSBRingBuf,
                                   unsigned long ulNumBytes);
 extern void USBRingBufInit(tUSBRingBufObject *ptUSBRingBuf,
                            unsigned char *pucBuf, unsigned long ulSize);
+extern void USBRingBufInitEx(tUSBRingBufObject *ptUSBRingBuf,
+                             unsigned char *pucBuf, unsigned long ulSize,
+                             unsigned long ulFlags);
 
 //*****************************************************************************
 //
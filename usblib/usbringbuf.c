@@ -43,18 +43,40 @@
 #define NULL                    ((void *)0)
 #endif
 
+//*****************************************************************************
+//
+// A data memory barrier.  This is used by ring buffers operating in single-
+// producer/single-consumer mode to ensure that accesses to the buffer data
+// are complete before an index is published to the other context and that a
+// newly observed index is read before the data it describes.
+//
+//*****************************************************************************
+#if defined(gcc) || defined(codered) || defined(sourcerygxx)
+#define RING_MEMORY_BARRIER()   __sync_synchronize()
+#elif defined(ccs)
+#define RING_MEMORY_BARRIER()   __asm("    dmb")
+#elif defined(ewarm)
+#define RING_MEMORY_BARRIER()   __asm("dmb")
+#elif defined(rvmdk) || defined(__ARMCC_VERSION)
+#define RING_MEMORY_BARRIER()   __dmb(0xf)
+#else
+#error Unrecognized COMPILER!
+#endif
+
 //*****************************************************************************
 //
 // Change the value of a variable atomically.
 //
 // \param pulVal points to the index whose value is to be modified.
 // \param ulDelta is the number of bytes to increment the index by.
-// \param ulSize is the size of the buffer the index refers to.
+// \param ulSize is the size of the buffer the index refers to or 0 if the
+// index is free-running.
 //
 // This function is used to increment a read or write buffer index that may be
 // written in various different contexts.  It ensures that the
 // read/modify/write sequence is not interrupted and, hence, guards against
-// corruption of the variable.  The new value is adjusted for buffer wrap.
+// corruption of the variable.  The new value is adjusted for buffer wrap
+// unless the index is free-running.
 //
 // \return None.
 //
@@ -80,9 +102,12 @@ UpdateIndexAtomic(volatile unsigned long *pulVal, unsigned long ulDelta,
     // modulus operation with interrupts off but we don't want to fail in
     // case ulDelta is greater than ulSize (which is extremely unlikely but...)
     //
-    while(*pulVal >= ulSize)
+    if(ulSize)
     {
-        *pulVal -= ulSize;
+        while(*pulVal >= ulSize)
+        {
+            *pulVal -= ulSize;
+        }
     }
 
     //
@@ -94,6 +119,150 @@ UpdateIndexAtomic(volatile unsigned long *pulVal, unsigned long ulDelta,
     }
 }
 
+//*****************************************************************************
+//
+// Change the value of an index owned by the calling context.
+//
+// \param pulVal points to the index whose value is to be modified.
+// \param ulDelta is the number of bytes to increment the index by.
+// \param ulSize is the size of the buffer the index refers to or 0 if the
+// index is free-running.
+//
+// This function is used in place of UpdateIndexAtomic() for ring buffers
+// initialized with \b USB_RING_FLAG_SPSC.  In that mode only the producer
+// ever writes the write index and only the consumer ever writes the read
+// index so the read/modify/write sequence cannot race with another writer and
+// interrupts need not be disabled.  The new value is computed locally and
+// published with a single store after a memory barrier, ensuring that the
+// other context never sees an index that runs ahead of the buffer data.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+UpdateIndexOrdered(volatile unsigned long *pulVal, unsigned long ulDelta,
+                   unsigned long ulSize)
+{
+    unsigned long ulNew;
+
+    //
+    // Calculate the new index value, correcting for wrap if necessary.
+    //
+    ulNew = *pulVal + ulDelta;
+    if(ulSize)
+    {
+        while(ulNew >= ulSize)
+        {
+            ulNew -= ulSize;
+        }
+    }
+
+    //
+    // Make sure that all data accesses made by this context are complete
+    // before the other context can see the new index value.
+    //
+    RING_MEMORY_BARRIER();
+
+    //
+    // Publish the new index.
+    //
+    *pulVal = ulNew;
+}
+
+//*****************************************************************************
+//
+// Advance one of the ring buffer indices.
+//
+// \param ptUSBRingBuf is the ring buffer whose index is to be advanced.
+// \param pulVal points to the index whose value is to be modified.
+// \param ulDelta is the number of bytes to increment the index by.
+//
+// This function selects the index update method appropriate to the mode in
+// which the ring buffer was initialized.  Indices of power-of-two ring
+// buffers are free-running and are not wrapped here.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+UpdateIndex(tUSBRingBufObject *ptUSBRingBuf, volatile unsigned long *pulVal,
+            unsigned long ulDelta)
+{
+    unsigned long ulSize;
+
+    //
+    // Free-running indices are never wrapped.
+    //
+    ulSize = (ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2) ? 0 :
+             ptUSBRingBuf->ulSize;
+
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
+    {
+        UpdateIndexOrdered(pulVal, ulDelta, ulSize);
+    }
+    else
+    {
+        UpdateIndexAtomic(pulVal, ulDelta, ulSize);
+    }
+}
+
+//*****************************************************************************
+//
+// Convert a ring buffer index into an offset into the buffer memory.
+//
+// \param ptUSBRingBuf is the ring buffer the index refers to.
+// \param ulIndex is the read or write index to convert.
+//
+// The indices of a ring buffer initialized with \b USB_RING_FLAG_POW2 are
+// free-running and are masked to find the buffer offset.  In all other modes
+// the index is already an offset.
+//
+// \return Returns the buffer offset corresponding to \e ulIndex.
+//
+//*****************************************************************************
+static unsigned long
+IndexToOffset(tUSBRingBufObject *ptUSBRingBuf, unsigned long ulIndex)
+{
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        return(ulIndex & (ptUSBRingBuf->ulSize - 1));
+    }
+    else
+    {
+        return(ulIndex);
+    }
+}
+
+//*****************************************************************************
+//
+// Copy a block of bytes between a ring buffer and a linear client buffer.
+//
+// \param pucDst points to the first byte of the destination.
+// \param pucSrc points to the first byte of the source.
+// \param ulCount is the number of bytes to copy.
+//
+// This function copies a single contiguous span of data.  It is used by
+// USBRingBufRead() and USBRingBufWrite() to move data in at most two spans
+// (either side of the buffer wrap) so that the ring indices need only be
+// updated once per call rather than once per byte.  The library does not
+// depend upon the C runtime so a simple loop is used in place of memcpy().
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+CopyBytes(unsigned char *pucDst, const unsigned char *pucSrc,
+          unsigned long ulCount)
+{
+    //
+    // Copy the span one byte at a time.
+    //
+    while(ulCount--)
+    {
+        *pucDst++ = *pucSrc++;
+    }
+}
+
 //*****************************************************************************
 //
 //! Determines whether a ring buffer is full or not.
@@ -126,8 +295,14 @@ USBRingBufFull(tUSBRingBufObject *ptUSBRingBuf)
     ulRead = ptUSBRingBuf->ulReadIndex;
 
     //
-    // Return the full status of the buffer.
+    // Return the full status of the buffer.  Power-of-two buffers use every
+    // byte so are full when the free-running indices are a buffer apart.
     //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        return(((ulWrite - ulRead) == ptUSBRingBuf->ulSize) ? true : false);
+    }
+
     return((((ulWrite + 1) % ptUSBRingBuf->ulSize) == ulRead) ? true : false);
 }
 
@@ -176,6 +351,9 @@ USBRingBufEmpty(tUSBRingBufObject *ptUSBRingBuf)
 //!
 //! Discards all data from the ring buffer.
 //!
+//! \note If the ring buffer was initialized with \b USB_RING_FLAG_SPSC, this
+//! function may only be called from the consumer context.
+//!
 //! \return None.
 //
 //*****************************************************************************
@@ -189,6 +367,17 @@ USBRingBufFlush(tUSBRingBufObject *ptUSBRingBuf)
     //
     ASSERT(ptUSBRingBuf != NULL);
 
+    //
+    // In single-producer/single-consumer mode, the read index belongs to the
+    // caller so it can be moved up to the current write index without
+    // disabling interrupts.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
+    {
+        ptUSBRingBuf->ulReadIndex = ptUSBRingBuf->ulWriteIndex;
+        return;
+    }
+
     //
     // Set the Read/Write pointers to be the same.  Do this with interrupts
     // disabled to prevent the possibility of corruption of the read index.
@@ -229,6 +418,14 @@ USBRingBufUsed(tUSBRingBufObject *ptUSBRingBuf)
     ulWrite = ptUSBRingBuf->ulWriteIndex;
     ulRead = ptUSBRingBuf->ulReadIndex;
 
+    //
+    // Free-running indices never need to be corrected for wrap.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        return(ulWrite - ulRead);
+    }
+
     //
     // Return the number of bytes contained in the ring buffer.
     //
@@ -255,6 +452,14 @@ USBRingBufFree(tUSBRingBufObject *ptUSBRingBuf)
     //
     ASSERT(ptUSBRingBuf != NULL);
 
+    //
+    // Power-of-two buffers can be completely filled.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        return(ptUSBRingBuf->ulSize - USBRingBufUsed(ptUSBRingBuf));
+    }
+
     //
     // Return the number of bytes available in the ring buffer.
     //
@@ -292,6 +497,17 @@ USBRingBufContigUsed(tUSBRingBufObject *ptUSBRingBuf)
     ulWrite = ptUSBRingBuf->ulWriteIndex;
     ulRead = ptUSBRingBuf->ulReadIndex;
 
+    //
+    // For a power-of-two buffer, the contiguous data is limited by the total
+    // data and the distance from the read offset to the end of the buffer.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        ulWrite -= ulRead;
+        ulRead = ptUSBRingBuf->ulSize - IndexToOffset(ptUSBRingBuf, ulRead);
+        return((ulWrite < ulRead) ? ulWrite : ulRead);
+    }
+
     //
     // Return the number of contiguous bytes available.
     //
@@ -329,6 +545,18 @@ USBRingBufContigFree(tUSBRingBufObject *ptUSBRingBuf)
     ulWrite = ptUSBRingBuf->ulWriteIndex;
     ulRead = ptUSBRingBuf->ulReadIndex;
 
+    //
+    // For a power-of-two buffer, the contiguous space is limited by the total
+    // free space and the distance from the write offset to the end of the
+    // buffer.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+    {
+        ulRead = ptUSBRingBuf->ulSize - (ulWrite - ulRead);
+        ulWrite = ptUSBRingBuf->ulSize - IndexToOffset(ptUSBRingBuf, ulWrite);
+        return((ulRead < ulWrite) ? ulRead : ulWrite);
+    }
+
     //
     // Return the number of contiguous bytes available.
     //
@@ -379,6 +607,62 @@ USBRingBufSize(tUSBRingBufObject *ptUSBRingBuf)
     return(ptUSBRingBuf->ulSize);
 }
 
+//*****************************************************************************
+//
+//! Returns a pointer to the oldest byte of data in a ring buffer.
+//!
+//! \param ptUSBRingBuf is the ring buffer object to check.
+//!
+//! This function returns a pointer to the buffer memory at the current read
+//! index.  Together with USBRingBufContigUsed(), it allows a client to access
+//! data in place without knowing how the ring buffer indices are encoded.
+//!
+//! \return Returns a pointer to the byte at the read index.
+//
+//*****************************************************************************
+unsigned char *
+USBRingBufReadPtr(tUSBRingBufObject *ptUSBRingBuf)
+{
+    //
+    // Check the arguments.
+    //
+    ASSERT(ptUSBRingBuf != NULL);
+
+    //
+    // Return a pointer to the byte at the current read index.
+    //
+    return(ptUSBRingBuf->pucBuf +
+           IndexToOffset(ptUSBRingBuf, ptUSBRingBuf->ulReadIndex));
+}
+
+//*****************************************************************************
+//
+//! Returns a pointer to the first free byte in a ring buffer.
+//!
+//! \param ptUSBRingBuf is the ring buffer object to check.
+//!
+//! This function returns a pointer to the buffer memory at the current write
+//! index.  Together with USBRingBufContigFree(), it allows a client to add
+//! data in place without knowing how the ring buffer indices are encoded.
+//!
+//! \return Returns a pointer to the byte at the write index.
+//
+//*****************************************************************************
+unsigned char *
+USBRingBufWritePtr(tUSBRingBufObject *ptUSBRingBuf)
+{
+    //
+    // Check the arguments.
+    //
+    ASSERT(ptUSBRingBuf != NULL);
+
+    //
+    // Return a pointer to the byte at the current write index.
+    //
+    return(ptUSBRingBuf->pucBuf +
+           IndexToOffset(ptUSBRingBuf, ptUSBRingBuf->ulWriteIndex));
+}
+
 //*****************************************************************************
 //
 //! Reads a single byte of data from a ring buffer.
@@ -406,14 +690,24 @@ USBRingBufReadOne(tUSBRingBufObject *ptUSBRingBuf)
     ASSERT(USBRingBufUsed(ptUSBRingBuf) != 0);
 
     //
-    // Write the data byte.
+    // In single-producer/single-consumer mode, make sure the data is not
+    // read before the write index that told the caller it was there.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
+    {
+        RING_MEMORY_BARRIER();
+    }
+
+    //
+    // Read the data byte.
     //
-    ucTemp = ptUSBRingBuf->pucBuf[ptUSBRingBuf->ulReadIndex];
+    ucTemp = ptUSBRingBuf->pucBuf[IndexToOffset(ptUSBRingBuf,
+                                                ptUSBRingBuf->ulReadIndex)];
 
     //
     // Increment the read index.
     //
-    UpdateIndexAtomic(&ptUSBRingBuf->ulReadIndex, 1, ptUSBRingBuf->ulSize);
+    UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulReadIndex, 1);
 
     //
     // Return the character read.
@@ -438,7 +732,7 @@ void
 USBRingBufRead(tUSBRingBufObject *ptUSBRingBuf, unsigned char *pucData,
                unsigned long ulLength)
 {
-    unsigned long ulTemp;
+    unsigned long ulRead, ulFirst;
 
     //
     // Check the arguments.
@@ -453,12 +747,37 @@ USBRingBufRead(tUSBRingBufObject *ptUSBRingBuf, unsigned char *pucData,
     ASSERT(ulLength <= USBRingBufUsed(ptUSBRingBuf));
 
     //
-    // Read the data from the ring buffer.
+    // In single-producer/single-consumer mode, make sure the data is not
+    // read before the write index that told the caller it was there.
     //
-    for(ulTemp = 0; ulTemp < ulLength; ulTemp++)
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
     {
-        pucData[ulTemp] = USBRingBufReadOne(ptUSBRingBuf);
+        RING_MEMORY_BARRIER();
     }
+
+    //
+    // How many of the requested bytes lie between the read index and the
+    // end of the buffer?
+    //
+    ulRead = IndexToOffset(ptUSBRingBuf, ptUSBRingBuf->ulReadIndex);
+    ulFirst = ptUSBRingBuf->ulSize - ulRead;
+    ulFirst = (ulFirst < ulLength) ? ulFirst : ulLength;
+
+    //
+    // Copy the data up to the buffer wrap then, if the data straddles the
+    // wrap, copy the remainder from the start of the buffer.
+    //
+    CopyBytes(pucData, ptUSBRingBuf->pucBuf + ulRead, ulFirst);
+    if(ulFirst < ulLength)
+    {
+        CopyBytes(pucData + ulFirst, ptUSBRingBuf->pucBuf,
+                  ulLength - ulFirst);
+    }
+
+    //
+    // Remove all the data we copied from the buffer in a single update.
+    //
+    UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulReadIndex, ulLength);
 }
 
 //*****************************************************************************
@@ -498,8 +817,7 @@ USBRingBufAdvanceRead(tUSBRingBufObject *ptUSBRingBuf,
     //
     // Advance the buffer read index by the required number of bytes.
     //
-    UpdateIndexAtomic(&ptUSBRingBuf->ulReadIndex, ulCount,
-                      ptUSBRingBuf->ulSize);
+    UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulReadIndex, ulCount);
 }
 
 //*****************************************************************************
@@ -556,15 +874,27 @@ USBRingBufAdvanceWrite(tUSBRingBufObject *ptUSBRingBuf,
     //
     ASSERT(ulCount >= ulNumBytes);
 
+    //
+    // In single-producer/single-consumer mode, publish the new write index
+    // after the data.  The read index belongs to the consumer so no attempt
+    // is made to fix it up if the client overflowed the buffer.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
+    {
+        UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulWriteIndex, ulNumBytes);
+        return;
+    }
+
     //
     // Update the write pointer.
     //
     ptUSBRingBuf->ulWriteIndex += ulNumBytes;
 
     //
-    // Check and correct for wrap.
+    // Check and correct for wrap.  Free-running indices are never wrapped.
     //
-    if(ptUSBRingBuf->ulWriteIndex >= ptUSBRingBuf->ulSize)
+    if(!(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2) &&
+       (ptUSBRingBuf->ulWriteIndex >= ptUSBRingBuf->ulSize))
     {
         ptUSBRingBuf->ulWriteIndex -= ptUSBRingBuf->ulSize;
     }
@@ -581,8 +911,15 @@ USBRingBufAdvanceWrite(tUSBRingBufObject *ptUSBRingBuf,
     {
         //
         // Yes - we need to advance the read pointer to ahead of the write
-        // pointer to discard some of the oldest data.
+        // pointer to discard some of the oldest data.  A power-of-two buffer
+        // has no unused byte so is left full.
         //
+        if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_POW2)
+        {
+            ptUSBRingBuf->ulReadIndex = (ptUSBRingBuf->ulWriteIndex -
+                                         ptUSBRingBuf->ulSize);
+            return;
+        }
         ptUSBRingBuf->ulReadIndex = ptUSBRingBuf->ulWriteIndex + 1;
 
         //
@@ -621,15 +958,25 @@ USBRingBufWriteOne(tUSBRingBufObject *ptUSBRingBuf, unsigned char ucData)
     //
     ASSERT(USBRingBufFree(ptUSBRingBuf) != 0);
 
+    //
+    // In single-producer/single-consumer mode, make sure the space is not
+    // written before the read index that told the caller it was free.
+    //
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
+    {
+        RING_MEMORY_BARRIER();
+    }
+
     //
     // Write the data byte.
     //
-    ptUSBRingBuf->pucBuf[ptUSBRingBuf->ulWriteIndex] = ucData;
+    ptUSBRingBuf->pucBuf[IndexToOffset(ptUSBRingBuf,
+                                       ptUSBRingBuf->ulWriteIndex)] = ucData;
 
     //
     // Increment the write index.
     //
-    UpdateIndexAtomic(&ptUSBRingBuf->ulWriteIndex, 1, ptUSBRingBuf->ulSize);
+    UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulWriteIndex, 1);
 }
 
 //*****************************************************************************
@@ -649,7 +996,7 @@ void
 USBRingBufWrite(tUSBRingBufObject *ptUSBRingBuf, const unsigned char *pucData,
                 unsigned long ulLength)
 {
-    unsigned long ulTemp;
+    unsigned long ulWrite, ulFirst;
 
     //
     // Check the arguments.
@@ -664,12 +1011,37 @@ USBRingBufWrite(tUSBRingBufObject *ptUSBRingBuf, const unsigned char *pucData,
     ASSERT(ulLength <= USBRingBufFree(ptUSBRingBuf));
 
     //
-    // Write the data into the ring buffer.
+    // In single-producer/single-consumer mode, make sure the space is not
+    // written before the read index that told the caller it was free.
     //
-    for(ulTemp = 0; ulTemp < ulLength; ulTemp++)
+    if(ptUSBRingBuf->ulFlags & USB_RING_FLAG_SPSC)
     {
-        USBRingBufWriteOne(ptUSBRingBuf, pucData[ulTemp]);
+        RING_MEMORY_BARRIER();
     }
+
+    //
+    // How many of the bytes can be written between the write index and the
+    // end of the buffer?
+    //
+    ulWrite = IndexToOffset(ptUSBRingBuf, ptUSBRingBuf->ulWriteIndex);
+    ulFirst = ptUSBRingBuf->ulSize - ulWrite;
+    ulFirst = (ulFirst < ulLength) ? ulFirst : ulLength;
+
+    //
+    // Copy the data up to the buffer wrap then, if the data straddles the
+    // wrap, copy the remainder to the start of the buffer.
+    //
+    CopyBytes(ptUSBRingBuf->pucBuf + ulWrite, pucData, ulFirst);
+    if(ulFirst < ulLength)
+    {
+        CopyBytes(ptUSBRingBuf->pucBuf, pucData + ulFirst,
+                  ulLength - ulFirst);
+    }
+
+    //
+    // Add all the new data to the buffer in a single update.
+    //
+    UpdateIndex(ptUSBRingBuf, &ptUSBRingBuf->ulWriteIndex, ulLength);
 }
 
 //*****************************************************************************
@@ -681,6 +1053,9 @@ USBRingBufWrite(tUSBRingBufObject *ptUSBRingBuf, const unsigned char *pucData,
 //! \param ulSize is the size of the buffer in bytes.
 //!
 //! This function initializes a ring buffer object, preparing it to store data.
+//! The ring buffer operates in the default mode in which index updates are
+//! protected by disabling interrupts.  To select a different mode, use
+//! USBRingBufInitEx().
 //!
 //! \return None.
 //
@@ -688,6 +1063,52 @@ USBRingBufWrite(tUSBRingBufObject *ptUSBRingBuf, const unsigned char *pucData,
 void
 USBRingBufInit(tUSBRingBufObject *ptUSBRingBuf, unsigned char *pucBuf,
                unsigned long ulSize)
+{
+    //
+    // Initialize the ring buffer in the default mode.
+    //
+    USBRingBufInitEx(ptUSBRingBuf, pucBuf, ulSize, 0);
+}
+
+//*****************************************************************************
+//
+//! Initializes a ring buffer object in a given mode.
+//!
+//! \param ptUSBRingBuf points to the ring buffer to be initialized.
+//! \param pucBuf points to the data buffer to be used for the ring buffer.
+//! \param ulSize is the size of the buffer in bytes.
+//! \param ulFlags selects the ring buffer mode.  This is a logical OR of
+//! \b USB_RING_FLAG_xxx values or 0 for the default mode.
+//!
+//! This function initializes a ring buffer object, preparing it to store data
+//! and selecting the method used to update the buffer indices.
+//!
+//! If \b USB_RING_FLAG_SPSC is specified, the ring buffer is used by exactly
+//! one producer and exactly one consumer, for example a USB interrupt handler
+//! writing data and the application main loop reading it.  In this mode the
+//! read and write indices are each updated by a single context using ordered
+//! loads and stores and interrupts are never disabled.  The producer must
+//! only call USBRingBufWrite(), USBRingBufWriteOne() and
+//! USBRingBufAdvanceWrite() and the consumer must only call USBRingBufRead(),
+//! USBRingBufReadOne(), USBRingBufAdvanceRead() and USBRingBufFlush().  Either
+//! context may query the buffer state.
+//!
+//! If \b USB_RING_FLAG_POW2 is specified, \e ulSize must be a power of two.
+//! The read and write indices then run freely and are masked with
+//! (\e ulSize - 1) to find the buffer offset, avoiding any wrap comparisons
+//! when indices are updated.  Since the buffer is empty when the indices are
+//! equal and full when they are \e ulSize apart, all \e ulSize bytes of the
+//! buffer can hold data rather than the usual (\e ulSize - 1).  Clients that
+//! access the buffer directly using indices obtained from the ring buffer
+//! structure must mask them before use or use USBRingBufReadPtr() and
+//! USBRingBufWritePtr().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBRingBufInitEx(tUSBRingBufObject *ptUSBRingBuf, unsigned char *pucBuf,
+                 unsigned long ulSize, unsigned long ulFlags)
 {
     //
     // Check the arguments.
@@ -695,12 +1116,14 @@ USBRingBufInit(tUSBRingBufObject *ptUSBRingBuf, unsigned char *pucBuf,
     ASSERT(ptUSBRingBuf != NULL);
     ASSERT(pucBuf != NULL);
     ASSERT(ulSize != 0);
+    ASSERT(!(ulFlags & USB_RING_FLAG_POW2) || !(ulSize & (ulSize - 1)));
 
     //
     // Initialize the ring buffer object.
     //
     ptUSBRingBuf->ulSize = ulSize;
     ptUSBRingBuf->pucBuf = pucBuf;
+    ptUSBRingBuf->ulFlags = ulFlags;
     ptUSBRingBuf->ulWriteIndex = ptUSBRingBuf->ulReadIndex = 0;
 }
 
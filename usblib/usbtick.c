@@ -157,6 +157,7 @@ InternalUSBRegisterTickHandler(tUSBTickHandler pfHandler,
             // Save the instance data.
             //
             g_pvTickInstance[lIdx] = pvInstance;
+            break;
         }
     }
 